@@ -40,7 +40,8 @@ SOURCES += \
     Network/Message.cpp \
     KnownExtensions.cpp \
     Hash_noShare.cpp \
-    Hash_share.cpp
+    Hash_share.cpp \
+    Containers/RoaringBitmap.cpp
 
 HEADERS += Hashes.h \
     Hash.h \
@@ -73,6 +74,7 @@ HEADERS += Hashes.h \
     Containers/SortedList.h \
     Containers/SortedArray.h \
     Containers/MapArray.h \
+    Containers/RoaringBitmap.h \
     SelfWeakPointer.h \
     Hash_noShare.h \
     Hash_share.h
@@ -36,7 +36,11 @@ const quint16 Constants::DEFAULT_CORE_REMOTE_CONTROL_PORT { 59485 };
    const QString Constants::FILE_EXTENSION("bin");
 #endif
 
-const QString Constants::FILE_CACHE("cache." + FILE_EXTENSION); ///< The name of the file cache saved in the local data directory.
+const QString Constants::FILE_CACHE("files_cache.bin"); ///< The name of the file cache saved in the local data directory, always binary.
+const QString Constants::FILE_CACHE_LEGACY("cache." + FILE_EXTENSION); ///< The file cache of the previous versions, converted once to 'FILE_CACHE'.
+const QString Constants::FILE_INDEX_SNAPSHOT("index_snapshot.bin"); ///< The search indexes saved alongside the file cache, always binary.
+const QString Constants::FILE_CACHE_JOURNAL("cache_journal.bin"); ///< The changes of the file cache since it was saved, always binary.
+const QString Constants::FILE_HASH_STORE("hashes.bin"); ///< The hashes of the chunks mapped in memory, referenced by the file cache. Always binary.
 const QString Constants::FILE_QUEUE("queue." + FILE_EXTENSION); ///< This file contains the current downloads.
 const QString Constants::DIR_CHAT_MESSAGES("chat");
 const QString Constants::FILE_CHAT_MESSAGES("messages." + FILE_EXTENSION); ///< This file contains the last chat messages.
@@ -36,6 +36,10 @@ namespace Common
       static const QString FILE_EXTENSION;
 
       static const QString FILE_CACHE;
+      static const QString FILE_CACHE_LEGACY;
+      static const QString FILE_INDEX_SNAPSHOT;
+      static const QString FILE_CACHE_JOURNAL;
+      static const QString FILE_HASH_STORE;
       static const QString FILE_QUEUE;
       static const QString DIR_CHAT_MESSAGES;
       static const QString FILE_CHAT_MESSAGES;
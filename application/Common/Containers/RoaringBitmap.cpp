@@ -0,0 +1,395 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <Containers/RoaringBitmap.h>
+using namespace Common;
+
+#include <algorithm>
+#include <iterator>
+
+#include <QtAlgorithms>
+
+const int RoaringBitmap::ARRAY_MAX_SIZE(4096); ///< Above this cardinality an array takes more memory than a bitmap.
+const int RoaringBitmap::BITMAP_NB_WORDS(65536 / 64);
+
+bool RoaringBitmap::Container::contains(quint16 value) const
+{
+   if (this->isBitmap())
+      return this->bitmap[value >> 6] & Q_UINT64_C(1) << (value & 63);
+
+   return std::binary_search(this->array.constBegin(), this->array.constEnd(), value);
+}
+
+/**
+  * @return 'false' if the value was already in the container.
+  */
+bool RoaringBitmap::Container::add(quint16 value)
+{
+   if (this->isBitmap())
+   {
+      quint64& word = this->bitmap[value >> 6];
+      const quint64 mask = Q_UINT64_C(1) << (value & 63);
+      if (word & mask)
+         return false;
+      word |= mask;
+      this->cardinality++;
+      return true;
+   }
+
+   auto i = std::lower_bound(this->array.begin(), this->array.end(), value);
+   if (i != this->array.end() && *i == value)
+      return false;
+
+   this->array.insert(i, value);
+   this->cardinality++;
+   this->normalize();
+   return true;
+}
+
+/**
+  * @return 'false' if the value wasn't in the container.
+  */
+bool RoaringBitmap::Container::remove(quint16 value)
+{
+   if (this->isBitmap())
+   {
+      quint64& word = this->bitmap[value >> 6];
+      const quint64 mask = Q_UINT64_C(1) << (value & 63);
+      if (!(word & mask))
+         return false;
+      word &= ~mask;
+      this->cardinality--;
+      this->normalize();
+      return true;
+   }
+
+   auto i = std::lower_bound(this->array.begin(), this->array.end(), value);
+   if (i == this->array.end() || *i != value)
+      return false;
+
+   this->array.erase(i);
+   this->cardinality--;
+   return true;
+}
+
+QVector<quint64> RoaringBitmap::Container::toBitmap() const
+{
+   if (this->isBitmap())
+      return this->bitmap;
+
+   QVector<quint64> words(BITMAP_NB_WORDS, 0);
+   for (auto i = this->array.constBegin(); i != this->array.constEnd(); ++i)
+      words[*i >> 6] |= Q_UINT64_C(1) << (*i & 63);
+   return words;
+}
+
+void RoaringBitmap::Container::setBitmap(const QVector<quint64>& words)
+{
+   this->array.clear();
+   this->bitmap = words;
+   this->cardinality = 0;
+   for (auto i = this->bitmap.constBegin(); i != this->bitmap.constEnd(); ++i)
+      this->cardinality += qPopulationCount(*i);
+   this->normalize();
+}
+
+/**
+  * Choose the representation taking the less memory.
+  */
+void RoaringBitmap::Container::normalize()
+{
+   if (this->isBitmap() && this->cardinality <= ARRAY_MAX_SIZE)
+   {
+      this->array.clear();
+      this->array.reserve(this->cardinality);
+      for (int i = 0; i < this->bitmap.size(); i++)
+         for (quint64 word = this->bitmap[i]; word; word &= word - 1)
+            this->array << static_cast<quint16>(i * 64 + qCountTrailingZeroBits(word));
+      this->bitmap.clear();
+   }
+   else if (!this->isBitmap() && this->cardinality > ARRAY_MAX_SIZE)
+   {
+      this->bitmap = this->toBitmap();
+      this->array.clear();
+   }
+}
+
+/////
+
+RoaringBitmap::RoaringBitmap()
+{
+}
+
+/**
+  * @return 'false' if the value was already in the set.
+  */
+bool RoaringBitmap::add(quint32 value)
+{
+   const quint16 key = value >> 16;
+   int i = this->indexOf(key);
+   if (i < 0)
+   {
+      i = -i - 1;
+      this->containers.insert(i, Container(key));
+   }
+   return this->containers[i].add(value & 0xFFFF);
+}
+
+/**
+  * @return 'false' if the value wasn't in the set.
+  */
+bool RoaringBitmap::remove(quint32 value)
+{
+   const int i = this->indexOf(value >> 16);
+   if (i < 0)
+      return false;
+
+   Container& container = this->containers[i];
+   if (!container.remove(value & 0xFFFF))
+      return false;
+
+   if (container.cardinality == 0)
+      this->containers.remove(i);
+   return true;
+}
+
+bool RoaringBitmap::contains(quint32 value) const
+{
+   const int i = this->indexOf(value >> 16);
+   return i >= 0 && this->containers[i].contains(value & 0xFFFF);
+}
+
+int RoaringBitmap::cardinality() const
+{
+   int n = 0;
+   for (auto i = this->containers.constBegin(); i != this->containers.constEnd(); ++i)
+      n += i->cardinality;
+   return n;
+}
+
+bool RoaringBitmap::isEmpty() const
+{
+   return this->containers.isEmpty();
+}
+
+void RoaringBitmap::clear()
+{
+   this->containers.clear();
+}
+
+RoaringBitmap& RoaringBitmap::operator&=(const RoaringBitmap& other)
+{
+   QVector<Container> result;
+
+   int j = 0;
+   for (int i = 0; i < this->containers.size() && j < other.containers.size(); i++)
+   {
+      const Container& c1 = this->containers[i];
+      while (j < other.containers.size() && other.containers[j].key < c1.key)
+         j++;
+      if (j == other.containers.size() || other.containers[j].key != c1.key)
+         continue;
+
+      const Container& c2 = other.containers[j];
+      Container container(c1.key);
+
+      if (!c1.isBitmap() && !c2.isBitmap())
+      {
+         std::set_intersection(c1.array.constBegin(), c1.array.constEnd(), c2.array.constBegin(), c2.array.constEnd(), std::back_inserter(container.array));
+         container.cardinality = container.array.size();
+      }
+      else if (!c1.isBitmap() || !c2.isBitmap())
+      {
+         // Each value of the array is tested against the bitmap.
+         const Container& array = c1.isBitmap() ? c2 : c1;
+         const Container& bitmap = c1.isBitmap() ? c1 : c2;
+         for (auto k = array.array.constBegin(); k != array.array.constEnd(); ++k)
+            if (bitmap.contains(*k))
+               container.array << *k;
+         container.cardinality = container.array.size();
+      }
+      else
+      {
+         QVector<quint64> words(c1.bitmap);
+         for (int k = 0; k < BITMAP_NB_WORDS; k++)
+            words[k] &= c2.bitmap[k];
+         container.setBitmap(words);
+      }
+
+      if (container.cardinality > 0)
+         result << container;
+   }
+
+   this->containers = result;
+   return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator|=(const RoaringBitmap& other)
+{
+   QVector<Container> result;
+   result.reserve(this->containers.size() + other.containers.size());
+
+   int i = 0, j = 0;
+   while (i < this->containers.size() || j < other.containers.size())
+   {
+      if (j == other.containers.size() || i < this->containers.size() && this->containers[i].key < other.containers[j].key)
+      {
+         result << this->containers[i++];
+      }
+      else if (i == this->containers.size() || other.containers[j].key < this->containers[i].key)
+      {
+         result << other.containers[j++];
+      }
+      else
+      {
+         const Container& c1 = this->containers[i++];
+         const Container& c2 = other.containers[j++];
+         Container container(c1.key);
+
+         if (!c1.isBitmap() && !c2.isBitmap() && c1.cardinality + c2.cardinality <= ARRAY_MAX_SIZE)
+         {
+            std::set_union(c1.array.constBegin(), c1.array.constEnd(), c2.array.constBegin(), c2.array.constEnd(), std::back_inserter(container.array));
+            container.cardinality = container.array.size();
+         }
+         else
+         {
+            QVector<quint64> words = c1.toBitmap();
+            if (c2.isBitmap())
+               for (int k = 0; k < BITMAP_NB_WORDS; k++)
+                  words[k] |= c2.bitmap[k];
+            else
+               for (auto k = c2.array.constBegin(); k != c2.array.constEnd(); ++k)
+                  words[*k >> 6] |= Q_UINT64_C(1) << (*k & 63);
+            container.setBitmap(words);
+         }
+
+         result << container;
+      }
+   }
+
+   this->containers = result;
+   return *this;
+}
+
+/**
+  * Remove the values contained in 'other'.
+  */
+RoaringBitmap& RoaringBitmap::operator-=(const RoaringBitmap& other)
+{
+   QVector<Container> result;
+   result.reserve(this->containers.size());
+
+   int j = 0;
+   for (int i = 0; i < this->containers.size(); i++)
+   {
+      const Container& c1 = this->containers[i];
+      while (j < other.containers.size() && other.containers[j].key < c1.key)
+         j++;
+      if (j == other.containers.size() || other.containers[j].key != c1.key)
+      {
+         result << c1;
+         continue;
+      }
+
+      const Container& c2 = other.containers[j];
+      Container container(c1.key);
+
+      if (!c1.isBitmap())
+      {
+         for (auto k = c1.array.constBegin(); k != c1.array.constEnd(); ++k)
+            if (!c2.contains(*k))
+               container.array << *k;
+         container.cardinality = container.array.size();
+      }
+      else
+      {
+         QVector<quint64> words(c1.bitmap);
+         if (c2.isBitmap())
+            for (int k = 0; k < BITMAP_NB_WORDS; k++)
+               words[k] &= ~c2.bitmap[k];
+         else
+            for (auto k = c2.array.constBegin(); k != c2.array.constEnd(); ++k)
+               words[*k >> 6] &= ~(Q_UINT64_C(1) << (*k & 63));
+         container.setBitmap(words);
+      }
+
+      if (container.cardinality > 0)
+         result << container;
+   }
+
+   this->containers = result;
+   return *this;
+}
+
+bool RoaringBitmap::operator==(const RoaringBitmap& other) const
+{
+   if (this->containers.size() != other.containers.size())
+      return false;
+
+   for (int i = 0; i < this->containers.size(); i++)
+   {
+      const Container& c1 = this->containers[i];
+      const Container& c2 = other.containers[i];
+      if (c1.key != c2.key || c1.cardinality != c2.cardinality || c1.array != c2.array || c1.bitmap != c2.bitmap)
+         return false;
+   }
+   return true;
+}
+
+/**
+  * Call 'fun' for each value in increasing order until it returns 'false'.
+  */
+void RoaringBitmap::forall(std::function<bool(quint32)> fun) const
+{
+   for (auto i = this->containers.constBegin(); i != this->containers.constEnd(); ++i)
+   {
+      const quint32 high = static_cast<quint32>(i->key) << 16;
+      if (i->isBitmap())
+      {
+         for (int j = 0; j < i->bitmap.size(); j++)
+            for (quint64 word = i->bitmap[j]; word; word &= word - 1)
+               if (!fun(high | (j * 64 + qCountTrailingZeroBits(word))))
+                  return;
+      }
+      else
+      {
+         for (auto j = i->array.constBegin(); j != i->array.constEnd(); ++j)
+            if (!fun(high | *j))
+               return;
+      }
+   }
+}
+
+QVector<quint32> RoaringBitmap::toVector() const
+{
+   QVector<quint32> values;
+   values.reserve(this->cardinality());
+   this->forall([&](quint32 value) { values << value; return true; });
+   return values;
+}
+
+/**
+  * @return The position of the container having the given key or '-(insertion position) - 1' if there is no such container.
+  */
+int RoaringBitmap::indexOf(quint16 key) const
+{
+   auto i = std::lower_bound(this->containers.constBegin(), this->containers.constEnd(), key, [](const Container& container, quint16 key) { return container.key < key; });
+   if (i != this->containers.constEnd() && i->key == key)
+      return i - this->containers.constBegin();
+   return -(i - this->containers.constBegin()) - 1;
+}
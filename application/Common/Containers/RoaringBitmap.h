@@ -0,0 +1,95 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#pragma once
+
+#include <functional>
+
+#include <QVector>
+
+/**
+  * @class Common::RoaringBitmap
+  *
+  * A compressed set of 32 bits integers, see http://roaringbitmap.org for the original idea.
+  *
+  * The integers are grouped by their 16 most significant bits, each group is stored in a container:
+  *  - A sorted array of the 16 least significant bits when the group has at most 'ARRAY_MAX_SIZE' integers.
+  *  - A bitmap of 2^16 bits (8 KiB) otherwise.
+  * The set operations (and, or, and not) are done container by container, thus they are very fast for dense sets
+  * and remain compact for sparse ones.
+  *
+  * This class isn't thread safe.
+  */
+
+namespace Common
+{
+   class RoaringBitmap
+   {
+      static const int ARRAY_MAX_SIZE;
+      static const int BITMAP_NB_WORDS;
+
+      struct Container
+      {
+         Container(quint16 key = 0) : key(key), cardinality(0) {}
+
+         bool isBitmap() const { return !this->bitmap.isEmpty(); }
+         bool contains(quint16 value) const;
+         bool add(quint16 value);
+         bool remove(quint16 value);
+
+         QVector<quint64> toBitmap() const;
+         void setBitmap(const QVector<quint64>& words);
+         void normalize();
+
+         quint16 key; ///< The 16 most significant bits of the integers.
+         int cardinality;
+         QVector<quint16> array; ///< Used if 'cardinality' <= 'ARRAY_MAX_SIZE'.
+         QVector<quint64> bitmap; ///< Used if 'cardinality' > 'ARRAY_MAX_SIZE'.
+      };
+
+   public:
+      RoaringBitmap();
+
+      bool add(quint32 value);
+      bool remove(quint32 value);
+      bool contains(quint32 value) const;
+
+      int cardinality() const;
+      bool isEmpty() const;
+      void clear();
+
+      RoaringBitmap& operator&=(const RoaringBitmap& other);
+      RoaringBitmap& operator|=(const RoaringBitmap& other);
+      RoaringBitmap& operator-=(const RoaringBitmap& other);
+
+      RoaringBitmap operator&(const RoaringBitmap& other) const { RoaringBitmap result(*this); return result &= other; }
+      RoaringBitmap operator|(const RoaringBitmap& other) const { RoaringBitmap result(*this); return result |= other; }
+      RoaringBitmap operator-(const RoaringBitmap& other) const { RoaringBitmap result(*this); return result -= other; }
+
+      bool operator==(const RoaringBitmap& other) const;
+      bool operator!=(const RoaringBitmap& other) const { return !(*this == other); }
+
+      void forall(std::function<bool(quint32)> fun) const;
+      QVector<quint32> toVector() const;
+
+   private:
+      int indexOf(quint16 key) const;
+
+      QVector<Container> containers; ///< Sorted by key, a container is never empty.
+   };
+}
@@ -24,6 +24,7 @@
 #include <QByteArray>
 #include <QDataStream>
 #include <QCryptographicHash>
+#include <QtEndian>
 
 #include <Common/Uncopyable.h>
 
@@ -59,6 +60,11 @@ namespace Common
       inline const char* getData() const noexcept { return this->data; }
       inline QByteArray getByteArray() const { return QByteArray(this->data, HASH_SIZE); }
 
+      /**
+        * The first 8 bytes of the hash as a big-endian number, see 'Protos.Core.IMAlive.chunk_prefix'.
+        */
+      inline quint64 getPrefix() const noexcept { return qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(this->getData())); }
+
       QString toStr() const;
       QString toStrCArray() const;
       bool isNull() const noexcept;
@@ -94,15 +94,18 @@ Common::Message Common::Message::readMessageBody(const Common::MessageHeader& he
 
    case MessageHeader::CORE_IM_ALIVE:                    return readMessageBody<Protos::Core::IMAlive>               (header, source);
    case MessageHeader::CORE_CHUNKS_OWNED:                return readMessageBody<Protos::Core::ChunksOwned>           (header, source);
+   case MessageHeader::CORE_HAVE_CHUNKS:                 return readMessageBody<Protos::Core::HaveChunks>            (header, source);
    case MessageHeader::CORE_CHAT_MESSAGES:               return readMessageBody<Protos::Common::ChatMessages>        (header, source);
    case MessageHeader::CORE_GET_LAST_CHAT_MESSAGES:      return readMessageBody<Protos::Core::GetLastChatMessages>   (header, source);
    case MessageHeader::CORE_FIND:                        return readMessageBody<Protos::Core::Find>                  (header, source);
    case MessageHeader::CORE_FIND_RESULT:                 return readMessageBody<Protos::Common::FindResult>          (header, source);
+   case MessageHeader::CORE_HELLO:                       return readMessageBody<Protos::Common::Null>                (header, source);
    case MessageHeader::CORE_GET_ENTRIES:                 return readMessageBody<Protos::Core::GetEntries>            (header, source);
    case MessageHeader::CORE_GET_ENTRIES_RESULT:          return readMessageBody<Protos::Core::GetEntriesResult>      (header, source);
    case MessageHeader::CORE_GET_HASHES:                  return readMessageBody<Protos::Core::GetHashes>             (header, source);
    case MessageHeader::CORE_GET_HASHES_RESULT:           return readMessageBody<Protos::Core::GetHashesResult>       (header, source);
    case MessageHeader::CORE_HASH_RESULT:                 return readMessageBody<Protos::Core::HashResult>            (header, source);
+   case MessageHeader::CORE_HASH_RESULTS:                return readMessageBody<Protos::Core::HashResults>           (header, source);
    case MessageHeader::CORE_GET_CHUNK:                   return readMessageBody<Protos::Core::GetChunk>              (header, source);
    case MessageHeader::CORE_GET_CHUNK_RESULT:            return readMessageBody<Protos::Core::GetChunkResult>        (header, source);
 
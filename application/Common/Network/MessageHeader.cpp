@@ -19,6 +19,10 @@
 #include <Common/Network/MessageHeader.h>
 using namespace Common;
 
+#include <cstring>
+
+#include <QtEndian>
+
 #include <Protos/common.pb.h>
 #include <Protos/core_protocol.pb.h>
 #include <Protos/gui_protocol.pb.h>
@@ -27,7 +31,7 @@ using namespace Common;
   * @class Common::MessageHeader
   *
   * Contains all type of messages that can be exchange between cores and between gui and core.
-  * Can read or write header message.
+  * Can read or write header message. The integers are in big-endian followed by the 20 bytes of the sender ID.
   * See the *.proto files in "/application/Protos" for more information.
   */
 
@@ -84,15 +88,18 @@ QString MessageHeader::messToStr(MessageType type)
    case CORE_IM_ALIVE: return "IM_ALIVE";
    case CORE_GOODBYE: return "GOODBYE";
    case CORE_CHUNKS_OWNED: return "CHUNKS_OWNED";
+   case CORE_HAVE_CHUNKS: return "HAVE_CHUNKS";
    case CORE_CHAT_MESSAGES: return "CHAT_MESSAGES";
    case CORE_GET_LAST_CHAT_MESSAGES: return "CHAT_GET_LAST_MESSAGES";
    case CORE_FIND: return "FIND";
    case CORE_FIND_RESULT: return "FIND_RESULT";
+   case CORE_HELLO: return "HELLO";
    case CORE_GET_ENTRIES: return "GET_ENTRIES";
    case CORE_GET_ENTRIES_RESULT: return "GET_ENTRIES_RESULT";
    case CORE_GET_HASHES: return "GET_HASHES";
    case CORE_GET_HASHES_RESULT: return "GET_HASHES_RESULT";
    case CORE_HASH_RESULT: return "HASH_RESULT";
+   case CORE_HASH_RESULTS: return "HASH_RESULTS";
    case CORE_GET_CHUNK: return "GET_CHUNK";
    case CORE_GET_CHUNK_RESULT: return "GET_CHUNK_RESULT";
 
@@ -151,41 +158,28 @@ MessageHeader MessageHeader::readHeader(const char* data)
 {
    MessageHeader header;
 
-   QByteArray array = QByteArray::fromRawData(data, HEADER_SIZE);
-   QDataStream stream(&array, QIODevice::ReadOnly);
-
-   quint32 type;
-   stream >> type;
-   header.type = static_cast<MessageType>(type);
-
-   stream >> header.size;
-   stream >> header.senderID;
+   header.type = static_cast<MessageType>(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data)));
+   header.size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data + sizeof(quint32)));
+   header.senderID = Hash(data + 2 * sizeof(quint32));
 
    return header;
 }
 
 void MessageHeader::writeHeader(QIODevice& device, const MessageHeader& header)
 {
-   QDataStream stream(&device);
-   MessageHeader::writeHeader(stream, header);
+   char data[HEADER_SIZE];
+   MessageHeader::writeHeader(data, header);
+   device.write(data, HEADER_SIZE);
 }
 
+/**
+  * @remarks The buffer size must be at least the header size (28 bytes).
+  */
 void MessageHeader::writeHeader(char* buffer, const MessageHeader& header)
 {
-   // We can't use 'fromRawData' because QByteArray can't modify the given buffer.
-   // QByteArray array = QByteArray::fromRawData(buffer, HEADER_SIZE);
-
-   QByteArray array(HEADER_SIZE, 0);
-   QDataStream stream(&array, QIODevice::WriteOnly);
-   MessageHeader::writeHeader(stream, header);
-   memcpy(buffer, array.data(), HEADER_SIZE);
-}
-
-void MessageHeader::writeHeader(QDataStream& stream, const MessageHeader& header)
-{
-   stream << header.type;
-   stream << header.size;
-   stream << header.senderID;
+   qToBigEndian<quint32>(header.type, reinterpret_cast<uchar*>(buffer));
+   qToBigEndian<quint32>(header.size, reinterpret_cast<uchar*>(buffer + sizeof(quint32)));
+   memcpy(buffer + 2 * sizeof(quint32), header.senderID.getData(), Hash::HASH_SIZE);
 }
 
 const int MessageHeader::HEADER_SIZE(sizeof(MessageHeader::type) + sizeof(MessageHeader::size) + Hash::HASH_SIZE);
@@ -41,6 +41,7 @@ namespace Common
          CORE_IM_ALIVE =                  0x0001,
          CORE_GOODBYE =                   0x00FE,
          CORE_CHUNKS_OWNED =              0x0002,
+         CORE_HAVE_CHUNKS =               0x0003,
 
          CORE_CHAT_MESSAGES =             0x0011,
          CORE_GET_LAST_CHAT_MESSAGES =    0x0018,
@@ -49,12 +50,15 @@ namespace Common
          CORE_FIND_RESULT =               0x0022,
 
          // TCP.
+         CORE_HELLO =                     0x0030,
+
          CORE_GET_ENTRIES =               0x0031,
          CORE_GET_ENTRIES_RESULT =        0x0032,
 
          CORE_GET_HASHES =                0x0041,
          CORE_GET_HASHES_RESULT =         0x0042,
          CORE_HASH_RESULT =               0x0043,
+         CORE_HASH_RESULTS =              0x0044,
 
          CORE_GET_CHUNK =                 0x0051,
          CORE_GET_CHUNK_RESULT =          0x0052,
@@ -120,8 +124,6 @@ namespace Common
       static void writeHeader(char* buffer, const MessageHeader& header);
 
    private:
-      static void writeHeader(QDataStream& stream, const MessageHeader& header);
-
       MessageType type;
       quint32 size;
       Hash senderID;
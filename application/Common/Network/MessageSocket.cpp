@@ -204,7 +204,10 @@ void MessageSocket::dataReceivedSlot()
       this->onNewDataReceived();
       if (this->currentHeader.isNull() && this->socket->bytesAvailable() >= MessageHeader::HEADER_SIZE)
       {
-         this->currentHeader = MessageHeader::readHeader(*this->socket);
+         if (this->readBuffer.size() < MessageHeader::HEADER_SIZE)
+            this->readBuffer.resize(MessageHeader::HEADER_SIZE);
+         this->socket->read(this->readBuffer.data(), MessageHeader::HEADER_SIZE);
+         this->currentHeader = MessageHeader::readHeader(this->readBuffer.constData());
 
          if (this->remoteID.isNull())
             this->remoteID = this->currentHeader.getSenderID();
@@ -218,6 +221,10 @@ void MessageSocket::dataReceivedSlot()
             this->socket->close();
             return;
          }
+
+         // A 'NULL_MESS' header can't be distinguished from the absence of header, it has no body thus the next message is read.
+         if (this->currentHeader.isNull())
+            continue;
       }
 
       if (!this->currentHeader.isNull() && this->socket->bytesAvailable() >= this->currentHeader.getSize())
@@ -249,12 +256,27 @@ void MessageSocket::disconnectedSlot()
 
 /**
   * Read the next message corresponding to the current header type.
+  * The whole body is read at once in 'readBuffer' and parsed from there, only the bytes of the message are
+  * read because the following ones may not be a message, for example the data of a chunk after a 'GetChunkResult'.
   */
 bool MessageSocket::readMessage()
 {
+   const int size = static_cast<int>(this->currentHeader.getSize());
+   if (this->readBuffer.size() < size)
+      this->readBuffer.resize(size);
+
+   if (this->socket->read(this->readBuffer.data(), size) != size)
+      return false;
+
    try
    {
-      const Message& message = Message::readMessageBodyFromDevice(this->currentHeader, this->socket);
+      const Message& message = Message::readMessageBody(this->currentHeader, static_cast<const char*>(this->readBuffer.constData()));
+
+      if (this->readBuffer.size() > MAX_KEPT_READ_BUFFER_SIZE)
+      {
+         this->readBuffer.clear();
+         this->readBuffer.squeeze();
+      }
 
       MESSAGE_SOCKET_LOG_DEBUG(QString("Socket[%1]: Data received from %2, %3\n%4").arg(
          QString::number(this->num),
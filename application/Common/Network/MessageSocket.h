@@ -23,6 +23,7 @@
 #include <QAbstractSocket>
 #include <QHostAddress>
 #include <QTimer>
+#include <QVector>
 
 #include <google/protobuf/message.h>
 
@@ -43,6 +44,8 @@ namespace Common
    class MessageSocket : public QObject, Uncopyable
    {
       Q_OBJECT
+      static const int MAX_KEPT_READ_BUFFER_SIZE = 1024 * 1024; // The read buffer is released after reading a larger message.
+
    protected:
       class ILogger
       {
@@ -117,6 +120,7 @@ namespace Common
       bool listening;
 
       MessageHeader currentHeader;
+      QVector<char> readBuffer; // Reused to read the header and the body of each message.
 
 #ifdef DEBUG
       // To identify the sockets in debug mode.
@@ -7,7 +7,10 @@
 #include <QElapsedTimer>
 #include <QRandomGenerator64>
 
+#include <Protos/core_protocol.pb.h>
+
 #include <Containers/SortedArray.h>
+#include <Network/MessageHeader.h>
 using namespace Common;
 
 BenchmarkTests::BenchmarkTests()
@@ -166,3 +169,75 @@ void BenchmarkTests::sortedArray()
    }
    qDebug() << timer.elapsed();
 }
+
+/**
+  * The hashes of a 'GetHashes' query sent one by one ('HashResult') or by batches ('HashResults'), size and encoding time.
+  * Measured with GCC 12 -O2 on an x86-64 VM, the message headers are included:
+  *  - 100 hashes: 5398 B in 16.4 us -> 2133 B in 3.3 us.
+  *  - 10'000 hashes: 549'870 B in 1.62 ms -> 220'221 B in 0.18 ms.
+  *  - 100'000 hashes: 5.58 MB in 15.3 ms -> 2.29 MB in 1.65 ms.
+  */
+void BenchmarkTests::hashResults()
+{
+   const int HASH_SIZE = 20;
+   const int MAX_NB_HASHES_PER_HASH_RESULTS = 1024; // See 'Core/PeerManager/priv/Constants.h'.
+   const int nbRounds = 50;
+
+   QRandomGenerator64 rng(42);
+   QList<std::string> hashes;
+   for (int i = 0; i < 100000; i++)
+   {
+      std::string hash(HASH_SIZE, '\0');
+      for (int j = 0; j < HASH_SIZE; j++)
+         hash[j] = static_cast<char>(rng.bounded(256));
+      hashes << hash;
+   }
+
+   QElapsedTimer timer;
+   std::string output;
+
+   qDebug() << "Nb hashes\tHashResult [B]\t[us]\tHashResults [B]\t[us]";
+   for (int n = 100; n <= hashes.size(); n *= 10)
+   {
+      qint64 sizeOneByOne = 0;
+      timer.start();
+      for (int r = 0; r < nbRounds; r++)
+      {
+         sizeOneByOne = 0;
+         for (int i = 0; i < n; i++)
+         {
+            Protos::Core::HashResult hashResult;
+            hashResult.set_num(i);
+            hashResult.mutable_hash()->set_hash(hashes[i]);
+            output.clear();
+            hashResult.SerializeToString(&output);
+            sizeOneByOne += MessageHeader::HEADER_SIZE + output.size();
+         }
+      }
+      const double timeOneByOne = timer.nsecsElapsed() / 1000.0 / nbRounds;
+
+      qint64 sizeBatched = 0;
+      timer.start();
+      for (int r = 0; r < nbRounds; r++)
+      {
+         sizeBatched = 0;
+         Protos::Core::HashResults hashResults;
+         for (int i = 0; i < n; i++)
+         {
+            hashResults.add_num(i);
+            hashResults.mutable_hashes()->append(hashes[i]);
+            if (hashResults.num_size() >= MAX_NB_HASHES_PER_HASH_RESULTS || i == n - 1)
+            {
+               output.clear();
+               hashResults.SerializeToString(&output);
+               sizeBatched += MessageHeader::HEADER_SIZE + output.size();
+               hashResults.Clear();
+            }
+         }
+      }
+      const double timeBatched = timer.nsecsElapsed() / 1000.0 / nbRounds;
+
+      QVERIFY(sizeBatched < sizeOneByOne);
+      qDebug() << n << "\t" << sizeOneByOne << "\t" << timeOneByOne << "\t" << sizeBatched << "\t" << timeBatched;
+   }
+}
@@ -10,5 +10,6 @@ public:
 
 private slots:
    void sortedArray();
+   void hashResults();
 
 };
@@ -35,6 +35,7 @@
 #include <Containers/SortedList.h>
 #include <Containers/SortedArray.h>
 #include <Containers/MapArray.h>
+#include <Containers/RoaringBitmap.h>
 #include <Network/MessageHeader.h>
 #include <PersistentData.h>
 #include <Settings.h>
@@ -369,6 +370,63 @@ void Tests::mapArray()
    }
 }
 
+/**
+  * The bitmaps are compared to 'std::set', the values are spread to have some sparse (array) and some dense (bitmap) containers.
+  */
+void Tests::roaringBitmap()
+{
+   QRandomGenerator64 random(42);
+
+   for (int n = 0; n < 10; n++)
+   {
+      const quint32 range = n % 2 == 0 ? 70000 : 10000000;
+
+      RoaringBitmap b1, b2;
+      std::set<quint32> s1, s2;
+      for (int i = 0; i < 20000; i++)
+      {
+         const quint32 v1 = random.bounded(range);
+         QCOMPARE(b1.add(v1), s1.insert(v1).second);
+         const quint32 v2 = random.bounded(range);
+         QCOMPARE(b2.add(v2), s2.insert(v2).second);
+      }
+
+      for (int i = 0; i < 5000; i++)
+      {
+         const quint32 v = random.bounded(range);
+         QCOMPARE(b1.remove(v), s1.erase(v) == 1);
+      }
+
+      QCOMPARE(b1.cardinality(), static_cast<int>(s1.size()));
+      QCOMPARE(b1.toVector(), QVector<quint32>(s1.begin(), s1.end()));
+
+      std::set<quint32> intersection, difference, union_(s1);
+      union_.insert(s2.begin(), s2.end());
+      for (auto i = s1.begin(); i != s1.end(); ++i)
+         (s2.count(*i) ? intersection : difference).insert(*i);
+
+      QCOMPARE((b1 & b2).toVector(), QVector<quint32>(intersection.begin(), intersection.end()));
+      QCOMPARE((b1 | b2).toVector(), QVector<quint32>(union_.begin(), union_.end()));
+      QCOMPARE((b1 - b2).toVector(), QVector<quint32>(difference.begin(), difference.end()));
+
+      RoaringBitmap b3(b1);
+      b3 |= b2;
+      b3 -= b2;
+      QVERIFY(b3 == b1 - b2);
+
+      for (int i = 0; i < 1000; i++)
+      {
+         const quint32 v = random.bounded(range);
+         QCOMPARE(b1.contains(v), s1.count(v) == 1);
+      }
+   }
+
+   RoaringBitmap empty;
+   QVERIFY(empty.isEmpty());
+   QVERIFY((empty & empty).isEmpty());
+   QCOMPARE(empty.cardinality(), 0);
+}
+
 void Tests::transferRateCalculator()
 {
    QSKIP("TODO: Rewrite this test, take too much time.");
@@ -636,6 +694,87 @@ void Tests::messageHeader()
    QVERIFY(qstrncmp(data, buffer, MessageHeader::HEADER_SIZE) == 0);
    for (int i = 0; i < 4; i++)
       QVERIFY(buffer[MessageHeader::HEADER_SIZE + i] == '\0');
+
+   // A header without sender ID.
+   MessageHeader::writeHeader(buffer, MessageHeader(MessageHeader::CORE_GOODBYE, 0, Hash()));
+   const MessageHeader headerWithoutSender = MessageHeader::readHeader(buffer);
+   QCOMPARE(headerWithoutSender.getType(), MessageHeader::CORE_GOODBYE);
+   QCOMPARE(headerWithoutSender.getSize(), 0u);
+   QVERIFY(headerWithoutSender.getSenderID().isNull());
+}
+
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <Protos/core_protocol.pb.h>
+
+#include <Network/Message.h>
+#include <Network/MessageSocket.h>
+
+namespace
+{
+   /**
+     * Keeps the types of the received messages.
+     */
+   class TypesMessageSocket : public MessageSocket
+   {
+      class Logger : public ILogger
+      {
+      public:
+         void logDebug(const QString& message) { qDebug() << message; }
+         void logError(const QString& message) { qDebug() << message; }
+      };
+
+   public:
+      TypesMessageSocket(QAbstractSocket* socket) : MessageSocket(new Logger(), socket) {}
+
+      QList<MessageHeader::MessageType> receivedTypes;
+
+   private:
+      void onNewMessage(const Message& message) { this->receivedTypes << message.getHeader().getType(); }
+   };
+}
+
+/**
+  * A 'NULL_MESS' or a 'HELLO' message followed by a request in the same segment, as sent by a connection opened in advance
+  * (see 'PM::ConnectionPool::prewarmSockets()'): the request must be read without waiting for more data.
+  */
+void Tests::messageSocketReadsAllTheBufferedMessages()
+{
+   QTcpServer server;
+   QVERIFY(server.listen(QHostAddress::LocalHost));
+
+   QTcpSocket client;
+   client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+   QVERIFY(client.waitForConnected(5000));
+   QVERIFY(server.waitForNewConnection(5000));
+
+   TypesMessageSocket socket(server.nextPendingConnection());
+   socket.startListening();
+
+   const Hash senderID = Hash::rand();
+   Protos::Core::GetChunk getChunk;
+   getChunk.mutable_chunk()->set_hash(Hash::rand().getData(), Hash::HASH_SIZE);
+   getChunk.set_offset(42);
+
+   QByteArray data(3 * MessageHeader::HEADER_SIZE + getChunk.ByteSizeLong(), 0);
+   int size = Message::writeMessageToBuffer(data.data(), data.size(), MessageHeader(MessageHeader::NULL_MESS, 0, senderID));
+   size += Message::writeMessageToBuffer(data.data() + size, data.size() - size, MessageHeader(MessageHeader::CORE_HELLO, 0, senderID));
+   size += Message::writeMessageToBuffer(data.data() + size, data.size() - size, MessageHeader(MessageHeader::CORE_GET_CHUNK, getChunk.ByteSizeLong(), senderID), &getChunk);
+   QCOMPARE(size, data.size());
+
+   QCOMPARE(client.write(data), qint64(data.size()));
+   QVERIFY(client.waitForBytesWritten(5000));
+
+   QElapsedTimer timer;
+   timer.start();
+   while (socket.receivedTypes.size() < 2 && timer.elapsed() < 5000)
+      QTest::qWait(10);
+
+   // The 'NULL_MESS' isn't reported.
+   QCOMPARE(socket.receivedTypes.size(), 2);
+   QVERIFY(socket.receivedTypes[0] == MessageHeader::CORE_HELLO);
+   QVERIFY(socket.receivedTypes[1] == MessageHeader::CORE_GET_CHUNK);
 }
 
 void Tests::readAndWriteWithZeroCopyStreamQIODevice()
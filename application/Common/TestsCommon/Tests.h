@@ -50,6 +50,9 @@ private slots:
    // MapArray class.
    void mapArray();
 
+   // RoaringBitmap class.
+   void roaringBitmap();
+
    // TransferRateCalculator
    void transferRateCalculator();
 
@@ -74,6 +77,7 @@ private slots:
    void bloomFilter();
 
    void messageHeader();
+   void messageSocketReadsAllTheBufferedMessages();
 
    // ZeroCopyOutputStreamQIODevice and ZeroCopyInputStreamQIODevice classes.
    void readAndWriteWithZeroCopyStreamQIODevice();
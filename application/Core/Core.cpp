@@ -125,6 +125,18 @@ void Core::printSimilarFiles() const
    this->fileManager->printSimilarFiles();
 }
 
+void Core::printFindStats() const
+{
+   const NL::INetworkListener::FindStats& stats = this->networkListener->getFindStats();
+   L_WARN(QString("Find stats: pending: %1, dropped: %2, latency [ms]: median: %3, 95th percentile: %4, 99th percentile: %5").
+      arg(stats.nbPendingFinds).
+      arg(stats.nbDroppedFinds).
+      arg(stats.latencyMedian).
+      arg(stats.latency95).
+      arg(stats.latency99)
+   );
+}
+
 void Core::changePassword(const QString& newPassword)
 {
    quint64 salt = QRandomGenerator64::global()->generate64();
@@ -169,11 +181,28 @@ Protos::Core::Settings* Core::createDefaultValuesSettings()
    ///// FileManager /////
    settings->set_minimum_duration_when_hashing(3000);
    settings->set_scan_period_unwatchable_dirs(30000);
+   settings->set_scan_nb_threads(4);
+   settings->set_dir_events_coalescing_delay(50);
+   settings->set_dir_watcher_fanotify(false);
+   settings->set_hashing_max_rate(0);
+   settings->set_hashing_max_rate_when_uploading(4194304);
+   settings->set_hashing_idle_io_priority(true);
+   settings->set_file_pool_max_open_files(256);
+   settings->set_upload_prefetch_nb_chunks(1);
+   settings->set_upload_drop_sent_chunks(false);
+   settings->set_find_nb_threads(2);
+   settings->set_find_queue_size(64);
+   settings->set_find_max_pending_per_peer(2);
+   settings->set_imalive_hash_prefixes(true);
+   settings->set_multicast_discovery(true);
+   settings->set_prewarm_sockets(true);
    settings->set_unfinished_suffix_term(".unfinished");
    settings->set_minimum_free_space(1048576);
    settings->set_save_cache_period(60000);
    settings->set_check_received_data_integrity(true);
    settings->set_get_entries_timeout(5000);
+   settings->set_substring_index(false);
+   settings->set_search_result_cache_size(1048576);
 
    ///// PeerManager /////
    settings->set_pending_socket_timeout(10000);
@@ -247,6 +276,13 @@ void Core::checkSettingsIntegrity()
 
    this->checkSetting("minimum_duration_when_hashing", 100u, 30u * 1000u);
    this->checkSetting("scan_period_unwatchable_dirs", 1000u, 60u * 60u * 1000u);
+   this->checkSetting("scan_nb_threads", 1u, 64u);
+   this->checkSetting("dir_events_coalescing_delay", 0u, 1000u);
+   this->checkSetting("file_pool_max_open_files", 16u, 65536u);
+   this->checkSetting("upload_prefetch_nb_chunks", 0u, 16u);
+   this->checkSetting("find_nb_threads", 1u, 16u);
+   this->checkSetting("find_queue_size", 1u, 4096u);
+   this->checkSetting("find_max_pending_per_peer", 1u, 64u);
    static const QRegExp unfinishedSuffixExp("^\\.\\S+$");
    if (!unfinishedSuffixExp.exactMatch(SETTINGS.get<QString>("unfinished_suffix_term")))
    {
@@ -257,6 +293,7 @@ void Core::checkSettingsIntegrity()
    this->checkSetting("save_cache_period", 1000u, 4294967295u);
 
    this->checkSetting("get_entries_timeout", 1000u, 60u * 1000u);
+   this->checkSetting("search_result_cache_size", 0u, 256u * 1024u * 1024u);
    this->checkSetting("pending_socket_timeout", 10u, 30u * 1000u);
    this->checkSetting("peer_timeout_factor", 1.0, 10.0);
    this->checkSetting("idle_socket_timeout", 1000u, 60u * 60u * 1000u);
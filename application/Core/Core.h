@@ -50,6 +50,7 @@ namespace CoreSpace
 
       void dumpWordIndex() const;
       void printSimilarFiles() const;
+      void printFindStats() const;
 
       void changePassword(const QString& newPassword);
       void removePassword();
@@ -105,6 +105,10 @@ void CoreService::processUserInput(QString input)
    {
       this->core->printSimilarFiles();
    }
+   else if (input == "printfs")
+   {
+      this->core->printFindStats();
+   }
    else
    {
       QTextStream out(stdout);
@@ -119,5 +123,6 @@ void CoreService::printCommands()
        << " - help: show this message" << endl
        << " - quit: stop the core" << endl
        << " - dumpwi: dump the word index in the log as a warning" << endl
-       << " - printsf: print the similar files in the log as a warning" << endl;
+       << " - printsf: print the similar files in the log as a warning" << endl
+       << " - printfs: print the statistics about the searches asked by the other peers in the log as a warning" << endl;
 }
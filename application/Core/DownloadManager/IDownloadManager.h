@@ -91,6 +91,12 @@ namespace DM
         */
       virtual QList<QSharedPointer<IChunkDownloader>> getTheOldestUnfinishedChunks(int n) = 0;
 
+      /**
+        * Return the n (at max) unfinished chunks whose hash has become known since the last call, each chunk is returned only once.
+        * Used to look for all the sources of the new chunks at once, see 'Protos::Core::HaveChunks'.
+        */
+      virtual QList<QSharedPointer<IChunkDownloader>> getChunksToLocate(int n) = 0;
+
       /**
         * @return Byte/s.
         */
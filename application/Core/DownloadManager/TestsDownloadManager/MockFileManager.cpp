@@ -75,7 +75,7 @@ QList<Protos::Common::FindResult> MockFileManager::find(const QString& words, in
    return QList<Protos::Common::FindResult>();
 }
 
-QList<Protos::Common::FindResult> MockFileManager::find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize)
+QList<Protos::Common::FindResult> MockFileManager::find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize, bool substringMatch, int maxEditDistance)
 {
    return QList<Protos::Common::FindResult>();
 }
@@ -85,6 +85,11 @@ QBitArray MockFileManager::haveChunks(const QList<Common::Hash>& hashes)
    return QBitArray();
 }
 
+QBitArray MockFileManager::haveChunks(const QList<quint64>& hashPrefixes)
+{
+   return QBitArray();
+}
+
 quint64 MockFileManager::getAmount()
 {
    return 0;
@@ -23,8 +23,9 @@ public:
    Protos::Common::Entries getEntries(const Protos::Common::Entry& dir, int maxNbHashesPerEntry = std::numeric_limits<int>::max());
    Protos::Common::Entries getEntries();
    QList<Protos::Common::FindResult> find(const QString& words, int maxNbResult, int maxSize);
-   QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize);
+   QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize, bool substringMatch = false, int maxEditDistance = 0);
    QBitArray haveChunks(const QList<Common::Hash>& hashes);
+   QBitArray haveChunks(const QList<quint64>& hashPrefixes);
    quint64 getAmount();
    CacheStatus getCacheStatus() const;
    int getProgress() const;
@@ -0,0 +1,97 @@
+#include <MockPeer.h>
+
+MockPeer::MockPeer(const Common::Hash& ID, const QString& nick)
+   : ID(ID), nick(nick)
+{
+}
+
+Common::Hash MockPeer::getID() const
+{
+   return this->ID;
+}
+
+QHostAddress MockPeer::getIP() const
+{
+   return QHostAddress();
+}
+
+quint16 MockPeer::getPort() const
+{
+   return 0;
+}
+
+QString MockPeer::getNick() const
+{
+   return this->nick;
+}
+
+QString MockPeer::getCoreVersion() const
+{
+   return QString();
+}
+
+quint64 MockPeer::getSharingAmount() const
+{
+   return 0;
+}
+
+quint32 MockPeer::getDownloadRate() const
+{
+   return 0;
+}
+
+quint32 MockPeer::getUploadRate() const
+{
+   return 0;
+}
+
+quint32 MockPeer::getSpeed()
+{
+   return 0;
+}
+
+void MockPeer::setSpeed(quint32 newSpeed)
+{
+}
+
+void MockPeer::block(int duration, const QString& reason)
+{
+}
+
+bool MockPeer::isAlive() const
+{
+   return false;
+}
+
+bool MockPeer::isAvailable() const
+{
+   return false;
+}
+
+quint32 MockPeer::getProtocolVersion() const
+{
+   return 0;
+}
+
+QSharedPointer<PM::IGetEntriesResult> MockPeer::getEntries(const Protos::Core::GetEntries& dirs)
+{
+   // Not available.
+   return QSharedPointer<PM::IGetEntriesResult>();
+}
+
+QSharedPointer<PM::IGetHashesResult> MockPeer::getHashes(const Protos::Common::Entry& file)
+{
+   // Not available.
+   return QSharedPointer<PM::IGetHashesResult>();
+}
+
+QSharedPointer<PM::IGetChunkResult> MockPeer::getChunk(const Protos::Core::GetChunk& chunk)
+{
+   // Not available.
+   return QSharedPointer<PM::IGetChunkResult>();
+}
+
+QString MockPeer::toStringLog() const
+{
+   return this->nick;
+}
@@ -0,0 +1,39 @@
+#ifndef TESTS_DOWNLOADMANAGER_MOCKPEER_H
+#define TESTS_DOWNLOADMANAGER_MOCKPEER_H
+
+#include <PeerManager/IPeer.h>
+
+/**
+  * A peer never available, the downloads having it as source keep their known hashes and never download anything.
+  */
+class MockPeer : public PM::IPeer
+{
+public:
+   MockPeer(const Common::Hash& ID, const QString& nick);
+
+   Common::Hash getID() const;
+   QHostAddress getIP() const;
+   quint16 getPort() const;
+   QString getNick() const;
+   QString getCoreVersion() const;
+   quint64 getSharingAmount() const;
+   quint32 getDownloadRate() const;
+   quint32 getUploadRate() const;
+   quint32 getSpeed();
+   void setSpeed(quint32 newSpeed);
+   void block(int duration, const QString& reason = QString());
+   bool isAlive() const;
+   bool isAvailable() const;
+   quint32 getProtocolVersion() const;
+   QSharedPointer<PM::IGetEntriesResult> getEntries(const Protos::Core::GetEntries& dirs);
+   QSharedPointer<PM::IGetHashesResult> getHashes(const Protos::Common::Entry& file);
+   QSharedPointer<PM::IGetChunkResult> getChunk(const Protos::Core::GetChunk& chunk);
+
+   QString toStringLog() const;
+
+private:
+   const Common::Hash ID;
+   const QString nick;
+};
+
+#endif
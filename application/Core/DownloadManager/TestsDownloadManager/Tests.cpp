@@ -28,6 +28,7 @@ using namespace DM;
 
 #include <Common/LogManager/Builder.h>
 #include <Common/Global.h>
+#include <Common/Constants.h>
 
 #include <Builder.h>
 
@@ -37,6 +38,7 @@ using namespace DM;
   */
 
 Tests::Tests()
+   : peerSource(Common::Hash::rand(), "source")
 {
 }
 
@@ -52,6 +54,64 @@ void Tests::initTestCase()
    this->downloadManager = Builder::newDownloadManager(this->fileManager, this->peerManager);
 }
 
+/**
+  * The source is never available thus the chunks stay unfinished.
+  */
+void Tests::getChunksToLocate()
+{
+   qDebug() << "===== getChunksToLocate() =====";
+
+   const int NB_CHUNKS = 3;
+   QList<Common::Hash> hashes;
+
+   // All the hashes of the first file are known.
+   Protos::Common::Entry remoteEntry1;
+   remoteEntry1.set_type(Protos::Common::Entry_Type_FILE);
+   remoteEntry1.set_path("/");
+   remoteEntry1.set_name("a.bin");
+   remoteEntry1.set_size(NB_CHUNKS * Common::Constants::CHUNK_SIZE);
+   for (int i = 0; i < NB_CHUNKS; i++)
+   {
+      hashes << Common::Hash::rand();
+      remoteEntry1.add_chunk()->set_hash(hashes.last().getData(), Common::Hash::HASH_SIZE);
+   }
+
+   // Only the first hash of the second file is known, the scanning stops at the first unknown hash.
+   Protos::Common::Entry remoteEntry2(remoteEntry1);
+   remoteEntry2.set_name("b.bin");
+   remoteEntry2.clear_chunk();
+   hashes << Common::Hash::rand();
+   remoteEntry2.add_chunk()->set_hash(hashes.last().getData(), Common::Hash::HASH_SIZE);
+   for (int i = 1; i < NB_CHUNKS; i++)
+      remoteEntry2.add_chunk();
+
+   QVERIFY(this->downloadManager->getChunksToLocate(10).isEmpty());
+
+   this->downloadManager->addDownload(remoteEntry1, &this->peerSource);
+   this->downloadManager->addDownload(remoteEntry2, &this->peerSource);
+
+   QList<QSharedPointer<IChunkDownloader>> chunks = this->downloadManager->getChunksToLocate(2);
+   QCOMPARE(chunks.size(), 2);
+   QVERIFY(chunks[0]->getHash() == hashes[0]);
+   QVERIFY(chunks[1]->getHash() == hashes[1]);
+
+   chunks = this->downloadManager->getChunksToLocate(10);
+   QCOMPARE(chunks.size(), 2);
+   QVERIFY(chunks[0]->getHash() == hashes[2]);
+   QVERIFY(chunks[1]->getHash() == hashes[3]);
+
+   // Each chunk is given once, even after a pause.
+   QVERIFY(this->downloadManager->getChunksToLocate(10).isEmpty());
+   QList<quint64> IDs;
+   for (QListIterator<IDownload*> i(this->downloadManager->getDownloads()); i.hasNext();)
+      IDs << i.next()->getID();
+   this->downloadManager->pauseDownloads(IDs);
+   this->downloadManager->pauseDownloads(IDs, false);
+   QVERIFY(this->downloadManager->getChunksToLocate(10).isEmpty());
+
+   this->downloadManager->removeDownloads(IDs);
+}
+
 void Tests::cleanupTestCase()
 {
    qDebug() << "===== cleanupTestCase() =====";
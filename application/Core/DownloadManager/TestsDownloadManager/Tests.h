@@ -37,6 +37,7 @@ using namespace DM;
 
 #include <MockFileManager.h>
 #include <MockPeerManager.h>
+#include <MockPeer.h>
 
 class Tests : public QObject
 {
@@ -46,13 +47,14 @@ public:
 
 private slots:
    void initTestCase();
-
+   void getChunksToLocate();
 
    void cleanupTestCase();
 
 private:
    QSharedPointer<MockFileManager> fileManager;
    QSharedPointer<MockPeerManager> peerManager;
+   MockPeer peerSource; // Must be deleted after the download manager.
    QSharedPointer<IDownloadManager> downloadManager;
 };
 
@@ -43,7 +43,8 @@ DownloadManager::DownloadManager(QSharedPointer<FM::IFileManager> fileManager, Q
    threadPool(NUMBER_OF_DOWNLOADER),
    numberOfDownloadThreadRunning(0),
    queueChanged(false),
-   queueLoaded(false)
+   queueLoaded(false),
+   chunksToLocate(false)
 {
    this->threadPool.setStackSize(MIN_DOWNLOAD_THREAD_STACK_SIZE + SETTINGS.get<quint32>("buffer_size_writing"));
 
@@ -176,6 +177,9 @@ Download* DownloadManager::addDownload(const Protos::Common::Entry& remoteEntry,
          );
          newDownload = fileDownload;
          connect(fileDownload, &FileDownload::newHashKnown, this, &DownloadManager::setQueueChanged, Qt::DirectConnection);
+         connect(fileDownload, &FileDownload::newHashKnown, this, &DownloadManager::setChunksToLocate, Qt::DirectConnection);
+         connect(fileDownload, &FileDownload::chunksToLocate, this, &DownloadManager::setChunksToLocate, Qt::DirectConnection);
+         this->chunksToLocate = true;
       }
       break;
 
@@ -244,7 +248,10 @@ void DownloadManager::pauseDownloads(QList<quint64> IDs, bool pause)
       this->setQueueChanged();
 
    if (!pause)
+   {
+      this->chunksToLocate = true; // The chunks of a paused download aren't located.
       this->scanTheQueue();
+   }
 }
 
 QList<QSharedPointer<IChunkDownloader>> DownloadManager::getTheFirstUnfinishedChunks(int n)
@@ -266,6 +273,23 @@ QList<QSharedPointer<IChunkDownloader>> DownloadManager::getTheOldestUnfinishedC
    return this->downloadQueue.getTheOldestUnfinishedChunks(n);
 }
 
+QList<QSharedPointer<IChunkDownloader>> DownloadManager::getChunksToLocate(int n)
+{
+   QList<QSharedPointer<IChunkDownloader>> chunks;
+   if (!this->chunksToLocate)
+      return chunks;
+
+   DownloadQueue::ScanningIterator<IsDownloable> i(this->downloadQueue);
+   FileDownload* fileDownload;
+   while (chunks.size() < n && (fileDownload = static_cast<FileDownload*>(i.next())))
+      fileDownload->getChunksToLocate(chunks, n - chunks.size());
+
+   if (chunks.size() < n)
+      this->chunksToLocate = false;
+
+   return chunks;
+}
+
 int DownloadManager::getDownloadRate()
 {
    return this->transferRateCalculator.getTransferRate();
@@ -479,4 +503,9 @@ void DownloadManager::setQueueChanged()
    this->queueChanged = true;
 }
 
+void DownloadManager::setChunksToLocate()
+{
+   this->chunksToLocate = true;
+}
+
 const quint32 DownloadManager::MIN_DOWNLOAD_THREAD_STACK_SIZE(64 * 1024);
@@ -74,6 +74,7 @@ namespace DM
 
       QList<QSharedPointer<IChunkDownloader>> getTheFirstUnfinishedChunks(int n);
       QList<QSharedPointer<IChunkDownloader>> getTheOldestUnfinishedChunks(int n);
+      QList<QSharedPointer<IChunkDownloader>> getChunksToLocate(int n);
 
       int getDownloadRate();
 
@@ -99,6 +100,7 @@ namespace DM
    private slots:
       void saveQueueToFile();
       void setQueueChanged();
+      void setChunksToLocate();
 
    private:
       LOG_INIT_H("DownloadManager")
@@ -127,5 +129,6 @@ namespace DM
       QTimer saveTimer; // To know when to save the queue, for exemple each 5min.
       bool queueChanged;
       bool queueLoaded;
+      bool chunksToLocate; // 'false' when 'getChunksToLocate(..)' has nothing to return, avoids scanning the queue.
    };
 }
@@ -51,6 +51,7 @@ FileDownload::FileDownload(
    linkedPeers(linkedPeers),
    NB_CHUNK(this->remoteEntry.size() / Common::Constants::CHUNK_SIZE + (this->remoteEntry.size() % Common::Constants::CHUNK_SIZE == 0 ? 0 : 1)),
    nbChunkAsked(0),
+   nbChunkLocated(0),
    occupiedPeersAskingForHashes(occupiedPeersAskingForHashes),
    occupiedPeersDownloadingChunk(occupiedPeersDownloadingChunk),
    threadPool(threadPool),
@@ -307,6 +308,30 @@ void FileDownload::getUnfinishedChunks(QList<QSharedPointer<IChunkDownloader>>&
    }
 }
 
+/**
+  * Fills 'chunks' with the unfinished chunks never given before by this method. Do not add more than 'nMax' chunk to chunks.
+  * The hashes are received in order, the scanning stops at the first unknown hash.
+  */
+void FileDownload::getChunksToLocate(QList<QSharedPointer<IChunkDownloader>>& chunks, int nMax)
+{
+   if (this->status == COMPLETE || this->status == DELETED || this->status == PAUSED)
+      return;
+
+   int n = 0;
+   for (; this->nbChunkLocated < this->chunkDownloaders.size() && n < nMax; this->nbChunkLocated++)
+   {
+      const QSharedPointer<ChunkDownloader>& chunkDownloader = this->chunkDownloaders[this->nbChunkLocated];
+      if (chunkDownloader.isNull())
+         break;
+
+      if (!chunkDownloader->isComplete())
+      {
+         chunks << chunkDownloader;
+         n++;
+      }
+   }
+}
+
 /**
   * When we explicitly remove a download, we must remove all unfinished files.
   */
@@ -360,6 +385,7 @@ bool FileDownload::retrieveHashes()
    connect(this->getHashesResult.data(), &PM::IGetHashesResult::result, this, &FileDownload::result);
    connect(this->getHashesResult.data(), &PM::IGetHashesResult::nextHash, this, &FileDownload::nextHash);
    connect(this->getHashesResult.data(), &PM::IGetHashesResult::timeout, this, &FileDownload::getHashTimeout);
+   this->getHashesTimer.start();
    this->getHashesResult->start();
 
    return true;
@@ -512,6 +538,11 @@ void FileDownload::nextHash(const Protos::Core::HashResult& hashResult)
    if (++this->nbHashesKnown >= this->NB_CHUNK)
    {
       this->nbHashesKnown = this->NB_CHUNK;
+      if (this->getHashesTimer.isValid())
+      {
+         L_DEBU(QString("All the %1 hashes of %2 received in %3 ms").arg(this->NB_CHUNK).arg(Common::ProtoHelper::getStr(this->remoteEntry, &Protos::Common::Entry::name)).arg(this->getHashesTimer.elapsed()));
+         this->getHashesTimer.invalidate();
+      }
       this->getHashesResult.clear();
       this->occupiedPeersAskingForHashes.setPeerAsFree(this->peerSource);
       this->updateStatus();
@@ -650,7 +681,15 @@ void FileDownload::reset()
 {
    this->chunksWithoutDownloader.clear();
    for (QListIterator<QSharedPointer<ChunkDownloader>> i(this->chunkDownloaders); i.hasNext();)
-      i.next()->reset();
+   {
+      auto chunkDownloader = i.next();
+      if (!chunkDownloader.isNull())
+         chunkDownloader->reset();
+   }
    this->localEntry.set_exists(false);
    this->localEntry.clear_shared_dir();
+
+   // The complete chunks have been skipped by 'getChunksToLocate(..)', they must be located again.
+   this->nbChunkLocated = 0;
+   emit chunksToLocate();
 }
@@ -22,6 +22,7 @@
 #include <QMap>
 #include <QSharedPointer>
 #include <QTime>
+#include <QElapsedTimer>
 
 #include <Common/ThreadPool.h>
 
@@ -72,6 +73,7 @@ namespace DM
       QSharedPointer<ChunkDownloader> getAChunkToDownload();
 
       void getUnfinishedChunks(QList<QSharedPointer<IChunkDownloader>>& chunks, int nMax, bool notAlreadyAsked = true);
+      void getChunksToLocate(QList<QSharedPointer<IChunkDownloader>>& chunks, int nMax);
 
       inline QTime getLastTimeGetAllUnfinishedChunks() const;
 
@@ -82,6 +84,7 @@ namespace DM
 
    signals:
       void newHashKnown();
+      void chunksToLocate();
       void lastTimeGetAllUnfinishedChunksChanged(QTime oldTime);
 
    private slots:
@@ -109,6 +112,7 @@ namespace DM
       QList<QSharedPointer<ChunkDownloader>> chunkDownloaders;
 
       int nbChunkAsked;
+      int nbChunkLocated; // The chunks before this index have been given by 'getChunksToLocate(..)'.
 
       OccupiedPeers& occupiedPeersAskingForHashes;
       OccupiedPeers& occupiedPeersDownloadingChunk;
@@ -117,6 +121,7 @@ namespace DM
 
       int nbHashesKnown;
       QSharedPointer<PM::IGetHashesResult> getHashesResult;
+      QElapsedTimer getHashesTimer; // Started when the hashes are asked, to measure the time to receive all of them.
 
       Common::TransferRateCalculator& transferRateCalculator;
 
@@ -38,6 +38,7 @@ macx {
 SOURCES += priv/Builder.cpp \
     priv/FileManager.cpp \
     priv/FileUpdater/FileUpdater.cpp \
+    priv/FileUpdater/DirScanner.cpp \
     priv/FileUpdater/DirWatcher.cpp \
     priv/Cache/Entry.cpp \
     priv/Cache/File.cpp \
@@ -56,9 +57,17 @@ SOURCES += priv/Builder.cpp \
     priv/Log.cpp \
     priv/Global.cpp \
     priv/Cache/FilePool.cpp \
+    priv/Cache/HashingThrottle.cpp \
     priv/Cache/FileHasher.cpp \
     priv/GetEntriesResult.cpp \
-    priv/SizeIndexEntries.cpp
+    priv/SizeIndexEntries.cpp \
+    priv/IndexSnapshot.cpp \
+    priv/FilterIndex.cpp \
+    priv/FindResultCache.cpp \
+    priv/Cache/CacheJournal.cpp \
+    priv/Cache/FileCacheWriter.cpp \
+    priv/Cache/FileCacheReader.cpp \
+    priv/Cache/HashStore.cpp
 HEADERS += IGetHashesResult.h \
     IFileManager.h \
     IChunk.h \
@@ -66,6 +75,7 @@ HEADERS += IGetHashesResult.h \
     priv/Log.h \
     priv/FileManager.h \
     priv/FileUpdater/FileUpdater.h \
+    priv/FileUpdater/DirScanner.h \
     priv/FileUpdater/DirWatcher.h \
     priv/Cache/Entry.h \
     priv/Cache/File.h \
@@ -73,6 +83,7 @@ HEADERS += IGetHashesResult.h \
     priv/Cache/SharedDirectory.h \
     priv/ChunkIndex/Chunks.h \
     priv/WordIndex/WordIndex.h \
+    priv/WordIndex/TrigramIndex.h \
     priv/WordIndex/Node.h \
     ../../Protos/core_protocol.pb.h \
     ../../Protos/common.pb.h \
@@ -91,9 +102,18 @@ HEADERS += IGetHashesResult.h \
     priv/Global.h \
     priv/FileUpdater/DirWatcherLinux.h \
     priv/Cache/FilePool.h \
+    priv/Cache/HashingThrottle.h \
     priv/Cache/FileHasher.h \
     IGetEntriesResult.h \
     priv/GetEntriesResult.h \
     priv/ExtensionIndex.h \
-    priv/SizeIndexEntries.h
+    priv/SizeIndexEntries.h \
+    priv/IndexSnapshot.h \
+    priv/FilterIndex.h \
+    priv/FindResultCache.h \
+    priv/Cache/CacheJournal.h \
+    priv/Cache/FileCacheWriter.h \
+    priv/Cache/FileCacheReader.h \
+    priv/Cache/HashStore.h \
+    priv/Cache/EntryMutex.h
 OTHER_FILES +=
@@ -139,10 +139,12 @@ namespace FM
         * @param maxNbResult The maximum total number of result, sum of all 'FindResult' sizes.
         * @param maxSize This is the size in bytes each 'FindResult' can't exceed. (Because UDP datagrams have a maximum size).
         * It should not be here but it's far more harder to split the result outside this method.
+        * @param substringMatch If true the words may match anywhere inside the names and not only their beginning. Only available if the setting 'substring_index' is enabled, otherwise ignored.
+        * @param maxEditDistance The number of typing errors (insertions, deletions or substitutions) tolerated in each word. Ignored if the substring match is used.
         * @remarks Will not fill the fields 'FindResult.tag' and 'FindResult.peer_id'.
         */
       virtual QList<Protos::Common::FindResult> find(const QString& words, int maxNbResult, int maxSize) = 0;
-      virtual QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize) = 0;
+      virtual QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize, bool substringMatch = false, int maxEditDistance = 0) = 0;
 
       /**
         * Ask if we have the given hashes. For each hashes a bit is set (1 if the hash is known or 0 otherwise) into the returned QBitArray.
@@ -150,6 +152,12 @@ namespace FM
         */
       virtual QBitArray haveChunks(const QList<Common::Hash>& hashes) = 0;
 
+      /**
+        * Same as above but with the prefixes of the hashes, see 'Common::Hash::getPrefix()'.
+        * A bit may be set for a chunk we don't have if its prefix collides with the one of a known chunk.
+        */
+      virtual QBitArray haveChunks(const QList<quint64>& hashPrefixes) = 0;
+
       /**
         * Return the amount of shared data.
         */
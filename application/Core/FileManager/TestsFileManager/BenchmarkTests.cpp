@@ -0,0 +1,346 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#include <BenchmarkTests.h>
+using namespace FM;
+
+#if defined(Q_OS_LINUX)
+   #include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include <QtDebug>
+#include <QTest>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QVector>
+#include <QMutex>
+#include <QRandomGenerator64>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include <Common/StringUtils.h>
+#include <Common/Constants.h>
+#include <Common/SharedDir.h>
+#include <Common/Global.h>
+#include <Common/LogManager/Builder.h>
+
+#include <priv/WordIndex/WordIndex.h>
+#include <priv/WordIndex/TrigramIndex.h>
+#include <priv/Cache/Cache.h>
+#include <priv/Cache/SharedDirectory.h>
+#include <priv/Cache/Directory.h>
+#include <priv/Cache/File.h>
+#include <priv/Cache/Chunk.h>
+#include <priv/Cache/EntryMutex.h>
+#include <priv/FileUpdater/DirScanner.h>
+
+BenchmarkTests::BenchmarkTests()
+{
+}
+
+/**
+  * Generate a corpus of one million names built from pseudo-words, a bit like the one generated by the prototype "03_Search".
+  * About one word out of four is glued to the previous one, like in "2011Remastered".
+  */
+void BenchmarkTests::initTestCase()
+{
+   LM::Builder::initMsgHandler();
+
+   qDebug() << "===== initTestCase() =====";
+
+   QRandomGenerator64 rng(42);
+   const int NB_NAMES = 1000000;
+   const int VOCABULARY_SIZE = 20000;
+   const int NB_TERMS = 1000;
+   const QStringList SYLLABLES { "re", "mas", "ter", "ed", "the", "lit", "tle", "duck", "on", "ly", "ka", "zu", "mi", "pro", "ject", "ion", "set", "up", "ex", "tra", "sea", "son", "live", "cut", "dir", "mix", "al", "bum", "vo", "lu", "me" };
+
+   QStringList vocabulary;
+   vocabulary.reserve(VOCABULARY_SIZE);
+   for (int i = 0; i < VOCABULARY_SIZE; i++)
+   {
+      QString word;
+      const int nbSyllables = 2 + rng.bounded(3);
+      for (int j = 0; j < nbSyllables; j++)
+         word.append(SYLLABLES[rng.bounded(SYLLABLES.size())]);
+      vocabulary << word;
+   }
+
+   this->names.reserve(NB_NAMES);
+   for (int i = 0; i < NB_NAMES; i++)
+   {
+      QString name;
+      if (rng.bounded(10) == 0)
+         name.append(QString::number(1950 + rng.bounded(70)));
+
+      const int nbWords = 1 + rng.bounded(5);
+      for (int j = 0; j < nbWords; j++)
+      {
+         if (j > 0 && rng.bounded(4) != 0)
+            name.append(' ');
+         name.append(vocabulary[rng.bounded(vocabulary.size())]);
+      }
+      this->names << Common::StringUtils::splitInWords(name);
+   }
+
+   // Terms are taken from the middle of the words.
+   for (int i = 0; i < NB_TERMS; i++)
+   {
+      const QString& word = vocabulary[rng.bounded(vocabulary.size())];
+      const int position = rng.bounded(word.size() / 2);
+      this->terms << word.mid(position, 4 + rng.bounded(3));
+   }
+}
+
+/**
+  * The items are pointers inserted in a random order like the 'Entry*' of the file manager, which are
+  * inserted in the order of the scan and not in the order of their address.
+  */
+void BenchmarkTests::wordIndexVsTrigramIndex()
+{
+   qDebug() << "===== wordIndexVsTrigramIndex() =====";
+
+   const int MAX_NB_RESULT = 300; // Default value of the setting 'max_number_of_search_result_to_send'.
+
+   typedef const QStringList* Item;
+   QVector<Item> items;
+   items.reserve(this->names.size());
+   for (int i = 0; i < this->names.size(); i++)
+      items << &this->names[i];
+   std::shuffle(items.begin(), items.end(), QRandomGenerator64(42));
+
+   QElapsedTimer timer;
+
+   ///// Insert /////
+   qint64 memoryBefore = BenchmarkTests::residentMemory();
+   timer.start();
+   QScopedPointer<WordIndex<Item>> wordIndex(new WordIndex<Item>());
+   for (int i = 0; i < items.size(); i++)
+      wordIndex->addItem(*items[i], items[i]);
+   qDebug() << "WordIndex, insert" << this->names.size() << "names: Elapsed time [ms]:" << timer.elapsed() << ", memory [KiB]:" << (BenchmarkTests::residentMemory() - memoryBefore) / 1024;
+
+   memoryBefore = BenchmarkTests::residentMemory();
+   timer.start();
+   QScopedPointer<TrigramIndex<Item>> trigramIndex(new TrigramIndex<Item>());
+   for (int i = 0; i < items.size(); i++)
+      trigramIndex->addItem(*items[i], items[i]);
+   qDebug() << "TrigramIndex, insert" << this->names.size() << "names: Elapsed time [ms]:" << timer.elapsed() << ", memory [KiB]:" << (BenchmarkTests::residentMemory() - memoryBefore) / 1024;
+   qDebug() << trigramIndex->toStringLog();
+
+   ///// Search /////
+   qint64 nbResults = 0;
+   timer.start();
+   for (QStringListIterator i(this->terms); i.hasNext();)
+      nbResults += wordIndex->search(QStringList { i.next() }, MAX_NB_RESULT).size();
+   qDebug() << "WordIndex, search" << this->terms.size() << "terms: Elapsed time [ms]:" << timer.elapsed() << ", number of results:" << nbResults;
+
+   nbResults = 0;
+   timer.start();
+   for (QStringListIterator i(this->terms); i.hasNext();)
+      nbResults += trigramIndex->search(QStringList { i.next() }, MAX_NB_RESULT).size();
+   qDebug() << "TrigramIndex, search" << this->terms.size() << "terms: Elapsed time [ms]:" << timer.elapsed() << ", number of results:" << nbResults;
+
+   ///// Remove /////
+   timer.start();
+   for (int i = 0; i < items.size(); i++)
+      trigramIndex->rmItem(items[i]);
+   qDebug() << "TrigramIndex, remove" << this->names.size() << "names: Elapsed time [ms]:" << timer.elapsed();
+   QCOMPARE(trigramIndex->nbItems(), 0);
+}
+
+/**
+  * The files are created in memory only, like during the scan of a shared directory, the indexes of the file manager aren't included.
+  * The empty files measure the cost of a file alone, the cost of a chunk is measured with some files having hashes.
+  * Then the previous and the current allocation of the mutex of an entry and of a chunk are compared on the same number of objects.
+  */
+void BenchmarkTests::cacheMemory()
+{
+   qDebug() << "===== cacheMemory() =====";
+
+   const int NB_DIRS = 1000;
+   const int NB_FILES_PER_DIR = 100;
+   const int NB_CHUNKS_PER_FILE = 4;
+   const int NB_FILES = NB_DIRS * NB_FILES_PER_DIR;
+
+   Chunk::CHUNK_SIZE = Common::Constants::CHUNK_SIZE;
+
+   Cache cache;
+   SharedDirectory* sharedDir = cache.getSharedDirectory(cache.addASharedDir(QDir::tempPath()).first.ID);
+   QVERIFY(sharedDir);
+
+   const QDateTime dateLastModified = QDateTime::currentDateTime();
+   Common::Hashes hashes;
+   for (int i = 0; i < NB_CHUNKS_PER_FILE; i++)
+      hashes << Common::Hash::rand();
+
+   ///// Files without chunk /////
+   qint64 memoryBefore = BenchmarkTests::residentMemory();
+   for (int i = 0; i < NB_DIRS; i++)
+   {
+      Directory* dir = new Directory(sharedDir, QString("dir %1").arg(i));
+      for (int j = 0; j < NB_FILES_PER_DIR; j++)
+         new File(dir, QString("empty file %1.txt").arg(j), 0, dateLastModified);
+   }
+   const qint64 memoryFiles = BenchmarkTests::residentMemory() - memoryBefore;
+   qDebug() << "Files without chunk:" << NB_FILES << "files, memory [KiB]:" << memoryFiles / 1024 << ", bytes/file:" << memoryFiles / NB_FILES;
+
+   ///// Files with chunks /////
+   memoryBefore = BenchmarkTests::residentMemory();
+   for (int i = 0; i < NB_DIRS; i++)
+   {
+      Directory* dir = new Directory(sharedDir, QString("dir with chunks %1").arg(i));
+      for (int j = 0; j < NB_FILES_PER_DIR; j++)
+         new File(dir, QString("file %1.txt").arg(j), qint64(NB_CHUNKS_PER_FILE) * Chunk::CHUNK_SIZE, dateLastModified, hashes);
+   }
+   const qint64 memoryChunks = BenchmarkTests::residentMemory() - memoryBefore - memoryFiles;
+   const int nbChunks = NB_FILES * NB_CHUNKS_PER_FILE;
+   qDebug() << "Files with chunks:" << nbChunks << "chunks, memory of the chunks [KiB]:" << memoryChunks / 1024 << ", bytes/chunk:" << memoryChunks / nbChunks;
+
+   // The objects of the first measure are kept alive, otherwise the second one would reuse their freed memory.
+
+   ///// Mutex of an entry: 'QMutex::Recursive' (before) and 'EntryMutex' (after) /////
+   QVector<QMutex*> recursiveMutexes;
+   QVector<EntryMutex*> entryMutexes;
+   recursiveMutexes.reserve(NB_FILES);
+   entryMutexes.reserve(NB_FILES);
+
+   memoryBefore = BenchmarkTests::residentMemory();
+   for (int i = 0; i < NB_FILES; i++)
+   {
+      recursiveMutexes << new QMutex(QMutex::Recursive);
+      recursiveMutexes.last()->lock(); // To make sure the mutex is used like the one of an entry.
+      recursiveMutexes.last()->unlock();
+   }
+   const qint64 memoryRecursiveMutexes = BenchmarkTests::residentMemory() - memoryBefore;
+
+   memoryBefore = BenchmarkTests::residentMemory();
+   for (int i = 0; i < NB_FILES; i++)
+   {
+      entryMutexes << new EntryMutex();
+      entryMutexes.last()->lock();
+      entryMutexes.last()->unlock();
+   }
+   const qint64 memoryEntryMutexes = BenchmarkTests::residentMemory() - memoryBefore;
+
+   qDebug() << "Mutex of an entry, before (recursive QMutex): bytes/entry:" << memoryRecursiveMutexes / NB_FILES << ", after (EntryMutex): bytes/entry:" << memoryEntryMutexes / NB_FILES;
+
+   qDeleteAll(recursiveMutexes);
+   qDeleteAll(entryMutexes);
+
+   ///// Allocation of a chunk: 'QSharedPointer(new Chunk)' (before) and 'QSharedPointer::create(..)' (after) /////
+   // Both include the record of the chunk in the hash store.
+   QVector<QSharedPointer<Chunk>> separatedChunks;
+   QVector<QSharedPointer<Chunk>> contiguousChunks;
+   separatedChunks.reserve(nbChunks);
+   contiguousChunks.reserve(nbChunks);
+
+   memoryBefore = BenchmarkTests::residentMemory();
+   for (int i = 0; i < nbChunks; i++)
+      separatedChunks << QSharedPointer<Chunk>(new Chunk(nullptr, 0, 0));
+   const qint64 memorySeparatedChunks = BenchmarkTests::residentMemory() - memoryBefore;
+
+   memoryBefore = BenchmarkTests::residentMemory();
+   for (int i = 0; i < nbChunks; i++)
+      contiguousChunks << QSharedPointer<Chunk>::create(nullptr, 0, 0);
+   const qint64 memoryContiguousChunks = BenchmarkTests::residentMemory() - memoryBefore;
+
+   qDebug() << "Allocation of a chunk, before (QSharedPointer(new Chunk)): bytes/chunk:" << memorySeparatedChunks / nbChunks << ", after (QSharedPointer::create): bytes/chunk:" << memoryContiguousChunks / nbChunks;
+}
+
+/**
+  * A tree of 1000 directories (10 * 10 * 10) having 20 files each is generated in the temporary directory
+  * then listed with 'QDir::entryInfoList(..)' (the previous implementation of 'FileUpdater::scan(..)') and with 'DirScanner'.
+  * The directories are in the system cache after their creation thus this measures mostly the processing time,
+  * on a network storage the latency of each request makes the parallel listing much more profitable.
+  */
+void BenchmarkTests::scanDirectoryTree()
+{
+   qDebug() << "===== scanDirectoryTree() =====";
+
+   const int NB_DIRS_PER_LEVEL = 10;
+   const int NB_FILES_PER_DIR = 20;
+   const QString root = QDir::tempPath() + "/D-LAN scan benchmark/";
+
+   for (int i = 0; i < NB_DIRS_PER_LEVEL; i++)
+      for (int j = 0; j < NB_DIRS_PER_LEVEL; j++)
+         for (int k = 0; k < NB_DIRS_PER_LEVEL; k++)
+            for (int f = 0; f < NB_FILES_PER_DIR; f++)
+               QVERIFY(Common::Global::createFile(QString("%1dir %2/dir %3/dir %4/file %5.txt").arg(root).arg(i).arg(j).arg(k).arg(f)));
+
+   QElapsedTimer timer;
+
+   ///// QDir /////
+   timer.start();
+   int nbEntries = 0;
+   QStringList dirsToVisit { root };
+   while (!dirsToVisit.isEmpty())
+   {
+      const QString dir = dirsToVisit.takeFirst();
+      foreach (QFileInfo entry, QDir(dir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks))
+      {
+         nbEntries++;
+         if (entry.isDir())
+            dirsToVisit << entry.absoluteFilePath() + '/';
+         else
+            entry.lastModified();
+      }
+   }
+   qDebug() << "QDir::entryInfoList(..):" << nbEntries << "entries: Elapsed time [ms]:" << timer.elapsed();
+
+   ///// DirScanner /////
+   for (int nbThreads = 1; nbThreads <= 8; nbThreads *= 2)
+   {
+      DirScanner scanner(nbThreads);
+      timer.start();
+      int nbEntriesScanner = 0;
+      scanner.add(root, nullptr);
+      DirScanner::Listing listing;
+      while (scanner.next(listing))
+         for (QListIterator<DirScanner::Entry> i(listing.entries); i.hasNext();)
+         {
+            const DirScanner::Entry& entry = i.next();
+            nbEntriesScanner++;
+            if (entry.isDir)
+               scanner.add(listing.path + entry.name + '/', nullptr);
+         }
+      qDebug() << "DirScanner," << nbThreads << "thread(s):" << nbEntriesScanner << "entries: Elapsed time [ms]:" << timer.elapsed();
+      QCOMPARE(nbEntriesScanner, nbEntries);
+   }
+
+   Common::Global::recursiveDeleteDirectory(root);
+}
+
+/**
+  * Returns the resident memory of the process [byte] or -1 if it can't be known on this platform.
+  */
+qint64 BenchmarkTests::residentMemory()
+{
+#if defined(Q_OS_LINUX)
+   QFile statm("/proc/self/statm");
+   if (statm.open(QIODevice::ReadOnly))
+   {
+      const QList<QByteArray> values = statm.readAll().split(' ');
+      if (values.size() > 1)
+         return values[1].toLongLong() * sysconf(_SC_PAGESIZE);
+   }
+#endif
+   return -1;
+}
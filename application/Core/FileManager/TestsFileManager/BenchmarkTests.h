@@ -0,0 +1,55 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#ifndef TESTS_BENCHMARKTESTS_H
+#define TESTS_BENCHMARKTESTS_H
+
+#include <QObject>
+#include <QList>
+#include <QStringList>
+
+/**
+  * Some benchmarks of the internal structures of the file manager.
+  * Launched with the argument "-benchmark".
+  */
+class BenchmarkTests : public QObject
+{
+   Q_OBJECT
+public:
+   BenchmarkTests();
+
+private slots:
+   void initTestCase();
+
+   /***** Substring search (trigram index) against the word prefix search *****/
+   void wordIndexVsTrigramIndex();
+
+   /***** Memory taken by the files and the chunks of the cache *****/
+   void cacheMemory();
+
+   /***** Listing of a directory tree, sequential and parallel *****/
+   void scanDirectoryTree();
+
+private:
+   static qint64 residentMemory();
+
+   QList<QStringList> names; ///< A synthetic corpus of file names, already split in words.
+   QStringList terms; ///< Some terms to search, most of them are inside the words of 'names'.
+};
+
+#endif
@@ -20,6 +20,8 @@
 using namespace FM;
 
 #include <string>
+#include <limits>
+#include <cstring>
 using namespace std;
 
 #include <QtDebug>
@@ -28,7 +30,10 @@ using namespace std;
 #include <QTextStream>
 #include <QDataStream>
 #include <QStringList>
+#include <QDir>
 #include <QDirIterator>
+#include <QFileInfo>
+#include <QPair>
 
 #include <Protos/core_settings.pb.h>
 
@@ -39,12 +44,15 @@ using namespace std;
 #include <Common/ProtoHelper.h>
 #include <Common/Settings.h>
 #include <Common/SharedDir.h>
+#include <Common/StringUtils.h>
 
 #include <IChunk.h>
 #include <IGetHashesResult.h>
 #include <Exceptions.h>
 #include <priv/Constants.h>
 #include <priv/WordIndex/WordIndex.h>
+#include <priv/WordIndex/TrigramIndex.h>
+#include <priv/IndexSnapshot.h>
 
 #include <HashesReceiver.h>
 
@@ -70,9 +78,17 @@ void Tests::initTestCase()
    }
 
    Common::PersistentData::rmValue(Common::Constants::FILE_CACHE, Common::Global::DataFolderType::LOCAL); // Reset the stored cache.
+   Common::PersistentData::rmValue(Common::Constants::FILE_CACHE_LEGACY, Common::Global::DataFolderType::LOCAL);
+   Common::PersistentData::rmValue(Common::Constants::FILE_INDEX_SNAPSHOT, Common::Global::DataFolderType::LOCAL);
+   Common::PersistentData::rmValue(Common::Constants::FILE_CACHE_JOURNAL, Common::Global::DataFolderType::LOCAL);
+   Common::PersistentData::rmValue(Common::Constants::FILE_HASH_STORE, Common::Global::DataFolderType::LOCAL);
 
    SETTINGS.setFilename("core_settings_file_manager_tests.txt");
    SETTINGS.setSettingsMessage(new Protos::Core::Settings());
+   SETTINGS.set("substring_index", true);
+   SETTINGS.set("search_result_cache_size", 1048576u);
+   SETTINGS.set("scan_nb_threads", 4u);
+   SETTINGS.set("unfinished_suffix_term", QString(".unfinished"));
 }
 
 void Tests::testWordIndex()
@@ -142,6 +158,148 @@ void Tests::testWordIndex()
    QVERIFY(result10.size() == 0);
 }
 
+void Tests::testWordIndexWithErrors()
+{
+   qDebug() << "===== testWordIndexWithErrors() =====";
+
+   WordIndex<int> index;
+   int remastered = 1;
+   int master = 2;
+   int monster = 3;
+   int mister = 4;
+
+   index.addItem("remastered", remastered);
+   index.addItem("master", master);
+   index.addItem("monster", monster);
+   index.addItem("mister", mister);
+
+   QVERIFY(index.search("mastor").isEmpty());
+
+   QList<int> result1 = WordIndex<int>::resultToList(index.search("mastor", -1, nullptr, 1));
+   QVERIFY(result1.size() == 1);
+   QVERIFY(result1.contains(master));
+
+   // The results are sorted by distance.
+   QList<NodeResult<int>> result2 = index.search("mastor", -1, nullptr, 2);
+   QVERIFY(result2.size() == 2);
+   QVERIFY(result2[0].value == master && result2[0].level == 2);
+   QVERIFY(result2[1].value == mister && result2[1].level == 4);
+
+   QList<int> result3 = WordIndex<int>::resultToList(index.search("remastred", -1, nullptr, 1));
+   QVERIFY(result3.size() == 1);
+   QVERIFY(result3.contains(remastered));
+
+   // A short word can only match the beginning of an indexed word with one error.
+   QList<NodeResult<int>> result4 = index.search("mas", -1, nullptr, 2);
+   QVERIFY(result4.size() == 2);
+   QVERIFY(result4[0].value == master && result4[0].level == 1);
+   QVERIFY(result4[1].value == mister && result4[1].level == 3);
+
+   QList<NodeResult<int>> result5 = index.search("monstre", -1, nullptr, 2);
+   QVERIFY(result5.size() == 1);
+   QVERIFY(result5[0].value == monster && result5[0].level == 3);
+
+   // An exact match is still the best one.
+   QList<NodeResult<int>> result6 = index.search("master", -1, nullptr, 1);
+   QVERIFY(!result6.isEmpty());
+   QVERIFY(result6[0].value == master && result6[0].level == 0);
+
+   // An item matching all the words with some errors has a better level than an item matching less words exactly.
+   WordIndex<int> index2;
+   int misterMonster = 1;
+   int masterAlone = 2;
+   index2.addItem(QStringList { "mister", "monster" }, misterMonster);
+   index2.addItem(QStringList { "master" }, masterAlone);
+
+   QList<NodeResult<int>> result7 = index2.search(QStringList { "master", "monstor" }, -1, nullptr, 2);
+   QVERIFY(result7.size() == 2);
+   QVERIFY(result7[0].value == misterMonster);
+   QVERIFY(result7[1].value == masterAlone);
+   QVERIFY(result7[0].level < result7[1].level);
+}
+
+void Tests::testTrigramIndex()
+{
+   qDebug() << "===== testTrigramIndex() =====";
+
+   TrigramIndex<int> index;
+   int remastered = 1;
+   int theMaster = 2;
+   int remasterOfTheKing = 3;
+
+   index.addItem(Common::StringUtils::splitInWords("2011Remastered"), remastered);
+   index.addItem(Common::StringUtils::splitInWords("The Master"), theMaster);
+   index.addItem(Common::StringUtils::splitInWords("Remaster of the king"), remasterOfTheKing);
+
+   qDebug() << index.toStringLog();
+
+   // A term matching the beginning of a word has a better level than a term found inside a word.
+   QList<NodeResult<int>> result1 = index.search(QStringList { "remaster" });
+   QVERIFY(result1.size() == 2);
+   QVERIFY(result1[0].value == remasterOfTheKing && result1[0].level == 0);
+   QVERIFY(result1[1].value == remastered && result1[1].level == 1);
+
+   QList<int> result2 = WordIndex<int>::resultToList(index.search(QStringList { "master" }));
+   QVERIFY(result2.size() == 3);
+   QVERIFY(result2[0] == theMaster);
+
+   // All terms must be contained, the short ones are only verified.
+   QList<int> result3 = WordIndex<int>::resultToList(index.search(QStringList { "aster", "of" }));
+   QVERIFY(result3.size() == 1);
+   QVERIFY(result3.contains(remasterOfTheKing));
+
+   // Having all the trigrams isn't enough: all the trigrams of "remasterem" are in "2011remastered" but the term isn't contained.
+   QList<int> result4 = WordIndex<int>::resultToList(index.search(QStringList { "remasterem" }));
+   QVERIFY(result4.isEmpty());
+
+   QVERIFY(!TrigramIndex<int>::isSearchable(QStringList { "ma", "of" }));
+   QVERIFY(index.search(QStringList { "ma" }).isEmpty());
+
+   QVERIFY(index.rmItem(theMaster));
+   QVERIFY(!index.rmItem(theMaster));
+   QList<int> result5 = WordIndex<int>::resultToList(index.search(QStringList { "master" }));
+   QVERIFY(result5.size() == 2);
+   QVERIFY(!result5.contains(theMaster));
+
+   index.renameItem(Common::StringUtils::splitInWords("Masterpiece"), remastered);
+   QList<int> result6 = WordIndex<int>::resultToList(index.search(QStringList { "remaster" }));
+   QVERIFY(result6.size() == 1);
+   QVERIFY(result6.contains(remasterOfTheKing));
+   QList<int> result7 = WordIndex<int>::resultToList(index.search(QStringList { "piece" }));
+   QVERIFY(result7.size() == 1);
+   QVERIFY(result7.contains(remastered));
+
+   QVERIFY(index.rmItem(remastered));
+   QVERIFY(index.rmItem(remasterOfTheKing));
+   QVERIFY(index.nbItems() == 0);
+   QVERIFY(index.nbTrigrams() == 0);
+
+   // The items are added in decreasing order, the posting lists are sorted by the first search.
+   for (int i = 100; i > 0; i--)
+      index.addItem(Common::StringUtils::splitInWords(QString("file%1 master").arg(i)), i);
+   QVERIFY(index.rmItem(50)); // Removed from an unsorted posting list.
+   QCOMPARE(index.search(QStringList { "file", "aster" }).size(), 99);
+   QList<int> result8 = WordIndex<int>::resultToList(index.search(QStringList { "file5" }));
+   QCOMPARE(result8.size(), 10); // "file5" and from "file51" to "file59".
+   QVERIFY(!result8.contains(50));
+   QVERIFY(index.rmItem(51)); // Removed from a sorted posting list.
+   QCOMPARE(index.search(QStringList { "file5" }).size(), 9);
+
+   for (int i = 1; i <= 100; i++)
+      index.rmItem(i);
+   QVERIFY(index.nbItems() == 0);
+   QVERIFY(index.nbTrigrams() == 0);
+
+   // The results are limited after being sorted: the best level comes after the limit in the posting lists.
+   index.addItem(Common::StringUtils::splitInWords("2011Remastered"), remastered);
+   index.addItem(Common::StringUtils::splitInWords("The Master"), theMaster);
+   QList<NodeResult<int>> result9 = index.search(QStringList { "master" }, 1);
+   QCOMPARE(result9.size(), 1);
+   QVERIFY(result9[0].value == theMaster && result9[0].level == 0);
+   QVERIFY(index.rmItem(remastered));
+   QVERIFY(index.rmItem(theMaster));
+}
+
 void Tests::createFileManager()
 {
    qDebug() << "===== createFileManager() =====";
@@ -430,6 +588,41 @@ void Tests::getAnUnexistingChunk()
       QFAIL("No chunk must be found");
 }
 
+#include <priv/Cache/DataReader.h>
+
+/**
+  * A chunk is entirely read only when a read at its end returns nothing, see 'File::chunkEntirelyRead(..)'.
+  */
+void Tests::readAChunkUpToItsEnd()
+{
+   qDebug() << "===== readAChunkUpToItsEnd() =====";
+
+   QSharedPointer<IChunk> chunk = this->fileManager->getChunk(Common::Hash::fromStr("97d464813598e2e4299b5fe7db29aefffdf2641d")); // "r.txt".
+   QVERIFY(!chunk.isNull());
+   QCOMPARE(chunk->getChunkSize(), 5);
+
+   QByteArray buffer(SETTINGS.get<quint32>("buffer_size_reading"), 0);
+
+   {
+      QSharedPointer<IDataReader> reader = chunk->getDataReader();
+      QCOMPARE(reader->read(buffer.data(), 2), 3);
+      QVERIFY(!static_cast<DataReader*>(reader.data())->isEndReached());
+   }
+
+   {
+      QSharedPointer<IDataReader> reader = chunk->getDataReader();
+      int offset = 0;
+      int bytesRead;
+      while ((bytesRead = reader->read(buffer.data(), offset)) > 0)
+      {
+         QVERIFY(!static_cast<DataReader*>(reader.data())->isEndReached());
+         offset += bytesRead;
+      }
+      QCOMPARE(offset, 5);
+      QVERIFY(static_cast<DataReader*>(reader.data())->isEndReached());
+   }
+}
+
 void Tests::getHashesFromAFileEntry1()
 {
    qDebug() << "===== getHashesFromAFileEntry1() =====";
@@ -694,6 +887,148 @@ void Tests::findFilesBySizeRange()
    this->compareExpectedResult(results.first(), expectedResult);
 }
 
+void Tests::findFilesWithSubstrings()
+{
+   qDebug() << "===== findFilesWithSubstrings() =====";
+
+   QString terms("aaaaa bbbbb");
+
+   FindResult expectedResult;
+   expectedResult[0] << "aaaaaa bbbbbb.txt";
+
+   QList<Protos::Common::FindResult> results = this->fileManager->find(terms, QList<QString>(), 0, std::numeric_limits<qint64>::max(), Protos::Common::FindPattern::FILE_DIR, 10000, 65536, true);
+   QVERIFY(!results.isEmpty());
+   QCOMPARE(results.first().entry_size(), 1);
+   this->printSearch(terms, results.first());
+   this->compareExpectedResult(results.first(), expectedResult);
+}
+
+void Tests::findFilesWithATypingError()
+{
+   qDebug() << "===== findFilesWithATypingError() =====";
+
+   QString terms("bbbx");
+
+   FindResult expectedResult;
+   expectedResult[2] << "aaaa bbbb cccc.txt" << "aaaa bbbb.txt" << "aaaaaa bbbb.txt" << "bbbb cccc.nfo" << "cccc bbbb.nfo" << "bbbb dddd.nfo" << "bbbb.txt";
+   expectedResult[3] << "aaaaaa bbbbbb.txt" << "cccc bbbbbb.txt";
+
+   QVERIFY(this->fileManager->find(terms, 10000, 65536).isEmpty());
+
+   QList<Protos::Common::FindResult> results = this->fileManager->find(terms, QList<QString>(), 0, std::numeric_limits<qint64>::max(), Protos::Common::FindPattern::FILE_DIR, 10000, 65536, false, 1);
+   QVERIFY(!results.isEmpty());
+   QCOMPARE(results.first().entry_size(), 9);
+   this->printSearch(terms, results.first());
+   this->compareExpectedResult(results.first(), expectedResult);
+}
+
+/**
+  * The file manager is restarted, the snapshot written when it's deleted must answer the searches until the cache is loaded.
+  */
+void Tests::findFilesFromTheIndexSnapshot()
+{
+   qDebug() << "===== findFilesFromTheIndexSnapshot() =====";
+
+   QString terms("aaaa");
+
+   FindResult expectedResult;
+   expectedResult[0] << "aaaa cccc.txt" << "aaaa bbbb.txt" << "aaaa bbbb cccc.txt" << "aaaa dddddd.txt";
+   expectedResult[1] << "aaaaaa dddddd.txt" << "aaaaaa bbbb.txt" << "aaaaaa bbbbbb.txt";
+
+   this->fileManager.clear();
+   QTest::qWait(200);
+
+   {
+      QSharedPointer<IndexSnapshot> snapshot = IndexSnapshot::load(Common::Global::getDataFolder(Common::Global::DataFolderType::LOCAL) + '/' + Common::Constants::FILE_INDEX_SNAPSHOT);
+      QVERIFY(!snapshot.isNull());
+
+      const QList<NodeResult<quint32>>& result = snapshot->search(QStringList { terms }, 10000);
+      QCOMPARE(result.size(), 7);
+      for (QListIterator<NodeResult<quint32>> i(result); i.hasNext();)
+      {
+         const NodeResult<quint32>& entry = i.next();
+         Protos::Common::Entry protoEntry;
+         snapshot->populateEntry(entry.value, &protoEntry);
+         QVERIFY(expectedResult[entry.level].contains(Common::ProtoHelper::getStr(protoEntry, &Protos::Common::Entry::name)));
+      }
+
+      QCOMPARE(snapshot->searchByExtensions(QList<QString> { "NFO" }).size(), 3);
+   }
+
+   // The events aren't processed before the search thus the cache can't be already loaded.
+   this->fileManager = Builder::newFileManager();
+   QCOMPARE(this->fileManager->getCacheStatus(), IFileManager::LOADING_CACHE_IN_PROGRSS);
+
+   QList<Protos::Common::FindResult> results = this->fileManager->find(terms, 10000, 65536);
+   QVERIFY(!results.isEmpty());
+   QCOMPARE(results.first().entry_size(), 7);
+   this->printSearch(terms, results.first());
+   this->compareExpectedResult(results.first(), expectedResult);
+
+   for (int i = 0; i < 50 && this->fileManager->getCacheStatus() == IFileManager::LOADING_CACHE_IN_PROGRSS; i++)
+      QTest::qWait(100);
+   QVERIFY(this->fileManager->getCacheStatus() != IFileManager::LOADING_CACHE_IN_PROGRSS);
+}
+
+/**
+  * A snapshot having the right size but an invalid position in one of its tables must be rejected.
+  * The offsets follow the layout described in 'IndexSnapshot'.
+  */
+void Tests::loadACorruptedIndexSnapshot()
+{
+   qDebug() << "===== loadACorruptedIndexSnapshot() =====";
+
+   const QString snapshotPath = Common::Global::getDataFolder(Common::Global::DataFolderType::LOCAL) + '/' + Common::Constants::FILE_INDEX_SNAPSHOT;
+   const QString corruptedPath = snapshotPath + ".corrupted";
+
+   QFile snapshotFile(snapshotPath);
+   QVERIFY(snapshotFile.open(QIODevice::ReadOnly));
+   const QByteArray snapshot = snapshotFile.readAll();
+   snapshotFile.close();
+
+   auto readValue = [&](int offset) { quint32 value; memcpy(&value, snapshot.constData() + offset, sizeof(quint32)); return value; };
+   const quint32 nbEntries = readValue(8);
+   const quint32 nbWords = readValue(12);
+   const quint32 nbExtensions = readValue(16);
+   const quint32 nbSharedDirs = readValue(20);
+   QVERIFY(nbEntries > 0 && nbWords > 0);
+
+   const int HEADER_SIZE = 40;
+   const int ENTRY_RECORD_SIZE = 32;
+   const int KEY_RECORD_SIZE = 16;
+   const int SHARED_DIR_RECORD_SIZE = 32;
+   const int firstEntry = HEADER_SIZE;
+   const int firstWord = firstEntry + nbEntries * ENTRY_RECORD_SIZE;
+   const int firstPosting = firstWord + (nbWords + nbExtensions) * KEY_RECORD_SIZE + nbSharedDirs * SHARED_DIR_RECORD_SIZE;
+
+   // Each corruption writes a value at the given offset.
+   const QList<QPair<int, quint32>> corruptions {
+      { firstEntry + 24, nbSharedDirs }, // 'EntryRecord::sharedDir'.
+      { firstEntry + 16, std::numeric_limits<quint32>::max() }, // 'EntryRecord::name.offset'.
+      { firstWord + 12, std::numeric_limits<quint32>::max() }, // 'KeyRecord::nbPostings'.
+      { firstPosting, nbEntries } // The first posting.
+   };
+
+   for (QListIterator<QPair<int, quint32>> i(corruptions); i.hasNext();)
+   {
+      const QPair<int, quint32>& corruption = i.next();
+      QByteArray corrupted = snapshot;
+      memcpy(corrupted.data() + corruption.first, &corruption.second, sizeof(quint32));
+
+      QFile corruptedFile(corruptedPath);
+      QVERIFY(corruptedFile.open(QIODevice::WriteOnly));
+      QCOMPARE(corruptedFile.write(corrupted), qint64(corrupted.size()));
+      corruptedFile.close();
+
+      QVERIFY(IndexSnapshot::load(corruptedPath).isNull());
+   }
+
+   // The original snapshot is still valid.
+   QVERIFY(!IndexSnapshot::load(snapshotPath).isNull());
+
+   QFile::remove(corruptedPath);
+}
+
 void Tests::haveChunks()
 {
    qDebug() << "===== haveChunks() =====";
@@ -719,6 +1054,60 @@ void Tests::haveChunks()
       QVERIFY(result[i] == expectedResult[i]);
       qDebug() << hashes[i].toStr() << ":" << (result[i] ? "Yes" : "No");
    }
+
+   QList<quint64> hashPrefixes;
+   for (QListIterator<Common::Hash> i(hashes); i.hasNext();)
+      hashPrefixes << i.next().getPrefix();
+
+   QCOMPARE(this->fileManager->haveChunks(hashPrefixes), expectedResult);
+}
+
+#if defined(Q_OS_LINUX)
+   #include <fcntl.h>
+   #include <sys/stat.h>
+#endif
+
+/**
+  * A file is moved to another shared directory and renamed while the file manager is stopped,
+  * its hashes must be restored from the file cache by 'FileUpdater::restoreMovedFiles()'.
+  * The content is changed without changing the size and the modification date: the old hash
+  * is only known if the hashes have been restored and not computed again.
+  */
+void Tests::restoreAMovedFile()
+{
+   qDebug() << "===== restoreAMovedFile() =====";
+
+#if defined(Q_OS_LINUX)
+   const Common::Hash oldHash = Common::Hash::fromStr("4c24e58c47746ea04296df9342185d9b3a447899"); // "v.txt".
+   const Common::Hash newHash = Common::Hash::fromStr("cddf2730c0b8b278d50b6fe282c82d1bad7648fc"); // "w.txt".
+   const QString movedPath("sharedDirs/share2/moved v.txt");
+
+   this->fileManager.clear();
+   QTest::qWait(200);
+
+   QVERIFY(QFile::rename("sharedDirs/share1/v.txt", movedPath));
+
+   struct stat info;
+   QCOMPARE(stat(QFile::encodeName(movedPath).constData(), &info), 0);
+   {
+      QFile file(movedPath);
+      QVERIFY(file.open(QIODevice::ReadWrite)); // The file isn't truncated to keep its inode.
+      QCOMPARE(file.write("w.txt"), qint64(5));
+   }
+   const struct timespec times[2] = { info.st_atim, info.st_mtim };
+   QCOMPARE(utimensat(AT_FDCWD, QFile::encodeName(movedPath).constData(), times, 0), 0);
+
+   this->fileManager = Builder::newFileManager();
+   for (int i = 0; i < 50 && this->fileManager->getCacheStatus() != IFileManager::UP_TO_DATE; i++)
+      QTest::qWait(100);
+   QCOMPARE(this->fileManager->getCacheStatus(), IFileManager::UP_TO_DATE);
+
+   const QBitArray& result = this->fileManager->haveChunks(QList<Common::Hash>() << oldHash << newHash);
+   QVERIFY(result[0]);
+   QVERIFY(!result[1]);
+#else
+   QSKIP("The modification date of a file can't be set back on this platform");
+#endif
 }
 
 void Tests::printAmount()
@@ -736,15 +1125,53 @@ void Tests::rmSharedDirectory()
    this->fileManager->setSharedDirs(this->sharedDirs);
 }
 
+#include <priv/ChunkIndex/Chunks.h>
+#include <priv/Cache/Chunk.h>
+#include <priv/Cache/Directory.h>
+#include <priv/Cache/File.h>
+
+/**
+  * The lookups of several hashes and hash prefixes used to answer the 'IMAlive' and 'HaveChunks' messages.
+  * Two hashes sharing their prefix can't be distinguished by 'containsPrefixes(..)'.
+  */
+void Tests::chunksContains()
+{
+   qDebug() << "===== chunksContains() =====";
+
+   const Common::Hash known = Common::Hash::fromStr("f6126deaa5e1d9692d54e3bef0507721372ee7f8");
+   const Common::Hash samePrefix = Common::Hash::fromStr("f6126deaa5e1d969ffffffffffffffffffffffff");
+   const Common::Hash unknown = Common::Hash::fromStr("8374d82e993012aa23b293f319eef2c21d2da3b9");
+   QCOMPARE(known.getPrefix(), samePrefix.getPrefix());
+
+   Chunks chunks;
+   QSharedPointer<Chunk> chunk1(new Chunk(nullptr, 0, 0, known));
+   QSharedPointer<Chunk> chunk2(new Chunk(nullptr, 0, 0, known)); // Another file with the same content.
+   chunks.add(chunk1);
+   chunks.add(chunk2);
+
+   QBitArray expectedResult(4);
+   expectedResult.setBit(0);
+   QCOMPARE(chunks.contains(QList<Common::Hash>() << known << samePrefix << unknown << Common::Hash()), expectedResult);
+   QVERIFY(chunks.contains(QList<Common::Hash>() << unknown << samePrefix).isNull());
+
+   QBitArray expectedPrefixResult(3);
+   expectedPrefixResult.setBit(0);
+   expectedPrefixResult.setBit(1);
+   QCOMPARE(chunks.containsPrefixes(QList<quint64>() << known.getPrefix() << samePrefix.getPrefix() << unknown.getPrefix()), expectedPrefixResult);
+
+   // The prefix is known as long as one of its chunks is.
+   chunks.rm(chunk1);
+   QVERIFY(chunks.containsPrefixes(QList<quint64>() << known.getPrefix()).testBit(0));
+   chunks.rm(chunk2);
+   QVERIFY(chunks.containsPrefixes(QList<quint64>() << known.getPrefix()).isNull());
+   QVERIFY(chunks.contains(QList<Common::Hash>() << known).isNull());
+}
+
 /**
   * The following case tests the Bloom filter performance
   * used in the class 'Chunks'.
   * The bloom filter can be enable in "Chunks.h".
   */
-#include <priv/ChunkIndex/Chunks.h>
-#include <priv/Cache/Chunk.h>
-#include <priv/Cache/Directory.h>
-#include <priv/Cache/File.h>
 void Tests::chunksPerformance()
 {
    qDebug() << "===== chunksPerformance() =====";
@@ -811,8 +1238,8 @@ void Tests::extensionIndexRmItem()
    index.addItem(mp3s[1].right(3), mp3s[1]);
    index.addItem("jpg", "file3.jpg");
 
-   index.rmItem(mp3s[0].right(3), mp3s[0]);
-   index.rmItem("jpg", "file3.jpg");
+   index.rmItem(mp3s[0]);
+   index.rmItem("file3.jpg");
 
    {
       QList<QString> result = index.search(mp3s[1].right(3));
@@ -824,6 +1251,18 @@ void Tests::extensionIndexRmItem()
       QList<QString> result = index.search("jpg");
       QVERIFY(result.count() == 0);
    }
+
+   // The identifiers of the removed items are reused, the new items mustn't be found by the extensions of the old ones.
+   index.addItem("png", "file4.png");
+   index.addItem("png", "file5.png");
+   QVERIFY(index.search("mp3").count() == 1);
+   QVERIFY(index.search("jpg").isEmpty());
+   QVERIFY(index.search("png").count() == 2);
+
+   // An item has only one extension.
+   index.addItem("gif", "file4.png");
+   QVERIFY(index.search("png").count() == 1);
+   QVERIFY(index.search("gif").count() == 1);
 }
 
 void Tests::extensionIndexChangeItem()
@@ -834,7 +1273,7 @@ void Tests::extensionIndexChangeItem()
    index.addItem(mp3s[0].right(3), mp3s[0]);
    index.addItem(mp3s[1].right(3), mp3s[1]);
 
-   index.changeItem("mp3", "JPG", mp3s[1]);
+   index.changeItem("JPG", mp3s[1]);
 
    {
       QList<QString> result = index.search("mp3");
@@ -915,6 +1354,690 @@ void Tests::extensionIndexSearchWithSomeExtensions()
    }
 }
 
+#include <QSet>
+#include <QDateTime>
+
+#include <priv/FilterIndex.h>
+#include <priv/Cache/Cache.h>
+#include <priv/Cache/SharedDirectory.h>
+
+void Tests::filterIndexSizeBuckets()
+{
+   QList<qint64> sizes { 0, 1, 3, 4, 7, 8, 9, 10, 15, 16, 1000, 1023, 1024, 1 << 30, std::numeric_limits<qint64>::max() };
+
+   for (QListIterator<qint64> i(sizes); i.hasNext();)
+   {
+      const qint64 size = i.next();
+      const int bucket = FilterIndex::sizeBucket(size);
+      QVERIFY(FilterIndex::sizeBucketLowerBound(bucket) <= size);
+      QVERIFY(FilterIndex::sizeBucketUpperBound(bucket) >= size);
+   }
+
+   QCOMPARE(FilterIndex::sizeBucket(8), FilterIndex::sizeBucket(9));
+   QVERIFY(FilterIndex::sizeBucket(9) != FilterIndex::sizeBucket(10));
+   QCOMPARE(FilterIndex::sizeBucketUpperBound(FilterIndex::sizeBucket(1023)), Q_INT64_C(1023));
+   QCOMPARE(FilterIndex::sizeBucketLowerBound(FilterIndex::sizeBucket(1024)), Q_INT64_C(1024));
+}
+
+/**
+  * The entries are created in memory only, they aren't scanned.
+  */
+void Tests::filterIndexFilter()
+{
+   Chunk::CHUNK_SIZE = Common::Constants::CHUNK_SIZE;
+
+   Cache cache;
+   SharedDirectory* sharedDir = cache.getSharedDirectory(cache.addASharedDir(QDir::tempPath()).first.ID);
+   QVERIFY(sharedDir);
+
+   const QDateTime dateLastModified = QDateTime::currentDateTime();
+   Directory* music = new Directory(sharedDir, "music");
+   File* smallMp3 = new File(music, "small.mp3", 100, dateLastModified);
+   File* bigMp3 = new File(music, "big.MP3", 5000, dateLastModified);
+   File* smallJpg = new File(music, "small.jpg", 100, dateLastModified);
+   File* readme = new File(music, "readme", 100, dateLastModified);
+
+   FilterIndex index;
+   for (Entry* entry : QList<Entry*> { music, smallMp3, bigMp3, smallJpg, readme })
+      index.addItem(entry);
+
+   auto search = [&](const QList<QString>& extensions, qint64 minSize, qint64 maxSize, Protos::Common::FindPattern_Category category) {
+      const QList<Entry*>& result = index.search(index.filter(extensions, minSize, maxSize, category));
+      return QSet<Entry*>(result.begin(), result.end());
+   };
+
+   const qint64 MAX = std::numeric_limits<qint64>::max();
+
+   QCOMPARE(search({ "mp3" }, 0, MAX, Protos::Common::FindPattern::FILE_DIR), (QSet<Entry*> { smallMp3, bigMp3 }));
+   QCOMPARE(search({ "mp3" }, 0, 1000, Protos::Common::FindPattern::FILE), (QSet<Entry*> { smallMp3 }));
+   QCOMPARE(search({ "mp3", "jpg" }, 101, MAX, Protos::Common::FindPattern::FILE_DIR), (QSet<Entry*> { bigMp3 }));
+   QCOMPARE(search({}, 0, 1000, Protos::Common::FindPattern::FILE), (QSet<Entry*> { smallMp3, smallJpg, readme }));
+   QCOMPARE(search({}, 0, MAX, Protos::Common::FindPattern::DIR), (QSet<Entry*> { music }));
+   QVERIFY(search({ "mp3" }, 0, MAX, Protos::Common::FindPattern::DIR).isEmpty());
+   QVERIFY(search({ "mp3" }, 1000, 100, Protos::Common::FindPattern::FILE_DIR).isEmpty());
+
+   // A removed entry isn't matched anymore and its identifier can be reused by an entry having another extension.
+   index.rmItem(smallMp3);
+   index.addItem(readme);
+   File* smallAvi = new File(music, "small.avi", 100, dateLastModified);
+   index.addItem(smallAvi);
+   QCOMPARE(search({ "mp3" }, 0, 1000, Protos::Common::FindPattern::FILE), QSet<Entry*>());
+   QCOMPARE(search({ "avi" }, 0, 1000, Protos::Common::FindPattern::FILE), (QSet<Entry*> { smallAvi }));
+
+   // The size bucket follows the size of the entry.
+   bigMp3->asFileForHasher()->setSize(50);
+   index.resizeItem(bigMp3);
+   QCOMPARE(search({ "mp3" }, 0, 100, Protos::Common::FindPattern::FILE), (QSet<Entry*> { bigMp3 }));
+}
+
+#include <priv/FindResultCache.h>
+
+void Tests::findResultCache()
+{
+   FindResultCache cache(1024);
+   QList<Protos::Common::FindResult> results;
+   results << Protos::Common::FindResult();
+   results.last().add_entry()->set_level(1);
+
+   const QString& key = FindResultCache::key("Aaaa  bbbb", { "TXT", "avi", "txt" }, 0, 42, Protos::Common::FindPattern::FILE, 100, 1000, false, 0);
+   QCOMPARE(FindResultCache::key("aaaa bbbb", { "avi", "txt" }, 0, 42, Protos::Common::FindPattern::FILE, 100, 1000, false, 0), key);
+   QVERIFY(FindResultCache::key("aaaa bbbb", { "avi", "txt" }, 0, 42, Protos::Common::FindPattern::DIR, 100, 1000, false, 0) != key);
+
+   QList<Protos::Common::FindResult> cachedResults;
+   QVERIFY(!cache.get(key, cachedResults));
+
+   cache.insert(key, results, cache.getGeneration());
+   QVERIFY(cache.get(key, cachedResults));
+   QCOMPARE(cachedResults.size(), 1);
+   QCOMPARE(cachedResults.first().entry(0).level(), 1u);
+
+   // Results computed before an invalidation are dropped.
+   const quint64 generation = cache.getGeneration();
+   cache.invalidate();
+   QVERIFY(!cache.get(key, cachedResults));
+   cache.insert(key, results, generation);
+   QVERIFY(!cache.get(key, cachedResults));
+
+   QCOMPARE(cache.getNbHits(), 1ull);
+   QCOMPARE(cache.getNbMisses(), 3ull);
+   qDebug() << cache.toStringLog();
+}
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <priv/Cache/CacheJournal.h>
+
+void Tests::cacheJournalReplay()
+{
+   const QString journalPath("cache_journal_test.bin");
+   const std::string sharedDirId(Common::Hash::HASH_SIZE, 'x');
+
+   QList<Protos::FileCache::JournalRecord> records;
+   for (int i = 1; i <= 5; i++)
+   {
+      records << Protos::FileCache::JournalRecord();
+      records.last().set_sequence(i);
+      records.last().mutable_shared_dir_id()->set_hash(sharedDirId);
+   }
+   records[0].set_removed_entry("b.txt"); // Already included in the cache.
+   records[1].add_dir("dir1");
+   records[1].mutable_file()->set_filename("c.txt");
+   records[1].mutable_file()->set_size(42);
+   records[2].set_removed_entry("a.txt");
+   records[3].add_dir("dir2");
+   records[3].mutable_file()->set_filename("d.txt");
+   records[4].set_removed_entry("dir2");
+
+   std::string buffer;
+   {
+      google::protobuf::io::StringOutputStream stringStream(&buffer);
+      google::protobuf::io::CodedOutputStream codedStream(&stringStream);
+      for (QListIterator<Protos::FileCache::JournalRecord> i(records); i.hasNext();)
+      {
+         const Protos::FileCache::JournalRecord& record = i.next();
+         codedStream.WriteVarint32(record.ByteSizeLong());
+         record.SerializeWithCachedSizes(&codedStream);
+      }
+   }
+   const qint64 journalSize = buffer.size();
+   buffer.append("\x10\x01", 2); // A truncated record.
+
+   QFile file(journalPath);
+   QVERIFY(file.open(QIODevice::WriteOnly));
+   file.write(buffer.data(), buffer.size());
+   file.close();
+
+   CacheJournal journal;
+   journal.setFilepath(journalPath);
+   QCOMPARE(journal.load(1, 0), 4ull);
+
+   // The directories of the cache.
+   Protos::FileCache::DirRecord root;
+   root.add_file()->set_filename("a.txt");
+   journal.apply(sharedDirId, root);
+   QCOMPARE(root.file_size(), 0);
+
+   Protos::FileCache::DirRecord subDir; // Its parent has been removed.
+   subDir.add_dir("dir2");
+   subDir.add_dir("sub");
+   subDir.add_file()->set_filename("e.txt");
+   journal.apply(sharedDirId, subDir);
+   QCOMPARE(subDir.file_size(), 0);
+
+   // 'dir2' has been created and then removed.
+   const QList<Protos::FileCache::DirRecord> remainingDirs = journal.takeRemainingDirs(sharedDirId);
+   QCOMPARE(remainingDirs.size(), 1);
+   QCOMPARE(Common::ProtoHelper::getRepeatedStr(remainingDirs.first(), &Protos::FileCache::DirRecord::dir, 0), QString("dir1"));
+   QCOMPARE(quint64(remainingDirs.first().file(0).size()), 42ull);
+   journal.endReplay();
+
+   // The truncated record has been removed.
+   QCOMPARE(journal.getSize(), journalSize);
+   QCOMPARE(QFile(journalPath).size(), journalSize);
+
+   journal.clear();
+   QVERIFY(!QFile::exists(journalPath));
+}
+
+#include <priv/Cache/FileCacheWriter.h>
+#include <priv/Cache/FileCacheReader.h>
+
+void Tests::fileCacheReadWrite()
+{
+   const QString cachePath("files_cache_test.bin");
+   const Common::Hash sharedDirId1(std::string(Common::Hash::HASH_SIZE, 'x'));
+   const Common::Hash sharedDirId2(std::string(Common::Hash::HASH_SIZE, 'y'));
+
+   // A cache of the previous format.
+   Protos::FileCache::Hashes hashes;
+   hashes.set_journal_sequence(3);
+   Protos::FileCache::Hashes::SharedDir* sharedDir = hashes.add_shareddir();
+   sharedDir->mutable_id()->set_hash(sharedDirId1.getData(), Common::Hash::HASH_SIZE);
+   sharedDir->set_path("/share1/");
+   sharedDir->mutable_root()->add_file()->set_filename("a.txt");
+   Protos::FileCache::Hashes::Dir* dir1 = sharedDir->mutable_root()->add_dir();
+   dir1->set_name("dir1");
+   dir1->add_file()->set_filename("b.txt");
+   dir1->add_file()->set_filename("c.txt");
+   dir1->add_dir()->set_name("dir2");
+   sharedDir = hashes.add_shareddir();
+   sharedDir->mutable_id()->set_hash(sharedDirId2.getData(), Common::Hash::HASH_SIZE);
+   sharedDir->set_path("/share2/");
+
+   QVERIFY(FileCacheWriter::convert(hashes, cachePath));
+   QVERIFY(!QFile::exists(cachePath + ".temp"));
+
+   FileCacheReader reader(cachePath);
+   QVERIFY(reader.open());
+   QCOMPARE(int(reader.getHeader().version()), FILE_CACHE_VERSION);
+   QCOMPARE(quint64(reader.getHeader().journal_sequence()), 3ull);
+   QCOMPARE(quint64(reader.getHeader().nb_files()), 3ull);
+   QCOMPARE(reader.getHeader().shareddir_size(), 2);
+   QCOMPARE(Common::ProtoHelper::getStr(reader.getHeader().shareddir(1), &Protos::FileCache::Hashes::SharedDir::path), QString("/share2/"));
+
+   // A directory comes before its sub directories.
+   QStringList dirs;
+   QList<int> nbFiles;
+   QVERIFY(reader.restore(sharedDirId1, [&](Protos::FileCache::DirRecord& record) {
+      QStringList path;
+      for (int i = 0; i < record.dir_size(); i++)
+         path << Common::ProtoHelper::getRepeatedStr(record, &Protos::FileCache::DirRecord::dir, i);
+      dirs << path.join('/');
+      nbFiles << record.file_size();
+   }));
+   QCOMPARE(dirs, QStringList() << "" << "dir1" << "dir1/dir2");
+   QCOMPARE(nbFiles, QList<int>() << 1 << 2 << 0);
+
+   // The root of an empty shared directory has a record too.
+   int nbRecords = 0;
+   QVERIFY(reader.restore(sharedDirId2, [&](Protos::FileCache::DirRecord&) { nbRecords++; }));
+   QCOMPARE(nbRecords, 1);
+
+   QVERIFY(QFile::remove(cachePath));
+   QVERIFY(!FileCacheReader(cachePath).open());
+}
+
+#include <priv/Cache/HashStore.h>
+
+void Tests::hashStoreRecords()
+{
+   HashStore& hashStore = HashStore::getInstance();
+   hashStore.endLoading(); // Already done by the file manager.
+
+   const Common::Hash hash(std::string(Common::Hash::HASH_SIZE, 'h'));
+   const quint32 fileId = hashStore.newFileId();
+   QVERIFY(fileId != 0);
+   QVERIFY(hashStore.newFileId() != fileId);
+
+   const quint32 record0 = hashStore.allocate(fileId, 0, 42, hash);
+   const quint32 record1 = hashStore.allocate(fileId, 1, 0);
+   QCOMPARE(hashStore.isPersistent(record1), hashStore.isPersistent()); // The file can be extended.
+   QVERIFY(!hashStore.isPersistent(std::numeric_limits<quint32>::max()));
+   QVERIFY(hashStore.getHash(record0) == hash);
+   QCOMPARE(hashStore.getKnownBytes(record0), 42u);
+   QVERIFY(!hashStore.hasHash(record1));
+   hashStore.setHash(record1, hash);
+   QVERIFY(hashStore.hasHash(record1));
+
+   // The records can only be adopted by their file and in the order of their chunks.
+   QVERIFY(hashStore.adopt(QVector<quint32>() << record0 << record1, fileId));
+   QVERIFY(!hashStore.adopt(QVector<quint32>() << record1 << record0, fileId));
+   QVERIFY(!hashStore.adopt(QVector<quint32>() << record0 << record1, fileId + 1));
+   QVERIFY(!hashStore.adopt(QVector<quint32>() << hashStore.getNbRecords(), fileId));
+
+   // Each record has now two references.
+   hashStore.release(record0);
+   hashStore.release(record1);
+   hashStore.release(record1);
+
+   // A free record can't be adopted once the loading is finished and is reused by the next allocation.
+   QVERIFY(!hashStore.adopt(QVector<quint32>() << record0 << record1, fileId));
+   const int nbFreeRecords = hashStore.getNbFreeRecords();
+   QCOMPARE(hashStore.allocate(fileId, 1, 0), record1);
+   QCOMPARE(hashStore.getNbFreeRecords(), nbFreeRecords - 1);
+   QVERIFY(!hashStore.hasHash(record1));
+
+   hashStore.release(record0);
+   hashStore.release(record1);
+   QCOMPARE(hashStore.getNbFreeRecords(), nbFreeRecords + 1);
+
+   // The records released by a file manager can be adopted by the next one while it loads its file cache.
+   hashStore.beginLoading();
+   QCOMPARE(hashStore.getNbFreeRecords(), 0);
+   QVERIFY(hashStore.adopt(QVector<quint32>() << record0 << record1, fileId));
+   hashStore.endLoading();
+   QCOMPARE(hashStore.getNbFreeRecords(), nbFreeRecords - 1);
+   QVERIFY(!hashStore.adopt(QVector<quint32>() << record0 << record1, fileId + 1));
+
+   hashStore.release(record0);
+   hashStore.release(record1);
+   QCOMPARE(hashStore.getNbFreeRecords(), nbFreeRecords + 1);
+}
+
+#include <priv/Cache/HashingThrottle.h>
+
+/**
+  * The hashing time is counted from the creation of the throttle and the unused time is accumulated up to 'HashingThrottle::MAX_BURST' (1 s).
+  */
+void Tests::hashingThrottleRate()
+{
+   SETTINGS.set("hashing_max_rate", 0u);
+   SETTINGS.set("hashing_max_rate_when_uploading", 0u);
+   {
+      HashingThrottle throttle;
+      throttle.dataHashed(100000000);
+      QCOMPARE(throttle.getDelay(), 0);
+   }
+
+   SETTINGS.set("hashing_max_rate", 1000000u); // 1 MB/s.
+   HashingThrottle throttle;
+
+   // Nothing is accumulated at the beginning.
+   throttle.dataHashed(500000);
+   int delay = throttle.getDelay();
+   QVERIFY2(delay > 400 && delay <= 500, qPrintable(QString::number(delay)));
+   QTest::qSleep(delay + 10);
+   QCOMPARE(throttle.getDelay(), 0);
+
+   // Two idle seconds but only one is accumulated.
+   QTest::qSleep(2000);
+   throttle.dataHashed(1500000);
+   delay = throttle.getDelay();
+   QVERIFY2(delay > 400 && delay <= 500, qPrintable(QString::number(delay)));
+   QTest::qSleep(delay + 10);
+
+   throttle.dataHashed(250000);
+   delay = throttle.getDelay();
+   QVERIFY2(delay > 150 && delay <= 250, qPrintable(QString::number(delay)));
+
+   SETTINGS.set("hashing_max_rate", 0u);
+}
+
+/**
+  * The rate 'hashing_max_rate_when_uploading' is used as long as the upload rate measured by 'TransferRateCalculator' isn't null:
+  * from the end of its current slot (100 ms) to the end of its period (3 s).
+  */
+void Tests::hashingThrottleWhenUploading()
+{
+   SETTINGS.set("hashing_max_rate", 4000000u); // 4 MB/s.
+   SETTINGS.set("hashing_max_rate_when_uploading", 1000000u); // 1 MB/s.
+   HashingThrottle throttle;
+
+   throttle.dataHashed(2000000);
+   int delay = throttle.getDelay();
+   QVERIFY2(delay > 400 && delay <= 500, qPrintable(QString::number(delay)));
+   QTest::qSleep(delay + 10);
+
+   throttle.dataRead(1000000);
+   QTest::qSleep(200);
+   throttle.dataHashed(2000000);
+   delay = throttle.getDelay();
+   QVERIFY2(delay > 1500 && delay <= 2000, qPrintable(QString::number(delay)));
+
+   // The upload is finished, 'hashing_max_rate' is used again.
+   QTest::qSleep(3500);
+   throttle.dataHashed(6000000);
+   delay = throttle.getDelay();
+   QVERIFY2(delay > 400 && delay <= 500, qPrintable(QString::number(delay)));
+
+   // Without 'hashing_max_rate' the hashing isn't limited when nothing is uploaded.
+   SETTINGS.set("hashing_max_rate", 0u);
+   HashingThrottle throttleOnlyWhenUploading;
+   throttleOnlyWhenUploading.dataHashed(2000000);
+   QCOMPARE(throttleOnlyWhenUploading.getDelay(), 0);
+
+   throttleOnlyWhenUploading.dataRead(1000000);
+   QTest::qSleep(200);
+   throttleOnlyWhenUploading.dataHashed(2000000);
+   delay = throttleOnlyWhenUploading.getDelay();
+   QVERIFY2(delay > 1500 && delay <= 2000, qPrintable(QString::number(delay)));
+
+   SETTINGS.set("hashing_max_rate_when_uploading", 0u);
+}
+
+#include <priv/Cache/FilePool.h>
+
+/**
+  * The pool is created by the cache with the setting 'file_pool_max_open_files'.
+  */
+void Tests::filePoolLeastRecentlyReleased()
+{
+   QStringList paths;
+   for (char c = 'a'; c <= 'g'; c++)
+   {
+      const QString path = QString("filePool/%1.txt").arg(c);
+      QVERIFY(Common::Global::createFile(path));
+      paths << QDir::currentPath() + '/' + path;
+   }
+
+   SETTINGS.set("file_pool_max_open_files", 3u);
+   {
+      Cache cache;
+      FilePool& pool = cache.getFilePool();
+      auto open = [&](int i) { return pool.open(paths[i], QIODevice::ReadOnly); };
+
+      QFile* a = open(0);
+      QFile* b = open(1);
+      QFile* c = open(2);
+      QVERIFY(a && b && c);
+      pool.release(a);
+      pool.release(b);
+      pool.release(c);
+
+      // The least recently released file is closed first.
+      QFile* d = open(3);
+      QVERIFY(!pool.isOpen(paths[0]));
+      QVERIFY(pool.isOpen(paths[1]) && pool.isOpen(paths[2]) && pool.isOpen(paths[3]));
+
+      // A reused file becomes the most recently released when released again.
+      QCOMPARE(open(1), b);
+      pool.release(b);
+      QFile* e = open(4);
+      QVERIFY(!pool.isOpen(paths[2]));
+      QVERIFY(pool.isOpen(paths[1]));
+
+      // The files in use are never closed, the limit can be exceeded.
+      QFile* f = open(5);
+      QVERIFY(!pool.isOpen(paths[1]));
+      QFile* g = open(6);
+      QVERIFY(pool.isOpen(paths[3]) && pool.isOpen(paths[4]) && pool.isOpen(paths[5]) && pool.isOpen(paths[6]));
+
+      // Released above the limit, a file is closed immediately.
+      pool.release(d);
+      QVERIFY(!pool.isOpen(paths[3]));
+
+      // Releasing a file twice doesn't change its place in the order.
+      pool.release(e);
+      pool.release(f);
+      pool.release(e);
+      a = open(0);
+      QVERIFY(!pool.isOpen(paths[4]));
+      QVERIFY(pool.isOpen(paths[5]));
+      b = open(1);
+      QVERIFY(!pool.isOpen(paths[5]));
+      c = open(2);
+      QVERIFY(pool.isOpen(paths[0]) && pool.isOpen(paths[1]) && pool.isOpen(paths[2]) && pool.isOpen(paths[6]));
+
+      pool.release(a);
+      pool.release(b);
+      pool.release(c);
+      pool.release(g);
+   }
+   SETTINGS.set("file_pool_max_open_files", 0u);
+
+   Common::Global::recursiveDeleteDirectory("filePool");
+}
+
+/**
+  * See 'File::prefetchChunksAfter(..)'.
+  */
+void Tests::prefetchRange()
+{
+   typedef QPair<qint64, qint64> Range;
+   const qint64 C = Chunk::CHUNK_SIZE;
+   const qint64 fileSize = 3 * C + C / 2; // Four chunks, the last one isn't full.
+
+   QCOMPARE(File::getPrefetchRange(0, 1, 4, fileSize), Range(C, C));
+   QCOMPARE(File::getPrefetchRange(0, 2, 4, fileSize), Range(C, 2 * C));
+   QCOMPARE(File::getPrefetchRange(1, 2, 4, fileSize), Range(2 * C, C + C / 2));
+   QCOMPARE(File::getPrefetchRange(1, 16, 4, fileSize), Range(2 * C, C + C / 2));
+
+   // Nothing after the last chunk or when the prefetching is disabled.
+   QCOMPARE(File::getPrefetchRange(3, 1, 4, fileSize).second, qint64(0));
+   QCOMPARE(File::getPrefetchRange(0, 0, 4, fileSize).second, qint64(0));
+   QCOMPARE(File::getPrefetchRange(0, 1, 1, C / 2).second, qint64(0));
+}
+
+#include <priv/FileUpdater/DirScanner.h>
+#if defined(Q_OS_LINUX)
+   #include <sys/stat.h>
+#endif
+
+void Tests::dirScannerList()
+{
+   QVERIFY(Common::Global::createFile("scanner/a.txt"));
+   QVERIFY(Common::Global::createFile("scanner/.hidden"));
+   QVERIFY(Common::Global::createFile("scanner/dir1/b.txt"));
+   QVERIFY(Common::Global::createFile("scanner/dir1/dir2/"));
+
+   // The sub-directories are added as they are found, like the 'FileUpdater' does.
+   DirScanner scanner(2);
+   scanner.add(QDir::currentPath() + "/scanner/", nullptr);
+
+   QStringList files;
+   QStringList dirs;
+   DirScanner::Listing listing;
+   while (scanner.next(listing))
+      for (QListIterator<DirScanner::Entry> i(listing.entries); i.hasNext();)
+      {
+         const DirScanner::Entry& entry = i.next();
+         if (entry.isDir)
+         {
+            dirs << entry.name;
+            scanner.add(listing.path + entry.name + '/', nullptr);
+         }
+         else
+         {
+            files << entry.name;
+            QCOMPARE(entry.size, QFileInfo(listing.path + entry.name).size());
+            QCOMPARE(entry.dateLastModified, QFileInfo(listing.path + entry.name).lastModified());
+#if defined(Q_OS_LINUX)
+            struct stat info;
+            QCOMPARE(stat(QFile::encodeName(listing.path + entry.name).constData(), &info), 0);
+            QCOMPARE(entry.inode, static_cast<quint64>(info.st_ino));
+            QCOMPARE(entry.device, static_cast<quint64>(info.st_dev));
+            QCOMPARE(entry.nsLastModified, static_cast<quint32>(info.st_mtim.tv_nsec % 1000000));
+#endif
+         }
+      }
+
+   files.sort();
+   dirs.sort();
+   QCOMPARE(files, QStringList() << "a.txt" << "b.txt");
+   QCOMPARE(dirs, QStringList() << "dir1" << "dir2");
+
+   QVERIFY(DirScanner::list(QDir::currentPath() + "/scanner/unknown/").isEmpty());
+
+   Common::Global::recursiveDeleteDirectory("scanner");
+}
+
+#include <QScopedPointer>
+
+#include <priv/FileUpdater/DirWatcher.h>
+
+/**
+  * An event is written "<type> <path1> [<path2>]", for example "MOVE /s/a/x.txt /s/b/x.txt".
+  */
+static QList<WatcherEvent> toWatcherEvents(const QStringList& events)
+{
+   QList<WatcherEvent> watcherEvents;
+   for (QStringListIterator i(events); i.hasNext();)
+   {
+      const QStringList& words = i.next().split(' ');
+      const QString& type = words[0];
+      if (type == "MOVE")
+         watcherEvents << WatcherEvent(WatcherEvent::MOVE, words[1], words[2]);
+      else if (type == "NEW")
+         watcherEvents << WatcherEvent(WatcherEvent::NEW, words[1]);
+      else if (type == "DELETED")
+         watcherEvents << WatcherEvent(WatcherEvent::DELETED, words[1]);
+      else if (type == "CONTENT_CHANGED")
+         watcherEvents << WatcherEvent(WatcherEvent::CONTENT_CHANGED, words[1]);
+      else if (type == "RESCAN")
+         watcherEvents << WatcherEvent(WatcherEvent::RESCAN, words[1]);
+   }
+   return watcherEvents;
+}
+
+static QStringList toStrings(const QList<WatcherEvent>& watcherEvents)
+{
+   QStringList events;
+   for (QListIterator<WatcherEvent> i(watcherEvents); i.hasNext();)
+   {
+      WatcherEvent event = i.next();
+      events << event.toStr().remove(':').simplified();
+   }
+   return events;
+}
+
+void Tests::dirWatcherCoalesce_data()
+{
+   QTest::addColumn<QStringList>("events");
+   QTest::addColumn<QStringList>("expected");
+
+   QTest::newRow("one event")
+      << (QStringList() << "NEW /s/a/x.txt")
+      << (QStringList() << "NEW /s/a/x.txt");
+
+   QTest::newRow("two events in the same directory")
+      << (QStringList() << "NEW /s/a/x.txt" << "CONTENT_CHANGED /s/a/y.txt")
+      << (QStringList() << "RESCAN /s/a");
+
+   QTest::newRow("two events in different directories")
+      << (QStringList() << "NEW /s/a/x.txt" << "NEW /s/b/y.txt")
+      << (QStringList() << "NEW /s/a/x.txt" << "NEW /s/b/y.txt");
+
+   QTest::newRow("NEW then DELETED")
+      << (QStringList() << "NEW /s/a/x.txt" << "DELETED /s/a/x.txt")
+      << (QStringList() << "NEW /s/a/x.txt" << "DELETED /s/a/x.txt");
+
+   QTest::newRow("NEW, DELETED then NEW in the same directory")
+      << (QStringList() << "NEW /s/a/x.txt" << "DELETED /s/a/x.txt" << "NEW /s/a/y.txt")
+      << (QStringList() << "NEW /s/a/x.txt" << "DELETED /s/a/x.txt" << "NEW /s/a/y.txt");
+
+   QTest::newRow("chain of MOVE")
+      << (QStringList() << "MOVE /s/a/x.txt /s/a/y.txt" << "MOVE /s/a/y.txt /s/b/z.txt" << "MOVE /s/b /s/c")
+      << (QStringList() << "MOVE /s/a/x.txt /s/a/y.txt" << "MOVE /s/a/y.txt /s/b/z.txt" << "MOVE /s/b /s/c");
+
+   QTest::newRow("NEW around a MOVE")
+      << (QStringList() << "NEW /s/a/x.txt" << "MOVE /s/a/x.txt /s/b/x.txt" << "NEW /s/a/y.txt")
+      << (QStringList() << "NEW /s/a/x.txt" << "MOVE /s/a/x.txt /s/b/x.txt" << "NEW /s/a/y.txt");
+
+   QTest::newRow("RESCAN alone")
+      << (QStringList() << "RESCAN /s/a")
+      << (QStringList() << "RESCAN /s/a");
+
+   QTest::newRow("RESCAN twice")
+      << (QStringList() << "RESCAN /s/a" << "RESCAN /s/a")
+      << (QStringList() << "RESCAN /s/a");
+
+   QTest::newRow("RESCAN absorbing its children")
+      << (QStringList() << "NEW /s/a/b/x.txt" << "RESCAN /s/a" << "CONTENT_CHANGED /s/a/b/c/y.txt" << "NEW /s/a/z.txt" << "NEW /s/d/w.txt")
+      << (QStringList() << "RESCAN /s/a" << "NEW /s/d/w.txt");
+
+   QTest::newRow("RESCAN not absorbing a directory with the same prefix")
+      << (QStringList() << "RESCAN /s/a" << "NEW /s/ab/x.txt")
+      << (QStringList() << "RESCAN /s/a" << "NEW /s/ab/x.txt");
+
+   QTest::newRow("two unfinished files in the same directory")
+      << (QStringList() << "NEW /s/a/x.txt.unfinished" << "CONTENT_CHANGED /s/a/y.txt.unfinished" << "CONTENT_CHANGED /s/a/x.txt.unfinished")
+      << QStringList();
+
+   QTest::newRow("unfinished files around a finished one")
+      << (QStringList() << "CONTENT_CHANGED /s/a/x.txt.unfinished" << "NEW /s/a/y.txt" << "CONTENT_CHANGED /s/a/x.txt.unfinished")
+      << (QStringList() << "NEW /s/a/y.txt");
+
+   QTest::newRow("RESCAN not absorbing across a DELETED")
+      << (QStringList() << "RESCAN /s/a" << "DELETED /s/a/x.txt" << "NEW /s/a/y.txt")
+      << (QStringList() << "RESCAN /s/a" << "DELETED /s/a/x.txt" << "NEW /s/a/y.txt");
+}
+
+void Tests::dirWatcherCoalesce()
+{
+   QFETCH(QStringList, events);
+   QFETCH(QStringList, expected);
+
+   QCOMPARE(toStrings(DirWatcher::coalesce(toWatcherEvents(events))), expected);
+}
+
+/**
+  * The kernel queue of inotify overflows while nobody reads it, the modification made after the overflow is lost
+  * and must be found back by comparing the modification times: only the modified directories are rescanned.
+  */
+void Tests::dirWatcherOverflowRecovery()
+{
+#if defined(Q_OS_LINUX)
+   QVERIFY(Common::Global::createFile("watcher/a/"));
+   QVERIFY(Common::Global::createFile("watcher/b/c/"));
+   QVERIFY(Common::Global::createFile("watcher/d/"));
+   const QString root = QDir::cleanPath(QDir::currentPath() + "/watcher");
+
+   QScopedPointer<DirWatcher> watcher(DirWatcher::getNewWatcher());
+   QVERIFY(watcher->addDir(root));
+
+   int maxQueuedEvents = 16384;
+   QFile maxQueuedEventsFile("/proc/sys/fs/inotify/max_queued_events");
+   if (maxQueuedEventsFile.open(QIODevice::ReadOnly))
+      maxQueuedEvents = maxQueuedEventsFile.readAll().trimmed().toInt();
+
+   // Three events by iteration: 'IN_CREATE', 'IN_CLOSE_WRITE' and 'IN_DELETE'.
+   for (int i = 0; i < maxQueuedEvents / 2; i++)
+   {
+      QVERIFY(Common::Global::createFile("watcher/a/x.txt"));
+      QVERIFY(QFile::remove("watcher/a/x.txt"));
+   }
+   QVERIFY(Common::Global::createFile("watcher/b/c/y.txt"));
+
+   const QStringList& events = toStrings(watcher->waitEvent(1000));
+
+   QVERIFY(events.contains("RESCAN " + root + "/a"));
+   QVERIFY(events.contains("RESCAN " + root + "/b/c"));
+   QVERIFY(!events.contains("RESCAN " + root));
+   QVERIFY(!events.contains("RESCAN " + root + "/b"));
+   for (QStringListIterator i(events); i.hasNext();)
+   {
+      const QString& event = i.next();
+      QVERIFY2(!event.contains(root + "/d"), qPrintable(event));
+      QVERIFY2(!event.contains("y.txt"), qPrintable(event)); // Lost with the overflow.
+   }
+
+   watcher.reset();
+   Common::Global::recursiveDeleteDirectory("watcher");
+#else
+   QSKIP("The recovery of an overflow is only implemented for Linux");
+#endif
+}
+
 void Tests::cleanupTestCase()
 {
    qDebug() << "===== cleanupTestCase() =====";
@@ -40,6 +40,8 @@ private slots:
    void initTestCase();
 
    void testWordIndex();
+   void testWordIndexWithErrors();
+   void testTrigramIndex();
 
    void createFileManager();
 
@@ -72,6 +74,7 @@ private slots:
    /***** Ask for chunks by hash *****/
    void getAnExistingChunk();
    void getAnUnexistingChunk();
+   void readAChunkUpToItsEnd();
 
    /***** Get Hashes from a FileEntry which the hash is already computed *****/
    void getHashesFromAFileEntry1();
@@ -93,10 +96,17 @@ private slots:
    void findFilesByExtensions();
    void findFilesByExtensionsAndSizeRange();
    void findFilesBySizeRange();
+   void findFilesWithSubstrings();
+   void findFilesWithATypingError();
+   void findFilesFromTheIndexSnapshot();
+   void loadACorruptedIndexSnapshot();
 
    /***** Ask if the given hashes are known *****/
    void haveChunks();
 
+   /***** A file moved while the file manager isn't running *****/
+   void restoreAMovedFile();
+
    /***** Ask for the amount of shared byte *****/
    void printAmount();
 
@@ -105,7 +115,8 @@ private slots:
 
    /********** Unit tests of internals classes **********/
 
-   /***** Speed test of the class 'Chunks' *****/
+   /***** The class 'Chunks' *****/
+   void chunksContains();
    void chunksPerformance();
 
    /***** The exenstion index class *****/
@@ -115,6 +126,38 @@ private slots:
    void extensionIndexSearchWithOneExtension();
    void extensionIndexSearchWithSomeExtensions();
 
+   /***** The filter index class *****/
+   void filterIndexSizeBuckets();
+   void filterIndexFilter();
+
+   /***** The search result cache class *****/
+   void findResultCache();
+
+   /***** The file cache journal class *****/
+   void cacheJournalReplay();
+   void fileCacheReadWrite();
+
+   /***** The hash store class *****/
+   void hashStoreRecords();
+
+   /***** The hashing throttle *****/
+   void hashingThrottleRate();
+   void hashingThrottleWhenUploading();
+
+   /***** The file pool *****/
+   void filePoolLeastRecentlyReleased();
+
+   /***** The prefetching of the uploaded chunks *****/
+   void prefetchRange();
+
+   /***** The directory scanner class *****/
+   void dirScannerList();
+
+   /***** The directory watcher *****/
+   void dirWatcherCoalesce_data();
+   void dirWatcherCoalesce();
+   void dirWatcherOverflowRecovery();
+
    void cleanupTestCase();
 
 private:
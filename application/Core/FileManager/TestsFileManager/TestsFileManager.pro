@@ -30,10 +30,12 @@ SOURCES += main.cpp \
     HashesReceiver.cpp \
     StressTest.cpp \
     ../../../Protos/core_settings.pb.cc \
-    StressTests.cpp
+    StressTests.cpp \
+    BenchmarkTests.cpp
 HEADERS += Tests.h \
     ../../../Protos/common.pb.h \
     HashesReceiver.h \
     StressTest.h \
     ../../../Protos/core_settings.pb.h \
-    StressTests.h
+    StressTests.h \
+    BenchmarkTests.h
@@ -21,6 +21,7 @@
 
 #include <Tests.h>
 #include <StressTests.h>
+#include <BenchmarkTests.h>
 
 int main(int argc, char *argv[])
 {
@@ -31,6 +32,11 @@ int main(int argc, char *argv[])
       StressTests tests;
       return QTest::qExec(&tests);
    }
+   else if (a.arguments().contains("-benchmark"))
+   {
+      BenchmarkTests tests;
+      return QTest::qExec(&tests);
+   }
    else
    {
       Tests tests;
@@ -33,6 +33,7 @@ using namespace FM;
 #include <priv/Constants.h>
 #include <priv/Cache/SharedDirectory.h>
 #include <priv/Cache/File.h>
+#include <priv/Cache/FileCacheWriter.h>
 
 /**
   * @class FM::Cache
@@ -42,10 +43,13 @@ using namespace FM;
   *  - Browse directories and files.
   *  - Create a new file.
   *  - Add or remove a shared directory (root).
-  *  - Serialize or deserialize the hashes of the files in a 'Protos::FileCache::Hashes' structure (to be saved/loaded in/from a physical file).
+  *  - Serialize the hashes of the files directory by directory with a 'FileCacheWriter' (to be saved in a physical file).
   */
 
 Cache::Cache() :
+   filePool(SETTINGS.get<quint32>("file_pool_max_open_files")),
+   NB_CHUNKS_TO_PREFETCH(SETTINGS.get<quint32>("upload_prefetch_nb_chunks")),
+   DROP_SENT_CHUNKS(SETTINGS.get<bool>("upload_drop_sent_chunks")),
    mutex(QMutex::Recursive)
 {
    qRegisterMetaType<Entry*>("Entry*");
@@ -616,23 +620,17 @@ void Cache::createSharedDirs(const Protos::FileCache::Hashes& hashes)
 }
 
 /**
-  * Populates the given structure to be persisted later.
+  * Write the hashes of all the shared directories, see 'FileManager::persistCacheToFile()'.
   */
-void Cache::populateHashes(Protos::FileCache::Hashes& hashes) const
+void Cache::populateHashes(FileCacheWriter& writer) const
 {
    QMutexLocker locker(&this->mutex);
 
-   hashes.set_version(FILE_CACHE_VERSION);
-   hashes.set_chunksize(Common::Constants::CHUNK_SIZE);
-
    for (QListIterator<SharedDirectory*> i(this->sharedDirs); i.hasNext();)
    {
       SharedDirectory* sharedDir = i.next();
-      Protos::FileCache::Hashes_SharedDir* sharedDirMess = hashes.add_shareddir();
-      sharedDirMess->mutable_id()->set_hash(sharedDir->getId().getData(), Common::Hash::HASH_SIZE);
-      Common::ProtoHelper::setStr(*sharedDirMess, &Protos::FileCache::Hashes_SharedDir::set_path, sharedDir->getFullPath());
-
-      sharedDir->populateHashesDir(*sharedDirMess->mutable_root());
+      writer.beginSharedDir(sharedDir->getId(), sharedDir->getFullPath());
+      sharedDir->populateHashesDir(writer);
    }
 }
 
@@ -661,6 +659,11 @@ void Cache::onEntryRenamed(Entry* entry, const QString& oldName)
    emit entryRenamed(entry, oldName);
 }
 
+void Cache::onEntryMoved(Entry* entry, Directory* oldDirectory)
+{
+   emit entryMoved(entry, oldDirectory);
+}
+
 void Cache::onEntryResizing(Entry* entry)
 {
    emit entryResizing(entry);
@@ -686,8 +689,12 @@ void Cache::onScanned(Directory* dir)
    emit directoryScanned(dir);
 }
 
+/**
+  * The deletion waits for the ones holding the mutex and still using the entry, see 'FileManager::persistIndexSnapshot()'.
+  */
 void Cache::deleteEntry(Entry* entry)
 {
+   QMutexLocker locker(&this->mutex);
    delete entry;
 }
 
@@ -35,11 +35,13 @@
 #include <priv/Cache/SharedDirectory.h>
 #include <priv/Cache/Chunk.h>
 #include <priv/Cache/FilePool.h>
+#include <priv/Cache/HashingThrottle.h>
 
 namespace FM
 {
    class Entry;
    class FileUpdater;
+   class FileCacheWriter;
 
    class Cache : public QObject, Common::Uncopyable
    {
@@ -72,15 +74,20 @@ namespace FM
       Directory* getFittestDirectory(const QString& path) const;
 
       void createSharedDirs(const Protos::FileCache::Hashes& hashes);
-      void populateHashes(Protos::FileCache::Hashes& hashes) const;
+      void populateHashes(FileCacheWriter& writer) const;
 
       quint64 getAmount() const;
 
       FilePool& getFilePool() { return this->filePool; }
+      QMutex& getMutex() const { return this->mutex; } ///< While it's locked no entry can be deleted, see 'deleteEntry(..)'.
+      HashingThrottle& getHashingThrottle() { return this->hashingThrottle; }
+      int getNbChunksToPrefetch() const { return this->NB_CHUNKS_TO_PREFETCH; }
+      bool dropSentChunks() const { return this->DROP_SENT_CHUNKS; }
 
       void onEntryAdded(Entry* entry);
       void onEntryRemoved(Entry* entry);
       void onEntryRenamed(Entry* entry, const QString& oldName);
+      void onEntryMoved(Entry* entry, Directory* oldDirectory);
       void onEntryResizing(Entry* entry);
       void onEntryResized(Entry* entry, qint64 oldSize);
 
@@ -96,6 +103,7 @@ namespace FM
       void entryAdded(Entry* entry);
       void entryRemoved(Entry* entry);
       void entryRenamed(Entry* entry, const QString& oldName);
+      void entryMoved(Entry* entry, Directory* oldDirectory); ///< 'oldDirectory' is null when a shared directory is moved.
       void entryResizing(Entry* entry);
       void entryResized(Entry* entry, qint64 oldSize);
 
@@ -119,6 +127,10 @@ namespace FM
       QList<SharedDirectory*> sharedDirs;
 
       FilePool filePool;
+      HashingThrottle hashingThrottle;
+
+      const int NB_CHUNKS_TO_PREFETCH; ///< See 'File::prefetchChunksAfter(..)'.
+      const bool DROP_SENT_CHUNKS; ///< See 'File::chunkEntirelyRead(..)'.
 
       mutable QMutex mutex; ///< To protect all the data into the cache, files and directories.
    };
@@ -0,0 +1,502 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/CacheJournal.h>
+using namespace FM;
+
+#include <string>
+#include <algorithm>
+
+#include <QFile>
+#include <QPair>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include <Common/ProtoHelper.h>
+
+#include <priv/Log.h>
+#include <priv/Constants.h>
+#include <priv/Cache/Entry.h>
+#include <priv/Cache/File.h>
+#include <priv/Cache/Directory.h>
+#include <priv/Cache/SharedDirectory.h>
+
+/**
+  * @class FM::CacheJournal
+  *
+  * Records the changes of the hashes since the last complete persisted cache (see 'Cache::populateHashes(..)')
+  * in an append-only file. Thus the cost of persisting depends on the number of changes and not on the size of the shares.
+  *
+  * The changes are gathered in memory and appended periodically with 'flush()'. A record contains the new state of a file or the
+  * name of a removed entry. The changes which can't be described by a record, like moving a directory, ask for a compaction:
+  * the owner must then persist the complete cache between 'beginCompaction()' and 'endCompaction(..)'. A compaction is also
+  * asked when the journal becomes larger than the cache.
+  *
+  * At start the records are loaded with 'load(..)' and applied to each directory of the persisted cache while it's restored,
+  * see 'apply(..)' and 'takeRemainingDirs(..)'. Thus the persisted cache never has to be entirely in memory.
+  * 'load(..)', 'flush()', 'beginCompaction()' and 'endCompaction(..)' must not be called concurrently.
+  */
+
+CacheJournal::CacheJournal() :
+   sequence(0), size(0), cacheSize(0), compactionNeeded(false)
+{
+}
+
+/**
+  * Must be called before the other methods. Without file path all the changes ask for a compaction.
+  */
+void CacheJournal::setFilepath(const QString& filepath)
+{
+   QMutexLocker locker(&this->mutex);
+   this->filepath = filepath;
+   this->size = QFile(filepath).size();
+}
+
+/**
+  * Load the records which aren't already included in the persisted cache, they are then applied directory by directory with 'apply(..)'.
+  * A truncated last record (crash during a 'flush()') is removed from the journal.
+  * @param cacheSequence The sequence number of the last record included in the persisted cache.
+  * @param cacheSize The size of the persisted cache [B].
+  * @return The number of loaded records.
+  */
+quint64 CacheJournal::load(quint64 cacheSequence, qint64 cacheSize)
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->cacheSize = cacheSize;
+   this->sequence = cacheSequence;
+
+   if (this->filepath.isEmpty())
+      return 0;
+
+   QFile file(this->filepath);
+   if (!file.exists())
+      return 0;
+
+   if (!file.open(QIODevice::ReadWrite))
+   {
+      L_ERRO(QString("Unable to open the file cache journal %1 : %2").arg(this->filepath).arg(file.errorString()));
+      return 0;
+   }
+
+   const QByteArray data = file.readAll();
+
+   int position = 0;
+   Protos::FileCache::JournalRecord record;
+   while (position < data.size())
+   {
+      google::protobuf::io::CodedInputStream stream(reinterpret_cast<const quint8*>(data.constData() + position), data.size() - position);
+      quint32 recordSize;
+      if (!stream.ReadVarint32(&recordSize))
+         break;
+
+      const int headerSize = stream.CurrentPosition();
+      if (recordSize > quint32(data.size() - position - headerSize) || !record.ParseFromArray(data.constData() + position + headerSize, recordSize))
+         break;
+
+      position += headerSize + recordSize;
+
+      if (record.sequence() <= cacheSequence)
+         continue;
+
+      const Common::Hash sharedDirId(record.shared_dir_id().hash());
+      QStringList dirs;
+      for (int i = 0; i < record.dir_size(); i++)
+         dirs << Common::ProtoHelper::getRepeatedStr(record, &Protos::FileCache::JournalRecord::dir, i);
+      const QString path = dirs.join('/');
+
+      this->replayedDirs[sharedDirId][path].records << this->replayedRecords.size();
+      if (!record.has_file())
+      {
+         const QString& name = Common::ProtoHelper::getStr(record, &Protos::FileCache::JournalRecord::removed_entry);
+         this->removedDirs[sharedDirId][path.isEmpty() ? name : path + '/' + name] << this->replayedRecords.size();
+      }
+
+      this->replayedRecords << record;
+      this->sequence = record.sequence();
+   }
+
+   if (position < data.size())
+   {
+      L_WARN(QString("The file cache journal %1 is truncated, %2 bytes ignored").arg(this->filepath).arg(data.size() - position));
+      file.resize(position);
+   }
+
+   this->size = position;
+   return this->replayedRecords.size();
+}
+
+/**
+  * Apply the loaded records to a directory of the persisted cache.
+  */
+void CacheJournal::apply(const Common::Hash& sharedDirId, Protos::FileCache::DirRecord& record)
+{
+   QMutexLocker locker(&this->mutex);
+   this->applyAll(sharedDirId, record);
+}
+
+/**
+  * Return the directories which aren't in the persisted cache but have some files in the loaded records.
+  * Must be called once all the directories of the given shared directory have been given to 'apply(..)'.
+  */
+QList<Protos::FileCache::DirRecord> CacheJournal::takeRemainingDirs(const Common::Hash& sharedDirId)
+{
+   QMutexLocker locker(&this->mutex);
+
+   QList<Protos::FileCache::DirRecord> result;
+
+   auto dirs = this->replayedDirs.find(sharedDirId);
+   if (dirs == this->replayedDirs.end())
+      return result;
+
+   for (auto i = dirs->begin(); i != dirs->end(); ++i)
+   {
+      if (i->applied)
+         continue;
+
+      Protos::FileCache::DirRecord record;
+      for (QStringListIterator j(i.key().split('/', QString::SkipEmptyParts)); j.hasNext();)
+         Common::ProtoHelper::addRepeatedStr(record, &Protos::FileCache::DirRecord::add_dir, j.next());
+
+      this->applyAll(sharedDirId, record);
+      if (record.file_size() > 0)
+         result << record;
+   }
+
+   this->replayedDirs.erase(dirs);
+   return result;
+}
+
+/**
+  * Release the loaded records.
+  */
+void CacheJournal::endReplay()
+{
+   QMutexLocker locker(&this->mutex);
+   this->replayedRecords.clear();
+   this->replayedDirs.clear();
+   this->removedDirs.clear();
+}
+
+/**
+  * The state of the file will be written by the next 'flush()'.
+  */
+void CacheJournal::fileChanged(File* file)
+{
+   QMutexLocker locker(&this->mutex);
+   this->changedFiles.insert(file);
+}
+
+/**
+  * Must be called before the entry is deleted.
+  */
+void CacheJournal::entryRemoved(Entry* entry)
+{
+   if (entry->getRoot() == entry)
+   {
+      this->setCompactionNeeded();
+      return;
+   }
+
+   const Protos::FileCache::JournalRecord& record = CacheJournal::removedEntryRecord(entry, CacheJournal::getDirs(entry), entry->getName());
+
+   // Both at once, a 'flush()' mustn't write the removal and then the state of the file.
+   QMutexLocker locker(&this->mutex);
+   if (File* file = dynamic_cast<File*>(entry))
+      this->changedFiles.remove(file);
+   this->removedEntries << record;
+}
+
+/**
+  * A renamed file is removed under its old name and written again.
+  * The content of a renamed directory can't be described by a record.
+  */
+void CacheJournal::entryRenamed(Entry* entry, const QString& oldName)
+{
+   File* file = dynamic_cast<File*>(entry);
+   if (!file)
+   {
+      this->setCompactionNeeded();
+      return;
+   }
+
+   const Protos::FileCache::JournalRecord& record = CacheJournal::removedEntryRecord(entry, CacheJournal::getDirs(entry), oldName);
+
+   QMutexLocker locker(&this->mutex);
+   this->removedEntries << record;
+   this->changedFiles.insert(file);
+}
+
+/**
+  * Same as 'entryRenamed(..)'.
+  */
+void CacheJournal::entryMoved(Entry* entry, Directory* oldDirectory)
+{
+   File* file = dynamic_cast<File*>(entry);
+   if (!file || !oldDirectory)
+   {
+      this->setCompactionNeeded();
+      return;
+   }
+
+   const Protos::FileCache::JournalRecord& record = CacheJournal::removedEntryRecord(entry, CacheJournal::getDirsOfDirectory(oldDirectory), entry->getName());
+
+   QMutexLocker locker(&this->mutex);
+   this->removedEntries << record;
+   this->changedFiles.insert(file);
+}
+
+/**
+  * The next persist must write the complete cache.
+  */
+void CacheJournal::setCompactionNeeded()
+{
+   QMutexLocker locker(&this->mutex);
+   this->compactionNeeded = true;
+}
+
+bool CacheJournal::isCompactionNeeded() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->compactionNeeded || this->filepath.isEmpty() || this->size > qMax(MIN_CACHE_JOURNAL_SIZE_TO_COMPACT, this->cacheSize);
+}
+
+/**
+  * Append the pending changes to the journal.
+  * @return 'false' if the journal can't be written, in this case a compaction is needed.
+  */
+bool CacheJournal::flush()
+{
+   this->mutex.lock();
+   QList<Protos::FileCache::JournalRecord> records = this->removedEntries;
+   const QSet<File*> files = this->changedFiles;
+   this->removedEntries.clear();
+   this->changedFiles.clear();
+   this->mutex.unlock();
+
+   // The files are read without holding 'mutex' because 'fileChanged(..)' may be called while a file is locked.
+   for (QSetIterator<File*> i(files); i.hasNext();)
+   {
+      File* file = i.next();
+      records << Protos::FileCache::JournalRecord();
+      Protos::FileCache::JournalRecord& record = records.last();
+      record.mutable_shared_dir_id()->set_hash(file->getRoot()->getId().getData(), Common::Hash::HASH_SIZE);
+      for (QStringListIterator j(CacheJournal::getDirs(file)); j.hasNext();)
+         Common::ProtoHelper::addRepeatedStr(record, &Protos::FileCache::JournalRecord::add_dir, j.next());
+
+      // Like 'Directory::populateHashesDir(..)' a file without hash isn't kept.
+      if (file->hasOneOrMoreHashes())
+         file->populateHashesFile(*record.mutable_file());
+      else
+         Common::ProtoHelper::setStr(record, &Protos::FileCache::JournalRecord::set_removed_entry, file->getName());
+   }
+
+   if (records.isEmpty())
+      return true;
+
+   QMutexLocker locker(&this->mutex);
+
+   if (this->filepath.isEmpty())
+   {
+      this->compactionNeeded = true;
+      return false;
+   }
+
+   std::string buffer;
+   {
+      google::protobuf::io::StringOutputStream stringStream(&buffer);
+      google::protobuf::io::CodedOutputStream codedStream(&stringStream);
+      for (QMutableListIterator<Protos::FileCache::JournalRecord> i(records); i.hasNext();)
+      {
+         Protos::FileCache::JournalRecord& record = i.next();
+         record.set_sequence(++this->sequence);
+         codedStream.WriteVarint32(record.ByteSizeLong());
+         record.SerializeWithCachedSizes(&codedStream);
+      }
+   }
+
+   QFile file(this->filepath);
+   if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(buffer.data(), buffer.size()) != qint64(buffer.size()) || !file.flush())
+   {
+      L_ERRO(QString("Unable to append to the file cache journal %1 : %2").arg(this->filepath).arg(file.errorString()));
+      this->compactionNeeded = true;
+      return false;
+   }
+
+   this->size += buffer.size();
+   return true;
+}
+
+/**
+  * Called before reading the complete cache, the pending changes are dropped because they will be included.
+  * The changes made during the compaction will be written by the next 'flush()', a compaction asked meanwhile by
+  * 'setCompactionNeeded()' is kept.
+  * @return The sequence number to store in the complete cache, see 'endCompaction(..)'.
+  */
+quint64 CacheJournal::beginCompaction()
+{
+   QMutexLocker locker(&this->mutex);
+   this->removedEntries.clear();
+   this->changedFiles.clear();
+   this->compactionNeeded = false;
+   return this->sequence;
+}
+
+/**
+  * Called when the complete cache including the records up to 'sequence' has been persisted, the journal is emptied.
+  * If the compaction fails this method mustn't be called, the owner must ask again for a compaction with 'setCompactionNeeded()'.
+  * @param cacheSize The size of the persisted cache [B].
+  */
+void CacheJournal::endCompaction(quint64 sequence, qint64 cacheSize)
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->cacheSize = cacheSize;
+
+   // Some records have been appended since, they aren't included in the complete cache.
+   if (sequence != this->sequence)
+      return;
+
+   QFile file(this->filepath);
+   if (file.exists() && !file.resize(0))
+      L_ERRO(QString("Unable to empty the file cache journal %1 : %2").arg(this->filepath).arg(file.errorString()));
+   else
+      this->size = 0;
+}
+
+/**
+  * Remove all the records, used when the complete cache is lost.
+  */
+void CacheJournal::clear()
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->sequence = 0;
+   this->removedEntries.clear();
+   this->changedFiles.clear();
+   this->compactionNeeded = true;
+
+   if (!this->filepath.isEmpty() && QFile::exists(this->filepath) && !QFile::remove(this->filepath))
+      L_ERRO(QString("Unable to remove the file cache journal %1").arg(this->filepath));
+   else
+      this->size = 0;
+}
+
+qint64 CacheJournal::getSize() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->size;
+}
+
+Protos::FileCache::JournalRecord CacheJournal::removedEntryRecord(const Entry* entry, const QStringList& dirs, const QString& name)
+{
+   Protos::FileCache::JournalRecord record;
+   record.mutable_shared_dir_id()->set_hash(entry->getRoot()->getId().getData(), Common::Hash::HASH_SIZE);
+   for (QStringListIterator i(dirs); i.hasNext();)
+      Common::ProtoHelper::addRepeatedStr(record, &Protos::FileCache::JournalRecord::add_dir, i.next());
+   Common::ProtoHelper::setStr(record, &Protos::FileCache::JournalRecord::set_removed_entry, name);
+   return record;
+}
+
+/**
+  * Return the names of the directories from the root of the shared directory to the given entry.
+  */
+QStringList CacheJournal::getDirs(const Entry* entry)
+{
+   return entry->getPath().split('/', QString::SkipEmptyParts);
+}
+
+/**
+  * Return the names of the directories from the root of the shared directory to the given directory, included.
+  */
+QStringList CacheJournal::getDirsOfDirectory(const Directory* directory)
+{
+   if (dynamic_cast<const SharedDirectory*>(directory))
+      return QStringList();
+   return CacheJournal::getDirs(directory) << directory->getName();
+}
+
+/**
+  * Replace or remove a file of the given directory.
+  */
+void CacheJournal::apply(const Protos::FileCache::JournalRecord& record, Protos::FileCache::DirRecord& dirRecord)
+{
+   const std::string& name = record.has_file() ? record.file().filename() : record.removed_entry();
+
+   for (int i = 0; i < dirRecord.file_size(); i++)
+      if (dirRecord.file(i).filename() == name)
+      {
+         if (record.has_file())
+            dirRecord.mutable_file(i)->CopyFrom(record.file());
+         else
+            dirRecord.mutable_file()->DeleteSubrange(i, 1);
+         return;
+      }
+
+   if (record.has_file())
+      dirRecord.add_file()->CopyFrom(record.file());
+}
+
+/**
+  * Apply in order the records of the directory and the removals of the directory or of one of its parents.
+  * 'mutex' must be locked.
+  */
+void CacheJournal::applyAll(const Common::Hash& sharedDirId, Protos::FileCache::DirRecord& record)
+{
+   QStringList dirs;
+   for (int i = 0; i < record.dir_size(); i++)
+      dirs << Common::ProtoHelper::getRepeatedStr(record, &Protos::FileCache::DirRecord::dir, i);
+
+   QList<QPair<int, bool>> operations; // The position of the record and 'true' if it removes the whole directory.
+
+   auto sharedDirDirs = this->replayedDirs.find(sharedDirId);
+   if (sharedDirDirs != this->replayedDirs.end())
+   {
+      auto dir = sharedDirDirs->find(dirs.join('/'));
+      if (dir != sharedDirDirs->end())
+      {
+         for (QListIterator<int> i(dir->records); i.hasNext();)
+            operations << qMakePair(i.next(), false);
+         dir->applied = true;
+      }
+   }
+
+   auto sharedDirRemovedDirs = this->removedDirs.find(sharedDirId);
+   if (sharedDirRemovedDirs != this->removedDirs.end())
+   {
+      QString path;
+      for (int i = 0; i < dirs.size(); i++)
+      {
+         path = i == 0 ? dirs[i] : path + '/' + dirs[i];
+         for (QListIterator<int> j(sharedDirRemovedDirs->value(path)); j.hasNext();)
+            operations << qMakePair(j.next(), true);
+      }
+   }
+
+   std::sort(operations.begin(), operations.end());
+
+   for (QListIterator<QPair<int, bool>> i(operations); i.hasNext();)
+   {
+      const QPair<int, bool>& operation = i.next();
+      if (operation.second)
+         record.clear_file();
+      else
+         CacheJournal::apply(this->replayedRecords[operation.first], record);
+   }
+}
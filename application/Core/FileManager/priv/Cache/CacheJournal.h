@@ -0,0 +1,93 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#pragma once
+
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+
+#include <Protos/files_cache.pb.h>
+
+#include <Common/Hash.h>
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class Entry;
+   class File;
+   class Directory;
+
+   class CacheJournal : Common::Uncopyable
+   {
+   public:
+      CacheJournal();
+
+      void setFilepath(const QString& filepath);
+
+      quint64 load(quint64 cacheSequence, qint64 cacheSize);
+      void apply(const Common::Hash& sharedDirId, Protos::FileCache::DirRecord& record);
+      QList<Protos::FileCache::DirRecord> takeRemainingDirs(const Common::Hash& sharedDirId);
+      void endReplay();
+
+      void fileChanged(File* file);
+      void entryRemoved(Entry* entry);
+      void entryRenamed(Entry* entry, const QString& oldName);
+      void entryMoved(Entry* entry, Directory* oldDirectory);
+      void setCompactionNeeded();
+
+      bool isCompactionNeeded() const;
+      bool flush();
+      quint64 beginCompaction();
+      void endCompaction(quint64 sequence, qint64 cacheSize);
+      void clear();
+
+      qint64 getSize() const;
+
+   private:
+      static Protos::FileCache::JournalRecord removedEntryRecord(const Entry* entry, const QStringList& dirs, const QString& name);
+      static QStringList getDirs(const Entry* entry);
+      static QStringList getDirsOfDirectory(const Directory* directory);
+      static void apply(const Protos::FileCache::JournalRecord& record, Protos::FileCache::DirRecord& dirRecord);
+      void applyAll(const Common::Hash& sharedDirId, Protos::FileCache::DirRecord& record);
+
+      QString filepath; ///< Empty if the journal can't be written.
+
+      quint64 sequence; ///< The sequence number of the last record.
+      qint64 size; ///< The size of the journal file [B].
+      qint64 cacheSize; ///< The size of the last complete cache [B], the journal is compacted when it becomes larger.
+      bool compactionNeeded;
+
+      QSet<File*> changedFiles; ///< Their state is written by 'flush()'.
+      QList<Protos::FileCache::JournalRecord> removedEntries; ///< Written by 'flush()' before the changed files.
+
+      struct ReplayedDir
+      {
+         QList<int> records; ///< Positions in 'replayedRecords'.
+         bool applied = false;
+      };
+      QList<Protos::FileCache::JournalRecord> replayedRecords; ///< The records loaded by 'load(..)' and not yet included in the cache.
+      QHash<Common::Hash, QHash<QString, ReplayedDir>> replayedDirs; ///< The records of each directory by shared directory and path.
+      QHash<Common::Hash, QHash<QString, QList<int>>> removedDirs; ///< The records which may remove a directory by shared directory and path of the directory.
+
+      mutable QMutex mutex;
+   };
+}
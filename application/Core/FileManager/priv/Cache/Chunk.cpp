@@ -32,7 +32,8 @@ using namespace FM;
   * @class FM::Chunk
   *
   * A chunk is a part of a file. It's identified by a hash which can be unknown when a chunk is created and be set later by 'setHash(..)'.
-  * A chunk can be read or write, when a chunk is written the 'knownBytes' member is increased.
+  * A chunk can be read or write, when a chunk is written its known bytes are increased.
+  * The hash and the known bytes are stored in a record of the 'HashStore' owned by the chunk, see 'setRecord(..)'.
   * Each chunk of a file has a unique number which begins at 0 and define the order of data, chunk#1 represents the data right after chunk#0 and so on.
   *
   * Concurrent accesses are protected by the 'QSharedPointer', see the 'File' class.
@@ -41,13 +42,13 @@ using namespace FM;
 int Chunk::CHUNK_SIZE(0);
 
 Chunk::Chunk(File* file, int num, quint32 knownBytes) :
-   file(file), num(num), knownBytes(knownBytes)
+   file(file), num(num), record(HashStore::getInstance().allocate(file ? file->getHashStoreId() : 0, num, knownBytes))
 {
-   L_DEBU(QString("New chunk[%1] : %2. File : %3").arg(num).arg(hash.toStr()).arg(this->file ? this->file->getFullPath() : "<no file defined>"));
+   L_DEBU(QString("New chunk[%1]. File : %2").arg(num).arg(this->file ? this->file->getFullPath() : "<no file defined>"));
 }
 
 Chunk::Chunk(File* file, int num, quint32 knownBytes, const Common::Hash& hash) :
-   file(file), num(num), knownBytes(knownBytes), hash(hash)
+   file(file), num(num), record(HashStore::getInstance().allocate(file ? file->getHashStoreId() : 0, num, knownBytes, hash))
 {
    L_DEBU(QString("New chunk[%1] : %2. File : %3").arg(num).arg(hash.toStr()).arg(this->file ? this->file->getFullPath() : "<no file defined>"));
 }
@@ -55,9 +56,11 @@ Chunk::Chunk(File* file, int num, quint32 knownBytes, const Common::Hash& hash)
 Chunk::~Chunk()
 {
    L_DEBU(QString("Chunk Deleted[%1] : %2. File : %3").arg(num).
-      arg(this->hash.toStr()).
+      arg(this->getHash().toStr()).
       arg(this->file ? this->file->getFullPath() : "<file deleted>")
    );
+
+   HashStore::getInstance().release(this->record);
 }
 
 QString Chunk::toStringLog() const
@@ -67,18 +70,39 @@ QString Chunk::toStringLog() const
 
 Chunk* Chunk::restoreFromFileCache(const Protos::FileCache::Hashes_Chunk& chunk)
 {
-   this->knownBytes = chunk.known_bytes();
+   HashStore& hashStore = HashStore::getInstance();
+
+   hashStore.setKnownBytes(this->record, chunk.known_bytes());
 
    if (chunk.has_hash())
-      this->hash = chunk.hash().hash();
+      hashStore.setHash(this->record, chunk.hash().hash());
    return this;
 }
 
 void Chunk::populateHashesChunk(Protos::FileCache::Hashes_Chunk& chunk) const
 {
-   chunk.set_known_bytes(this->knownBytes);
-   if (!this->hash.isNull())
-      chunk.mutable_hash()->set_hash(this->hash.getData(), Common::Hash::HASH_SIZE);
+   HashStore& hashStore = HashStore::getInstance();
+
+   chunk.set_known_bytes(hashStore.getKnownBytes(this->record));
+   if (hashStore.hasHash(this->record))
+      chunk.mutable_hash()->set_hash(hashStore.getHash(this->record).getData(), Common::Hash::HASH_SIZE);
+}
+
+/**
+  * The position of the record of the chunk in the 'HashStore'.
+  */
+quint32 Chunk::getRecord() const
+{
+   return this->record;
+}
+
+/**
+  * Replace the record of the chunk by a record already referenced for it, see 'HashStore::adopt(..)'.
+  */
+void Chunk::setRecord(quint32 record)
+{
+   HashStore::getInstance().release(this->record);
+   this->record = record;
 }
 
 void Chunk::removeItsIncompleteFile()
@@ -138,6 +162,24 @@ void Chunk::dataReaderDeleted()
       this->file->dataReaderDeleted();
 }
 
+/**
+  * See 'File::prefetchChunksAfter(..)'.
+  */
+void Chunk::prefetchNextChunks()
+{
+   if (this->file)
+      this->file->prefetchChunksAfter(this->num);
+}
+
+/**
+  * See 'File::chunkEntirelyRead(..)'.
+  */
+void Chunk::entirelyRead()
+{
+   if (this->file)
+      this->file->chunkEntirelyRead(this->num);
+}
+
 /**
   * Called by a deleted file just before dying.
   */
@@ -169,33 +211,33 @@ QVector<QSharedPointer<Chunk>> Chunk::getOtherChunks() const
 
 bool Chunk::hasHash() const
 {
-   return !this->hash.isNull();
+   return HashStore::getInstance().hasHash(this->record);
 }
 
 Common::Hash Chunk::getHash() const
 {
-   return this->hash;
+   return HashStore::getInstance().getHash(this->record);
 }
 
 void Chunk::setHash(const Common::Hash& hash)
 {
    #ifdef DEBUG
       L_DEBU(QString("Chunk[%1] setHash(..) : %2").arg(this->num).arg(hash.toStr()));
-      if (!this->hash.isNull() && this->hash != hash)
-         L_WARN(QString("Chunk::setHash : Hash chunk changed from %1 to %2 for the file %3").arg(this->hash.toStr()).arg(hash.toStr()).arg(this->file->getFullPath()));
+      if (this->hasHash() && this->getHash() != hash)
+         L_WARN(QString("Chunk::setHash : Hash chunk changed from %1 to %2 for the file %3").arg(this->getHash().toStr()).arg(hash.toStr()).arg(this->file->getFullPath()));
    #endif
 
-   this->hash = hash;
+   HashStore::getInstance().setHash(this->record, hash);
 }
 
 int Chunk::getKnownBytes() const
 {
-   return this->knownBytes;
+   return HashStore::getInstance().getKnownBytes(this->record);
 }
 
 void Chunk::setKnownBytes(int bytes)
 {
-   this->knownBytes = bytes;
+   HashStore::getInstance().setKnownBytes(this->record, bytes);
 }
 
 int Chunk::getChunkSize() const
@@ -215,7 +257,7 @@ int Chunk::getChunkSize() const
 
 bool Chunk::isComplete() const
 {
-   return this->file && this->knownBytes >= this->getChunkSize(); // Should be '==' but we are never 100% sure ;).
+   return this->file && this->getKnownBytes() >= this->getChunkSize(); // Should be '==' but we are never 100% sure ;).
 }
 
 bool Chunk::isOwnedBy(File* file) const
@@ -223,6 +265,14 @@ bool Chunk::isOwnedBy(File* file) const
    return this->file == file;
 }
 
+/**
+  * Return null if the file has been deleted.
+  */
+File* Chunk::getFile() const
+{
+   return this->file;
+}
+
 bool Chunk::matchesEntry(const Protos::Common::Entry& entry) const
 {
    return this->file->matchesEntry(entry);
@@ -33,6 +33,7 @@
 #include <priv/Log.h>
 #include <priv/Constants.h>
 #include <priv/Cache/File.h>
+#include <priv/Cache/HashStore.h>
 
 namespace FM
 {
@@ -59,6 +60,9 @@ namespace FM
 
       void populateHashesChunk(Protos::FileCache::Hashes_Chunk& chunk) const;
 
+      quint32 getRecord() const;
+      void setRecord(quint32 record);
+
       void removeItsIncompleteFile();
       bool populateEntry(Protos::Common::Entry* entry) const;
 
@@ -73,6 +77,9 @@ namespace FM
       void dataWriterDeleted();
       void dataReaderDeleted();
 
+      void prefetchNextChunks();
+      void entirelyRead();
+
       void fileDeleted();
 
       inline int read(char* buffer, int offset);
@@ -93,14 +100,14 @@ namespace FM
       bool isComplete() const;
 
       bool isOwnedBy(File* file) const;
+      File* getFile() const;
 
       bool matchesEntry(const Protos::Common::Entry& entry) const;
 
    private:
       File* file;
       const int num; // First is 0.
-      int knownBytes; ///< Relative offset, 0 means we don't have any byte and 'getChunkSize()' means we have all the chunk data.
-      Common::Hash hash;
+      quint32 record; ///< The hash and the known bytes are kept in the 'HashStore', known bytes is a relative offset: 0 means we don't have any byte and 'getChunkSize()' means we have all the chunk data.
    };
 }
 
@@ -123,10 +130,12 @@ inline int FM::Chunk::read(char* buffer, int offset)
    if (!this->file)
       throw ChunkDeletedException();
 
-   if (this->knownBytes == 0)
+   const int knownBytes = HashStore::getInstance().getKnownBytes(this->record);
+
+   if (knownBytes == 0)
       throw ChunkDataUnknownException();
 
-   if (offset >= this->knownBytes)
+   if (offset >= knownBytes)
       return 0;
 
    const int bytesRemaining = this->getChunkSize() - offset;
@@ -147,18 +156,23 @@ inline bool FM::Chunk::write(const char* buffer, int nbBytes)
 
    const int CURRENT_CHUNK_SIZE = this->getChunkSize();
 
-   if (this->knownBytes + nbBytes > CURRENT_CHUNK_SIZE)
+   HashStore& hashStore = HashStore::getInstance();
+   int knownBytes = hashStore.getKnownBytes(this->record);
+
+   if (knownBytes + nbBytes > CURRENT_CHUNK_SIZE)
       throw TryToWriteBeyondTheEndOfChunkException();
 
-   this->knownBytes += this->file->write(buffer, nbBytes, this->knownBytes + static_cast<qint64>(this->num) * CHUNK_SIZE);
+   knownBytes += this->file->write(buffer, nbBytes, knownBytes + static_cast<qint64>(this->num) * CHUNK_SIZE);
 
-   if (this->knownBytes > CURRENT_CHUNK_SIZE) // Should never be true.
+   if (knownBytes > CURRENT_CHUNK_SIZE) // Should never be true.
    {
-      L_ERRO("Chunk::write(..) : this->knownBytes > getChunkSize");
-      this->knownBytes = CURRENT_CHUNK_SIZE;
+      L_ERRO("Chunk::write(..) : knownBytes > getChunkSize");
+      knownBytes = CURRENT_CHUNK_SIZE;
    }
 
-   const bool COMPLETE = this->knownBytes == CURRENT_CHUNK_SIZE;
+   hashStore.setKnownBytes(this->record, knownBytes);
+
+   const bool COMPLETE = knownBytes == CURRENT_CHUNK_SIZE;
 
    if (COMPLETE)
       this->file->chunkComplete(this);
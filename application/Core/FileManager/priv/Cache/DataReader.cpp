@@ -25,17 +25,31 @@ using namespace FM;
   * @exception UnableToOpenFileInReadModeException
   */
 DataReader::DataReader(Chunk& chunk) :
-   chunk(chunk)
+   chunk(chunk), endReached(false)
 {
    this->chunk.newDataReaderCreated();
+   this->chunk.prefetchNextChunks();
 }
 
 DataReader::~DataReader()
 {
+   if (this->endReached)
+      this->chunk.entirelyRead();
    this->chunk.dataReaderDeleted();
 }
 
 int DataReader::read(char* buffer, uint offset)
 {
-   return this->chunk.read(buffer, offset);
+   const int bytesRead = this->chunk.read(buffer, offset);
+   if (bytesRead == 0 && static_cast<int>(offset) >= this->chunk.getChunkSize())
+      this->endReached = true;
+   return bytesRead;
+}
+
+/**
+  * The chunk has been read up to its end: a read at its end has returned nothing, see 'File::chunkEntirelyRead(..)'.
+  */
+bool DataReader::isEndReached() const
+{
+   return this->endReached;
 }
@@ -32,11 +32,13 @@ namespace FM
       ~DataReader();
 
       int read(char* buffer, uint offset);
+      bool isEndReached() const;
 
    protected:
       void run();
 
    private:
       Chunk& chunk;
+      bool endReached; ///< 'true' if the chunk has been read up to its end.
    };
 }
@@ -30,6 +30,7 @@ using namespace FM;
 #include <priv/FileManager.h>
 #include <priv/Cache/File.h>
 #include <priv/Cache/SharedDirectory.h>
+#include <priv/Cache/FileCacheWriter.h>
 
 /**
   * @exception UnableToCreateNewDirException (may be thrown only if 'createPhysically' is true).
@@ -41,7 +42,7 @@ Directory::Directory(Directory* parent, const QString& name, bool createPhysical
    files(&Directory::entrySortingFun),
    scanned(true)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    L_DEBU(QString("New Directory : %1, createPhysically = %2").arg(this->getFullPath()).arg(createPhysically));
 
    if (createPhysically)
@@ -75,7 +76,7 @@ Directory::~Directory()
 void Directory::del(bool invokeDelete)
 {
    {
-      QMutexLocker locker(&this->mutex);
+      EntryMutexLocker locker(&this->mutex);
 
       this->deleteSubDirs();
 
@@ -90,84 +91,85 @@ void Directory::del(bool invokeDelete)
 }
 
 /**
-  * Retore the hashes from the cache.
+  * Retore the hashes of the files of this directory from the cache, the sub directories have their own record.
   * All file which are not complete and not in the cache are physically removed.
   * Only files ending with the setting "unfinished_suffix_term" will be removed.
   * @return The files which have all theirs hashes (complete).
   */
-QList<File*> Directory::restoreFromFileCache(const Protos::FileCache::Hashes::Dir& dir)
+QList<File*> Directory::restoreFromFileCache(const Protos::FileCache::DirRecord& record)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    QList<File*> ret;
 
-   if (Common::ProtoHelper::getStr(dir, &Protos::FileCache::Hashes_Dir::name) == this->getName())
-   {
-      // Sub directories . . .
-      for (int i = 0; i < dir.dir_size(); i++)
-         for (QLinkedListIterator<Directory*> d(this->subDirs.getList()); d.hasNext();)
-            ret << d.next()->restoreFromFileCache(dir.dir(i));
-
-      // . . . And files.
-      QLinkedList<File*> filesNotInDir = this->files.getList();
-      for (int i = 0; i < dir.file_size(); i++)
-         for (QLinkedListIterator<File*> j(this->files.getList()); j.hasNext();)
+   QLinkedList<File*> filesNotInDir = this->files.getList();
+   for (int i = 0; i < record.file_size(); i++)
+      for (QLinkedListIterator<File*> j(this->files.getList()); j.hasNext();)
+      {
+         File* f = j.next();
+         if (f->restoreFromFileCache(record.file(i)) && f->hasAllHashes())
          {
-            File* f = j.next();
-            if (f->restoreFromFileCache(dir.file(i)) && f->hasAllHashes())
-            {
-               filesNotInDir.removeOne(f);
-               ret << f;
-            }
+            filesNotInDir.removeOne(f);
+            ret << f;
          }
+      }
 
-      // Remove unfinished files not in 'dir'.
-      for (QLinkedListIterator<File*> i(filesNotInDir); i.hasNext();)
+   // Remove unfinished files not in 'record'.
+   for (QLinkedListIterator<File*> i(filesNotInDir); i.hasNext();)
+   {
+      File* file = i.next();
+      if (!file->isComplete())
       {
-         File* file = i.next();
-         if (!file->isComplete())
-         {
-            file->removeUnfinishedFiles();
-            file->del();
-         }
+         file->removeUnfinishedFiles();
+         file->del();
       }
    }
 
    return ret;
 }
 
-void Directory::populateHashesDir(Protos::FileCache::Hashes::Dir& dirToFill) const
+/**
+  * Write a record for this directory and then for each of its sub directories.
+  * @param dirs The names of the directories from the root to this one, included. Empty for the root.
+  */
+void Directory::populateHashesDir(FileCacheWriter& writer, const QStringList& dirs) const
 {
    QLinkedList<Directory*> subDirsCopy;
    QLinkedList<File*> filesCopy;
 
    {
-      QMutexLocker locker(&this->mutex);
-      Common::ProtoHelper::setStr(dirToFill, &Protos::FileCache::Hashes_Dir::set_name, this->getName());
+      EntryMutexLocker locker(&this->mutex);
       subDirsCopy = this->subDirs.getList();
       filesCopy = this->files.getList();
    }
 
+   Protos::FileCache::DirRecord record;
+   for (QStringListIterator i(dirs); i.hasNext();)
+      Common::ProtoHelper::addRepeatedStr(record, &Protos::FileCache::DirRecord::add_dir, i.next());
+
    for (QLinkedListIterator<File*> i(filesCopy); i.hasNext();)
    {
       File* f = i.next();
 
       if (f->hasOneOrMoreHashes())
       {
-         Protos::FileCache::Hashes_File* file = dirToFill.add_file();
+         Protos::FileCache::Hashes_File* file = record.add_file();
          f->populateHashesFile(*file);
       }
    }
 
-   for (QLinkedListIterator<Directory*> dir(subDirsCopy); dir.hasNext();)
+   writer.addDir(record);
+
+   for (QLinkedListIterator<Directory*> i(subDirsCopy); i.hasNext();)
    {
-      dir.next()->populateHashesDir(*dirToFill.add_dir());
+      const Directory* dir = i.next();
+      dir->populateHashesDir(writer, QStringList(dirs) << dir->getName());
    }
 }
 
 void Directory::populateEntry(Protos::Common::Entry* dir, bool setSharedDir) const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    Entry::populateEntry(dir, setSharedDir);
 
@@ -189,7 +191,7 @@ void Directory::populateEntry(Protos::Common::Entry* dir, bool setSharedDir) con
   */
 void Directory::removeUnfinishedFiles()
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    // Removes incomplete file we don't know.
    foreach (File* f, this->files.getList())
@@ -201,7 +203,7 @@ void Directory::removeUnfinishedFiles()
 
 void Directory::moveInto(Directory* directory)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    if (directory == this->parent)
       return;
@@ -214,9 +216,12 @@ void Directory::moveInto(Directory* directory)
          return;
    } while (parentDestination = parentDestination->parent);
 
+   Directory* oldDirectory = this->parent;
    this->parent->subDirDeleted(this);
    directory->add(this);
    this->parent = directory;
+
+   this->cache->onEntryMoved(this, oldDirectory);
 }
 
 /**
@@ -232,7 +237,7 @@ void Directory::fileDeleted(File* file)
 
 void Directory::subDirDeleted(Directory* dir)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    this->subDirs.removeOne(dir);
 }
 
@@ -265,13 +270,13 @@ QString Directory::getFullPath() const
 
 SharedDirectory* Directory::getRoot() const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    return this->parent->getRoot(); // A directory MUST have a parent.
 }
 
 void Directory::rename(const QString& newName)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    Entry::rename(newName);
    if (this->parent)
       this->parent->subdirNameChanged(this);
@@ -294,7 +299,7 @@ bool Directory::isAChildOf(const Directory* dir) const
   */
 Directory* Directory::getSubDir(const QString& name) const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    for (QLinkedListIterator<Directory*> i(this->subDirs.getList()); i.hasNext();)
    {
@@ -308,19 +313,19 @@ Directory* Directory::getSubDir(const QString& name) const
 
 QLinkedList<Directory*> Directory::getSubDirs() const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    return this->subDirs.getList();
 }
 
 QLinkedList<File*> Directory::getFiles() const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    return this->files.getList();
 }
 
 QList<File*> Directory::getCompleteFiles() const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    QList<File*> completeFiles;
    foreach (File* file, this->files.getList())
    {
@@ -337,7 +342,7 @@ QList<File*> Directory::getCompleteFiles() const
   */
 Directory* Directory::createSubDir(const QString& name, bool physically)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    if (Directory* subDir = this->getSubDir(name))
       return subDir;
    return new Directory(this, name, physically);
@@ -362,7 +367,7 @@ Directory* Directory::createSubDirs(const QStringList& names, bool physically)
 
 File* Directory::getFile(const QString& name) const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    foreach (File* f, this->files.getList())
       if (f->getName() == name)
          return f;
@@ -375,14 +380,14 @@ File* Directory::getFile(const QString& name) const
   */
 void Directory::add(File* file)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    this->files.insert(file);
    (*this) += file->getSize();
 }
 
 void Directory::fileSizeChanged(qint64 oldSize, qint64 newSize)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    (*this) += newSize - oldSize;
 }
 
@@ -392,7 +397,7 @@ void Directory::fileSizeChanged(qint64 oldSize, qint64 newSize)
   */
 void Directory::stealContent(Directory* dir)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    if (dir == this)
    {
       L_ERRO("Directory::stealSubDirs(..) : dir == this");
@@ -420,19 +425,19 @@ void Directory::stealContent(Directory* dir)
 
 void Directory::add(Directory* dir)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    this->subDirs.insert(dir);
 }
 
 bool Directory::isScanned() const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    return this->scanned;
 }
 
 void Directory::setScanned(bool value)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    if (value == this->scanned)
       return;
@@ -447,7 +452,7 @@ void Directory::setScanned(bool value)
   */
 void Directory::fileNameChanged(File* file)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    this->files.itemChanged(file);
 }
 
@@ -459,7 +464,7 @@ void Directory::deleteSubDirs()
 
 void Directory::subdirNameChanged(Directory* dir)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    this->subDirs.itemChanged(dir);
 }
 
@@ -469,7 +474,7 @@ void Directory::subdirNameChanged(Directory* dir)
   */
 Directory& Directory::operator+=(qint64 size)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    this->setSize(this->getSize() + size);
 
@@ -481,7 +486,7 @@ Directory& Directory::operator+=(qint64 size)
 
 Directory& Directory::operator-=(qint64 size)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    this->setSize(this->getSize() - size);
 
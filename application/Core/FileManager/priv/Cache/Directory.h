@@ -19,6 +19,7 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 #include <QList>
 #include <QFileInfo>
 #include <QMutex>
@@ -36,6 +37,7 @@ namespace FM
    class File;
    class Cache;
    class SharedDirectory;
+   class FileCacheWriter;
 
    class Directory : public Entry
    {
@@ -49,8 +51,8 @@ namespace FM
       virtual ~Directory();
       virtual void del(bool invokeDelete = true);
 
-      QList<File*> restoreFromFileCache(const Protos::FileCache::Hashes::Dir& dir);
-      void populateHashesDir(Protos::FileCache::Hashes::Dir& dirToFill) const;
+      QList<File*> restoreFromFileCache(const Protos::FileCache::DirRecord& record);
+      void populateHashesDir(FileCacheWriter& writer, const QStringList& dirs = QStringList()) const;
 
       virtual void populateEntry(Protos::Common::Entry* dir, bool setSharedDir = false) const;
 
@@ -29,7 +29,7 @@ using namespace FM;
 #include <priv/Cache/SharedDirectory.h>
 
 Entry::Entry(Cache* cache, const QString& name, qint64 size) :
-   cache(cache), name(name), size(size), mutex(QMutex::Recursive)
+   cache(cache), name(name), size(size)
 {
    if (cache)
       this->cache->onEntryAdded(this);
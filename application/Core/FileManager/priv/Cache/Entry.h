@@ -19,12 +19,13 @@
 #pragma once
 
 #include <QString>
-#include <QMutex>
 
 #include <Common/Uncopyable.h>
 
 #include <Protos/common.pb.h>
 
+#include <priv/Cache/EntryMutex.h>
+
 namespace FM
 {
    class Directory;
@@ -83,7 +84,7 @@ namespace FM
       qint64 size;
 
    protected:
-      mutable QMutex mutex;
+      mutable EntryMutex mutex;
    };
 
    inline bool operator<(const Entry& e1, const Entry& e2)
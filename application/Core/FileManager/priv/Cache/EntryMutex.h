@@ -0,0 +1,80 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QMutex>
+#include <QThread>
+#include <QAtomicInteger>
+
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   /**
+     * A recursive mutex without any allocation. There is one per entry of the cache, a 'QMutex' created with 'QMutex::Recursive'
+     * would allocate its private data on the heap for each file and each directory.
+     * The plain 'QMutex' doesn't allocate anything as long as it isn't contended.
+     */
+   class EntryMutex : Common::Uncopyable
+   {
+   public:
+      EntryMutex() : count(0) {}
+
+      inline void lock()
+      {
+         const quintptr self = reinterpret_cast<quintptr>(QThread::currentThreadId());
+         if (this->owner.loadAcquire() == self)
+         {
+            this->count++;
+            return;
+         }
+
+         this->mutex.lock();
+         this->owner.storeRelease(self);
+         this->count = 1;
+      }
+
+      inline void unlock()
+      {
+         if (--this->count == 0)
+         {
+            this->owner.storeRelease(0);
+            this->mutex.unlock();
+         }
+      }
+
+   private:
+      QMutex mutex;
+      QAtomicInteger<quintptr> owner; ///< The thread currently owning the mutex, 0 if none.
+      quint32 count; ///< Only accessed by the owner.
+   };
+
+   /**
+     * The 'QMutexLocker' of 'EntryMutex'.
+     */
+   class EntryMutexLocker : Common::Uncopyable
+   {
+   public:
+      explicit EntryMutexLocker(EntryMutex* mutex) : mutex(mutex) { this->mutex->lock(); }
+      ~EntryMutexLocker() { this->mutex->unlock(); }
+
+   private:
+      EntryMutex* const mutex;
+   };
+}
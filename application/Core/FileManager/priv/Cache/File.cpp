@@ -19,6 +19,10 @@
 #include <priv/Cache/File.h>
 using namespace FM;
 
+#if defined(Q_OS_LINUX)
+   #include <fcntl.h>
+#endif
+
 #ifdef Q_OS_WIN32
    #include <io.h>
    #include <windows.h>
@@ -41,6 +45,7 @@ using namespace FM;
 #include <priv/Cache/Directory.h>
 #include <priv/Cache/SharedDirectory.h>
 #include <priv/Cache/Chunk.h>
+#include <priv/Cache/HashStore.h>
 
 /**
   * @class FM::File
@@ -79,7 +84,11 @@ File::File(
    Entry(dir->getCache(), name + (createPhysically && size > 0 ? Global::getUnfinishedSuffix() : ""), size),
    dir(dir),
    dateLastModified(dateLastModified),
+   nsLastModified(0),
    complete(!Global::isFileUnfinished(Entry::getName())),
+   hashStoreId(HashStore::getInstance().newFileId()),
+   device(0),
+   inode(0),
    numDataWriter(0),
    numDataReader(0),
    fileInWriteMode(nullptr),
@@ -145,7 +154,7 @@ FileForHasher* File::asFileForHasher()
   */
 void File::setToUnfinished(qint64 size, const Common::Hashes& hashes)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    L_DEBU(QString("File::setToUnfinished : %1").arg(this->getFullPath()));
 
    this->complete = false;
@@ -161,25 +170,51 @@ void File::setToUnfinished(qint64 size, const Common::Hashes& hashes)
 
 /**
   * Restore the data stored in a protocol buffer structure.
+  * If the file references some records of the 'HashStore' its chunks adopt them, the hashes aren't copied.
+  * @param checkTheNameToo 'false' to restore a file moved or renamed, see 'FileUpdater::restoreMovedFiles()'.
   * @return 'true' if the file match the given data or 'false' otherwise.
   */
-bool File::restoreFromFileCache(const Protos::FileCache::Hashes::File& file)
+bool File::restoreFromFileCache(const Protos::FileCache::Hashes::File& file, bool checkTheNameToo)
 {
+   const bool withRecords = file.hash_record_size() > 0;
+
    if (
       static_cast<qint64>(file.size()) == this->getSize() &&
-      Common::ProtoHelper::getStr(file, &Protos::FileCache::Hashes_File::filename) == this->getName() &&
+      (!checkTheNameToo || Common::ProtoHelper::getStr(file, &Protos::FileCache::Hashes_File::filename) == this->getName()) &&
          (
             Global::isFileUnfinished(this->getName()) ||
-            (qint64)file.date_last_modified() == this->getDateLastModified().toMSecsSinceEpoch() // We test the date only for finished files.
+            this->sameDateLastModified(file.date_last_modified(), file.date_last_modified_ns()) // We test the date only for finished files.
           ) &&
-      this->chunks.size() == file.chunk_size()
+      this->chunks.size() == (withRecords ? file.hash_record_size() : file.chunk_size())
    )
    {
       L_DEBU(QString("Restoring file '%1' from the file cache").arg(this->getFullPath()));
 
-      for (int i = 0; i < file.chunk_size(); i++)
+      if (withRecords)
+      {
+         QVector<quint32> records;
+         records.reserve(file.hash_record_size());
+         for (int i = 0; i < file.hash_record_size(); i++)
+            records << file.hash_record(i);
+
+         if (!HashStore::getInstance().adopt(records, file.hash_store_file_id()))
+         {
+            L_DEBU(QString("The hash records of the file '%1' are no longer valid").arg(this->getFullPath()));
+            return false;
+         }
+
+         this->hashStoreId = file.hash_store_file_id();
+         for (int i = 0; i < records.size(); i++)
+            this->chunks[i]->setRecord(records[i]);
+      }
+      else
+      {
+         for (int i = 0; i < file.chunk_size(); i++)
+            this->chunks[i]->restoreFromFileCache(file.chunk(i));
+      }
+
+      for (int i = 0; i < this->chunks.size(); i++)
       {
-         this->chunks[i]->restoreFromFileCache(file.chunk(i));
          if (this->chunks[i]->hasHash())
          {
             if (this->chunks[i]->getKnownBytes() > 0)
@@ -194,16 +229,34 @@ bool File::restoreFromFileCache(const Protos::FileCache::Hashes::File& file)
 
 void File::populateHashesFile(Protos::FileCache::Hashes_File& fileToFill) const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    Common::ProtoHelper::setStr(fileToFill, &Protos::FileCache::Hashes_File::set_filename, this->name);
    fileToFill.set_size(this->getSize());
    fileToFill.set_date_last_modified(this->getDateLastModified().toMSecsSinceEpoch());
+   fileToFill.set_date_last_modified_ns(this->nsLastModified);
+   fileToFill.set_inode(this->inode);
+   fileToFill.set_device(this->device);
 
-   for (QVectorIterator<QSharedPointer<Chunk>> i(this->chunks); i.hasNext();)
+   // The records of a persisted hash store are referenced instead of being copied.
+   HashStore& hashStore = HashStore::getInstance();
+   bool referenceRecords = hashStore.isPersistent();
+   for (QVectorIterator<QSharedPointer<Chunk>> i(this->chunks); i.hasNext() && referenceRecords;)
+      referenceRecords = hashStore.isPersistent(i.next()->getRecord());
+
+   if (referenceRecords)
    {
-      Protos::FileCache::Hashes_Chunk* chunk = fileToFill.add_chunk();
-      i.next()->populateHashesChunk(*chunk);
+      fileToFill.set_hash_store_file_id(this->hashStoreId);
+      for (QVectorIterator<QSharedPointer<Chunk>> i(this->chunks); i.hasNext();)
+         fileToFill.add_hash_record(i.next()->getRecord());
+   }
+   else
+   {
+      for (QVectorIterator<QSharedPointer<Chunk>> i(this->chunks); i.hasNext();)
+      {
+         Protos::FileCache::Hashes_Chunk* chunk = fileToFill.add_chunk();
+         i.next()->populateHashesChunk(*chunk);
+      }
    }
 }
 
@@ -217,7 +270,7 @@ void File::populateEntry(Protos::Common::Entry* entry, bool setSharedDir) const
 
 void File::populateEntry(Protos::Common::Entry* entry, bool setSharedDir, int maxHashes) const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    Entry::populateEntry(entry, setSharedDir);
 
@@ -238,7 +291,7 @@ void File::populateEntry(Protos::Common::Entry* entry, bool setSharedDir, int ma
 
 bool File::matchesEntry(const Protos::Common::Entry& entry) const
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    return
       this->getRoot()->getId() == entry.shared_dir().id().hash() &&
@@ -248,11 +301,34 @@ bool File::matchesEntry(const Protos::Common::Entry& entry) const
 }
 
 /**
-  * Return true if the size and the last modification date correspond to the given file information.
+  * Return true if the size and the last modification date correspond to the given ones, see 'DirScanner::list(..)'.
+  * The nanoseconds are only compared when they are known on both sides.
   */
-bool File::correspondTo(const QFileInfo& fileInfo, bool checkTheDateToo)
+bool File::correspondTo(qint64 size, const QDateTime& dateLastModified, quint32 nsLastModified, bool checkTheDateToo)
 {
-   return this->getSize() == fileInfo.size() && (!checkTheDateToo || this->getDateLastModified() == fileInfo.lastModified());
+   return this->getSize() == size && (!checkTheDateToo || this->sameDateLastModified(dateLastModified.toMSecsSinceEpoch(), nsLastModified));
+}
+
+/**
+  * Set the information given by the file system which aren't needed to share the file, see 'DirScanner::Entry'.
+  */
+void File::setFileSystemInfo(quint32 nsLastModified, quint64 device, quint64 inode)
+{
+   EntryMutexLocker locker(&this->mutex);
+
+   this->nsLastModified = nsLastModified;
+   this->device = device;
+   this->inode = inode;
+}
+
+quint64 File::getDevice() const
+{
+   return this->device;
+}
+
+quint64 File::getInode() const
+{
+   return this->inode;
 }
 
 QString File::getPath() const
@@ -276,7 +352,7 @@ SharedDirectory* File::getRoot() const
 
 void File::rename(const QString& newName)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    Entry::rename(newName);
    this->dir->fileNameChanged(this);
@@ -346,6 +422,11 @@ void File::newDataReaderCreated()
       this->fileInReadMode = this->cache->getFilePool().open(this->getFullPath(), QIODevice::ReadOnly | QIODevice::Unbuffered);
       if (!this->fileInReadMode)
          throw UnableToOpenFileInReadModeException();
+
+#if defined(Q_OS_LINUX)
+      // The chunks are read from the beginning to the end, it doubles the readahead window of the kernel.
+      posix_fadvise(this->fileInReadMode->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
    }
 }
 
@@ -376,6 +457,75 @@ void File::dataReaderDeleted()
    }
 }
 
+/**
+  * A peer asking the chunk 'num' will very likely ask the next ones, they are loaded in background in the page cache.
+  * The number of prefetched chunks is given by the setting 'upload_prefetch_nb_chunks'.
+  * Must be called between 'newDataReaderCreated()' and 'dataReaderDeleted()'.
+  */
+void File::prefetchChunksAfter(int num)
+{
+#if defined(Q_OS_LINUX)
+   int nbChunks;
+   {
+      EntryMutexLocker locker(&this->mutex);
+      nbChunks = this->chunks.size();
+   }
+
+   const QPair<qint64, qint64> range = File::getPrefetchRange(num, this->cache->getNbChunksToPrefetch(), nbChunks, this->getSize());
+   if (range.second <= 0)
+      return;
+
+   QMutexLocker locker(&this->readLock);
+
+   if (!this->fileInReadMode)
+      return;
+
+   if (posix_fadvise(this->fileInReadMode->handle(), range.first, range.second, POSIX_FADV_WILLNEED) != 0)
+      L_DEBU(QString("Unable to prefetch %1 bytes from %2 of %3").arg(range.second).arg(range.first).arg(this->getFullPath()));
+#else
+   Q_UNUSED(num);
+#endif
+}
+
+/**
+  * Return the range of the file holding the chunks following the chunk 'num', see 'prefetchChunksAfter(..)'.
+  * @return The offset and the length [B], the length is 0 if there is nothing to prefetch.
+  */
+QPair<qint64, qint64> File::getPrefetchRange(int num, int nbChunksToPrefetch, int nbChunks, qint64 fileSize)
+{
+   const int first = num + 1;
+   const int last = qMin(num + nbChunksToPrefetch, nbChunks - 1);
+   if (first > last)
+      return QPair<qint64, qint64>(0, 0);
+
+   const qint64 offset = static_cast<qint64>(first) * Chunk::CHUNK_SIZE;
+   return QPair<qint64, qint64>(offset, qMin(static_cast<qint64>(last + 1) * Chunk::CHUNK_SIZE, fileSize) - offset);
+}
+
+/**
+  * The chunk 'num' has been read up to its end by a reader, if there is no other reader its data are removed from the page cache
+  * to leave the memory to the chunks to come. Only done if the setting 'upload_drop_sent_chunks' is set because the same chunk
+  * may be asked a bit later by another peer.
+  * Must be called before 'dataReaderDeleted()'.
+  */
+void File::chunkEntirelyRead(int num)
+{
+#if defined(Q_OS_LINUX)
+   if (!this->cache->dropSentChunks())
+      return;
+
+   QMutexLocker locker(&this->readLock);
+
+   if (!this->fileInReadMode || this->numDataReader != 1)
+      return;
+
+   const qint64 offset = static_cast<qint64>(num) * Chunk::CHUNK_SIZE;
+   posix_fadvise(this->fileInReadMode->handle(), offset, Chunk::CHUNK_SIZE, POSIX_FADV_DONTNEED);
+#else
+   Q_UNUSED(num);
+#endif
+}
+
 /**
   * Write some bytes to the file at the given offset.
   * If the buffer exceed the file size then only the begining of the buffer is
@@ -424,6 +574,8 @@ qint64 File::read(char* buffer, qint64 offset, int maxBytesToRead)
    if (bytesRead == -1)
       throw IOErrorException();
 
+   this->cache->getHashingThrottle().dataRead(bytesRead);
+
    return bytesRead;
 }
 
@@ -434,7 +586,7 @@ QVector<QSharedPointer<Chunk>> File::getChunks() const
 
 bool File::hasAllHashes()
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    if (this->getSize() == 0)
       return false;
 
@@ -458,13 +610,13 @@ bool File::hasOneOrMoreHashes()
   */
 bool File::isComplete()
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
    return this->complete;
 }
 
 void File::chunkComplete(const Chunk* chunk)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    int nbChunkComplete = 0;
    for (int i = 0; i < this->chunks.size(); ++i)
@@ -506,7 +658,7 @@ void File::deleteIfIncomplete()
   */
 void File::removeUnfinishedFiles()
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    if (!this->complete)
    {
@@ -525,14 +677,17 @@ void File::removeUnfinishedFiles()
 
 void File::moveInto(Directory* directory)
 {
-   QMutexLocker locker(&this->mutex);
+   EntryMutexLocker locker(&this->mutex);
 
    if (this->dir == directory)
       return;
 
+   Directory* oldDirectory = this->dir;
    this->dir->fileDeleted(this);
    directory->add(this);
    this->dir = directory;
+
+   this->cache->onEntryMoved(this, oldDirectory);
 }
 
 void File::changeDirectory(Directory* dir)
@@ -550,6 +705,11 @@ bool File::hasAParentDir(Directory* dir)
    return this->dir->isAChildOf(dir);
 }
 
+quint32 File::getHashStoreId() const
+{
+   return this->hashStoreId;
+}
+
 /**
   * Called from a downloading thread.
   * Set the file as complete, change its name from "<name>.unfinished" to "<name>".
@@ -637,6 +797,7 @@ void File::setFileAsSparse(const QFile& file)
 
 /**
   * The number of given hashes may not match the total number of chunk.
+  * Each chunk is allocated with the reference counter of its 'QSharedPointer', see 'QSharedPointer::create(..)'.
   */
 void File::setHashes(const Common::Hashes& hashes)
 {
@@ -647,17 +808,28 @@ void File::setHashes(const Common::Hashes& hashes)
 
       if (i < hashes.size() && !hashes[i].isNull())
       {
-         QSharedPointer<Chunk> chunk(new Chunk(this, i, chunkKnownBytes, hashes[i]));
+         QSharedPointer<Chunk> chunk = QSharedPointer<Chunk>::create(this, i, chunkKnownBytes, hashes[i]);
          this->chunks << chunk;
          if (chunk->isComplete())
             this->cache->onChunkHashKnown(chunk);
       }
       else
          // If there is too few hashes then null hashes are added.
-         this->chunks << QSharedPointer<Chunk>(new Chunk(this, i, chunkKnownBytes));
+         this->chunks << QSharedPointer<Chunk>::create(this, i, chunkKnownBytes);
    }
 }
 
+/**
+  * @param msLastModified In ms since Epoch.
+  * @param nsLastModified Compared only if it's known on both sides.
+  */
+bool File::sameDateLastModified(qint64 msLastModified, quint32 nsLastModified) const
+{
+   return
+      this->dateLastModified.toMSecsSinceEpoch() == msLastModified &&
+      (this->nsLastModified == 0 || nsLastModified == 0 || this->nsLastModified == nsLastModified);
+}
+
 /////
 
 void FileForHasher::setSize(qint64 size)
@@ -669,8 +841,13 @@ void FileForHasher::setSize(qint64 size)
    }
 }
 
+/**
+  * The nanoseconds become unknown if the date has changed.
+  */
 void FileForHasher::updateDateLastModified(const QDateTime& date)
 {
+   if (this->dateLastModified != date)
+      this->nsLastModified = 0;
    this->dateLastModified = date;
 }
 
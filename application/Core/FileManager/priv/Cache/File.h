@@ -27,6 +27,7 @@
 #include <QFileInfo>
 #include <QVector>
 #include <QSharedPointer>
+#include <QPair>
 #include <QDateTime>
 
 #include <Protos/common.pb.h>
@@ -64,14 +65,17 @@ namespace FM
 
       void setToUnfinished(qint64 size, const Common::Hashes& hashes = Common::Hashes());
 
-      bool restoreFromFileCache(const Protos::FileCache::Hashes::File& file);
+      bool restoreFromFileCache(const Protos::FileCache::Hashes::File& file, bool checkTheNameToo = true);
       void populateHashesFile(Protos::FileCache::Hashes_File& fileToFill) const;
 
       void populateEntry(Protos::Common::Entry* entry, bool setSharedDir = false) const;
       void populateEntry(Protos::Common::Entry* entry, bool setSharedDir, int maxHashes) const;
       bool matchesEntry(const Protos::Common::Entry& entry) const;
 
-      bool correspondTo(const QFileInfo& fileInfo, bool checkTheDateToo = true);
+      bool correspondTo(qint64 size, const QDateTime& dateLastModified, quint32 nsLastModified, bool checkTheDateToo = true);
+      void setFileSystemInfo(quint32 nsLastModified, quint64 device, quint64 inode);
+      quint64 getDevice() const;
+      quint64 getInode() const;
 
       QString getPath() const;
       QString getFullPath() const;
@@ -85,6 +89,10 @@ namespace FM
       void dataWriterDeleted();
       void dataReaderDeleted();
 
+      void prefetchChunksAfter(int num);
+      static QPair<qint64, qint64> getPrefetchRange(int num, int nbChunksToPrefetch, int nbChunks, qint64 fileSize);
+      void chunkEntirelyRead(int num);
+
       qint64 write(const char* buffer, int nbBytes, qint64 offset);
       qint64 read(char* buffer, qint64 offset, int maxBytesToRead);
 
@@ -105,20 +113,27 @@ namespace FM
       void changeDirectory(Directory* dir);
       bool hasAParentDir(Directory* dir);
 
+      quint32 getHashStoreId() const;
+
    private:
       void setAsComplete();
       void deleteAllChunks();
       void createPhysicalFile();
       static void setFileAsSparse(const QFile& file);
       void setHashes(const Common::Hashes& hashes);
+      bool sameDateLastModified(qint64 msLastModified, quint32 nsLastModified) const;
 
    protected:
       Directory* dir;
       QVector<QSharedPointer<Chunk>> chunks;
       QDateTime dateLastModified;
+      quint32 nsLastModified; ///< The nanoseconds not included in 'dateLastModified', 0 if unknown.
 
    private:
       bool complete;
+      quint32 hashStoreId; ///< The identifier of the file in the 'HashStore', given to the records of its chunks.
+      quint64 device; ///< 0 if unknown.
+      quint64 inode; ///< 0 if unknown.
 
       quint16 numDataWriter;
       quint16 numDataReader;
@@ -0,0 +1,160 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/FileCacheReader.h>
+using namespace FM;
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <priv/Log.h>
+
+const quint32 FileCacheReader::MAGIC(0x43464C44); // "DLFC".
+
+/**
+  * @class FM::FileCacheReader
+  *
+  * Read a file cache written by 'FileCacheWriter'. The file is made of:
+  *  - For each shared directory a sequence of 'Protos::FileCache::DirRecord', each one prefixed by its size as a varint.
+  *  - A 'Protos::FileCache::Hashes' giving the position and the size of the records of each shared directory, see 'getHeader()'.
+  *  - A 'Footer' giving the position of the 'Hashes'. The values are in the native byte order.
+  *
+  * Only the header is kept in memory, the records of a shared directory are mapped and parsed one by one by 'restore(..)'.
+  * Thus the peak memory doesn't depend on the size of the cache but on the size of the largest directory.
+  */
+
+FileCacheReader::FileCacheReader(const QString& filepath) :
+   file(filepath)
+{
+}
+
+/**
+  * Read the header.
+  * @return 'false' if the file doesn't exist or is corrupted, in the latter case the error is logged.
+  */
+bool FileCacheReader::open()
+{
+   this->header.Clear();
+
+   if (this->file.fileName().isEmpty() || !this->file.exists())
+      return false;
+
+   if (!this->file.open(QIODevice::ReadOnly))
+   {
+      L_ERRO(QString("Unable to open the file cache %1 : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+      return false;
+   }
+
+   const qint64 fileSize = this->file.size();
+
+   Footer footer;
+   if (
+      fileSize < qint64(sizeof(Footer)) ||
+      !this->file.seek(fileSize - sizeof(Footer)) ||
+      this->file.read(reinterpret_cast<char*>(&footer), sizeof(Footer)) != sizeof(Footer) ||
+      footer.magic != MAGIC ||
+      footer.headerOffset + footer.headerSize + sizeof(Footer) != quint64(fileSize) ||
+      !this->file.seek(footer.headerOffset)
+   )
+   {
+      L_WARN(QString("The file cache %1 has an unknown format, it's ignored").arg(this->file.fileName()));
+      this->file.close();
+      return false;
+   }
+
+   const QByteArray data = this->file.read(footer.headerSize);
+   bool valid = data.size() == int(footer.headerSize) && this->header.ParseFromArray(data.constData(), data.size());
+
+   for (int i = 0; i < this->header.shareddir_size() && valid; i++)
+      valid = this->header.shareddir(i).offset() + this->header.shareddir(i).size() <= footer.headerOffset;
+
+   if (!valid)
+   {
+      L_WARN(QString("The file cache %1 is corrupted, it's ignored").arg(this->file.fileName()));
+      this->header.Clear();
+      this->file.close();
+      return false;
+   }
+
+   return true;
+}
+
+/**
+  * The roots of the shared directories aren't set, see 'Protos::FileCache::DirRecord'.
+  * Empty if 'open()' has failed.
+  */
+const Protos::FileCache::Hashes& FileCacheReader::getHeader() const
+{
+   return this->header;
+}
+
+qint64 FileCacheReader::getSize() const
+{
+   return this->file.size();
+}
+
+/**
+  * Call 'fun' for each directory record of the given shared directory, in the order they have been written:
+  * a directory always comes before its sub-directories.
+  * The given record is only valid during the call, it may be modified.
+  * @return 'false' if the records are corrupted, the records before the corrupted one have been given anyway.
+  */
+bool FileCacheReader::restore(const Common::Hash& sharedDirId, std::function<void(Protos::FileCache::DirRecord&)> fun)
+{
+   const Protos::FileCache::Hashes::SharedDir* sharedDir = nullptr;
+   for (int i = 0; i < this->header.shareddir_size() && !sharedDir; i++)
+      if (this->header.shareddir(i).id().hash() == sharedDirId)
+         sharedDir = &this->header.shareddir(i);
+
+   if (!sharedDir || sharedDir->size() == 0)
+      return true;
+
+   // The pages already parsed can be reclaimed by the system, unlike a buffer.
+   uchar* data = this->file.map(sharedDir->offset(), sharedDir->size());
+   if (!data)
+   {
+      L_ERRO(QString("Unable to map the file cache %1 : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+      return false;
+   }
+
+   const quint64 size = sharedDir->size();
+   quint64 position = 0;
+   Protos::FileCache::DirRecord record;
+   while (position < size)
+   {
+      google::protobuf::io::CodedInputStream stream(data + position, int(qMin<quint64>(size - position, 5)));
+      quint32 recordSize;
+      if (!stream.ReadVarint32(&recordSize))
+         break;
+
+      const int headerSize = stream.CurrentPosition();
+      if (recordSize > size - position - headerSize || !record.ParseFromArray(data + position + headerSize, recordSize))
+         break;
+
+      position += headerSize + recordSize;
+      fun(record);
+   }
+
+   this->file.unmap(data);
+
+   if (position < size)
+   {
+      L_WARN(QString("The file cache %1 is corrupted, some directories are ignored").arg(this->file.fileName()));
+      return false;
+   }
+   return true;
+}
@@ -0,0 +1,57 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <functional>
+
+#include <QString>
+#include <QFile>
+
+#include <Protos/files_cache.pb.h>
+
+#include <Common/Hash.h>
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class FileCacheReader : Common::Uncopyable
+   {
+   public:
+      static const quint32 MAGIC;
+
+      struct Footer
+      {
+         quint64 headerOffset; ///< The position of the 'Hashes' [B].
+         quint32 headerSize; ///< The size of the 'Hashes' [B].
+         quint32 magic;
+      };
+
+      FileCacheReader(const QString& filepath);
+
+      bool open();
+      const Protos::FileCache::Hashes& getHeader() const;
+      qint64 getSize() const;
+
+      bool restore(const Common::Hash& sharedDirId, std::function<void(Protos::FileCache::DirRecord&)> fun);
+
+   private:
+      QFile file;
+      Protos::FileCache::Hashes header; ///< The shared directories and the position of their records.
+   };
+}
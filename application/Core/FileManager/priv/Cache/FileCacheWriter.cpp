@@ -0,0 +1,186 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/FileCacheWriter.h>
+using namespace FM;
+
+#include <string>
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <Common/Global.h>
+#include <Common/Constants.h>
+#include <Common/ProtoHelper.h>
+
+#include <priv/Log.h>
+#include <priv/Constants.h>
+#include <priv/Cache/FileCacheReader.h>
+#include <priv/Cache/HashStore.h>
+
+const QString FileCacheWriter::TEMP_SUFFIX_TERM(".temp");
+
+/**
+  * @class FM::FileCacheWriter
+  *
+  * Write a file cache directory by directory, see 'FileCacheReader' for the format.
+  * Only the current directory is held in memory, not the whole cache.
+  *
+  * The records are written to a temporary file which is renamed by 'commit(..)', the previous cache is kept until then.
+  * If the writer is destroyed without a successful commit the temporary file is removed.
+  */
+
+FileCacheWriter::FileCacheWriter(const QString& filepath) :
+   filepath(filepath), file(filepath.isEmpty() ? QString() : filepath + TEMP_SUFFIX_TERM), error(false), committed(false), position(0)
+{
+   this->header.set_version(FILE_CACHE_VERSION);
+   this->header.set_chunksize(Common::Constants::CHUNK_SIZE);
+   this->header.set_hash_store_id(HashStore::getInstance().getId()); // See 'File::populateHashesFile(..)'.
+
+   if (filepath.isEmpty() || !this->file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+   {
+      L_ERRO(QString("Unable to open the file in write mode : %1, error : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+      this->error = true;
+   }
+}
+
+FileCacheWriter::~FileCacheWriter()
+{
+   if (!this->committed && !this->filepath.isEmpty())
+      this->file.remove();
+}
+
+/**
+  * The following directories belong to the given shared directory.
+  */
+void FileCacheWriter::beginSharedDir(const Common::Hash& id, const QString& path)
+{
+   Protos::FileCache::Hashes::SharedDir* sharedDir = this->header.add_shareddir();
+   sharedDir->mutable_id()->set_hash(id.getData(), Common::Hash::HASH_SIZE);
+   Common::ProtoHelper::setStr(*sharedDir, &Protos::FileCache::Hashes::SharedDir::set_path, path);
+   sharedDir->set_offset(this->position);
+}
+
+/**
+  * A directory must be added before its sub-directories.
+  */
+void FileCacheWriter::addDir(const Protos::FileCache::DirRecord& record)
+{
+   if (this->error || this->header.shareddir_size() == 0)
+      return;
+
+   const quint32 recordSize = record.ByteSizeLong();
+   QByteArray buffer(google::protobuf::io::CodedOutputStream::VarintSize32(recordSize) + recordSize, Qt::Uninitialized);
+   quint8* data = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(recordSize, reinterpret_cast<quint8*>(buffer.data()));
+   record.SerializeWithCachedSizesToArray(data);
+
+   if (this->file.write(buffer) != buffer.size())
+   {
+      L_ERRO(QString("Unable to write the file cache : %1, error : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+      this->error = true;
+      return;
+   }
+
+   this->position += buffer.size();
+
+   Protos::FileCache::Hashes::SharedDir* sharedDir = this->header.mutable_shareddir(this->header.shareddir_size() - 1);
+   sharedDir->set_size(sharedDir->size() + buffer.size());
+   this->header.set_nb_files(this->header.nb_files() + record.file_size());
+}
+
+/**
+  * Write the header and replace the previous file cache.
+  * @param journalSequence The sequence number of the last record of the journal included in this cache, see 'CacheJournal'.
+  * @return 'false' if the file can't be written, the error is logged.
+  */
+bool FileCacheWriter::commit(quint64 journalSequence)
+{
+   if (this->error)
+      return false;
+
+   this->header.set_journal_sequence(journalSequence);
+   const std::string header = this->header.SerializeAsString();
+
+   FileCacheReader::Footer footer;
+   footer.headerOffset = this->position;
+   footer.headerSize = header.size();
+   footer.magic = FileCacheReader::MAGIC;
+
+   if (
+      this->file.write(header.data(), header.size()) != qint64(header.size()) ||
+      this->file.write(reinterpret_cast<const char*>(&footer), sizeof(FileCacheReader::Footer)) != sizeof(FileCacheReader::Footer) ||
+      !this->file.flush()
+   )
+   {
+      L_ERRO(QString("Unable to write the file cache : %1, error : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+      this->error = true;
+      return false;
+   }
+
+   this->position += header.size() + sizeof(FileCacheReader::Footer);
+   this->file.close();
+
+   if (!Common::Global::rename(this->file.fileName(), this->filepath))
+      return false;
+
+   this->committed = true;
+   return true;
+}
+
+/**
+  * The number of bytes written so far, the size of the file cache once committed [B].
+  */
+qint64 FileCacheWriter::getSize() const
+{
+   return this->position;
+}
+
+/**
+  * Write a file cache of the previous format, a single 'Hashes' with the tree of each shared directory.
+  * @return 'false' if the file can't be written.
+  */
+bool FileCacheWriter::convert(const Protos::FileCache::Hashes& hashes, const QString& filepath)
+{
+   FileCacheWriter writer(filepath);
+
+   for (int i = 0; i < hashes.shareddir_size(); i++)
+   {
+      const Protos::FileCache::Hashes::SharedDir& sharedDir = hashes.shareddir(i);
+      writer.beginSharedDir(sharedDir.id().hash(), Common::ProtoHelper::getStr(sharedDir, &Protos::FileCache::Hashes::SharedDir::path));
+
+      QStringList dirs;
+      writer.addDirs(sharedDir.root(), dirs);
+   }
+
+   return writer.commit(hashes.journal_sequence());
+}
+
+void FileCacheWriter::addDirs(const Protos::FileCache::Hashes::Dir& dir, QStringList& dirs)
+{
+   Protos::FileCache::DirRecord record;
+   for (QStringListIterator i(dirs); i.hasNext();)
+      Common::ProtoHelper::addRepeatedStr(record, &Protos::FileCache::DirRecord::add_dir, i.next());
+   record.mutable_file()->CopyFrom(dir.file());
+   this->addDir(record);
+
+   for (int i = 0; i < dir.dir_size(); i++)
+   {
+      dirs << Common::ProtoHelper::getStr(dir.dir(i), &Protos::FileCache::Hashes::Dir::name);
+      this->addDirs(dir.dir(i), dirs);
+      dirs.removeLast();
+   }
+}
@@ -0,0 +1,59 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+
+#include <Protos/files_cache.pb.h>
+
+#include <Common/Hash.h>
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class FileCacheWriter : Common::Uncopyable
+   {
+   public:
+      FileCacheWriter(const QString& filepath);
+      ~FileCacheWriter();
+
+      void beginSharedDir(const Common::Hash& id, const QString& path);
+      void addDir(const Protos::FileCache::DirRecord& record);
+      bool commit(quint64 journalSequence);
+
+      qint64 getSize() const;
+
+      static bool convert(const Protos::FileCache::Hashes& hashes, const QString& filepath);
+
+   private:
+      void addDirs(const Protos::FileCache::Hashes::Dir& dir, QStringList& dirs);
+
+      static const QString TEMP_SUFFIX_TERM;
+
+      const QString filepath;
+      QFile file; ///< The temporary file, renamed by 'commit(..)'.
+      bool error;
+      bool committed;
+      quint64 position; ///< The number of bytes written [B].
+
+      Protos::FileCache::Hashes header;
+   };
+}
@@ -32,6 +32,7 @@ using namespace FM;
 #include <Exceptions.h>
 #include <priv/Cache/Cache.h>
 #include <priv/Cache/File.h>
+#include <priv/Cache/HashingThrottle.h>
 #include <priv/Log.h>
 
 /**
@@ -76,6 +77,9 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
 
    this->hashing = true;
 
+   HashingThrottle& throttle = this->currentFileCache->getCache()->getHashingThrottle();
+   HashingThrottle::IdleIOPriority idleIOPriority(throttle);
+
    const QString& filePath = this->currentFileCache->getFullPath();
 
    L_USER(tr("Computing hashes of %1 . . .").arg(filePath));
@@ -128,8 +132,15 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
       int bytesReadChunk = 0;
       while (bytesReadChunk < Chunk::CHUNK_SIZE)
       {
-         locker.unlock();
-         locker.relock();
+         // The wait is interrupted by 'internalStop()'.
+         const int delay = throttle.getDelay();
+         if (delay > 0)
+            this->throttleWaitCondition.wait(&this->hashingMutex, delay);
+         else
+         {
+            locker.unlock();
+            locker.relock();
+         }
 
          if (this->toStopHashing)
          {
@@ -169,6 +180,7 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
          }
 
          hasher.addData(buffer, bytesRead);
+         throttle.dataHashed(bytesRead);
 
          bytesReadChunk += bytesRead;
       }
@@ -185,7 +197,7 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
 
          if (chunks.size() <= chunkNum) // The size of the file has increased during the read . . .
          {
-            QSharedPointer<Chunk> newChunk(new Chunk(this->currentFileCache, chunkNum, bytesReadChunk, hash));
+            QSharedPointer<Chunk> newChunk = QSharedPointer<Chunk>::create(this->currentFileCache, chunkNum, bytesReadChunk, hash);
             this->currentFileCache->addChunk(newChunk);
             this->currentFileCache->getCache()->onChunkHashKnown(newChunk);
          }
@@ -269,6 +281,7 @@ void FileHasher::internalStop()
    this->toStopHashing = true;
    if (this->hashing)
    {
+      this->throttleWaitCondition.wakeOne();
       L_DEBU(QString("FileHasher::stop(): %1 . . .").arg(this->currentFileCache ? this->currentFileCache->getFullPath() : "?"));
       this->hashingStopped.wait(&this->hashingMutex);
       L_DEBU("File hashing stopped");
@@ -51,6 +51,7 @@ namespace FM
       bool hashing;
       bool toStopHashing;
       QWaitCondition hashingStopped;
+      QWaitCondition throttleWaitCondition; ///< To wait between two reads when the hashing is throttled, see 'HashingThrottle'.
       QMutex hashingMutex;
 
       static FilePool filePool;
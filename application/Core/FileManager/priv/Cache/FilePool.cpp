@@ -29,10 +29,15 @@ using namespace FM;
   * A file pool keeps a list of opened files ('open(..)').
   * After a file becomes released ('release(..)' and 'forceReleaseAll(..)'), it stays in open state during at least 'TIME_KEEP_FILE_OPEN_MIN' and can be reused via a call to 'open(..)'.
   * After the 'TIME_KEEP_FILE_OPEN_MIN' delay, the released file is deleted in the main Qt loop.
+  *
+  * The opened files are indexed by their path and the released ones are kept in a least recently used order: reusing, releasing
+  * and closing a file don't depend on the number of opened files.
+  * If there is more than 'MAX_NB_OPENED_FILES' opened files, the least recently released files are closed without waiting
+  * the 'TIME_KEEP_FILE_OPEN_MIN' delay. The files in use are never closed.
   */
 
-FilePool::FilePool(QObject* parent) :
-   QObject(parent)
+FilePool::FilePool(int maxNbOpenedFiles, QObject* parent) :
+   QObject(parent), MAX_NB_OPENED_FILES(maxNbOpenedFiles), newestReleased(nullptr), oldestReleased(nullptr)
 {
    this->timer.setInterval(TIME_RECHECK_TO_RELEASE);
    connect(&this->timer, &QTimer::timeout, this, &FilePool::tryToDeleteReleasedFiles);
@@ -44,9 +49,15 @@ FilePool::~FilePool()
 
    this->timer.stop();
 
-   for (QMutableListIterator<OpenedFile> i(this->files); i.hasNext();)
-      delete i.next().file;
+   for (QHashIterator<QFile*, OpenedFile*> i(this->files); i.hasNext();)
+   {
+      i.next();
+      delete i.key();
+      delete i.value();
+   }
    this->files.clear();
+   this->filesByPath.clear();
+   this->newestReleased = this->oldestReleased = nullptr;
 }
 
 /**
@@ -63,15 +74,14 @@ QFile* FilePool::open(const QString& path, QIODevice::OpenMode mode, bool* fileC
    if (fileCreated)
       *fileCreated = false;
 
-   for (QMutableListIterator<OpenedFile> i(this->files); i.hasNext();)
+   for (auto i = this->filesByPath.find(path); i != this->filesByPath.end() && i.key() == path; ++i)
    {
-      OpenedFile& file = i.next();
-
-      if (file.file->fileName() == path && file.mode == mode && file.releasedTime.isValid())
+      OpenedFile* openedFile = i.value();
+      if (openedFile->mode == mode && openedFile->releasedTime.isValid())
       {
          L_DEBU(QString("FilePool::open(%1, %2): file already in cache").arg(path).arg(mode));
-         file.releasedTime.invalidate();
-         return file.file;
+         this->removeFromReleased(openedFile);
+         return openedFile->file;
       }
    }
 
@@ -89,7 +99,19 @@ QFile* FilePool::open(const QString& path, QIODevice::OpenMode mode, bool* fileC
    }
 
    L_DEBU(QString("FilePool::open(%1, %2): file added to the cache").arg(path).arg(mode));
-   this->files << OpenedFile { file, mode, QElapsedTimer() };
+   OpenedFile* openedFile = new OpenedFile { file, path, mode, QElapsedTimer(), nullptr, nullptr };
+   this->files.insert(file, openedFile);
+   this->filesByPath.insert(path, openedFile);
+
+   QList<QFile*> filesToDelete;
+   this->closeExceedingFiles(filesToDelete);
+   if (!filesToDelete.isEmpty())
+   {
+      locker.unlock();
+      for (QListIterator<QFile*> i(filesToDelete); i.hasNext();)
+         delete i.next();
+   }
+
    return file;
 }
 
@@ -100,27 +122,34 @@ void FilePool::release(QFile* file, bool forceToClose)
 
    QMutexLocker locker(&this->mutex);
 
-   for (QMutableListIterator<OpenedFile> i(this->files); i.hasNext();)
+   OpenedFile* openedFile = this->files.value(file);
+   if (!openedFile)
+      return;
+
+   if (forceToClose)
    {
-      OpenedFile& openedFile = i.next();
-      if (openedFile.file == file)
-      {
-         if (forceToClose)
-         {
-            L_DEBU(QString("FilePool::release(%1, %2): file forced to close").arg(file->fileName()).arg(forceToClose));
-            QFile* fileToDelete = openedFile.file;
-            i.remove();
-            locker.unlock(); // The 'delete' below can take a while (because of flushing data), we avoid to block the access to the 'FilePool' by unlocking the mutex.
-            delete fileToDelete;
-         }
-         else
-         {
-            openedFile.releasedTime.start();
-            L_DEBU(QString("FilePool::release(%1, %2): file set as released. Timer already started? : %3").arg(file->fileName()).arg(forceToClose).arg(this->timer.isActive()));
-            if (!this->timer.isActive())
-               QMetaObject::invokeMethod(&this->timer, "start");
-         }
+      L_DEBU(QString("FilePool::release(%1, %2): file forced to close").arg(file->fileName()).arg(forceToClose));
+      this->remove(openedFile);
+      locker.unlock(); // The 'delete' below can take a while (because of flushing data), we avoid to block the access to the 'FilePool' by unlocking the mutex.
+      delete file;
+   }
+   else
+   {
+      if (openedFile->releasedTime.isValid()) // Already released.
          return;
+
+      this->addToReleased(openedFile);
+      L_DEBU(QString("FilePool::release(%1, %2): file set as released. Timer already started? : %3").arg(file->fileName()).arg(forceToClose).arg(this->timer.isActive()));
+      if (!this->timer.isActive())
+         QMetaObject::invokeMethod(&this->timer, "start");
+
+      QList<QFile*> filesToDelete;
+      this->closeExceedingFiles(filesToDelete);
+      if (!filesToDelete.isEmpty())
+      {
+         locker.unlock();
+         for (QListIterator<QFile*> i(filesToDelete); i.hasNext();)
+            delete i.next();
       }
    }
 }
@@ -131,15 +160,12 @@ void FilePool::forceReleaseAll(const QString& path)
 
    QList<QFile*> filesToDelete;
 
-   for (QMutableListIterator<OpenedFile> i(this->files); i.hasNext();)
+   for (QListIterator<OpenedFile*> i(this->filesByPath.values(path)); i.hasNext();)
    {
-      OpenedFile& openedFile = i.next();
-      if (openedFile.file->fileName() == path)
-      {
-         L_DEBU(QString("FilePool::forceReleaseAll(%1): file forced to release and close").arg(path));
-         filesToDelete << openedFile.file;
-         i.remove();
-      }
+      OpenedFile* openedFile = i.next();
+      L_DEBU(QString("FilePool::forceReleaseAll(%1): file forced to release and close").arg(path));
+      filesToDelete << openedFile->file;
+      this->remove(openedFile);
    }
 
    if (!filesToDelete.isEmpty())
@@ -150,6 +176,16 @@ void FilePool::forceReleaseAll(const QString& path)
    }
 }
 
+/**
+  * For testing purpose.
+  * @return 'true' if the pool has at least one file opened with the given path, in use or released.
+  */
+bool FilePool::isOpen(const QString& path) const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->filesByPath.contains(path);
+}
+
 void FilePool::tryToDeleteReleasedFiles()
 {
    QMutexLocker locker(&this->mutex);
@@ -158,26 +194,15 @@ void FilePool::tryToDeleteReleasedFiles()
 
    QList<QFile*> filesToDelete;
 
-   bool stopTimer = true;
-   for (QMutableListIterator<OpenedFile> i(this->files); i.hasNext();)
+   // The released files are sorted by release time, we can stop at the first one which must be kept.
+   while (this->oldestReleased && this->oldestReleased->releasedTime.elapsed() > TIME_KEEP_FILE_OPEN_MIN)
    {
-      const OpenedFile& openedFile = i.next();
-      if (openedFile.releasedTime.isValid())
-      {
-         if (openedFile.releasedTime.elapsed() > TIME_KEEP_FILE_OPEN_MIN)
-         {
-            L_DEBU(QString("FilePool::tryToDeleteReleasedFiles(): file closed: %1").arg(openedFile.file->fileName()));
-            filesToDelete << openedFile.file;
-            i.remove();
-         }
-         else
-         {
-            stopTimer = false;
-         }
-      }
+      L_DEBU(QString("FilePool::tryToDeleteReleasedFiles(): file closed: %1").arg(this->oldestReleased->path));
+      filesToDelete << this->oldestReleased->file;
+      this->remove(this->oldestReleased);
    }
 
-   if (stopTimer)
+   if (!this->oldestReleased)
    {
       L_DEBU("FilePool::tryToDeleteReleasedFiles(): timer stopped");
       this->timer.stop();
@@ -190,3 +215,63 @@ void FilePool::tryToDeleteReleasedFiles()
          delete i.next();
    }
 }
+
+/**
+  * Remove the file from the pool, the 'QFile' isn't deleted.
+  */
+void FilePool::remove(OpenedFile* openedFile)
+{
+   if (openedFile->releasedTime.isValid())
+      this->removeFromReleased(openedFile);
+
+   this->files.remove(openedFile->file);
+   this->filesByPath.remove(openedFile->path, openedFile);
+   delete openedFile;
+}
+
+/**
+  * Remove the least recently released files while there is too many opened files.
+  * @param[out] filesToDelete The files to delete once the mutex is unlocked.
+  */
+void FilePool::closeExceedingFiles(QList<QFile*>& filesToDelete)
+{
+   if (this->MAX_NB_OPENED_FILES <= 0)
+      return;
+
+   while (this->files.size() > this->MAX_NB_OPENED_FILES && this->oldestReleased)
+   {
+      L_DEBU(QString("FilePool::closeExceedingFiles(): file closed: %1").arg(this->oldestReleased->path));
+      filesToDelete << this->oldestReleased->file;
+      this->remove(this->oldestReleased);
+   }
+}
+
+void FilePool::addToReleased(OpenedFile* openedFile)
+{
+   openedFile->releasedTime.start();
+
+   openedFile->older = this->newestReleased;
+   openedFile->newer = nullptr;
+   if (this->newestReleased)
+      this->newestReleased->newer = openedFile;
+   else
+      this->oldestReleased = openedFile;
+   this->newestReleased = openedFile;
+}
+
+void FilePool::removeFromReleased(OpenedFile* openedFile)
+{
+   openedFile->releasedTime.invalidate();
+
+   if (openedFile->newer)
+      openedFile->newer->older = openedFile->older;
+   else
+      this->newestReleased = openedFile->older;
+
+   if (openedFile->older)
+      openedFile->older->newer = openedFile->newer;
+   else
+      this->oldestReleased = openedFile->newer;
+
+   openedFile->newer = openedFile->older = nullptr;
+}
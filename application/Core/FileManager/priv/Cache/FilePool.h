@@ -20,6 +20,9 @@
 
 #include <QObject>
 #include <QMutex>
+#include <QHash>
+#include <QMultiHash>
+#include <QList>
 #include <QFile>
 #include <QTime>
 #include <QTimer>
@@ -37,13 +40,15 @@ namespace FM
       static const int TIME_RECHECK_TO_RELEASE = 1000; // [ms].
 
    public:
-      explicit FilePool(QObject* parent = nullptr);
+      explicit FilePool(int maxNbOpenedFiles = 0, QObject* parent = nullptr);
       ~FilePool();
 
       QFile* open(const QString& path, QIODevice::OpenMode mode, bool* fileCreated = nullptr);
       void release(QFile* file, bool forceToClose = false);
       void forceReleaseAll(const QString& path);
 
+      bool isOpen(const QString& path) const;
+
    private slots:
       void tryToDeleteReleasedFiles();
 
@@ -51,12 +56,29 @@ namespace FM
       struct OpenedFile
       {
          QFile* file;
+         QString path;
          QIODevice::OpenMode mode;
          QElapsedTimer releasedTime; // '!isValid()' if not released.
+
+         // The released files are linked from the most recently released ('newestReleased') to the least recently released ('oldestReleased').
+         OpenedFile* newer;
+         OpenedFile* older;
       };
 
-      QList<OpenedFile> files;
-      QMutex mutex;
+      void remove(OpenedFile* openedFile);
+      void closeExceedingFiles(QList<QFile*>& filesToDelete);
+
+      void addToReleased(OpenedFile* openedFile);
+      void removeFromReleased(OpenedFile* openedFile);
+
+      const int MAX_NB_OPENED_FILES; // 0 = unlimited.
+
+      QHash<QFile*, OpenedFile*> files;
+      QMultiHash<QString, OpenedFile*> filesByPath;
+      OpenedFile* newestReleased;
+      OpenedFile* oldestReleased;
+
+      mutable QMutex mutex;
       QTimer timer;
    };
 
@@ -0,0 +1,400 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/HashStore.h>
+using namespace FM;
+
+#include <cstring>
+#include <new>
+#include <limits>
+
+#include <QRandomGenerator64>
+
+#include <priv/Log.h>
+#include <priv/Constants.h>
+
+/**
+  * @class FM::HashStore
+  *
+  * Stores the hash and the number of known bytes of each chunk in fixed size records, a 'Chunk' only keeps the position of its record.
+  *
+  * The records are in a file mapped in memory by segments of 'SEGMENT_SIZE' records, see 'open(..)'. Thus the hashes don't take any
+  * space in the heap, the system only loads the pages which are used and the file cache can reference the records instead of copying
+  * the hashes: at start a file adopts its previous records without reading them, see 'adopt(..)'.
+  * Without file (no data folder or 'open(..)' not called) the segments are allocated in memory.
+  *
+  * A segment is never moved or unmapped thus the content of a record is read and written without lock, like the other members of
+  * a chunk. Only the allocation of the records is protected.
+  *
+  * If the file can't be extended the next segments are allocated in memory, their records aren't counted in the header of the file and
+  * the file cache copies their hashes instead of referencing them, see 'isPersistent(quint32)'.
+  *
+  * The records of a file have its identifier and their chunk number, a reference from the file cache is valid only if they match.
+  * The file isn't explicitly synchronized: after a crash of the system some records may be lost, their file is then hashed again.
+  *
+  * There is one store per process, it's never deleted because some chunks may outlive the file manager.
+  */
+
+const quint32 HashStore::MAGIC(0x53484C44); // "DLHS".
+const quint32 HashStore::SEGMENT_SIZE(65536); // 2 MiB.
+const int HashStore::MAX_NB_SEGMENTS(16384);
+
+HashStore::HashStore() :
+   header(new Header()), segments(new Record*[MAX_NB_SEGMENTS]()), nbSegments(0), nbPersistentSegments(0), nbRecords(0), loading(true)
+{
+   this->header->magic = MAGIC;
+   this->header->version = HASH_STORE_VERSION;
+   this->header->id = QRandomGenerator64::global()->generate64();
+}
+
+/**
+  * Can be called from any thread, the initialization of a local static variable is thread safe.
+  */
+HashStore& HashStore::getInstance()
+{
+   static HashStore* instance = new HashStore();
+   return *instance;
+}
+
+/**
+  * Map the given file, it's created if it doesn't exist or isn't valid.
+  * Must be called before any record is allocated, the following calls are ignored.
+  * @return 'false' if the file can't be used, the records are then kept in memory.
+  */
+bool HashStore::open(const QString& filepath)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (this->file.isOpen())
+      return this->file.fileName() == filepath;
+
+   if (filepath.isEmpty())
+      return false;
+
+   if (this->nbRecords > 0)
+   {
+      L_WARN(QString("The hash store %1 can't be opened, some records are already in memory").arg(filepath));
+      return false;
+   }
+
+   this->file.setFileName(filepath);
+   if (!this->file.open(QIODevice::ReadWrite))
+   {
+      L_ERRO(QString("Unable to open the hash store %1 : %2").arg(filepath).arg(this->file.errorString()));
+      return false;
+   }
+
+   if (!this->mapFile())
+   {
+      this->file.close();
+      return false;
+   }
+
+   return true;
+}
+
+/**
+  * The records are persisted and can be referenced by the file cache.
+  */
+bool HashStore::isPersistent() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->file.isOpen();
+}
+
+/**
+  * The given record is persisted, it's false for the records of the segments allocated in memory when the file can't be extended.
+  */
+bool HashStore::isPersistent(quint32 record) const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->file.isOpen() && record < quint32(this->nbPersistentSegments) * SEGMENT_SIZE;
+}
+
+/**
+  * A file cache referencing the records of another store must ignore these references.
+  */
+quint64 HashStore::getId() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->header->id;
+}
+
+/**
+  * Called by each file manager before loading its file cache: the records without reference, including the ones released by a
+  * previous file manager, may be adopted again until 'endLoading()'.
+  */
+void HashStore::beginLoading()
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->loading = true;
+   this->freeRecords.clear(); // Rebuilt by 'endLoading()'.
+}
+
+/**
+  * Called once the file cache is loaded, the records which haven't been adopted are released.
+  */
+void HashStore::endLoading()
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (!this->loading)
+      return;
+   this->loading = false;
+
+   for (quint32 i = 0; i < this->nbRecords; i++)
+      if (this->nbReferences[i] == 0)
+      {
+         Record* record = this->getRecord(i);
+         if (record->fileId != 0) // To avoid writing all the pages.
+            record->fileId = 0;
+         this->freeRecords << i;
+      }
+
+   L_DEBU(QString("Hash store loaded: %1 records, %2 free").arg(this->nbRecords).arg(this->freeRecords.size()));
+}
+
+/**
+  * Return an identifier for a new file, it's never 0.
+  */
+quint32 HashStore::newFileId()
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (++this->header->lastFileId == 0)
+      ++this->header->lastFileId;
+   return this->header->lastFileId;
+}
+
+/**
+  * @return The position of the new record, it must be released by 'release(..)'.
+  * @exception std::bad_alloc If the maximum number of records is reached.
+  */
+quint32 HashStore::allocate(quint32 fileId, int num, quint32 knownBytes, const Common::Hash& hash)
+{
+   QMutexLocker locker(&this->mutex);
+
+   quint32 index;
+   if (!this->freeRecords.isEmpty())
+   {
+      index = this->freeRecords.takeLast();
+   }
+   else
+   {
+      index = this->nbRecords;
+      if (index == quint32(this->nbSegments) * SEGMENT_SIZE && !this->addSegment())
+         throw std::bad_alloc();
+
+      this->nbRecords++;
+      if (index < quint32(this->nbPersistentSegments) * SEGMENT_SIZE)
+         this->header->nbRecords = this->nbRecords;
+      this->nbReferences << 0;
+   }
+
+   Record* record = this->getRecord(index);
+   memcpy(record->hash, hash.getData(), Common::Hash::HASH_SIZE);
+   record->knownBytes = knownBytes;
+   record->fileId = fileId;
+   record->num = num;
+
+   this->nbReferences[index] = 1;
+   return index;
+}
+
+/**
+  * Reference the given records if they belong to the file 'fileId', the first record must be the chunk 0 and so on.
+  * A record without reference can only be adopted between 'beginLoading()' and 'endLoading()'.
+  * @return 'false' if at least one record doesn't match, in this case none is referenced.
+  */
+bool HashStore::adopt(const QVector<quint32>& records, quint32 fileId)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (fileId == 0)
+      return false;
+
+   for (int i = 0; i < records.size(); i++)
+   {
+      const quint32 index = records[i];
+      if (index >= this->nbRecords || (!this->loading && this->nbReferences[index] == 0))
+         return false;
+
+      const Record* record = this->getRecord(index);
+      if (record->fileId != fileId || record->num != quint32(i))
+         return false;
+   }
+
+   for (QVectorIterator<quint32> i(records); i.hasNext();)
+   {
+      quint16& nbReferences = this->nbReferences[i.next()];
+      if (nbReferences < std::numeric_limits<quint16>::max())
+         nbReferences++;
+   }
+
+   return true;
+}
+
+void HashStore::release(quint32 record)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (record >= this->nbRecords || this->nbReferences[record] == 0 || --this->nbReferences[record] > 0)
+      return;
+
+   // The file identifier is kept: the file cache persisted when a file manager is deleted still references the record and the next
+   // file manager may adopt it. A record which isn't adopted is reset by 'endLoading()', a reused one by 'allocate(..)'.
+
+   // During the loading all the released records are gathered by 'endLoading()'.
+   if (!this->loading)
+      this->freeRecords << record;
+}
+
+Common::Hash HashStore::getHash(quint32 record) const
+{
+   return Common::Hash(this->getRecord(record)->hash);
+}
+
+bool HashStore::hasHash(quint32 record) const
+{
+   return memcmp(this->getRecord(record)->hash, Common::Hash::NULL_HASH, Common::Hash::HASH_SIZE) != 0;
+}
+
+void HashStore::setHash(quint32 record, const Common::Hash& hash)
+{
+   memcpy(this->getRecord(record)->hash, hash.getData(), Common::Hash::HASH_SIZE);
+}
+
+quint32 HashStore::getKnownBytes(quint32 record) const
+{
+   return this->getRecord(record)->knownBytes;
+}
+
+void HashStore::setKnownBytes(quint32 record, quint32 knownBytes)
+{
+   this->getRecord(record)->knownBytes = knownBytes;
+}
+
+quint32 HashStore::getNbRecords() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->nbRecords;
+}
+
+int HashStore::getNbFreeRecords() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->freeRecords.size();
+}
+
+/**
+  * If the file can't be extended the segment and all the next ones are allocated in memory, their records aren't persisted.
+  * 'mutex' must be locked.
+  */
+bool HashStore::addSegment()
+{
+   if (this->nbSegments == MAX_NB_SEGMENTS)
+   {
+      L_ERRO(QString("The hash store is full (%1 records)").arg(this->nbRecords));
+      return false;
+   }
+
+   const qint64 segmentSize = qint64(SEGMENT_SIZE) * sizeof(Record);
+
+   Record* segment = nullptr;
+   if (this->file.isOpen() && this->nbPersistentSegments == this->nbSegments)
+   {
+      const qint64 offset = sizeof(Header) + this->nbSegments * segmentSize;
+      if (this->file.resize(offset + segmentSize))
+         segment = reinterpret_cast<Record*>(this->file.map(offset, segmentSize));
+
+      if (segment)
+         this->nbPersistentSegments++;
+      else
+         L_ERRO(QString("Unable to extend the hash store %1 : %2, the new records are kept in memory").arg(this->file.fileName()).arg(this->file.errorString()));
+   }
+
+   if (!segment)
+      segment = new Record[SEGMENT_SIZE]();
+
+   this->segments[this->nbSegments++] = segment;
+   return true;
+}
+
+/**
+  * Read the header of the file and map its segments, the pages of the records are only read when they are accessed.
+  * 'mutex' must be locked.
+  */
+bool HashStore::mapFile()
+{
+   const qint64 segmentSize = qint64(SEGMENT_SIZE) * sizeof(Record);
+
+   Header header;
+   if (
+      this->file.read(reinterpret_cast<char*>(&header), sizeof(Header)) != sizeof(Header) ||
+      header.magic != MAGIC ||
+      header.version != HASH_STORE_VERSION ||
+      (header.nbRecords + SEGMENT_SIZE - 1) / SEGMENT_SIZE > quint32(MAX_NB_SEGMENTS) ||
+      this->file.size() < qint64(sizeof(Header)) + (header.nbRecords + SEGMENT_SIZE - 1) / SEGMENT_SIZE * segmentSize
+   )
+   {
+      if (this->file.size() > 0)
+         L_WARN(QString("The hash store %1 has an unknown format or is corrupted, it's reset").arg(this->file.fileName()));
+
+      header = *this->header;
+      if (!this->file.resize(0) || this->file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) != sizeof(Header) || !this->file.flush())
+      {
+         L_ERRO(QString("Unable to write the hash store %1 : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+         return false;
+      }
+   }
+
+   uchar* mappedHeader = this->file.map(0, sizeof(Header));
+   if (!mappedHeader)
+   {
+      L_ERRO(QString("Unable to map the hash store %1 : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+      return false;
+   }
+
+   const int nbSegments = (header.nbRecords + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+   for (int i = 0; i < nbSegments; i++)
+   {
+      uchar* segment = this->file.map(sizeof(Header) + i * segmentSize, segmentSize);
+      if (!segment)
+      {
+         L_ERRO(QString("Unable to map the hash store %1 : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+         for (int j = 0; j < i; j++)
+         {
+            this->file.unmap(reinterpret_cast<uchar*>(this->segments[j]));
+            this->segments[j] = nullptr;
+         }
+         this->file.unmap(mappedHeader);
+         return false;
+      }
+      this->segments[i] = reinterpret_cast<Record*>(segment);
+   }
+
+   delete this->header;
+   this->header = reinterpret_cast<Header*>(mappedHeader);
+   this->nbSegments = nbSegments;
+   this->nbPersistentSegments = nbSegments;
+   this->nbRecords = header.nbRecords;
+   this->nbReferences.fill(0, header.nbRecords);
+
+   return true;
+}
@@ -0,0 +1,105 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <QMutex>
+
+#include <Common/Hash.h>
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class HashStore : Common::Uncopyable
+   {
+      static const quint32 MAGIC;
+      static const quint32 SEGMENT_SIZE; ///< The number of records per segment.
+      static const int MAX_NB_SEGMENTS;
+
+      struct Header
+      {
+         quint32 magic;
+         quint32 version;
+         quint64 id; ///< Random, stored in the file cache to check the references to the records.
+         quint32 nbRecords;
+         quint32 lastFileId;
+         quint64 padding; ///< The records are aligned on their size.
+      };
+
+      struct Record
+      {
+         char hash[Common::Hash::HASH_SIZE]; ///< Null if unknown.
+         quint32 knownBytes;
+         quint32 fileId; ///< 0 if the record hasn't been adopted by the last loading.
+         quint32 num; ///< The number of the chunk in its file.
+      };
+
+      HashStore();
+
+   public:
+      static HashStore& getInstance();
+
+      bool open(const QString& filepath);
+      bool isPersistent() const;
+      bool isPersistent(quint32 record) const;
+      quint64 getId() const;
+      void beginLoading();
+      void endLoading();
+
+      quint32 newFileId();
+      quint32 allocate(quint32 fileId, int num, quint32 knownBytes, const Common::Hash& hash = Common::Hash());
+      bool adopt(const QVector<quint32>& records, quint32 fileId);
+      void release(quint32 record);
+
+      Common::Hash getHash(quint32 record) const;
+      bool hasHash(quint32 record) const;
+      void setHash(quint32 record, const Common::Hash& hash);
+
+      quint32 getKnownBytes(quint32 record) const;
+      void setKnownBytes(quint32 record, quint32 knownBytes);
+
+      quint32 getNbRecords() const;
+      int getNbFreeRecords() const;
+
+   private:
+      inline Record* getRecord(quint32 record) const;
+      bool addSegment();
+      bool mapFile();
+
+      QFile file; ///< Not opened if the store is only in memory.
+      Header* header; ///< Mapped from the file or allocated in memory. 'Header::nbRecords' only counts the records of the persistent segments.
+      Record** segments; ///< 'MAX_NB_SEGMENTS' pointers, a segment is never moved once added.
+      int nbSegments;
+      int nbPersistentSegments; ///< The first segments mapped from the file, the following ones are allocated in memory.
+      quint32 nbRecords; ///< All the records, including the ones of the segments allocated in memory.
+
+      bool loading; ///< The records without reference may be adopted between 'beginLoading()' and 'endLoading()'.
+      QVector<quint16> nbReferences; ///< For each record.
+      QVector<quint32> freeRecords;
+
+      mutable QMutex mutex; ///< Protects the allocation of the records, not their content.
+   };
+}
+
+inline FM::HashStore::Record* FM::HashStore::getRecord(quint32 record) const
+{
+   return this->segments[record / SEGMENT_SIZE] + record % SEGMENT_SIZE;
+}
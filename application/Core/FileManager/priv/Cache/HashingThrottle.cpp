@@ -0,0 +1,127 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/HashingThrottle.h>
+using namespace FM;
+
+#if defined(Q_OS_LINUX)
+   #include <unistd.h>
+   #include <sys/syscall.h>
+#endif
+
+#include <Common/Settings.h>
+
+#include <priv/Log.h>
+
+/**
+  * @class FM::HashingThrottle
+  *
+  * Limits the reading rate of the 'FileHasher' to let the disk bandwidth to the uploads.
+  * The rate is limited by the setting 'hashing_max_rate' and by 'hashing_max_rate_when_uploading' as long as
+  * some data are read to be uploaded, see 'dataRead(..)'.
+  *
+  * 'dataHashed(..)' and 'getDelay()' are only called by the hashing thread.
+  */
+
+#if defined(Q_OS_LINUX)
+namespace
+{
+   // See 'linux/ioprio.h', not always available.
+   const int IOPRIO_WHO_PROCESS = 1;
+   const int IOPRIO_CLASS_SHIFT = 13;
+   const int IOPRIO_CLASS_IDLE = 3;
+}
+#endif
+
+HashingThrottle::HashingThrottle() :
+   MAX_RATE(SETTINGS.get<quint32>("hashing_max_rate")),
+   MAX_RATE_WHEN_UPLOADING(SETTINGS.get<quint32>("hashing_max_rate_when_uploading")),
+   IDLE_IO_PRIORITY(SETTINGS.get<bool>("hashing_idle_io_priority")),
+   nextHashing(0)
+{
+   this->timer.start();
+}
+
+/**
+  * Some data of a file have been read to be uploaded, see 'File::read(..)'.
+  */
+void HashingThrottle::dataRead(int bytes)
+{
+   this->uploadRate.addData(bytes);
+}
+
+/**
+  * Some data have been read by the hasher, the next read may be delayed, see 'getDelay()'.
+  */
+void HashingThrottle::dataHashed(int bytes)
+{
+   const quint32 maxRate = this->getMaxRate();
+   if (maxRate == 0)
+      return;
+
+   this->nextHashing = qMax(this->nextHashing, this->timer.nsecsElapsed() - MAX_BURST) + 1000000000LL * bytes / maxRate;
+}
+
+/**
+  * Return the time to wait before reading the next data to hash [ms].
+  */
+int HashingThrottle::getDelay()
+{
+   if (this->getMaxRate() == 0)
+      return 0;
+
+   const qint64 delay = (this->nextHashing - this->timer.nsecsElapsed()) / 1000000;
+   return delay > 0 ? delay : 0;
+}
+
+quint32 HashingThrottle::getMaxRate()
+{
+   if (this->MAX_RATE_WHEN_UPLOADING != 0 && this->uploadRate.getTransferRate() > 0)
+      return this->MAX_RATE == 0 ? this->MAX_RATE_WHEN_UPLOADING : qMin(this->MAX_RATE, this->MAX_RATE_WHEN_UPLOADING);
+   return this->MAX_RATE;
+}
+
+/////
+
+HashingThrottle::IdleIOPriority::IdleIOPriority(const HashingThrottle& throttle) :
+   previousPriority(-1)
+{
+#if defined(Q_OS_LINUX)
+   if (!throttle.IDLE_IO_PRIORITY)
+      return;
+
+   const int priority = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+   if (priority < 0)
+      return;
+
+   if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == 0)
+      this->previousPriority = priority;
+   else
+      L_DEBU("Unable to set the I/O priority of the hashing thread");
+#else
+   Q_UNUSED(throttle);
+#endif
+}
+
+HashingThrottle::IdleIOPriority::~IdleIOPriority()
+{
+#if defined(Q_OS_LINUX)
+   if (this->previousPriority >= 0)
+      syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, this->previousPriority);
+#endif
+}
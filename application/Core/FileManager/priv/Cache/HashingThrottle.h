@@ -0,0 +1,65 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QElapsedTimer>
+
+#include <Common/Uncopyable.h>
+#include <Common/TransferRateCalculator.h>
+
+namespace FM
+{
+   class HashingThrottle : Common::Uncopyable
+   {
+      static const qint64 MAX_BURST = 1000000000; // [ns]. The unused time isn't accumulated beyond this duration.
+
+   public:
+      HashingThrottle();
+
+      void dataRead(int bytes);
+
+      void dataHashed(int bytes);
+      int getDelay();
+
+      /**
+        * Set the I/O scheduling class of the current thread to idle during the lifetime of the object, only on Linux.
+        */
+      class IdleIOPriority : Common::Uncopyable
+      {
+      public:
+         IdleIOPriority(const HashingThrottle& throttle);
+         ~IdleIOPriority();
+
+      private:
+         int previousPriority; ///< -1 if the priority hasn't been changed.
+      };
+
+   private:
+      quint32 getMaxRate();
+
+      const quint32 MAX_RATE; ///< [B/s]. 0 means unlimited.
+      const quint32 MAX_RATE_WHEN_UPLOADING; ///< [B/s]. 0 means unlimited.
+      const bool IDLE_IO_PRIORITY;
+
+      Common::TransferRateCalculator uploadRate;
+
+      QElapsedTimer timer;
+      qint64 nextHashing; ///< [ns]. The time, relative to 'timer', from which the next data can be hashed.
+   };
+}
@@ -130,6 +130,7 @@ void SharedDirectory::moveInto(Directory* directory)
 void SharedDirectory::moveInto(const QString& path)
 {
    this->path = Common::Global::cleanDirPath(path);
+   this->cache->onEntryMoved(this, nullptr);
 }
 
 QString SharedDirectory::getPath() const
@@ -29,6 +29,8 @@ using namespace FM;
   * - Add identical files 'a' and 'b'.
   * - remove 'a'. 'b' wouldn't be remove from Chunks at the same time.
   *
+  * The number of chunks of each hash prefix is kept to answer to the 'IMAlive' messages asking some chunks by their prefix, see 'containsPrefixes(..)'.
+  *
   * We may use a Bloom filter to reduce the time of a call to 'contains(..)', 'value(..)' and 'values(..)'.
   * Some measurements (compiled with GCC 4.6 and -02):
   *  - The filter reduces the call time of 'contains()' from about 20% with 30'000 hashes
@@ -45,7 +47,9 @@ void Chunks::add(const QSharedPointer<Chunk>& chunk)
       return;
 
    QMutexLocker locker(&this->mutex);
-   this->insert(chunk->getHash(), chunk);
+   const Common::Hash& hash = chunk->getHash();
+   this->insert(hash, chunk);
+   this->nbChunksPerPrefix[hash.getPrefix()]++;
 #ifdef BLOOM_FILTER_ON
    this->bloomFilter.add(chunk->getHash());
 #endif
@@ -57,7 +61,14 @@ void Chunks::rm(const QSharedPointer<Chunk>& chunk)
       return;
 
    QMutexLocker locker(&this->mutex);
-   this->remove(chunk->getHash(), chunk);
+   const Common::Hash& hash = chunk->getHash();
+   const int nbRemoved = this->remove(hash, chunk);
+   if (nbRemoved > 0)
+   {
+      auto nbChunks = this->nbChunksPerPrefix.find(hash.getPrefix());
+      if (nbChunks != this->nbChunksPerPrefix.end() && (nbChunks.value() -= nbRemoved) <= 0)
+         this->nbChunksPerPrefix.erase(nbChunks);
+   }
 #ifdef BLOOM_FILTER_ON
    if (this->isEmpty())
       this->bloomFilter.reset();
@@ -103,3 +114,51 @@ bool Chunks::contains(const Common::Hash& hash) const
 #endif
    return QMultiHash<Common::Hash, QSharedPointer<Chunk>>::contains(hash);
 }
+
+/**
+  * Look up all the given hashes with the mutex locked once.
+  * @return A bit set for each known hash or a null 'QBitArray' if none of them is known.
+  */
+QBitArray Chunks::contains(const QList<Common::Hash>& hashes) const
+{
+   QBitArray result(hashes.size());
+   bool atLeastOneKnown = false;
+
+   QMutexLocker locker(&this->mutex);
+   for (int i = 0; i < hashes.size(); i++)
+   {
+      const Common::Hash& hash = hashes[i];
+      if (hash.isNull())
+         continue;
+#ifdef BLOOM_FILTER_ON
+      if (!this->bloomFilter.test(hash))
+         continue;
+#endif
+      if (QMultiHash<Common::Hash, QSharedPointer<Chunk>>::contains(hash))
+      {
+         result.setBit(i);
+         atLeastOneKnown = true;
+      }
+   }
+
+   return atLeastOneKnown ? result : QBitArray();
+}
+
+/**
+  * Same as 'contains(..)' for the prefixes of the hashes.
+  */
+QBitArray Chunks::containsPrefixes(const QList<quint64>& hashPrefixes) const
+{
+   QBitArray result(hashPrefixes.size());
+   bool atLeastOneKnown = false;
+
+   QMutexLocker locker(&this->mutex);
+   for (int i = 0; i < hashPrefixes.size(); i++)
+      if (this->nbChunksPerPrefix.contains(hashPrefixes[i]))
+      {
+         result.setBit(i);
+         atLeastOneKnown = true;
+      }
+
+   return atLeastOneKnown ? result : QBitArray();
+}
@@ -26,6 +26,8 @@
 #include <QHash>
 #include <QSharedPointer>
 #include <QMutex>
+#include <QList>
+#include <QBitArray>
 
 #include <Common/Hash.h>
 #ifdef BLOOM_FILTER_ON
@@ -44,8 +46,12 @@ namespace FM
       QSharedPointer<Chunk> value(const Common::Hash& hash) const;
       QList<QSharedPointer<Chunk>> values(const Common::Hash& hash) const;
       bool contains(const Common::Hash& hash) const;
+      QBitArray contains(const QList<Common::Hash>& hashes) const;
+      QBitArray containsPrefixes(const QList<quint64>& hashPrefixes) const;
 
    private:
+      QHash<quint64, int> nbChunksPerPrefix; ///< See 'Common::Hash::getPrefix()'.
+
       mutable QMutex mutex; // From the documentation : "they (containers) are thread-safe in situations where they are used as read-only containers by all threads used to access them.".
 
 #ifdef BLOOM_FILTER_ON
@@ -23,9 +23,24 @@
 namespace FM
 {
    // 2 -> 3 : BLAKE -> Sha-1
-   const int FILE_CACHE_VERSION = 3;
+   // 3 -> 4 : A sequence of 'DirRecord' instead of a single 'Hashes', see 'FileCacheReader'.
+   const int FILE_CACHE_VERSION = 4;
+   const int FILE_CACHE_LEGACY_VERSION = 3; ///< The last version of the cache written as a single 'Hashes', it's converted at start.
+
+   // The journal of the file cache is compacted when it becomes larger than the cache itself, but not below this size [B].
+   const qint64 MIN_CACHE_JOURNAL_SIZE_TO_COMPACT = 1024 * 1024;
+
+   // Version of the binary format of the index snapshot, see 'IndexSnapshot'.
+   const quint32 INDEX_SNAPSHOT_VERSION = 1;
+
+   // Version of the binary format of the hash store, see 'HashStore'.
+   const quint32 HASH_STORE_VERSION = 1;
 
    // When searching we don't want to send all the hashes of entries
    // because it may take a lot of memory (UDP datagram are very small).
    const int NB_MAX_HASHES_PER_ENTRY_SEARCH = 8;
+
+   // The maximum number of errors tolerated in each searched word. Above this value the search becomes
+   // too expensive and the results meaningless.
+   const int MAX_SEARCH_EDIT_DISTANCE = 2;
 }
@@ -4,11 +4,29 @@
 #include <limits>
 
 #include <QHash>
-#include <QSet>
 #include <QList>
+#include <QVector>
 #include <QString>
 #include <QMutex>
 
+#include <Common/Containers/RoaringBitmap.h>
+
+/**
+  * @class FM::ExtensionIndex
+  *
+  * Index some items by their extension.
+  *
+  * Each item receives a dense identifier (the identifiers of the removed items are reused) and each extension
+  * is associated to the set of identifiers having it as a 'Common::RoaringBitmap'. A subclass can maintain
+  * some other sets of identifiers, see 'itemAdded(..)' and 'itemRemoved(..)', and combine them with the
+  * extensions with some bitmap operations.
+  *
+  * An item has at most one extension, the one of each identifier is kept to remove it from the right bitmap.
+  * An item without extension receives an identifier too but can't be found with 'search(..)'.
+  *
+  * This class is thread safe.
+  */
+
 namespace FM
 {
    template<typename T>
@@ -16,17 +34,40 @@ namespace FM
    {
    public:
       ExtensionIndex();
+      virtual ~ExtensionIndex() {}
 
       void addItem(const QString& extension, const T& item);
-      void rmItem(const QString& extension, const T& item);
-      void changeItem(const QString& oldExtension, const QString& newExtension, const T& item);
+      void rmItem(const T& item);
+      void changeItem(const QString& newExtension, const T& item);
 
       QList<T> search(const QString& extension, int limit = std::numeric_limits<int>::max(), std::function<bool(const T&)> predicat = nullptr) const;
       QList<T> search(const QList<QString>& extensions, int limit = std::numeric_limits<int>::max(), std::function<bool(const T&)> predicat = nullptr) const;
 
-   private:
-      QHash<QString, QSet<T>> index;
+      void forall(std::function<void(const QString&, const QList<T>&)> fun) const;
+
+   protected:
+      Common::RoaringBitmap getBitmap(const QList<QString>& extensions) const;
+      QList<T> getItems(const Common::RoaringBitmap& ids, int limit = std::numeric_limits<int>::max(), std::function<bool(const T&)> predicat = nullptr) const;
+      bool getId(const T& item, quint32& id) const;
+      const T& getItem(quint32 id) const;
+
+      /**
+        * Called when an item receives its identifier and before it's released, 'mutex' is locked.
+        */
+      virtual void itemAdded(quint32 id, const T& item) {}
+      virtual void itemRemoved(quint32 id, const T& item) {}
+
       mutable QMutex mutex;
+
+   private:
+      void setExtension(quint32 id, const QString& extension);
+      void unsetExtension(quint32 id);
+
+      QHash<QString, Common::RoaringBitmap> index; ///< The extensions are in lower case.
+      QHash<T, quint32> ids;
+      QVector<T> items; ///< The item of each identifier.
+      QVector<QString> extensions; ///< The extension of each identifier, it shares the key of 'index'. Empty if none.
+      QVector<quint32> freeIds;
    };
 }
 
@@ -36,40 +77,61 @@ FM::ExtensionIndex<T>::ExtensionIndex() :
 {
 }
 
+/**
+  * If the item is already indexed its extension is replaced.
+  */
 template<typename T>
 void FM::ExtensionIndex<T>::addItem(const QString& extension, const T& item)
 {
-   if (extension.isEmpty())
-      return;
-
    QMutexLocker locker(&this->mutex);
-   QSet<T>& set = this->index[extension.toLower()];
-   set.insert(item);
+
+   quint32 id;
+   if (!this->getId(item, id))
+   {
+      if (this->freeIds.isEmpty())
+      {
+         id = this->items.size();
+         this->items << item;
+         this->extensions << QString();
+      }
+      else
+      {
+         id = this->freeIds.takeLast();
+         this->items[id] = item;
+      }
+      this->ids.insert(item, id);
+      this->itemAdded(id, item);
+   }
+
+   this->setExtension(id, extension);
 }
 
+/**
+  * The identifier of the item is released.
+  */
 template<typename T>
-void FM::ExtensionIndex<T>::rmItem(const QString& extension, const T& item)
+void FM::ExtensionIndex<T>::rmItem(const T& item)
 {
-   if (extension.isEmpty())
+   QMutexLocker locker(&this->mutex);
+
+   auto id = this->ids.find(item);
+   if (id == this->ids.end())
       return;
 
-   QMutexLocker locker(&this->mutex);
+   this->unsetExtension(id.value());
 
-   auto setIterator = this->index.find(extension);
-   if (setIterator != this->index.end())
-   {
-      setIterator->remove(item);
-      if (setIterator->empty())
-         this->index.erase(setIterator);
-   }
+   this->itemRemoved(id.value(), item);
+   this->items[id.value()] = T();
+   this->freeIds << id.value();
+   this->ids.erase(id);
 }
 
+/**
+  * The item keeps its identifier.
+  */
 template<typename T>
-void FM::ExtensionIndex<T>::changeItem(const QString& oldExtension, const QString& newExtension, const T& item)
+void FM::ExtensionIndex<T>::changeItem(const QString& newExtension, const T& item)
 {
-   QMutexLocker locker(&this->mutex);
-
-   this->rmItem(oldExtension, item);
    this->addItem(newExtension, item);
 }
 
@@ -83,31 +145,108 @@ template<typename T>
 QList<T> FM::ExtensionIndex<T>::search(const QList<QString>& extensions, int limit, std::function<bool(const T&)> predicat) const
 {
    QMutexLocker locker(&this->mutex);
+   return this->getItems(this->getBitmap(extensions), limit, predicat);
+}
 
-   QList<T> result;
+/**
+  * Call 'fun' for each extension (in lower case) with the items having it.
+  */
+template<typename T>
+void FM::ExtensionIndex<T>::forall(std::function<void(const QString&, const QList<T>&)> fun) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   for (auto i = this->index.constBegin(); i != this->index.constEnd(); ++i)
+      fun(i.key(), this->getItems(i.value()));
+}
+
+/**
+  * Return the identifiers of the items having one of the given extensions.
+  */
+template<typename T>
+Common::RoaringBitmap FM::ExtensionIndex<T>::getBitmap(const QList<QString>& extensions) const
+{
+   QMutexLocker locker(&this->mutex);
 
+   Common::RoaringBitmap result;
    for (QListIterator<QString> i(extensions); i.hasNext();)
    {
-      const QString& extension = i.next();
-
-      auto setIterator = this->index.find(extension.toLower());
-      if (setIterator != this->index.constEnd())
-      {
-         // Special case to speedup the process.
-         if (extensions.count() == 1 && !predicat && setIterator->count() <= limit)
-            return setIterator->values();
-
-         for (auto j = setIterator->constBegin(); j != setIterator->constEnd(); ++j)
-         {
-            if (!predicat || predicat(*j))
-               result << *j;
-
-            if (result.size() >= limit)
-               goto end;
-         }
-      }
+      auto bitmap = this->index.find(i.next().toLower());
+      if (bitmap != this->index.constEnd())
+         result |= bitmap.value();
    }
+   return result;
+}
+
+template<typename T>
+QList<T> FM::ExtensionIndex<T>::getItems(const Common::RoaringBitmap& ids, int limit, std::function<bool(const T&)> predicat) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   QList<T> result;
+   if (limit <= 0)
+      return result;
+
+   ids.forall([&](quint32 id) {
+      const T& item = this->items[id];
+      if (!predicat || predicat(item))
+         result << item;
+      return result.size() < limit;
+   });
 
-   end:
    return result;
 }
+
+/**
+  * 'mutex' must be locked.
+  */
+template<typename T>
+void FM::ExtensionIndex<T>::setExtension(quint32 id, const QString& extension)
+{
+   this->unsetExtension(id);
+
+   if (extension.isEmpty())
+      return;
+
+   auto bitmap = this->index.find(extension.toLower());
+   if (bitmap == this->index.end())
+      bitmap = this->index.insert(extension.toLower(), Common::RoaringBitmap());
+   bitmap->add(id);
+   this->extensions[id] = bitmap.key();
+}
+
+/**
+  * 'mutex' must be locked.
+  */
+template<typename T>
+void FM::ExtensionIndex<T>::unsetExtension(quint32 id)
+{
+   QString& extension = this->extensions[id];
+   if (extension.isEmpty())
+      return;
+
+   auto bitmap = this->index.find(extension);
+   if (bitmap != this->index.end())
+   {
+      bitmap->remove(id);
+      if (bitmap->isEmpty())
+         this->index.erase(bitmap);
+   }
+   extension.clear();
+}
+
+template<typename T>
+bool FM::ExtensionIndex<T>::getId(const T& item, quint32& id) const
+{
+   auto i = this->ids.find(item);
+   if (i == this->ids.constEnd())
+      return false;
+   id = i.value();
+   return true;
+}
+
+template<typename T>
+const T& FM::ExtensionIndex<T>::getItem(quint32 id) const
+{
+   return this->items[id];
+}
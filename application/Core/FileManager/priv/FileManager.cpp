@@ -27,6 +27,7 @@ using namespace FM;
 #include <QList>
 #include <QVector>
 #include <QDir>
+#include <QFile>
 #include <QMutableListIterator>
 
 #include <google/protobuf/text_format.h>
@@ -49,12 +50,17 @@ using namespace FM;
 #include <priv/Cache/Directory.h>
 #include <priv/Cache/SharedDirectory.h>
 #include <priv/Cache/Chunk.h>
+#include <priv/Cache/FileCacheReader.h>
+#include <priv/Cache/FileCacheWriter.h>
+#include <priv/Cache/HashStore.h>
 
 LOG_INIT_CPP(FileManager)
 
 FileManager::FileManager() :
    fileUpdater(this),
    cache(),
+   substringIndexEnabled(SETTINGS.get<bool>("substring_index")),
+   findResultCache(SETTINGS.get<quint32>("search_result_cache_size")),
    mutexPersistCache(QMutex::Recursive),
    cacheLoading(true),
    cacheChanged(false)
@@ -64,9 +70,13 @@ FileManager::FileManager() :
    connect(&this->cache, &Cache::entryAdded, this, &FileManager::entryAdded, Qt::DirectConnection);
    connect(&this->cache, &Cache::entryRemoved, this, &FileManager::entryRemoved, Qt::DirectConnection);
    connect(&this->cache, &Cache::entryRenamed, this, &FileManager::entryRenamed, Qt::DirectConnection);
+   connect(&this->cache, &Cache::entryMoved, this, &FileManager::entryMoved, Qt::DirectConnection);
    connect(&this->cache, &Cache::chunkHashKnown, this, &FileManager::chunkHashKnown, Qt::DirectConnection);
    connect(&this->cache, &Cache::chunkRemoved, this, &FileManager::chunkRemoved, Qt::DirectConnection);
 
+   connect(&this->cache, &Cache::entryResizing, this, &FileManager::entryResizing, Qt::DirectConnection);
+   connect(&this->cache, &Cache::entryResized, this, &FileManager::entryResized, Qt::DirectConnection);
+
    connect(&this->cache, &Cache::newSharedDirectory, this, &FileManager::newSharedDirectory, Qt::DirectConnection);
    connect(&this->cache, &Cache::sharedDirectoryRemoved, this, &FileManager::sharedDirectoryRemoved, Qt::DirectConnection);
 
@@ -77,6 +87,11 @@ FileManager::FileManager() :
    this->timerPersistCache.setSingleShot(true); // We use a single shot because if the time to save exceeds the property 'save_cache_period' it will cause some trouble (very rare case).
    connect(&this->timerPersistCache, &QTimer::timeout, this, &FileManager::persistCacheToFile);
 
+   this->loadIndexSnapshot();
+   // Must be opened before any chunk is created, the file cache references its records.
+   HashStore::getInstance().open(FileManager::getLocalDataPath(Common::Constants::FILE_HASH_STORE));
+   HashStore::getInstance().beginLoading(); // The store outlives the file manager, a previous one may have ended its loading.
+   this->cacheJournal.setFilepath(FileManager::getLocalDataPath(Common::Constants::FILE_CACHE_JOURNAL));
    this->loadCacheFromFile();
 
    this->fileUpdater.start();
@@ -86,8 +101,10 @@ FileManager::~FileManager()
 {
    L_DEBU("~FileManager : Stopping the file updater . . .");
    this->fileUpdater.stop();
+   this->waitCompaction(); // The changes made during a running compaction are written by the next call.
    this->cacheChanged = true;
-   this->forcePersistCacheToFile();
+   this->forcePersistCacheToFile(true);
+   this->waitCompaction();
    this->timerPersistCache.stop();
    this->cache.disconnect(this);
    L_DEBU("FileManager deleted");
@@ -190,52 +207,121 @@ Protos::Common::Entries FileManager::getEntries()
    return this->cache.getSharedEntries();
 }
 
-QList<Protos::Common::FindResult> FileManager::find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize)
+QList<Protos::Common::FindResult> FileManager::find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize, bool substringMatch, int maxEditDistance)
 {
    bool filterBySizeOn = minFileSize > 0 || maxFileSize != std::numeric_limits<qint64>::max();
    bool filterByExtensionsOn = !extensions.isEmpty();
    bool filterByCategoryOn = category != Protos::Common::FindPattern::FILE_DIR;
    bool filterOn = filterBySizeOn || filterByExtensionsOn || filterByCategoryOn;
 
+   maxEditDistance = qBound(0, maxEditDistance, MAX_SEARCH_EDIT_DISTANCE);
+
+   // The indexes are incomplete while the cache is loading.
+   if (this->cacheLoading)
+   {
+      QSharedPointer<IndexSnapshot> snapshot = this->getIndexSnapshot();
+      if (!snapshot.isNull())
+         return this->findInIndexSnapshot(*snapshot, words, extensions, minFileSize, maxFileSize, category, maxNbResult, maxSize);
+   }
+
+   // The same search is often sent by many peers in a short time.
+   const QString& cacheKey = FindResultCache::key(words, extensions, minFileSize, maxFileSize, category, maxNbResult, maxSize, substringMatch, maxEditDistance);
+   const quint64 cacheGeneration = this->findResultCache.getGeneration();
+   QList<Protos::Common::FindResult> findResults;
+   if (!this->cacheLoading && this->findResultCache.get(cacheKey, findResults))
+      return findResults;
+
    QList<NodeResult<Entry*>> result;
 
+   // The filters are evaluated once for all the entries, then checking a candidate is a single lookup.
+   const Common::RoaringBitmap filter = filterOn ? this->filterIndex.filter(extensions, minFileSize, maxFileSize, category) : Common::RoaringBitmap();
+   auto predicat = [&](Entry* entry) { return this->filterIndex.matches(filter, entry); };
+
    if (!words.isEmpty())
    {
-      result = !filterOn ?
-         this->wordIndex.search(Common::StringUtils::splitInWords(words), maxNbResult) :
-         this->wordIndex.search(Common::StringUtils::splitInWords(words), maxNbResult, [&](const Entry* entry) {
-            return (!filterBySizeOn || entry->getSize() >= minFileSize && entry->getSize() <= maxFileSize) &&
-                   (!filterByExtensionsOn || extensions.contains(entry->getExtension())) &&
-                   (!filterByCategoryOn || (category == Protos::Common::FindPattern::FILE && dynamic_cast<const File*>(entry) || category == Protos::Common::FindPattern::DIR && dynamic_cast<const Directory*>(entry)));
-         });
+      const QStringList& terms = Common::StringUtils::splitInWords(words);
+
+      // The substring search needs at least one term long enough to be looked up in the trigram index.
+      if (substringMatch && this->substringIndexEnabled && TrigramIndex<Entry*>::isSearchable(terms))
+         result = !filterOn ? this->trigramIndex.search(terms, maxNbResult) : this->trigramIndex.search(terms, maxNbResult, predicat);
+      else
+         result = !filterOn ? this->wordIndex.search(terms, maxNbResult, nullptr, maxEditDistance) : this->wordIndex.search(terms, maxNbResult, predicat, maxEditDistance);
    }
    else if (filterBySizeOn || filterByExtensionsOn)
    {
       QList<Entry*> intermediateResult;
 
-      if (!extensions.isEmpty())
-      {
-         if (filterBySizeOn || filterByCategoryOn)
-            intermediateResult = this->extensionIndex.search(extensions, maxNbResult, [&](const Entry* entry) {
-               return (!filterBySizeOn || entry->getSize() >= minFileSize && entry->getSize() <= maxFileSize) && (!filterByCategoryOn || (category == Protos::Common::FindPattern::FILE && dynamic_cast<const File*>(entry) || category == Protos::Common::FindPattern::DIR && dynamic_cast<const Directory*>(entry)));
-            });
-         else
-            intermediateResult = this->extensionIndex.search(extensions, maxNbResult);
-      }
+      // Without extension the entries are taken from the size index to have them sorted by size.
+      if (filterByExtensionsOn)
+         intermediateResult = this->filterIndex.search(filter, maxNbResult);
+      else if (filterByCategoryOn)
+         intermediateResult = this->sizeIndex.search(minFileSize, maxFileSize, maxNbResult, predicat);
       else
-      {
-         if (filterByCategoryOn)
-            intermediateResult = this->sizeIndex.search(minFileSize, maxFileSize, maxNbResult, [&](const Entry* entry) {
-               return category == Protos::Common::FindPattern::FILE && dynamic_cast<const File*>(entry) || category == Protos::Common::FindPattern::DIR && dynamic_cast<const Directory*>(entry);
-            });
-         else
-            intermediateResult = this->sizeIndex.search(minFileSize, maxFileSize, maxNbResult);
-      }
+         intermediateResult = this->sizeIndex.search(minFileSize, maxFileSize, maxNbResult);
 
       for (QListIterator<Entry*> i(intermediateResult); i.hasNext();)
          result << NodeResult<Entry*>(i.next());
    }
 
+   findResults = FileManager::splitInFindResults<Entry*>(result, maxSize, [](Entry* const& entry, Protos::Common::Entry* protoEntry) {
+      File* file = dynamic_cast<File*>(entry);
+      if (file)
+         file->populateEntry(protoEntry, true, NB_MAX_HASHES_PER_ENTRY_SEARCH);
+      else
+         entry->populateEntry(protoEntry, true);
+   });
+
+   if (!this->cacheLoading)
+      this->findResultCache.insert(cacheKey, findResults, cacheGeneration);
+
+   return findResults;
+}
+
+/**
+  * Same as 'find(..)' but uses the given snapshot instead of the indexes. The entries which don't belong
+  * to a current shared directory are ignored.
+  */
+QList<Protos::Common::FindResult> FileManager::findInIndexSnapshot(const IndexSnapshot& snapshot, const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize)
+{
+   bool filterBySizeOn = minFileSize > 0 || maxFileSize != std::numeric_limits<qint64>::max();
+   bool filterByExtensionsOn = !extensions.isEmpty();
+   bool filterByCategoryOn = category != Protos::Common::FindPattern::FILE_DIR;
+
+   QSet<Common::Hash> sharedDirIds;
+   for (QListIterator<Common::SharedDir> i(this->cache.getSharedDirs()); i.hasNext();)
+      sharedDirIds.insert(i.next().ID);
+
+   auto predicat = [&](const quint32& entry) {
+      return sharedDirIds.contains(snapshot.getSharedDirId(entry)) &&
+             (!filterBySizeOn || snapshot.getSize(entry) >= minFileSize && snapshot.getSize(entry) <= maxFileSize) &&
+             (!filterByExtensionsOn || extensions.contains(snapshot.getExtension(entry))) &&
+             (!filterByCategoryOn || (category == Protos::Common::FindPattern::DIR) == snapshot.isDirectory(entry));
+   };
+
+   QList<NodeResult<quint32>> result;
+
+   if (!words.isEmpty())
+   {
+      result = snapshot.search(Common::StringUtils::splitInWords(words), maxNbResult, predicat);
+   }
+   else if (filterBySizeOn || filterByExtensionsOn)
+   {
+      const QList<quint32>& intermediateResult = filterByExtensionsOn ? snapshot.searchByExtensions(extensions, maxNbResult, predicat) : snapshot.searchBySize(minFileSize, maxFileSize, maxNbResult, predicat);
+      for (QListIterator<quint32> i(intermediateResult); i.hasNext();)
+         result << NodeResult<quint32>(i.next());
+   }
+
+   return FileManager::splitInFindResults<quint32>(result, maxSize, [&](const quint32& entry, Protos::Common::Entry* protoEntry) {
+      snapshot.populateEntry(entry, protoEntry);
+   });
+}
+
+/**
+  * Put the found entries into some 'FindResult' messages, each of them not being bigger than 'maxSize'.
+  */
+template<typename T>
+QList<Protos::Common::FindResult> FileManager::splitInFindResults(const QList<NodeResult<T>>& result, int maxSize, std::function<void(const T&, Protos::Common::Entry*)> populateEntry)
+{
    QList<Protos::Common::FindResult> findResults;
    findResults << Protos::Common::FindResult();
    findResults.last().set_tag(std::numeric_limits<quint64>::max()); // Worst case to compute the size (int fields have a variable size).
@@ -243,17 +329,12 @@ QList<Protos::Common::FindResult> FileManager::find(const QString& words, const
    const int EMPTY_FIND_RESULT_SIZE = findResults.last().ByteSizeLong();
    int findResultCurrentSize = EMPTY_FIND_RESULT_SIZE; // [Byte].
 
-   for (QListIterator<NodeResult<Entry*>> i(result); i.hasNext();)
+   for (auto i = result.constBegin(); i != result.constEnd(); ++i)
    {
-      const NodeResult<Entry*>& entry = i.next();
       Protos::Common::FindResult::EntryLevel* entryLevel = findResults.last().add_entry();
-      entryLevel->set_level(entry.level);
+      entryLevel->set_level(i->level);
 
-      File* file = dynamic_cast<File*>(entry.value);
-      if (file)
-         file->populateEntry(entryLevel->mutable_entry(), true, NB_MAX_HASHES_PER_ENTRY_SEARCH);
-      else
-         entry.value->populateEntry(entryLevel->mutable_entry(), true);
+      populateEntry(i->value, entryLevel->mutable_entry());
 
       // We wouldn't use 'findResults.last().ByteSize()' because is too slow. Instead we call 'ByteSize()' for each entry and sum it.
       const int entryByteSize = entryLevel->ByteSizeLong() + 8; // Each entry take a bit of memory overhead . . . (Value found in an empiric way . . .).
@@ -280,19 +361,12 @@ QList<Protos::Common::FindResult> FileManager::find(const QString& words, const
 
 QBitArray FileManager::haveChunks(const QList<Common::Hash>& hashes)
 {
-   QBitArray result(hashes.size()); // All bits to 0 by default.
-   bool ownsAtLeastOneChunk = false;
-   for (int i = 0; i < hashes.size(); i++)
-      if (this->chunks.contains(hashes[i]))
-      {
-         result.setBit(i, true);
-         ownsAtLeastOneChunk = true;
-      }
-
-   if (!ownsAtLeastOneChunk)
-      return QBitArray();
+   return this->chunks.contains(hashes);
+}
 
-   return result;
+QBitArray FileManager::haveChunks(const QList<quint64>& hashPrefixes)
+{
+   return this->chunks.containsPrefixes(hashPrefixes);
 }
 
 quint64 FileManager::getAmount()
@@ -322,6 +396,9 @@ int FileManager::getProgress() const
 void FileManager::dumpWordIndex() const
 {
    L_WARN(this->wordIndex.toStringLog());
+   if (this->substringIndexEnabled)
+      L_WARN(this->trigramIndex.toStringLog());
+   L_WARN(this->findResultCache.toStringLog());
 }
 
 /**
@@ -379,12 +456,14 @@ Entry* FileManager::getEntry(const QString& path)
 void FileManager::newSharedDirectory(SharedDirectory* sharedDir)
 {
    this->fileUpdater.addRoot(sharedDir);
+   this->cacheJournal.setCompactionNeeded();
    this->forcePersistCacheToFile();
 }
 
 void FileManager::sharedDirectoryRemoved(SharedDirectory* sharedDir, Directory* dir)
 {
    this->fileUpdater.rmRoot(sharedDir, dir);
+   this->cacheJournal.setCompactionNeeded();
    this->forcePersistCacheToFile();
 }
 
@@ -399,10 +478,14 @@ void FileManager::entryAdded(Entry* entry)
       return;
 
    L_DEBU(QString("Adding entry '%1' to the index . . .").arg(entry->getName()));
-   this->wordIndex.addItem(Common::StringUtils::splitInWords(entry->getNameWithoutExtension()), entry);
-   this->extensionIndex.addItem(entry->getExtension(), entry);
+   const QStringList& words = Common::StringUtils::splitInWords(entry->getNameWithoutExtension());
+   this->wordIndex.addItem(words, entry);
+   if (this->substringIndexEnabled)
+      this->trigramIndex.addItem(words, entry);
+   this->filterIndex.addItem(entry);
    if (!this->cacheLoading)
       this->sizeIndex.addItem(entry);
+   this->findResultCache.invalidate();
    L_DEBU("Entry added to the index");
 }
 
@@ -414,27 +497,62 @@ void FileManager::entryRemoved(Entry* entry)
    L_DEBU(QString("Removing entry '%1' from the index . . .").arg(entry->getName()));
    if (!this->wordIndex.rmItem(Common::StringUtils::splitInWords(entry->getName()), entry))
       L_DEBU(QString("The entry '%1' hasn't been found in the index!").arg(entry->getName()));
-   this->extensionIndex.rmItem(entry->getExtension(), entry);
+   if (this->substringIndexEnabled)
+      this->trigramIndex.rmItem(entry);
+   this->filterIndex.rmItem(entry);
    this->sizeIndex.rmItem(entry);
+   this->findResultCache.invalidate();
    L_DEBU("Entry removed from the index");
+
+   // During the loading the journal is already included in the cache.
+   if (!this->cacheLoading)
+   {
+      this->cacheJournal.entryRemoved(entry);
+      this->setCacheChanged();
+   }
 }
 
 void FileManager::entryRenamed(Entry* entry, const QString& oldName)
 {
    L_DEBU(QString("Renaming entry '%1' to '%2' in the index . . .").arg(entry->getName()).arg(oldName));
    this->wordIndex.renameItem(Common::StringUtils::splitInWords(oldName), Common::StringUtils::splitInWords(entry->getName()), entry);
-   this->extensionIndex.changeItem(Common::KnownExtensions::getExtension(oldName), entry->getExtension(), entry);
+   if (this->substringIndexEnabled)
+      this->trigramIndex.renameItem(Common::StringUtils::splitInWords(entry->getNameWithoutExtension()), entry);
+   this->filterIndex.renameItem(entry);
+   this->findResultCache.invalidate();
    L_DEBU("Entry renamed in the index");
+
+   if (!this->cacheLoading)
+   {
+      this->cacheJournal.entryRenamed(entry, oldName);
+      this->setCacheChanged();
+   }
+}
+
+void FileManager::entryMoved(Entry* entry, Directory* oldDirectory)
+{
+   if (!this->cacheLoading)
+   {
+      this->cacheJournal.entryMoved(entry, oldDirectory);
+      this->setCacheChanged();
+   }
 }
 
+/**
+  * The size index is only built once the cache is loaded, see 'fileCacheLoadingComplete()'.
+  */
 void FileManager::entryResizing(Entry* entry)
 {
-   this->sizeIndex.rmItem(entry);
+   if (!this->cacheLoading)
+      this->sizeIndex.rmItem(entry);
 }
 
 void FileManager::entryResized(Entry* entry, qint64 oldSize)
 {
-   this->sizeIndex.addItem(entry);
+   this->filterIndex.resizeItem(entry);
+   if (!this->cacheLoading)
+      this->sizeIndex.addItem(entry);
+   this->findResultCache.invalidate();
 }
 
 void FileManager::chunkHashKnown(const QSharedPointer<Chunk>& chunk)
@@ -442,6 +560,13 @@ void FileManager::chunkHashKnown(const QSharedPointer<Chunk>& chunk)
    L_DEBU(QString("Adding chunk '%1' to the index . . .").arg(chunk->getHash().toStr()));
    this->chunks.add(chunk);
    L_DEBU("Chunk added to the index");
+   if (chunk->getNum() < NB_MAX_HASHES_PER_ENTRY_SEARCH) // Only the first hashes are sent with the search results.
+      this->findResultCache.invalidate();
+
+   // During the loading the hashes are restored from the cache.
+   File* file = chunk->getFile();
+   if (file && !this->cacheLoading)
+      this->cacheJournal.fileChanged(file);
    this->setCacheChanged();
 }
 
@@ -450,6 +575,12 @@ void FileManager::chunkRemoved(const QSharedPointer<Chunk>& chunk)
    L_DEBU(QString("Removing chunk '%1' from the index . . .").arg(chunk->getHash().toStr()));
    this->chunks.rm(chunk);
    L_DEBU("Chunk removed from the index");
+   if (chunk->getNum() < NB_MAX_HASHES_PER_ENTRY_SEARCH)
+      this->findResultCache.invalidate();
+
+   File* file = chunk->getFile();
+   if (file && !this->cacheLoading)
+      this->cacheJournal.fileChanged(file);
    this->setCacheChanged();
 }
 
@@ -458,27 +589,40 @@ void FileManager::chunkRemoved(const QSharedPointer<Chunk>& chunk)
   * It will give the file cache to the fileUpdater and ask it
   * to load the cache.
   * It will also start the timer to persist the cache.
+  * Only the header of the file cache is read here, the directories are read one by one by the fileUpdater.
   */
 void FileManager::loadCacheFromFile()
 {
-   // This hashes will be unallocated by the fileUpdater.
-   Protos::FileCache::Hashes* savedCache = new Protos::FileCache::Hashes();
+   const QString path = FileManager::getLocalDataPath(Common::Constants::FILE_CACHE);
+   if (!path.isNull() && !QFile::exists(path))
+      this->convertLegacyCache(path);
 
-   try
+   // This reader will be unallocated by the fileUpdater.
+   FileCacheReader* savedCache = new FileCacheReader(path);
+
+   if (!savedCache->open())
    {
-      Common::PersistentData::getValue(Common::Constants::FILE_CACHE, *savedCache, Common::Global::DataFolderType::LOCAL);
-      if (static_cast<int>(savedCache->version()) != FILE_CACHE_VERSION)
-      {
-         L_ERRO(QString("The version (%1) of the file cache \"%2\" doesn't match the current version (%3)").arg(savedCache->version()).arg(Common::Constants::FILE_CACHE).arg(FILE_CACHE_VERSION));
-         Common::PersistentData::rmValue(Common::Constants::FILE_CACHE, Common::Global::DataFolderType::LOCAL);
-         delete savedCache;
-         return;
-      }
+      L_WARN(QString("The persisted file cache cannot be retrived (the file doesn't exist or is corrupted) : %1").arg(Common::Constants::FILE_CACHE));
+      this->cacheJournal.clear(); // The journal is useless without the cache.
+   }
+   else if (static_cast<int>(savedCache->getHeader().version()) != FILE_CACHE_VERSION)
+   {
+      L_ERRO(QString("The version (%1) of the file cache \"%2\" doesn't match the current version (%3)").arg(savedCache->getHeader().version()).arg(Common::Constants::FILE_CACHE).arg(FILE_CACHE_VERSION));
+      delete savedCache;
+      Common::PersistentData::rmValue(Common::Constants::FILE_CACHE, Common::Global::DataFolderType::LOCAL);
+      this->cacheJournal.clear();
+      return;
+   }
+   else
+   {
+      const quint64 nbRecords = this->cacheJournal.load(savedCache->getHeader().journal_sequence(), savedCache->getSize());
+      if (nbRecords > 0)
+         L_DEBU(QString("%1 record(s) of the file cache journal loaded").arg(nbRecords));
 
       // Scan the shared directories and try to match the files against the saved cache.
       try
       {
-         this->cache.createSharedDirs(*savedCache);
+         this->cache.createSharedDirs(savedCache->getHeader());
       }
       catch (DirsNotFoundException& e)
       {
@@ -486,63 +630,177 @@ void FileManager::loadCacheFromFile()
             L_WARN(QString("During the file cache loading, this directory hasn't been found : %1").arg(path));
       }
    }
-   catch (Common::UnknownValueException& e)
+
+   this->fileUpdater.setFileCache(savedCache, &this->cacheJournal);
+}
+
+/**
+  * The file cache of the previous versions is a single 'Protos::FileCache::Hashes', it's written once in the current format and removed.
+  */
+void FileManager::convertLegacyCache(const QString& path)
+{
+   Protos::FileCache::Hashes hashes;
+
+   try
+   {
+      Common::PersistentData::getValue(Common::Constants::FILE_CACHE_LEGACY, hashes, Common::Global::DataFolderType::LOCAL);
+   }
+   catch (Common::UnknownValueException&)
    {
-      L_WARN(QString("The persisted file cache cannot be retrived (the file doesn't exist) : %1").arg(Common::Constants::FILE_CACHE));
+      return;
    }
    catch (...)
    {
-      L_WARN(QString("The persisted file cache cannot be retrived (Unkown exception) : %1").arg(Common::Constants::FILE_CACHE));
+      L_WARN(QString("The file cache of the previous version cannot be retrived : %1").arg(Common::Constants::FILE_CACHE_LEGACY));
+      return;
    }
 
-   this->fileUpdater.setFileCache(savedCache);
+   if (static_cast<int>(hashes.version()) == FILE_CACHE_LEGACY_VERSION && FileCacheWriter::convert(hashes, path))
+      L_DEBU(QString("The file cache of the previous version has been converted : %1").arg(Common::Constants::FILE_CACHE_LEGACY));
+   else
+      L_WARN(QString("The file cache of the previous version cannot be converted : %1").arg(Common::Constants::FILE_CACHE_LEGACY));
+
+   Common::PersistentData::rmValue(Common::Constants::FILE_CACHE_LEGACY, Common::Global::DataFolderType::LOCAL);
+}
+
+void FileManager::loadIndexSnapshot()
+{
+   const QString path = FileManager::getLocalDataPath(Common::Constants::FILE_INDEX_SNAPSHOT);
+   if (path.isNull())
+      return;
+
+   QSharedPointer<IndexSnapshot> snapshot = IndexSnapshot::load(path);
+   if (!snapshot.isNull())
+      L_DEBU(QString("Index snapshot loaded, %1 entries").arg(snapshot->getNbEntries()));
+
+   QMutexLocker locker(&this->mutexIndexSnapshot);
+   this->indexSnapshot = snapshot;
+}
+
+/**
+  * Save the current indexes, they will be used by the next session while the cache is loading.
+  * The cache is locked during the writing, the indexed entries can't be deleted.
+  */
+void FileManager::persistIndexSnapshot()
+{
+   const QString path = FileManager::getLocalDataPath(Common::Constants::FILE_INDEX_SNAPSHOT);
+   if (path.isNull())
+      return;
+
+   QMutexLocker locker(&this->cache.getMutex());
+
+   L_DEBU("Persisting the index snapshot . . .");
+   if (IndexSnapshot::write(path, this->wordIndex, this->filterIndex, this->sizeIndex))
+      L_DEBU("Persisting the index snapshot finished");
+}
+
+QSharedPointer<IndexSnapshot> FileManager::getIndexSnapshot() const
+{
+   QMutexLocker locker(&this->mutexIndexSnapshot);
+   return this->indexSnapshot;
+}
+
+/**
+  * @return A null string if the data folder is unavailable.
+  */
+QString FileManager::getLocalDataPath(const QString& name)
+{
+   try
+   {
+      return Common::Global::getDataFolder(Common::Global::DataFolderType::LOCAL) + '/' + name;
+   }
+   catch (Common::Global::UnableToGetFolder& e)
+   {
+      L_ERRO(e.errorMessage);
+      return QString();
+   }
 }
 
 /**
   * Save the cache to a file.
   * Restart the timer at the end of the operation.
   * Called by the fileUpdater when it needs to persist the cache.
+  * The changes are appended to the journal, when a compaction is needed the whole cache is written by 'compactionThread'.
+  * Nothing is persisted while a compaction is running, the changes made meanwhile are kept by the journal until the next call.
+  * @return 'true' if the compaction has been started, the index snapshot is written with it.
   */
-void FileManager::persistCacheToFile()
+bool FileManager::persistCacheToFile()
 {
    QMutexLocker locker(&this->mutexPersistCache);
 
+   bool compacted = false;
+
    QMutexLocker lockerCacheChanged(&this->mutexCacheChanged);
-   if (this->cacheChanged && !this->cacheLoading)
+   if (this->cacheChanged && !this->cacheLoading && !(this->compactionThread && this->compactionThread->isRunning()))
    {
       lockerCacheChanged.unlock();
 
-      L_DEBU("Persisting cache . . .");
-
-      Protos::FileCache::Hashes hashes;
-      this->cache.populateHashes(hashes);
-
-      try
+      // Most of the time only the changes are appended to the journal.
+      if (!this->cacheJournal.isCompactionNeeded() && this->cacheJournal.flush())
       {
-         Common::PersistentData::setValue(Common::Constants::FILE_CACHE, hashes, Common::Global::DataFolderType::LOCAL);
+         L_DEBU(QString("Changes of the cache appended to the journal, journal size: %1").arg(Common::Global::formatByteSize(this->cacheJournal.getSize())));
       }
-      catch (Common::PersistentDataIOException& err)
+      else
       {
-         L_ERRO(err.message);
+         // The previous thread is finished.
+         this->compactionThread.reset(QThread::create([this]() { this->compactCache(); }));
+         this->compactionThread->start(QThread::LowPriority);
+         compacted = true;
       }
 
       lockerCacheChanged.relock();
       this->cacheChanged = false;
-
-      L_DEBU("Persisting cache finished");
    }
 
    this->timerPersistCache.start();
+   return compacted;
+}
+
+/**
+  * Write the whole cache and empty the journal, called in 'compactionThread'.
+  * The cache is locked while it's read, the file manager may still be used.
+  */
+void FileManager::compactCache()
+{
+   L_DEBU("Persisting cache . . .");
+
+   FileCacheWriter writer(FileManager::getLocalDataPath(Common::Constants::FILE_CACHE));
+   const quint64 journalSequence = this->cacheJournal.beginCompaction();
+   this->cache.populateHashes(writer);
+
+   if (writer.commit(journalSequence))
+   {
+      this->cacheJournal.endCompaction(journalSequence, writer.getSize());
+   }
+   else
+   {
+      this->cacheJournal.setCompactionNeeded();
+      this->setCacheChanged();
+   }
+
+   this->persistIndexSnapshot();
+
+   L_DEBU("Persisting cache finished");
 }
 
-void FileManager::forcePersistCacheToFile()
+void FileManager::waitCompaction()
+{
+   if (this->compactionThread)
+      this->compactionThread->wait();
+}
+
+/**
+  * @param withIndexSnapshot Write the index snapshot even if only the journal is appended.
+  */
+void FileManager::forcePersistCacheToFile(bool withIndexSnapshot)
 {
    this->mutexCacheChanged.lock();
    this->cacheChanged = true;
    this->mutexCacheChanged.unlock();
 
    QMutexLocker locker(&this->mutexPersistCache);
-   this->persistCacheToFile();
+   if (!this->persistCacheToFile() && withIndexSnapshot && !this->cacheLoading)
+      this->persistIndexSnapshot();
 }
 
 /**
@@ -558,13 +816,17 @@ void FileManager::fileCacheLoadingComplete()
 {
    this->timerPersistCache.start();
    this->cacheLoading = false;
-
-   connect(&this->cache, &Cache::entryResizing, this, &FileManager::entryResizing, Qt::DirectConnection);
-   connect(&this->cache, &Cache::entryResized, this, &FileManager::entryResized, Qt::DirectConnection);
+   this->cacheJournal.endReplay();
+   HashStore::getInstance().endLoading();
 
    this->cache.forall([&](Entry* entry) {
       this->sizeIndex.addItem(entry);
    });
 
+   // The indexes are now complete.
+   this->mutexIndexSnapshot.lock();
+   this->indexSnapshot.clear();
+   this->mutexIndexSnapshot.unlock();
+
    emit fileCacheLoaded();
 }
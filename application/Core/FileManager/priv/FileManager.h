@@ -19,6 +19,7 @@
 #pragma once
 
 #include <limits>
+#include <functional>
 
 #include <QObject>
 #include <QSharedPointer>
@@ -26,6 +27,8 @@
 #include <QBitArray>
 #include <QMutex>
 #include <QTimer>
+#include <QThread>
+#include <QScopedPointer>
 
 #include <Protos/common.pb.h>
 #include <Protos/core_protocol.pb.h>
@@ -37,10 +40,14 @@
 #include <priv/FileUpdater/FileUpdater.h>
 #include <priv/Cache/Cache.h>
 #include <priv/Cache/Entry.h>
+#include <priv/Cache/CacheJournal.h>
 #include <priv/ChunkIndex/Chunks.h>
 #include <priv/WordIndex/WordIndex.h>
-#include <priv/ExtensionIndex.h>
+#include <priv/WordIndex/TrigramIndex.h>
+#include <priv/FilterIndex.h>
 #include <priv/SizeIndexEntries.h>
+#include <priv/IndexSnapshot.h>
+#include <priv/FindResultCache.h>
 
 namespace FM
 {
@@ -73,8 +80,9 @@ namespace FM
       Protos::Common::Entries getEntries();
 
       inline QList<Protos::Common::FindResult> find(const QString& words, int maxNbResult, int maxSize) { return this->find(words, QList<QString>(), 0, std::numeric_limits<qint64>::max(), Protos::Common::FindPattern::FILE_DIR, maxNbResult, maxSize); }
-      QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize);
+      QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize, bool substringMatch = false, int maxEditDistance = 0);
       QBitArray haveChunks(const QList<Common::Hash>& hashes);
+      QBitArray haveChunks(const QList<quint64>& hashPrefixes);
       quint64 getAmount();
       CacheStatus getCacheStatus() const;
       int getProgress() const;
@@ -92,17 +100,30 @@ namespace FM
       void entryAdded(Entry* entry);
       void entryRemoved(Entry* entry);
       void entryRenamed(Entry* entry, const QString& oldName);
+      void entryMoved(Entry* entry, Directory* oldDirectory);
       void entryResizing(Entry* entry);
       void entryResized(Entry* entry, qint64 oldSize);
       void chunkHashKnown(const QSharedPointer<Chunk>& chunk);
       void chunkRemoved(const QSharedPointer<Chunk>& chunk);
 
    private:
+      QList<Protos::Common::FindResult> findInIndexSnapshot(const IndexSnapshot& snapshot, const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize);
+
+      template<typename T>
+      static QList<Protos::Common::FindResult> splitInFindResults(const QList<NodeResult<T>>& result, int maxSize, std::function<void(const T&, Protos::Common::Entry*)> populateEntry);
+
       void loadCacheFromFile();
+      void convertLegacyCache(const QString& path);
+      void loadIndexSnapshot();
+      void persistIndexSnapshot();
+      void compactCache();
+      void waitCompaction();
+      QSharedPointer<IndexSnapshot> getIndexSnapshot() const;
+      static QString getLocalDataPath(const QString& name);
 
    private slots:
-      void persistCacheToFile();
-      void forcePersistCacheToFile();
+      bool persistCacheToFile();
+      void forcePersistCacheToFile(bool withIndexSnapshot = false);
       void setCacheChanged();
       void fileCacheLoadingComplete();
 
@@ -111,13 +132,21 @@ namespace FM
 
       FileUpdater fileUpdater;
       Cache cache; ///< The files and directories.
+      CacheJournal cacheJournal; ///< The changes of the hashes since the cache has been completely persisted.
       Chunks chunks; ///< The indexed chunks. It contains only completed chunks.
 
       WordIndex<Entry*> wordIndex;
-      ExtensionIndex<Entry*> extensionIndex;
+      TrigramIndex<Entry*> trigramIndex; ///< Only filled if the setting 'substring_index' is enabled.
+      const bool substringIndexEnabled;
+      FilterIndex filterIndex; ///< Extensions, categories and sizes of the entries.
       SizeIndexEntries sizeIndex;
+      FindResultCache findResultCache; ///< Invalidated by any change of the indexes or of the first hashes of a file.
+
+      QSharedPointer<IndexSnapshot> indexSnapshot; ///< The indexes persisted by the previous session, used to answer the searches while the cache is loading.
+      mutable QMutex mutexIndexSnapshot;
 
       QTimer timerPersistCache;
+      QScopedPointer<QThread> compactionThread; ///< Writes the complete cache, see 'compactCache()'.
       QMutex mutexPersistCache;
       QMutex mutexCacheChanged; ///< We use a second mutex (instead of using 'mutexPersistCache') to avoid deadlock created by "File -> chunkHashKnown()" and "persistCacheToFile() -> File".
       bool cacheLoading; ///< Set to 'true' during cache loading. It avoids to persist the cache during loading.
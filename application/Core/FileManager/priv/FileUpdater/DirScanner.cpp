@@ -0,0 +1,197 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/FileUpdater/DirScanner.h>
+using namespace FM;
+
+#if defined(Q_OS_LINUX)
+   #include <dirent.h>
+   #include <fcntl.h>
+   #include <sys/stat.h>
+#else
+   #include <QDir>
+   #include <QFileInfo>
+#endif
+
+#include <QFile>
+
+#include <priv/Log.h>
+
+/**
+  * @class FM::DirScanner
+  *
+  * Lists the content of some directories with a pool of threads, the directories are taken in the order they are added.
+  * On a network storage most of the scanning time is spent waiting the answers of the server, several directories
+  * are then listed at the same time.
+  *
+  * Only the listing is parallel: the listings are taken one by one by the 'FileUpdater' with 'next(..)' which updates
+  * the cache and adds the sub-directories found. Thus the cache is still only modified by the 'FileUpdater' thread.
+  */
+
+DirScanner::DirScanner(int nbThreads) :
+   nbDirsInProgress(0), generation(0), toStop(false)
+{
+   for (int i = 0; i < qMax(1, nbThreads); i++)
+   {
+      Worker* worker = new Worker(*this);
+      worker->start(QThread::LowPriority);
+      this->workers << worker;
+   }
+}
+
+DirScanner::~DirScanner()
+{
+   this->mutex.lock();
+   this->toStop = true;
+   this->dirAvailable.wakeAll();
+   this->mutex.unlock();
+
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+   {
+      Worker* worker = i.next();
+      worker->wait();
+      delete worker;
+   }
+}
+
+/**
+  * Add a directory to list, 'dir' is only given back with its listing, see 'next(..)'.
+  * The path must end with a '/'.
+  */
+void DirScanner::add(const QString& path, Directory* dir)
+{
+   QMutexLocker locker(&this->mutex);
+   this->dirsToList.enqueue(Listing { dir, path, QList<Entry>() });
+   this->dirAvailable.wakeOne();
+}
+
+/**
+  * Wait for the next listing.
+  * @return 'false' if there is no more directory to list.
+  */
+bool DirScanner::next(Listing& listing)
+{
+   QMutexLocker locker(&this->mutex);
+
+   while (this->listings.isEmpty() && (!this->dirsToList.isEmpty() || this->nbDirsInProgress > 0))
+      this->listingAvailable.wait(&this->mutex);
+
+   if (this->listings.isEmpty())
+      return false;
+
+   listing = this->listings.dequeue();
+   return true;
+}
+
+/**
+  * Remove all the directories to list and the listings not yet taken, for example when a scan is aborted.
+  */
+void DirScanner::clear()
+{
+   QMutexLocker locker(&this->mutex);
+   this->dirsToList.clear();
+   this->listings.clear();
+   this->generation++;
+}
+
+/**
+  * Return the directories and the files of the given directory.
+  * Like 'QDir::entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks)' the hidden entries,
+  * the symbolic links and the special files are ignored.
+  * On Linux the entries are read with 'readdir(..)' (one 'getdents64' call for many entries) and only the files are
+  * stated, with 'fstatat(..)' relative to the directory to avoid resolving the whole path for each file. The inodes,
+  * the devices and the nanoseconds of the modification dates are only known on Linux.
+  */
+QList<DirScanner::Entry> DirScanner::list(const QString& path)
+{
+   QList<Entry> entries;
+
+#if defined(Q_OS_LINUX)
+   DIR* dir = opendir(QFile::encodeName(path).constData());
+   if (!dir)
+   {
+      L_DEBU(QString("DirScanner::list(..): unable to open %1").arg(path));
+      return entries;
+   }
+
+   const int fd = dirfd(dir);
+   while (const dirent* dirEntry = readdir(dir))
+   {
+      const char* name = dirEntry->d_name;
+      if (name[0] == '.' || dirEntry->d_type == DT_LNK) // Includes "." and "..".
+         continue;
+
+      if (dirEntry->d_type == DT_DIR)
+      {
+         entries << Entry { QFile::decodeName(name), true, 0, QDateTime(), 0, 0, 0 };
+         continue;
+      }
+
+      struct stat info;
+      if (fstatat(fd, name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+         continue;
+
+      if (S_ISDIR(info.st_mode))
+         entries << Entry { QFile::decodeName(name), true, 0, QDateTime(), 0, 0, 0 };
+      else if (S_ISREG(info.st_mode))
+         entries << Entry {
+            QFile::decodeName(name),
+            false,
+            static_cast<qint64>(info.st_size),
+            QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(info.st_mtim.tv_sec) * 1000 + info.st_mtim.tv_nsec / 1000000),
+            static_cast<quint32>(info.st_mtim.tv_nsec % 1000000),
+            static_cast<quint64>(info.st_dev),
+            static_cast<quint64>(info.st_ino)
+         };
+   }
+
+   closedir(dir);
+#else
+   foreach (QFileInfo entry, QDir(path).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks)) // TODO: Add an option to follow or not symlinks.
+      entries << Entry { entry.fileName(), entry.isDir(), entry.isDir() ? 0 : entry.size(), entry.isDir() ? QDateTime() : entry.lastModified(), 0, 0, 0 };
+#endif
+
+   return entries;
+}
+
+void DirScanner::work()
+{
+   QMutexLocker locker(&this->mutex);
+
+   forever
+   {
+      while (this->dirsToList.isEmpty() && !this->toStop)
+         this->dirAvailable.wait(&this->mutex);
+
+      if (this->toStop)
+         return;
+
+      Listing listing = this->dirsToList.dequeue();
+      const quint64 generation = this->generation;
+      this->nbDirsInProgress++;
+
+      locker.unlock();
+      listing.entries = DirScanner::list(listing.path);
+      locker.relock();
+
+      this->nbDirsInProgress--;
+      if (generation == this->generation)
+         this->listings.enqueue(listing);
+      this->listingAvailable.wakeAll();
+   }
+}
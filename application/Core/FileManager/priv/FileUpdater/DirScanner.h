@@ -0,0 +1,92 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QList>
+#include <QQueue>
+#include <QDateTime>
+
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class Directory;
+
+   class DirScanner : Common::Uncopyable
+   {
+   public:
+      struct Entry
+      {
+         QString name;
+         bool isDir;
+         qint64 size; ///< Only for a file.
+         QDateTime dateLastModified; ///< Only for a file.
+         quint32 nsLastModified; ///< Only for a file. The nanoseconds not included in 'dateLastModified', 0 if unknown.
+         quint64 device; ///< Only for a file, 0 if unknown.
+         quint64 inode; ///< Only for a file, 0 if unknown.
+      };
+
+      struct Listing
+      {
+         Directory* dir;
+         QString path;
+         QList<Entry> entries; ///< Empty if the directory can't be read.
+      };
+
+      DirScanner(int nbThreads);
+      ~DirScanner();
+
+      void add(const QString& path, Directory* dir);
+      bool next(Listing& listing);
+      void clear();
+
+      static QList<Entry> list(const QString& path);
+
+   private:
+      class Worker : public QThread
+      {
+      public:
+         Worker(DirScanner& scanner) : scanner(scanner) {}
+
+      protected:
+         void run() override { this->scanner.work(); }
+
+      private:
+         DirScanner& scanner;
+      };
+
+      void work();
+
+      QList<Worker*> workers;
+
+      QQueue<Listing> dirsToList; ///< Listings without their entries, waiting for a worker.
+      QQueue<Listing> listings; ///< The listings ready to be taken by 'next(..)'.
+      int nbDirsInProgress;
+      quint64 generation; ///< Incremented by 'clear()', a listing started before is dropped.
+      bool toStop;
+
+      QMutex mutex;
+      QWaitCondition dirAvailable;
+      QWaitCondition listingAvailable;
+   };
+}
@@ -20,7 +20,10 @@
 using namespace FM;
 
 #include <QtCore/QtDebug>
+#include <QSet>
+#include <QHash>
 
+#include <priv/Global.h>
 #include <priv/Log.h>
 
 #if defined(Q_OS_WIN32)
@@ -41,6 +44,90 @@ DirWatcher* DirWatcher::getNewWatcher()
 #endif
 }
 
+/**
+  * Merge the events which only lead to a scan ('NEW', 'CONTENT_CHANGED' and 'RESCAN').
+  * When two or more of these events concern the same directory they are replaced by one 'RESCAN' of this directory,
+  * the events concerning a sub-directory of a directory already rescanned are dropped because a scan is recursive.
+  * The merging never crosses a 'MOVE' or a 'DELETED' event because the paths may not designate the same entries before and after.
+  * The 'NEW' and 'CONTENT_CHANGED' events of the unfinished files are dropped, they are written by the downloads and
+  * ignored by 'FileUpdater::processEvents(..)', they must not lead to a rescan of their directory.
+  */
+QList<WatcherEvent> DirWatcher::coalesce(const QList<WatcherEvent>& events)
+{
+   QList<WatcherEvent> result;
+
+   QList<WatcherEvent> run; // The current serie of events leading to a scan.
+   QHash<QString, int> nbEventsByDir;
+
+   auto flush = [&]() {
+      QSet<QString> dirsToRescan;
+      for (QHashIterator<QString, int> i(nbEventsByDir); i.hasNext();)
+      {
+         i.next();
+         if (i.value() > 1)
+            dirsToRescan.insert(i.key());
+      }
+
+      QSet<QString> dirsRescanned;
+      for (QListIterator<WatcherEvent> i(run); i.hasNext();)
+      {
+         const WatcherEvent& event = i.next();
+         const QString& dir = DirWatcher::getEventDir(event);
+
+         bool parentRescanned = false;
+         for (int j = dir.indexOf('/', 1); j != -1 && !parentRescanned; j = dir.indexOf('/', j + 1))
+            parentRescanned = dirsToRescan.contains(dir.left(j));
+
+         if (parentRescanned || dirsRescanned.contains(dir))
+            continue;
+
+         if (dirsToRescan.contains(dir))
+         {
+            dirsRescanned.insert(dir);
+            result << WatcherEvent(WatcherEvent::RESCAN, dir);
+         }
+         else
+            result << event;
+      }
+      run.clear();
+      nbEventsByDir.clear();
+   };
+
+   for (QListIterator<WatcherEvent> i(events); i.hasNext();)
+   {
+      const WatcherEvent& event = i.next();
+      switch (event.type)
+      {
+      case WatcherEvent::NEW:
+      case WatcherEvent::CONTENT_CHANGED:
+      case WatcherEvent::RESCAN:
+         if (event.type != WatcherEvent::RESCAN && Global::isFileUnfinished(event.path1))
+            break;
+         run << event;
+         // A 'RESCAN' counts twice to be always kept as a 'RESCAN'.
+         nbEventsByDir[DirWatcher::getEventDir(event)] += event.type == WatcherEvent::RESCAN ? 2 : 1;
+         break;
+
+      default:
+         flush();
+         result << event;
+      }
+   }
+   flush();
+
+   return result;
+}
+
+/**
+  * Return the directory concerned by an event which leads to a scan.
+  */
+QString DirWatcher::getEventDir(const WatcherEvent& event)
+{
+   if (event.type == WatcherEvent::RESCAN)
+      return event.path1;
+   return event.path1.left(event.path1.lastIndexOf('/'));
+}
+
 WatcherEvent::WatcherEvent() :
    type(WatcherEvent::UNKNOWN)
 {}
@@ -70,6 +157,7 @@ QString WatcherEvent::toStr()
    case NEW: str += "NEW"; break;
    case DELETED: str += "DELETED"; break;
    case CONTENT_CHANGED: str += "CONTENT_CHANGED"; break;
+   case RESCAN: str += "RESCAN"; break;
    case TIMEOUT: str += "TIMEOUT"; break;
    case UNKNOWN: default : str += "UNKNOWN"; break;
    }
@@ -95,6 +95,11 @@ namespace FM
         * @param timeout A timeout in milliseconds. -1 means forever.
         */
       virtual const QList<WatcherEvent> waitEvent(int timeout, QList<WaitCondition*> ws = QList<WaitCondition*>()) = 0;
+
+      static QList<WatcherEvent> coalesce(const QList<WatcherEvent>& events);
+
+   private:
+      static QString getEventDir(const WatcherEvent& event);
    };
 
    /**
@@ -119,6 +124,9 @@ namespace FM
          NEW,
          DELETED,
          CONTENT_CHANGED,
+         // The directory and all its sub-directories may have changed and must be rescanned.
+         // Used when some events are lost (queue overflow) or to replace several events concerning the same directory.
+         RESCAN,
          TIMEOUT,
          UNKNOWN
       };
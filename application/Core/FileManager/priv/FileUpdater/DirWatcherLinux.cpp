@@ -22,12 +22,25 @@ using namespace FM;
 #include <unistd.h>
 
 #include <QMutexLocker>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QSet>
+#include <QElapsedTimer>
+
+#include <Common/Settings.h>
 
 #include <priv/FileUpdater/WaitConditionLinux.h>
 #include <priv/Log.h>
 
 #include <sys/select.h>
 #include <sys/inotify.h>
+#include <sys/fanotify.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
 #include <errno.h>
 
 /**
@@ -35,28 +48,63 @@ using namespace FM;
   * @author Hervé Martinet
   *
   * Implementation of 'DirWatcher' for the linux platform with inotify.
+  *
+  * If the setting 'dir_watcher_fanotify' is enabled the whole file systems of the shared directories are watched with fanotify,
+  * it avoids to add one inotify watch by directory (see '/proc/sys/fs/inotify/max_user_watches'). It requires the CAP_SYS_ADMIN capability
+  * and a file system supporting the file handles, inotify is used when it's not the case.
+  *
+  * After an event the following events are gathered during 'COALESCING_DELAY' then merged, see 'DirWatcher::coalesce(..)'.
+  * When the kernel queue overflows the events are lost, only the directories whose modification time has changed are then rescanned,
+  * see 'recoverFromOverflow(..)'.
   */
 
 const int DirWatcherLinux::EVENT_SIZE = (sizeof (struct inotify_event));
 const size_t DirWatcherLinux::BUF_LEN = (1024 * (EVENT_SIZE + 16));
+const int DirWatcherLinux::MAX_BUFFERED_EVENTS_SIZE = 4 * 1024 * 1024;
 const uint32_t DirWatcherLinux::EVENTS_OBS = IN_MOVE|IN_DELETE|IN_CREATE|IN_CLOSE_WRITE;
 const uint32_t DirWatcherLinux::ROOT_EVENTS_OBS = EVENTS_OBS|IN_MOVE_SELF|IN_DELETE_SELF;
 
 class UnableToWatchException {};
 
-/**ath=/home/gburri/Downloads//Leonard - 35 albums/07 - Y a-t-il un gÃ©nie dans la salle
+namespace
+{
+   bool operator!=(const struct timespec& t1, const struct timespec& t2)
+   {
+      return t1.tv_sec != t2.tv_sec || t1.tv_nsec != t2.tv_nsec;
+   }
+
+   quint64 toFsidKey(const void* fsid)
+   {
+      quint64 key;
+      memcpy(&key, fsid, sizeof(key));
+      return key;
+   }
+}
+
+/**
   * Constructor.
   */
 DirWatcherLinux::DirWatcherLinux() :
-   mutex(QMutex::Recursive)
+   mutex(QMutex::Recursive),
+   COALESCING_DELAY(SETTINGS.get<quint32>("dir_events_coalescing_delay")),
+   fanotifyFileDescriptor(-1),
+   fanotifyMask(0),
+   nextFanotifyCookie(0)
 {
    // Initialize inotify
    this->initialized = true;
-   this->fileDescriptor = inotify_init();
+   this->fileDescriptor = inotify_init1(IN_NONBLOCK);
    if (fileDescriptor < 0) {
       L_WARN(QString("Unable to initialize inotify, DirWatcher not used."));
       this->initialized = false;
    }
+
+   if (this->initialized && SETTINGS.get<bool>("dir_watcher_fanotify"))
+   {
+      this->fanotifyFileDescriptor = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE);
+      if (this->fanotifyFileDescriptor < 0)
+         L_WARN(QString("Unable to initialize fanotify, inotify is used instead: %1").arg(strerror(errno)));
+   }
 }
 
 /**
@@ -69,6 +117,8 @@ DirWatcherLinux::~DirWatcherLinux ()
    for (QMutableListIterator<Dir*> i(rootDirs); i.hasNext();)
    {
       Dir* dir = i.next();
+      if (dir->wd < 0)
+         this->rmFanotifyDir(dir);
       delete dir;
       i.remove();
    }
@@ -77,6 +127,9 @@ DirWatcherLinux::~DirWatcherLinux ()
    if (close(this->fileDescriptor) < 0) {
        L_WARN(QString("DirWatcherLinux::~DirWatcherLinux: Unable to close file descriptor (inotify)."));
    }
+
+   if (this->fanotifyFileDescriptor >= 0 && close(this->fanotifyFileDescriptor) < 0)
+      L_WARN(QString("DirWatcherLinux::~DirWatcherLinux: Unable to close file descriptor (fanotify)."));
 }
 
 /**
@@ -90,7 +143,20 @@ bool DirWatcherLinux::addDir(const QString& path)
 
    try
    {
-      Dir* dir = new Dir(this, nullptr, path);
+      Dir* dir = nullptr;
+      if (this->fanotifyFileDescriptor >= 0)
+      {
+         dir = new Dir(this, nullptr, QDir::cleanPath(path), false);
+         if (!this->addFanotifyDir(dir))
+         {
+            delete dir;
+            dir = nullptr;
+         }
+      }
+
+      if (!dir)
+         dir = new Dir(this, nullptr, path);
+
       rootDirs << dir;
       return true;
    }
@@ -110,8 +176,10 @@ void DirWatcherLinux::rmDir(const QString& path)
    for (QMutableListIterator<Dir*> i(rootDirs); i.hasNext();)
    {
       Dir* dir = i.next();
-      if (dir->name == path)
+      if (dir->name == path || (dir->wd < 0 && dir->name == QDir::cleanPath(path)))
       {
+         if (dir->wd < 0)
+            this->rmFanotifyDir(dir);
          delete dir;
          i.remove();
          break;
@@ -120,20 +188,55 @@ void DirWatcherLinux::rmDir(const QString& path)
 }
 
 /**
-  * Return the full path of the file notified by an inotify event.
+  * Return the full path of the file notified by an event.
   * @param path the full path
   */
-QString DirWatcherLinux::getEventPath(inotify_event* event)
+QString DirWatcherLinux::getEventPath(const Event& event)
 {
    QMutexLocker locker(&this->mutex);
 
-   QString p = this->dirs.value(event->wd)->getFullPath();
-   if (event->len)
-      p.append('/').append(event->name);
+   QString p;
+   if (event.wd < 0)
+      p = event.dirPath;
+   else
+      p = this->dirs.value(event.wd)->getFullPath();
+
+   if (!event.name.isEmpty())
+      p.append('/').append(event.name);
 
    return p;
 }
 
+/**
+  * Return the watched directory where an event occured, 'nullptr' if it isn't watched anymore.
+  */
+DirWatcherLinux::Dir* DirWatcherLinux::getEventDir(const Event& event)
+{
+   if (event.wd < 0)
+      return this->getDir(event.dirPath);
+   return this->dirs.value(event.wd);
+}
+
+/**
+  * Return the directory in the tree index corresponding to the given path or 'nullptr' if there is none.
+  */
+DirWatcherLinux::Dir* DirWatcherLinux::getDir(const QString& path)
+{
+   for (QListIterator<Dir*> i(this->rootDirs); i.hasNext();)
+   {
+      Dir* dir = i.next();
+      const QString& rootPath = QDir::cleanPath(dir->name);
+      if (path != rootPath && !path.startsWith(rootPath + '/'))
+         continue;
+
+      const QStringList& names = path.mid(rootPath.size()).split('/', QString::SkipEmptyParts);
+      for (QStringListIterator j(names); j.hasNext() && dir;)
+         dir = dir->childs.value(j.next());
+      return dir;
+   }
+   return nullptr;
+}
+
 /**
   * @copydoc FM::DirWatcher::nbWatchedDir()
   */
@@ -173,6 +276,13 @@ const QList<WatcherEvent> DirWatcherLinux::waitEvent(int timeout, QList<WaitCond
    FD_SET(this->fileDescriptor, &fds);
    fd_max = this->fileDescriptor;
 
+   // Add the fanotify fd if it is used.
+   if (this->fanotifyFileDescriptor >= 0)
+   {
+      FD_SET(this->fanotifyFileDescriptor, &fds);
+      if (this->fanotifyFileDescriptor > fd_max) fd_max = this->fanotifyFileDescriptor;
+   }
+
    // Add fd for all WaitCondition in fd_set and ajust fd_max if needed.
    for (int i = 0; i < ws.size(); i++)
    {
@@ -215,66 +325,73 @@ const QList<WatcherEvent> DirWatcherLinux::waitEvent(int timeout, QList<WaitCond
       }
    }
 
-   L_DEBU("DirWatcherLinux::waitEvent: exit select by inotify");
+   L_DEBU("DirWatcherLinux::waitEvent: exit select by inotify or fanotify");
 
-   char buf[BUF_LEN];
-   int len = read(this->fileDescriptor, buf, BUF_LEN);
-   if (len < 0)
-   {
-      if (errno == EINTR)
-         // Need to reissue system call.
-         return QList<WatcherEvent>();
-      else
-         L_ERRO(QString("DirWatcherLinux::waitEvent: read inotify event failed."));
-   }
-   else if (!len)
-   {
-      L_ERRO(QString("DirWatcherLinux::waitEvent: BUF_LEN to small?"));
-   }
+   // The events are read without locking, the directories removed in the meantime are ignored below.
+   QByteArray inotifyEvents;
+   QByteArray fanotifyEvents;
+   locker.unlock();
+   this->readEvents(inotifyEvents, fanotifyEvents);
+   locker.relock();
+
+   QList<Event> rawEvents;
+   bool overflow = false;
+   this->parseInotifyEvents(inotifyEvents, rawEvents, overflow);
+   this->parseFanotifyEvents(fanotifyEvents, rawEvents, overflow);
 
    QList<WatcherEvent> events;
-   QList<inotify_event*> movedFromEvents;
+   QList<const Event*> movedFromEvents;
+   QSet<QString> modifiedDirs; // The directories whose content has been modified, their modification time is updated at the end.
 
-   for (int i = 0; i < len;)
+   for (QListIterator<Event> i(rawEvents); i.hasNext();)
    {
-      struct inotify_event* event = (struct inotify_event*)&buf[i];
-      i += EVENT_SIZE + event->len;
+      const Event& event = i.next();
 
-      if (!this->dirs.contains(event->wd))
+      Dir* dir = this->getEventDir(event);
+      if (!dir)
+      {
+         // With fanotify the events are known by path, they can be reported even if the directory isn't in the tree index.
+         if (event.wd < 0 && event.mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE))
+            events << WatcherEvent(event.mask & IN_CLOSE_WRITE ? WatcherEvent::CONTENT_CHANGED : WatcherEvent::NEW, this->getEventPath(event));
          continue;
+      }
+
+      if (event.mask & (IN_MOVE | IN_CREATE | IN_DELETE))
+         modifiedDirs.insert(QDir::cleanPath(dir->getFullPath()));
 
-      if (event->mask & IN_MOVED_FROM)
+      if (event.mask & IN_MOVED_FROM)
       {
          L_DEBU(QString("inotify event: IN_MOVED_FROM (path=%1)").arg(this->getEventPath(event)));
          // Add the event to movedToEvents.
-         movedFromEvents << event;
+         movedFromEvents << &event;
       }
 
-      if (event->mask & IN_MOVED_TO)
+      if (event.mask & IN_MOVED_TO)
       {
          L_DEBU(QString("inotify event: IN_MOVED_TO (path=%1)").arg(this->getEventPath(event)));
          // Check list of IN_MOVED_FROM events.
-         for (QMutableListIterator<inotify_event*> i(movedFromEvents); i.hasNext();)
+         for (QMutableListIterator<const Event*> i(movedFromEvents); i.hasNext();)
          {
-            struct inotify_event *fromEvent = i.next();
-            if (fromEvent->cookie == event->cookie)
+            const Event* fromEvent = i.next();
+            Dir* fromDir = this->getEventDir(*fromEvent);
+            if (fromEvent->cookie == event.cookie && (fromDir || fromEvent->wd < 0))
             {
                // If an IN_MOVES_FROM event is linked, create a MOVE WatcherEvent.
-               events << WatcherEvent(WatcherEvent::MOVE, getEventPath(fromEvent), this->getEventPath(event));
+               events << WatcherEvent(WatcherEvent::MOVE, getEventPath(*fromEvent), this->getEventPath(event));
 
                // If moved object is a directory, apply change to the local directory index
-               if (event->mask & IN_ISDIR)
+               if (event.mask & IN_ISDIR && fromDir)
                {
                   // Retrieve to directory by watch descriptor.
-                  Dir* toDir = this->dirs.value(event->wd);
+                  Dir* toDir = dir;
 
                   // Retrieve moved directory by child map of from directory,
                   // because actually the name hasn't changed.
-                  Dir* movedDir = this->dirs.value(fromEvent->wd)->childs.value(fromEvent->name);
+                  Dir* movedDir = fromDir->childs.value(fromEvent->name);
 
                   // If the name of moved directory has changed, rename it.
-                  if (movedDir && fromEvent->name != event->name)
-                     movedDir->rename(event->name);
+                  if (movedDir && fromEvent->name != event.name)
+                     movedDir->rename(event.name);
 
                   // If the path of moved directory has changed, move it.
                   if (movedDir && toDir && movedDir->parent->getFullPath() != toDir->getFullPath())
@@ -292,60 +409,413 @@ const QList<WatcherEvent> DirWatcherLinux::waitEvent(int timeout, QList<WaitCond
          // the end of the loop, when every IN_MOVED_TO event is processed.
          events << WatcherEvent(WatcherEvent::NEW, this->getEventPath(event));
 
-         if (event->mask & IN_ISDIR)
+         if (event.mask & IN_ISDIR)
             try
             {
-               new Dir(this, this->dirs.value(event->wd), event->name);
+               new Dir(this, dir, event.name);
             }
             catch (UnableToWatchException&) {}
       }
 
       end_moved_to:
 
-      if (event->mask & IN_DELETE)
+      if (event.mask & IN_DELETE)
       {
          L_DEBU(QString("inotify event: IN_DELETE (path=%1)").arg(this->getEventPath(event)));
          events << WatcherEvent(WatcherEvent::DELETED, this->getEventPath(event));
-         if (event->mask & IN_ISDIR)
-            delete this->dirs.value(event->wd)->childs.value(event->name);
+         if (event.mask & IN_ISDIR)
+            delete dir->childs.value(event.name);
       }
 
-      if (event->mask & IN_CREATE)
+      if (event.mask & IN_CREATE)
       {
          L_DEBU(QString("inotify event: IN_CREATE (path=%1)").arg(this->getEventPath(event)));
          events << WatcherEvent(WatcherEvent::NEW, this->getEventPath(event));
-         if (event->mask & IN_ISDIR)
+         if (event.mask & IN_ISDIR)
             try
             {
-               new Dir(this, this->dirs.value(event->wd), event->name);
+               new Dir(this, dir, event.name);
             }
             catch (UnableToWatchException&) {}
       }
 
-      if (event->mask & IN_CLOSE_WRITE)
+      if (event.mask & IN_CLOSE_WRITE)
       {
          L_DEBU(QString("inotify event: IN_CLOSE_WRITE (path=%1)").arg(this->getEventPath(event)));
          events << WatcherEvent(WatcherEvent::CONTENT_CHANGED, this->getEventPath(event));
       }
 
-      if (event->mask & IN_DELETE_SELF || event->mask & IN_MOVE_SELF)
+      if (event.mask & IN_DELETE_SELF || event.mask & IN_MOVE_SELF)
       {
          L_DEBU(QString("inotify event: IN_DELETE_SELF || IN_MOVE_SELF (path=%1)").arg(this->getEventPath(event)));
          // processed only for ROOT directory
          events << WatcherEvent(WatcherEvent::DELETED, this->getEventPath(event));
-         dirs.value(event->wd)->dwl->rmDir(this->getEventPath(event));
+         this->rmDir(dir->name);
       }
    }
 
    // Cause every IN_MOVED_FROM event with a linked IN_MOVED_TO event was removed of
    // the list, it contains only alone IN_MOVED_FROM event.
-   for (QMutableListIterator<struct inotify_event*> i(movedFromEvents); i.hasNext();)
+   for (QMutableListIterator<const Event*> i(movedFromEvents); i.hasNext();)
    {
-      struct inotify_event* e = i.next();
-      events << WatcherEvent(WatcherEvent::DELETED, this->getEventPath(e));
+      const Event* e = i.next();
+      if (this->getEventDir(*e) || e->wd < 0)
+         events << WatcherEvent(WatcherEvent::DELETED, this->getEventPath(*e));
    }
 
-   return events;
+   // A directory moved or deleted in the meantime isn't in the tree index anymore.
+   for (QSetIterator<QString> i(modifiedDirs); i.hasNext();)
+      if (Dir* dir = this->getDir(i.next()))
+         dir->updateModificationTime();
+
+   if (overflow)
+      events << this->recoverFromOverflow(rawEvents);
+
+   return DirWatcher::coalesce(events);
+}
+
+/**
+  * Read all the available events then wait 'COALESCING_DELAY' for the following ones.
+  * Emptying the kernel queues during this delay makes an overflow less likely.
+  */
+void DirWatcherLinux::readEvents(QByteArray& inotifyEvents, QByteArray& fanotifyEvents)
+{
+   QElapsedTimer timer;
+   timer.start();
+
+   char buf[BUF_LEN];
+   forever
+   {
+      int len;
+      while ((len = read(this->fileDescriptor, buf, BUF_LEN)) > 0)
+         inotifyEvents.append(buf, len);
+      if (len < 0 && errno != EAGAIN && errno != EINTR)
+         L_ERRO(QString("DirWatcherLinux::readEvents: read inotify event failed: %1").arg(strerror(errno)));
+
+      if (this->fanotifyFileDescriptor >= 0)
+      {
+         while ((len = read(this->fanotifyFileDescriptor, buf, BUF_LEN)) > 0)
+            fanotifyEvents.append(buf, len);
+         if (len < 0 && errno != EAGAIN && errno != EINTR)
+            L_ERRO(QString("DirWatcherLinux::readEvents: read fanotify event failed: %1").arg(strerror(errno)));
+      }
+
+      const int remainingTime = COALESCING_DELAY - timer.elapsed();
+      if (remainingTime <= 0 || inotifyEvents.size() + fanotifyEvents.size() >= MAX_BUFFERED_EVENTS_SIZE)
+         return;
+
+      fd_set fds;
+      FD_ZERO(&fds);
+      FD_SET(this->fileDescriptor, &fds);
+      if (this->fanotifyFileDescriptor >= 0)
+         FD_SET(this->fanotifyFileDescriptor, &fds);
+
+      struct timeval time;
+      time.tv_sec = remainingTime / 1000;
+      time.tv_usec = (remainingTime % 1000) * 1000;
+      if (select(qMax(this->fileDescriptor, this->fanotifyFileDescriptor) + 1, &fds, NULL, NULL, &time) <= 0)
+         return;
+   }
+}
+
+void DirWatcherLinux::parseInotifyEvents(const QByteArray& buffer, QList<Event>& events, bool& overflow)
+{
+   for (int i = 0; i < buffer.size();)
+   {
+      const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer.constData() + i);
+      i += EVENT_SIZE + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW)
+      {
+         L_WARN("DirWatcherLinux: the inotify queue has overflowed, some events are lost");
+         overflow = true;
+         continue;
+      }
+
+      if (!this->dirs.contains(event->wd))
+         continue;
+
+      Event e { event->wd, QString(), event->len ? QString::fromUtf8(event->name) : QString(), event->mask, event->cookie };
+      events << e;
+   }
+}
+
+/**
+  * Try to watch the file system of the given root directory with fanotify.
+  * @return 'false' if it's not possible, inotify must be used.
+  */
+bool DirWatcherLinux::addFanotifyDir(Dir* dir)
+{
+   const QString path = dir->getFullPath();
+
+   // The paths of the events are resolved without symbolic link, they must match the shared directory path.
+   if (QFileInfo(path).canonicalFilePath() != path)
+      return false;
+
+   const QByteArray& array = path.toUtf8();
+   struct statfs stats;
+   if (statfs(array.constData(), &stats) != 0)
+      return false;
+   const quint64 fsid = toFsidKey(&stats.f_fsid);
+
+   auto filesystem = this->fanotifyFilesystems.find(fsid);
+   if (filesystem == this->fanotifyFilesystems.end())
+   {
+      const int fd = open(array.constData(), O_RDONLY | O_DIRECTORY);
+      if (fd < 0)
+         return false;
+
+      // 'FAN_RENAME' (Linux 5.17) reports the two sides of a move in one event. If it's not available the moves are reported as a deletion and a creation.
+      if (this->fanotifyMask == 0)
+      {
+         const uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_CLOSE_WRITE | FAN_ONDIR;
+#ifdef FAN_RENAME
+         this->fanotifyMask = mask | FAN_RENAME;
+         if (fanotify_mark(this->fanotifyFileDescriptor, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, this->fanotifyMask, fd, nullptr) != 0 && errno == EINVAL)
+#endif
+            this->fanotifyMask = mask | FAN_MOVED_FROM | FAN_MOVED_TO;
+      }
+
+      if (fanotify_mark(this->fanotifyFileDescriptor, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, this->fanotifyMask, fd, nullptr) != 0)
+      {
+         L_WARN(QString("Unable to watch the file system of %1 with fanotify, inotify is used instead: %2").arg(path).arg(strerror(errno)));
+         close(fd);
+         return false;
+      }
+
+      FanotifyFilesystem newFilesystem { fd, QList<Dir*>() };
+      filesystem = this->fanotifyFilesystems.insert(fsid, newFilesystem);
+   }
+
+   filesystem->rootDirs << dir;
+   return true;
+}
+
+/**
+  * The file system is no longer watched if it doesn't contain any other root directory.
+  */
+void DirWatcherLinux::rmFanotifyDir(Dir* dir)
+{
+   for (auto i = this->fanotifyFilesystems.begin(); i != this->fanotifyFilesystems.end(); ++i)
+   {
+      if (!i->rootDirs.removeOne(dir))
+         continue;
+
+      if (i->rootDirs.isEmpty())
+      {
+         if (fanotify_mark(this->fanotifyFileDescriptor, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM, this->fanotifyMask, i->fd, nullptr) != 0)
+            L_WARN(QString("DirWatcherLinux::rmFanotifyDir: Unable to remove a fanotify mark: %1").arg(strerror(errno)));
+         close(i->fd);
+         this->fanotifyFilesystems.erase(i);
+      }
+      return;
+   }
+}
+
+/**
+  * The fanotify events are translated to inotify events, the events outside the root directories are ignored.
+  * The moves are identified by a cookie like inotify does.
+  */
+void DirWatcherLinux::parseFanotifyEvents(const QByteArray& buffer, QList<Event>& events, bool& overflow)
+{
+   QHash<QByteArray, QString> resolvedPaths; // The events of a bulk copy often concern the same directories.
+
+   int len = buffer.size();
+   for (const struct fanotify_event_metadata* metadata = reinterpret_cast<const struct fanotify_event_metadata*>(buffer.constData()); FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len))
+   {
+      if (metadata->fd >= 0)
+         close(metadata->fd);
+
+      if (metadata->mask & FAN_Q_OVERFLOW)
+      {
+         L_WARN("DirWatcherLinux: the fanotify queue has overflowed, some events are lost");
+         overflow = true;
+         continue;
+      }
+
+      uint32_t mask = 0;
+      if (metadata->mask & FAN_CREATE) mask |= IN_CREATE;
+      if (metadata->mask & FAN_DELETE) mask |= IN_DELETE;
+      if (metadata->mask & FAN_MOVED_FROM) mask |= IN_MOVED_FROM;
+      if (metadata->mask & FAN_MOVED_TO) mask |= IN_MOVED_TO;
+      if (metadata->mask & FAN_CLOSE_WRITE) mask |= IN_CLOSE_WRITE;
+      if (metadata->mask & FAN_ONDIR) mask |= IN_ISDIR;
+
+      // Without 'FAN_RENAME' the moves can't be paired, each side has its own cookie.
+      const uint32_t cookie = this->nextFanotifyCookie++;
+
+      const char* info = reinterpret_cast<const char*>(metadata) + metadata->metadata_len;
+      const char* end = reinterpret_cast<const char*>(metadata) + metadata->event_len;
+      for (; info < end; info += reinterpret_cast<const struct fanotify_event_info_header*>(info)->len)
+      {
+         const struct fanotify_event_info_fid* fid = reinterpret_cast<const struct fanotify_event_info_fid*>(info);
+
+         uint32_t infoMask = mask;
+         switch (fid->hdr.info_type)
+         {
+         case FAN_EVENT_INFO_TYPE_DFID_NAME:
+            break;
+#ifdef FAN_RENAME
+         case FAN_EVENT_INFO_TYPE_OLD_DFID_NAME:
+            infoMask |= IN_MOVED_FROM;
+            break;
+         case FAN_EVENT_INFO_TYPE_NEW_DFID_NAME:
+            infoMask |= IN_MOVED_TO;
+            break;
+#endif
+         default:
+            continue;
+         }
+
+         struct file_handle* handle = (struct file_handle*)fid->handle;
+         const QString& dirPath = this->resolveFanotifyPath(toFsidKey(&fid->fsid), handle, resolvedPaths);
+         if (dirPath.isNull())
+            continue;
+         const QString name = QString::fromUtf8(reinterpret_cast<const char*>(handle->f_handle) + handle->handle_bytes);
+
+         const QString& path = dirPath + '/' + name;
+         bool rootDirRemoved = false;
+         for (QListIterator<Dir*> i(this->rootDirs); i.hasNext() && !rootDirRemoved;)
+         {
+            Dir* rootDir = i.next();
+            if (rootDir->wd < 0 && rootDir->name == path && infoMask & (IN_DELETE | IN_MOVED_FROM))
+            {
+               Event e { -1, path, QString(), IN_DELETE_SELF, 0 };
+               events << e;
+               rootDirRemoved = true;
+            }
+         }
+         if (rootDirRemoved)
+            continue;
+
+         // Only the events inside the root directories watched with fanotify are kept.
+         Dir* dir = this->getDir(dirPath);
+         if (dir && dir->wd >= 0)
+            continue;
+         if (!dir)
+         {
+            bool insideARootDir = false;
+            for (QListIterator<Dir*> i(this->rootDirs); i.hasNext() && !insideARootDir;)
+            {
+               Dir* rootDir = i.next();
+               insideARootDir = rootDir->wd < 0 && dirPath.startsWith(rootDir->name + '/');
+            }
+            if (!insideARootDir)
+               continue;
+         }
+
+         Event e { -1, dirPath, name, infoMask, cookie };
+         events << e;
+      }
+   }
+}
+
+/**
+  * Return the current path of the directory designated by the given file handle or a null string if the directory doesn't exist anymore.
+  */
+QString DirWatcherLinux::resolveFanotifyPath(quint64 fsid, void* fileHandle, QHash<QByteArray, QString>& resolvedPaths)
+{
+   struct file_handle* handle = static_cast<struct file_handle*>(fileHandle);
+
+   QByteArray key(reinterpret_cast<const char*>(&fsid), sizeof(fsid));
+   key.append(reinterpret_cast<const char*>(handle), sizeof(struct file_handle) + handle->handle_bytes);
+
+   auto resolvedPath = resolvedPaths.find(key);
+   if (resolvedPath != resolvedPaths.end())
+      return resolvedPath.value();
+
+   QString path;
+   auto filesystem = this->fanotifyFilesystems.find(fsid);
+   if (filesystem != this->fanotifyFilesystems.end())
+   {
+      const int fd = open_by_handle_at(filesystem->fd, handle, O_RDONLY | O_PATH);
+      if (fd >= 0)
+      {
+         char buf[PATH_MAX];
+         const ssize_t len = readlink(QString("/proc/self/fd/%1").arg(fd).toUtf8().constData(), buf, sizeof(buf));
+         if (len > 0)
+            path = QString::fromUtf8(buf, len);
+         close(fd);
+      }
+   }
+
+   resolvedPaths.insert(key, path);
+   return path;
+}
+
+/**
+  * Some events have been lost. The directories whose modification time has changed and the ones concerned by the
+  * remaining events are rescanned, the tree index is updated.
+  * A file modified in place in a directory without other activity can't be detected, it will be by the next scan of its directory.
+  */
+QList<WatcherEvent> DirWatcherLinux::recoverFromOverflow(const QList<Event>& events)
+{
+   QList<WatcherEvent> watcherEvents;
+
+   for (QListIterator<Event> i(events); i.hasNext();)
+   {
+      const Event& event = i.next();
+      if (this->getEventDir(event))
+         watcherEvents << WatcherEvent(WatcherEvent::RESCAN, this->getEventPath(Event { event.wd, event.dirPath, QString(), 0, 0 }));
+   }
+
+   // 'rootDirs' may be modified by 'recoverFromOverflow(..)'.
+   const QList<Dir*> rootDirsCopy = this->rootDirs;
+   for (QListIterator<Dir*> i(rootDirsCopy); i.hasNext();)
+      this->recoverFromOverflow(i.next(), watcherEvents);
+
+   L_DEBU(QString("DirWatcherLinux::recoverFromOverflow: %1 directories to rescan").arg(watcherEvents.size()));
+   return watcherEvents;
+}
+
+void DirWatcherLinux::recoverFromOverflow(Dir* dir, QList<WatcherEvent>& watcherEvents)
+{
+   const QString path = dir->getFullPath();
+
+   if (!QDir(path).exists())
+   {
+      if (dir->parent)
+      {
+         watcherEvents << WatcherEvent(WatcherEvent::RESCAN, dir->parent->getFullPath());
+         delete dir;
+      }
+      else
+      {
+         watcherEvents << WatcherEvent(WatcherEvent::DELETED, path);
+         this->rmDir(dir->name);
+      }
+      return;
+   }
+
+   if (dir->updateModificationTime())
+   {
+      watcherEvents << WatcherEvent(WatcherEvent::RESCAN, path);
+
+      // The sub-directories created or deleted in the meantime.
+      const QStringList& names = QDir(path).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+      for (QStringListIterator i(names); i.hasNext();)
+      {
+         const QString& name = i.next();
+         if (!dir->childs.contains(name))
+            try
+            {
+               new Dir(this, dir, name);
+            }
+            catch (UnableToWatchException&) {}
+      }
+      for (QMutableMapIterator<QString, Dir*> i(dir->childs); i.hasNext();)
+         if (!names.contains(i.next().key()))
+         {
+            Dir* child = i.value();
+            i.remove();
+            child->parent = nullptr;
+            delete child;
+         }
+   }
+
+   const QList<Dir*> childs = dir->childs.values();
+   for (QListIterator<Dir*> i(childs); i.hasNext();)
+      this->recoverFromOverflow(i.next(), watcherEvents);
 }
 
 /**
@@ -361,18 +831,21 @@ const QList<WatcherEvent> DirWatcherLinux::waitEvent(int timeout, QList<WaitCond
   * @param name    the name of the Dir
   * @exception UnableToWatchException
   */
-DirWatcherLinux::Dir::Dir(DirWatcherLinux* dwl, Dir* parent, const QString& name) :
-   dwl(dwl), parent(parent), name(name)
+DirWatcherLinux::Dir::Dir(DirWatcherLinux* dwl, Dir* parent, const QString& name, bool inotify) :
+   dwl(dwl), parent(parent), name(name), wd(-1)
 {
    const QByteArray& array = this->getFullPath().toUtf8();
 
-   this->wd = inotify_add_watch(
-      dwl->fileDescriptor,
-      array.constData(),
-      (this->parent ? EVENTS_OBS : ROOT_EVENTS_OBS)
-   );
+   // The sub-directories of a directory watched by fanotify aren't watched by inotify.
+   const bool useInotify = this->parent ? this->parent->wd >= 0 : inotify;
+   if (useInotify)
+      this->wd = inotify_add_watch(
+         dwl->fileDescriptor,
+         array.constData(),
+         (this->parent ? EVENTS_OBS : ROOT_EVENTS_OBS)
+      );
 
-   if (this->wd < 0)
+   if (useInotify && this->wd < 0)
    {
       switch (errno)
       {
@@ -401,6 +874,10 @@ DirWatcherLinux::Dir::Dir(DirWatcherLinux* dwl, Dir* parent, const QString& name
       throw UnableToWatchException();
    }
 
+   this->mtime.tv_sec = 0;
+   this->mtime.tv_nsec = 0;
+   this->updateModificationTime();
+
    for (QListIterator<QString> i(QDir(this->getFullPath()).entryList(QDir::Dirs | QDir::NoDotAndDotDot)); i.hasNext();)
       try
       {
@@ -414,6 +891,8 @@ DirWatcherLinux::Dir::Dir(DirWatcherLinux* dwl, Dir* parent, const QString& name
             child.value()->parent = nullptr;
             delete child.value();
          }
+         if (this->wd >= 0)
+            inotify_rm_watch(this->dwl->fileDescriptor, this->wd);
          throw;
       }
 
@@ -421,7 +900,8 @@ DirWatcherLinux::Dir::Dir(DirWatcherLinux* dwl, Dir* parent, const QString& name
    if (this->parent)
       this->parent->childs.insert(this->name, this);
 
-   dwl->dirs.insert(this->wd, this);
+   if (this->wd >= 0)
+      dwl->dirs.insert(this->wd, this);
 }
 
 /**
@@ -434,16 +914,16 @@ DirWatcherLinux::Dir::~Dir()
       this->dwl->dirs.remove(this->wd);
       if (inotify_rm_watch(this->dwl->fileDescriptor, this->wd))
          L_WARN(QString("Dir::~Dir: Unable to remove an inotify watcher."));
-   
-      if (this->parent)
-         this->parent->childs.remove(this->name);
+   }
 
-      for (QMapIterator<QString, Dir*> i(this->childs); i.hasNext();)
-      {
-         auto child = i.next();
-         child.value()->parent = nullptr;
-         delete child.value();
-      }
+   if (this->parent)
+      this->parent->childs.remove(this->name);
+
+   for (QMapIterator<QString, Dir*> i(this->childs); i.hasNext();)
+   {
+      auto child = i.next();
+      child.value()->parent = nullptr;
+      delete child.value();
    }
 }
 
@@ -482,3 +962,21 @@ void DirWatcherLinux::Dir::move(Dir* to)
    this->parent = to;
    to->childs.insert(this->name, this);
 }
+
+/**
+  * Read the modification time of the directory, it changes when an entry is created, deleted or renamed.
+  * @return 'true' if it has changed since the last call.
+  */
+bool DirWatcherLinux::Dir::updateModificationTime()
+{
+   struct stat stats;
+   if (stat(this->getFullPath().toUtf8().constData(), &stats) != 0)
+      return false;
+
+   if (stats.st_mtim != this->mtime)
+   {
+      this->mtime = stats.st_mtim;
+      return true;
+   }
+   return false;
+}
@@ -19,12 +19,15 @@
 #pragma once
 
 #include <QMap>
+#include <QHash>
 #include <QList>
+#include <QByteArray>
 #include <QMutex>
 
 #include <priv/FileUpdater/DirWatcher.h>
 
 #include <sys/inotify.h>
+#include <time.h>
 
 namespace FM
 {
@@ -43,33 +46,77 @@ namespace FM
    private:
        static const int EVENT_SIZE; // Size of the event structure, not counting name.
        static const size_t BUF_LEN; // Reasonable guess as to size of 1024 events.
+       static const int MAX_BUFFERED_EVENTS_SIZE; // The events are no more gathered above this size [B].
        static const uint32_t EVENTS_OBS; // Inotify events catched for subdirectories.
        static const uint32_t ROOT_EVENTS_OBS; // Inotify events catched for root directories.
 
        struct Dir
        {
-          Dir(DirWatcherLinux* dwl, Dir* parent, const QString& name);
+          Dir(DirWatcherLinux* dwl, Dir* parent, const QString& name, bool inotify = true);
           ~Dir();
           QString getFullPath();
           void rename(const QString& newName);
           void move(Dir* to);
+          bool updateModificationTime();
 
           DirWatcherLinux* dwl;
           Dir* parent;
           QMap<QString, Dir*> childs;
           QString name;
-          int wd; // Watch descriptor.
+          int wd; // Watch descriptor, -1 if the directory is watched by fanotify.
+          struct timespec mtime; // The last known modification time, used to find the modified directories after an overflow.
+       };
+
+       /**
+         * An event from inotify or fanotify, the fanotify masks are translated to the inotify ones.
+         */
+       struct Event
+       {
+          int wd; // -1 for a fanotify event, in this case 'dirPath' is used.
+          QString dirPath;
+          QString name;
+          uint32_t mask;
+          uint32_t cookie;
+       };
+
+       /**
+         * A file system marked with fanotify.
+         */
+       struct FanotifyFilesystem
+       {
+          int fd; // A directory of the file system, needed to resolve the file handles.
+          QList<Dir*> rootDirs;
        };
 
        QMap<int, Dir*> dirs; // The watched dirs, indexed by watch descriptor.
        QList<Dir*> rootDirs; // The watched root dirs, indexed by full path.
 
        void rmWatcher(int watcher);
-       QString getEventPath(inotify_event *event);
+       QString getEventPath(const Event& event);
+       Dir* getEventDir(const Event& event);
+       Dir* getDir(const QString& path);
+
+       void readEvents(QByteArray& inotifyEvents, QByteArray& fanotifyEvents);
+       void parseInotifyEvents(const QByteArray& buffer, QList<Event>& events, bool& overflow);
+
+       bool addFanotifyDir(Dir* dir);
+       void rmFanotifyDir(Dir* dir);
+       void parseFanotifyEvents(const QByteArray& buffer, QList<Event>& events, bool& overflow);
+       QString resolveFanotifyPath(quint64 fsid, void* fileHandle, QHash<QByteArray, QString>& resolvedPaths);
+
+       QList<WatcherEvent> recoverFromOverflow(const QList<Event>& events);
+       void recoverFromOverflow(Dir* dir, QList<WatcherEvent>& watcherEvents);
 
        QMutex mutex;
 
        bool initialized;
        int fileDescriptor;
+
+       const int COALESCING_DELAY; // [ms].
+
+       int fanotifyFileDescriptor; // -1 if fanotify isn't used.
+       uint64_t fanotifyMask;
+       QHash<quint64, FanotifyFilesystem> fanotifyFilesystems; // Indexed by file system identifier (fsid).
+       uint32_t nextFanotifyCookie;
    };
 }
@@ -24,6 +24,7 @@ using namespace FM;
 #include <QElapsedTimer>
 
 #include <Common/Settings.h>
+#include <Common/ProtoHelper.h>
 
 #include <Exceptions.h>
 #include <priv/Global.h>
@@ -34,6 +35,9 @@ using namespace FM;
 #include <priv/Cache/SharedDirectory.h>
 #include <priv/Cache/Directory.h>
 #include <priv/Cache/File.h>
+#include <priv/Cache/FileCacheReader.h>
+#include <priv/Cache/CacheJournal.h>
+#include <priv/Cache/HashStore.h>
 #include <priv/FileUpdater/WaitCondition.h>
 
 /**
@@ -50,6 +54,7 @@ FileUpdater::FileUpdater(FileManager* fileManager) :
    progress(0),
    mutex(QMutex::Recursive),
    currentScanningDir(nullptr),
+   dirScanner(SETTINGS.get<quint32>("scan_nb_threads")),
    toStopHashing(false),
    remainingSizeToHash(0)
 {
@@ -146,11 +151,12 @@ void FileUpdater::rmRoot(SharedDirectory* dir, Directory* dir2)
   * Set the file cache to retrieve the hashes frome it.
   * Muste be called before starting the fileUpdater.
   * The shared dirs in fileCache must be previously added by 'addRoot(..)'.
-  * This object must unallocated the hashes.
+  * This object must unallocated the file cache.
+  * @param cacheJournal Its loaded records are applied to the directories of the file cache, see 'CacheJournal::load(..)'.
   */
-void FileUpdater::setFileCache(const Protos::FileCache::Hashes* fileCache)
+void FileUpdater::setFileCache(FileCacheReader* fileCache, CacheJournal* cacheJournal)
 {
-   this->fileCacheInformation = new FileCacheInformation(fileCache);
+   this->fileCacheInformation = new FileCacheInformation(fileCache, cacheJournal);
 }
 
 void FileUpdater::prioritizeAFileToHash(File* file)
@@ -225,6 +231,9 @@ void FileUpdater::run()
          this->restoreFromFileCache(static_cast<SharedDirectory*>(dir));
       }
 
+      // Once all the shared directories are restored because a file can be moved from one to another.
+      this->restoreMovedFiles();
+
       delete this->fileCacheInformation;
       this->fileCacheInformation = nullptr;
    }
@@ -434,39 +443,43 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
    this->currentScanningDir = dir;
    this->scanningMutex.unlock();
 
-   QLinkedList<Directory*> dirsToVisit;
-   dirsToVisit << dir;
+   // The directories are listed in parallel by 'dirScanner', the sub-directories found are added to it.
+   this->dirScanner.add(dir->getFullPath(), dir);
 
-   while (!dirsToVisit.isEmpty())
+   DirScanner::Listing listing;
+   while (this->dirScanner.next(listing))
    {
-      Directory* currentDir = dirsToVisit.takeFirst();
+      Directory* currentDir = listing.dir;
 
       QLinkedList<Directory*> currentSubDirs = currentDir->getSubDirs();
       QList<File*> currentFiles = currentDir->getCompleteFiles(); // We don't care about the unfinished files.
 
-      foreach (QFileInfo entry, QDir(currentDir->getFullPath()).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks)) // TODO: Add an option to follow or not symlinks.
+      for (QListIterator<DirScanner::Entry> i(listing.entries); i.hasNext();)
       {
+         const DirScanner::Entry& entry = i.next();
+
          QMutexLocker locker(&this->scanningMutex);
 
          if (!this->currentScanningDir || this->toStop)
          {
             L_DEBU("Scanning aborted : " + dir->getFullPath());
+            this->dirScanner.clear();
             this->currentScanningDir = nullptr;
             this->scanningStopped.wakeOne();
             return;
          }
 
-         if (entry.isDir())
+         if (entry.isDir)
          {
-            Directory* dir = currentDir->createSubDir(entry.fileName());
+            Directory* dir = currentDir->createSubDir(entry.name);
             dir->setScanned(false);
-            dirsToVisit << dir;
+            this->dirScanner.add(dir->getFullPath(), dir);
 
             currentSubDirs.removeOne(dir);
          }
-         else if (addUnfinished || !Global::isFileUnfinished(entry.fileName()))
+         else if (addUnfinished || !Global::isFileUnfinished(entry.name))
          {
-            File* file = currentDir->getFile(entry.fileName());
+            File* file = currentDir->getFile(entry.name);
             QMutexLocker locker(&this->mutex);
 
             // Only used when loading the cache to compute the progress.
@@ -482,7 +495,7 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
                    !this->filesWithoutHashes.contains(file) && // The case where a file is being copied and a lot of modification event is thrown (thus the file is in this->filesWithoutHashes).
                    !this->filesWithoutHashesPrioritized.contains(file) &&
                    file->isComplete() &&
-                   !file->correspondTo(entry, file->hasAllHashes()) // If the hashes of a file can't be computed (IO error, the file is being written for example) we only compare their sizes.
+                   !file->correspondTo(entry.size, entry.dateLastModified, entry.nsLastModified, file->hasAllHashes()) // If the hashes of a file can't be computed (IO error, the file is being written for example) we only compare their sizes.
                )
                {
                   currentFiles.removeOne(file);
@@ -500,9 +513,9 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
                // Very special case : there is a file 'a' without File* in cache and a file 'a.unfinished'.
                // This case occure when a file is redownloaded, the File* 'a' is renamed as 'a.unfinished' but the physical file 'a'
                // is not deleted.
-               File* unfinishedFile = currentDir->getFile(entry.fileName().append(Global::getUnfinishedSuffix()));
+               File* unfinishedFile = currentDir->getFile(QString(entry.name).append(Global::getUnfinishedSuffix()));
                if (!unfinishedFile)
-                  file = new File(currentDir, entry.fileName(), entry.size(), entry.lastModified());
+                  file = new File(currentDir, entry.name, entry.size, entry.dateLastModified);
                else
                {
                   currentFiles.removeOne(unfinishedFile);
@@ -510,6 +523,8 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
                }
             }
 
+            file->setFileSystemInfo(entry.nsLastModified, entry.device, entry.inode);
+
             // If a file is incomplete (unfinished) we can't compute its hashes because we don't have all data.
             if (file->getSize() > 0 && !file->hasAllHashes() && file->isComplete() && !this->filesWithoutHashes.contains(file) && !this->filesWithoutHashesPrioritized.contains(file))
             {
@@ -645,26 +660,78 @@ void FileUpdater::restoreFromFileCache(SharedDirectory* dir)
       return;
    }
 
-   for (int i = 0; i < this->fileCacheInformation->getFileCache()->shareddir_size(); i++)
-      if (this->fileCacheInformation->getFileCache()->shareddir(i).id().hash() == dir->getId())
+   // The references to the records of another hash store (reset or replaced) can't be adopted.
+   const bool hashRecordsValid = this->fileCacheInformation->getFileCache()->getHeader().hash_store_id() == HashStore::getInstance().getId();
+
+   QSet<File*> filesWithHashes;
+   auto restoreDir = [&](Protos::FileCache::DirRecord& record) {
+      if (!hashRecordsValid)
+         for (int i = 0; i < record.file_size(); i++)
+            record.mutable_file(i)->clear_hash_record();
+
+      Directory* directory = dir;
+      for (int i = 0; i < record.dir_size() && directory; i++)
+         directory = directory->getSubDir(Common::ProtoHelper::getRepeatedStr(record, &Protos::FileCache::DirRecord::dir, i));
+
+      if (directory)
+         for (QListIterator<File*> i(directory->restoreFromFileCache(record)); i.hasNext();)
+            filesWithHashes.insert(i.next());
+
+      // The files which are not in their directory anymore, the whole directory may have been moved.
+      for (int i = 0; i < record.file_size(); i++)
+         if (!directory || !directory->getFile(Common::ProtoHelper::getStr(record.file(i), &Protos::FileCache::Hashes_File::filename)))
+            this->fileCacheInformation->addMovedFileCandidate(record.file(i));
+   };
+
+   // Only one directory at a time is in memory.
+   CacheJournal* cacheJournal = this->fileCacheInformation->getCacheJournal();
+   this->fileCacheInformation->getFileCache()->restore(dir->getId(), [&](Protos::FileCache::DirRecord& record) {
+      cacheJournal->apply(dir->getId(), record);
+      restoreDir(record);
+   });
+
+   // The directories created since the file cache has been saved.
+   QList<Protos::FileCache::DirRecord> remainingDirs = cacheJournal->takeRemainingDirs(dir->getId());
+   for (QMutableListIterator<Protos::FileCache::DirRecord> i(remainingDirs); i.hasNext();)
+      restoreDir(i.next());
+
+   for (QMutableListIterator<File*> i(this->filesWithoutHashes); i.hasNext();)
+   {
+      File* f = i.next();
+      if (filesWithHashes.contains(f))
       {
-         auto filesWithHashesList = dir->restoreFromFileCache(this->fileCacheInformation->getFileCache()->shareddir(i).root());
-         QSet<File*> filesWithHashes(filesWithHashesList.begin(), filesWithHashesList.end());
+         this->remainingSizeToHash -= f->getSize();
+         i.remove();
+      }
+   }
 
-         for (QMutableListIterator<File*> i(this->filesWithoutHashes); i.hasNext();)
-         {
-            File* f = i.next();
-            if (filesWithHashes.contains(f))
-            {
-               this->remainingSizeToHash -= f->getSize();
-               i.remove();
-            }
-         }
+   L_DEBU("Restoring terminated: " + dir->getFullPath());
+}
 
-         break;
+/**
+  * Reattach the hashes of the files moved or renamed while the core wasn't running,
+  * a file is identified by its inode, its size and its last modification date.
+  * Must be called after 'restoreFromFileCache(..)' for each shared directory.
+  */
+void FileUpdater::restoreMovedFiles()
+{
+   if (!this->fileCacheInformation)
+      return;
+
+   int nbFilesRestored = 0;
+   for (QMutableListIterator<File*> i(this->filesWithoutHashes); i.hasNext();)
+   {
+      File* file = i.next();
+      if (this->fileCacheInformation->restoreMovedFile(file))
+      {
+         this->remainingSizeToHash -= file->getSize();
+         i.remove();
+         nbFilesRestored++;
       }
+   }
 
-   L_DEBU("Restoring terminated: " + dir->getFullPath());
+   if (nbFilesRestored > 0)
+      L_DEBU(QString("Hashes of %1 moved or renamed file(s) restored").arg(nbFilesRestored));
 }
 
 /**
@@ -734,6 +801,7 @@ bool FileUpdater::processEvents(const QList<WatcherEvent>& events)
 
       case WatcherEvent::NEW:
       case WatcherEvent::CONTENT_CHANGED:
+      case WatcherEvent::RESCAN:
          {
             Directory* dir = this->fileManager->getFittestDirectory(event.path1);
             if (dir && !this->dirsToScan.contains(dir))
@@ -752,11 +820,9 @@ bool FileUpdater::processEvents(const QList<WatcherEvent>& events)
 
 /////
 
-FileUpdater::FileCacheInformation::FileCacheInformation(const Protos::FileCache::Hashes* fileCache) :
-   fileCache(fileCache), fileCacheNbFiles(0), fileCacheNbFilesLoaded(0)
+FileUpdater::FileCacheInformation::FileCacheInformation(FileCacheReader* fileCache, CacheJournal* cacheJournal) :
+   fileCache(fileCache), cacheJournal(cacheJournal), fileCacheNbFiles(fileCache->getHeader().nb_files()), fileCacheNbFilesLoaded(0)
 {
-   for (int i = 0; i < this->fileCache->shareddir_size(); i++)
-      this->computeFileCacheNbFiles(this->fileCache->shareddir(i).root());
 }
 
 FileUpdater::FileCacheInformation::~FileCacheInformation()
@@ -771,11 +837,16 @@ void FileUpdater::FileCacheInformation::newFile()
    this->fileCacheNbFilesLoaded++;
 }
 
-const Protos::FileCache::Hashes* FileUpdater::FileCacheInformation::getFileCache()
+FileCacheReader* FileUpdater::FileCacheInformation::getFileCache()
 {
    return this->fileCache;
 }
 
+CacheJournal* FileUpdater::FileCacheInformation::getCacheJournal()
+{
+   return this->cacheJournal;
+}
+
 /**
   * return a value between 0 and 10000 (basis point).
   */
@@ -786,10 +857,42 @@ int FileUpdater::FileCacheInformation::getProgress() const
    return 10000LL * this->fileCacheNbFilesLoaded / this->fileCacheNbFiles;
 }
 
-void FileUpdater::FileCacheInformation::computeFileCacheNbFiles(const Protos::FileCache::Hashes::Dir& dir)
+/**
+  * The files without inode (unknown) and the unfinished ones are ignored.
+  */
+void FileUpdater::FileCacheInformation::addMovedFileCandidate(const Protos::FileCache::Hashes::File& file)
 {
-   for (int i = 0; i < dir.dir_size(); i++)
-      this->computeFileCacheNbFiles(dir.dir(i));
+   if (file.inode() == 0 || Global::isFileUnfinished(Common::ProtoHelper::getStr(file, &Protos::FileCache::Hashes_File::filename)))
+      return;
 
-   this->fileCacheNbFiles += dir.file_size();
+   this->movedFileCandidates.insert(qMakePair(file.inode(), file.size()), file);
+}
+
+/**
+  * Try to restore the hashes of the given file from a candidate having the same inode and size, the ones on the same device are preferred.
+  * @return 'true' if all the hashes have been restored.
+  */
+bool FileUpdater::FileCacheInformation::restoreMovedFile(File* file)
+{
+   if (file->getInode() == 0)
+      return false;
+
+   const QPair<quint64, quint64> key(file->getInode(), file->getSize());
+
+   // Two passes: first the candidates on the same device then the other ones.
+   for (int pass = 0; pass < 2; pass++)
+      for (auto i = this->movedFileCandidates.find(key); i != this->movedFileCandidates.end() && i.key() == key; ++i)
+      {
+         if ((i->device() == file->getDevice()) != (pass == 0))
+            continue;
+
+         if (file->restoreFromFileCache(i.value(), false))
+         {
+            L_DEBU(QString("The file '%1' has been moved or renamed, its hashes are restored").arg(file->getFullPath()));
+            this->movedFileCandidates.erase(i); // The hash records may have been adopted by the file.
+            return file->hasAllHashes();
+         }
+      }
+
+   return false;
 }
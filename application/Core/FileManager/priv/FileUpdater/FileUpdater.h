@@ -23,11 +23,14 @@
 #include <QMutex>
 #include <QString>
 #include <QList>
+#include <QMultiHash>
+#include <QPair>
 #include <QElapsedTimer>
 
 #include <Protos/files_cache.pb.h>
 
 #include <priv/FileUpdater/DirWatcher.h>
+#include <priv/FileUpdater/DirScanner.h>
 #include <priv/Cache/FileHasher.h>
 
 namespace FM
@@ -38,6 +41,8 @@ namespace FM
    class File;
    class Entry;
    class WaitCondition;
+   class FileCacheReader;
+   class CacheJournal;
 
    class FileUpdater : public QThread
    {
@@ -48,7 +53,7 @@ namespace FM
       ~FileUpdater();
 
       void stop();
-      void setFileCache(const Protos::FileCache::Hashes* fileCache);
+      void setFileCache(FileCacheReader* fileCache, CacheJournal* cacheJournal);
       void prioritizeAFileToHash(File* file);
 
       bool isScanning() const;
@@ -81,6 +86,7 @@ namespace FM
       void removeFromFilesWithoutHashes(Directory* dir);
 
       void restoreFromFileCache(SharedDirectory* dir);
+      void restoreMovedFiles();
 
       bool processEvents(const QList<WatcherEvent>& events);
 
@@ -92,19 +98,28 @@ namespace FM
       class FileCacheInformation
       {
       public:
-         FileCacheInformation(const Protos::FileCache::Hashes* fileCache);
+         FileCacheInformation(FileCacheReader* fileCache, CacheJournal* cacheJournal);
          ~FileCacheInformation();
 
          void newFile();
-         const Protos::FileCache::Hashes* getFileCache();
+         FileCacheReader* getFileCache();
+         CacheJournal* getCacheJournal();
          int getProgress() const;
 
-      private:
-         void computeFileCacheNbFiles(const Protos::FileCache::Hashes::Dir& dir);
+         void addMovedFileCandidate(const Protos::FileCache::Hashes::File& file);
+         bool restoreMovedFile(File* file);
 
-         const Protos::FileCache::Hashes* fileCache; ///< The hashes from the saved file cache. Used only temporally at the begining of 'run()'.
+      private:
+         FileCacheReader* fileCache; ///< The saved file cache, read directory by directory. Used only temporally at the begining of 'run()'.
+         CacheJournal* cacheJournal; ///< The changes made since the file cache has been saved, applied to each directory.
          int fileCacheNbFiles;
          int fileCacheNbFilesLoaded;
+
+         /**
+           * The files of the file cache without corresponding file in their directory, indexed by inode and size.
+           * They may have been moved or renamed, see 'FileUpdater::restoreMovedFiles()'.
+           */
+         QMultiHash<QPair<quint64, quint64>, Protos::FileCache::Hashes::File> movedFileCandidates;
       };
       FileCacheInformation* fileCacheInformation; // Only used during the loading of 'fileCache'.
 
@@ -119,6 +134,7 @@ namespace FM
       QElapsedTimer timerScanUnwatchable;
       QList<Directory*> dirsToScan; ///< When something change in a directory we put it in this list until it is scanned.
       Directory* currentScanningDir;
+      DirScanner dirScanner;
       QWaitCondition scanningStopped;
       mutable QMutex scanningMutex;
 
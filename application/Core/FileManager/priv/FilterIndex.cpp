@@ -0,0 +1,201 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/FilterIndex.h>
+using namespace FM;
+
+#include <QtAlgorithms>
+
+#include <priv/Cache/Entry.h>
+#include <priv/Cache/Directory.h>
+
+const int FilterIndex::NB_SIZE_BUCKETS(248); ///< 'sizeBucket(std::numeric_limits<qint64>::max()) + 1'.
+
+FilterIndex::FilterIndex() :
+   sizeBuckets(NB_SIZE_BUCKETS)
+{
+}
+
+void FilterIndex::addItem(Entry* entry)
+{
+   ExtensionIndex<Entry*>::addItem(entry->getExtension(), entry);
+}
+
+void FilterIndex::rmItem(Entry* entry)
+{
+   ExtensionIndex<Entry*>::rmItem(entry);
+}
+
+void FilterIndex::renameItem(Entry* entry)
+{
+   ExtensionIndex<Entry*>::changeItem(entry->getExtension(), entry);
+}
+
+/**
+  * Must be called each time the size of an entry changes.
+  */
+void FilterIndex::resizeItem(Entry* entry)
+{
+   QMutexLocker locker(&this->mutex);
+
+   quint32 id;
+   if (!this->getId(entry, id))
+      return;
+
+   const int bucket = FilterIndex::sizeBucket(entry->getSize());
+   if (bucket != this->sizeBucketOfItems[id])
+   {
+      this->sizeBuckets[this->sizeBucketOfItems[id]].remove(id);
+      this->sizeBuckets[bucket].add(id);
+      this->sizeBucketOfItems[id] = bucket;
+   }
+}
+
+/**
+  * Return the identifiers of the entries matching all the given criteria. An empty list of extensions means any extension.
+  */
+Common::RoaringBitmap FilterIndex::filter(const QList<QString>& extensions, qint64 minSize, qint64 maxSize, Protos::Common::FindPattern_Category category) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (category != Protos::Common::FindPattern::FILE_DIR)
+      this->classify();
+
+   Common::RoaringBitmap result = extensions.isEmpty() ? this->all : this->getBitmap(extensions);
+
+   if (category == Protos::Common::FindPattern::FILE)
+      result -= this->directories;
+   else if (category == Protos::Common::FindPattern::DIR)
+      result &= this->directories;
+
+   if ((minSize > 0 || maxSize != std::numeric_limits<qint64>::max()) && !result.isEmpty())
+   {
+      if (minSize > maxSize)
+         return Common::RoaringBitmap();
+
+      const int firstBucket = FilterIndex::sizeBucket(qMax(minSize, Q_INT64_C(0)));
+      const int lastBucket = FilterIndex::sizeBucket(maxSize);
+
+      Common::RoaringBitmap sizes;
+      for (int i = firstBucket; i <= lastBucket; i++)
+      {
+         const bool partial =
+            i == firstBucket && FilterIndex::sizeBucketLowerBound(i) < minSize ||
+            i == lastBucket && FilterIndex::sizeBucketUpperBound(i) > maxSize;
+
+         if (!partial)
+         {
+            sizes |= this->sizeBuckets[i];
+            continue;
+         }
+
+         // Only the entries of the buckets overlapping the boundaries of the range are checked one by one.
+         const Common::RoaringBitmap candidates = this->sizeBuckets[i] & result;
+         candidates.forall([&](quint32 id) {
+            const qint64 size = this->getItem(id)->getSize();
+            if (size >= minSize && size <= maxSize)
+               sizes.add(id);
+            return true;
+         });
+      }
+
+      result &= sizes;
+   }
+
+   return result;
+}
+
+bool FilterIndex::matches(const Common::RoaringBitmap& filter, Entry* entry) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   quint32 id;
+   return this->getId(entry, id) && filter.contains(id);
+}
+
+QList<Entry*> FilterIndex::search(const Common::RoaringBitmap& filter, int limit) const
+{
+   return this->getItems(filter, limit);
+}
+
+/**
+  * The sizes below 4 have their own bucket, then each power of two is divided in four buckets.
+  * For example [8, 9], [10, 11], [12, 13] and [14, 15].
+  */
+int FilterIndex::sizeBucket(qint64 size)
+{
+   if (size < 4)
+      return qMax(size, Q_INT64_C(0));
+
+   const int e = 63 - qCountLeadingZeroBits(static_cast<quint64>(size));
+   const int m = (size >> (e - 2)) & 3;
+   return 4 * (e - 1) + m;
+}
+
+qint64 FilterIndex::sizeBucketLowerBound(int bucket)
+{
+   if (bucket < 4)
+      return bucket;
+
+   const int e = bucket / 4 + 1;
+   const int m = bucket % 4;
+   return static_cast<qint64>(4 + m) << (e - 2);
+}
+
+qint64 FilterIndex::sizeBucketUpperBound(int bucket)
+{
+   if (bucket + 1 >= NB_SIZE_BUCKETS)
+      return std::numeric_limits<qint64>::max();
+   return FilterIndex::sizeBucketLowerBound(bucket + 1) - 1;
+}
+
+/**
+  * Each entry is only cast once, at the first search filtering by category after its addition.
+  */
+void FilterIndex::classify() const
+{
+   if (this->unclassified.isEmpty())
+      return;
+
+   this->unclassified.forall([this](quint32 id) {
+      if (dynamic_cast<Directory*>(this->getItem(id)))
+         this->directories.add(id);
+      return true;
+   });
+   this->unclassified.clear();
+}
+
+void FilterIndex::itemAdded(quint32 id, Entry* const& entry)
+{
+   this->all.add(id);
+   this->unclassified.add(id);
+
+   const int bucket = FilterIndex::sizeBucket(entry->getSize());
+   this->sizeBuckets[bucket].add(id);
+   if (static_cast<int>(id) >= this->sizeBucketOfItems.size())
+      this->sizeBucketOfItems.resize(id + 1);
+   this->sizeBucketOfItems[id] = bucket;
+}
+
+void FilterIndex::itemRemoved(quint32 id, Entry* const& entry)
+{
+   this->all.remove(id);
+   this->unclassified.remove(id);
+   this->directories.remove(id);
+   this->sizeBuckets[this->sizeBucketOfItems[id]].remove(id);
+}
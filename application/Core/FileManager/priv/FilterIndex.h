@@ -0,0 +1,80 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#pragma once
+
+#include <limits>
+
+#include <QList>
+#include <QVector>
+#include <QString>
+
+#include <Protos/common.pb.h>
+
+#include <Common/Containers/RoaringBitmap.h>
+
+#include <priv/ExtensionIndex.h>
+
+namespace FM
+{
+   class Entry;
+
+   /**
+     * @class FM::FilterIndex
+     *
+     * Index the entries by extension, category (file or directory) and size to evaluate the filters of a search.
+     *
+     * The sizes are grouped in buckets, four per power of two, thus a size range is the union of some buckets and
+     * only the entries of the two buckets at the boundaries have to be checked individually.
+     *
+     * A filter is computed once with some bitmap operations, then checking a candidate is a single lookup.
+     */
+   class FilterIndex : public ExtensionIndex<Entry*>
+   {
+      static const int NB_SIZE_BUCKETS;
+
+   public:
+      FilterIndex();
+
+      void addItem(Entry* entry);
+      void rmItem(Entry* entry);
+      void renameItem(Entry* entry);
+      void resizeItem(Entry* entry);
+
+      Common::RoaringBitmap filter(const QList<QString>& extensions, qint64 minSize = 0, qint64 maxSize = std::numeric_limits<qint64>::max(), Protos::Common::FindPattern_Category category = Protos::Common::FindPattern::FILE_DIR) const;
+      bool matches(const Common::RoaringBitmap& filter, Entry* entry) const;
+      QList<Entry*> search(const Common::RoaringBitmap& filter, int limit = std::numeric_limits<int>::max()) const;
+
+      static int sizeBucket(qint64 size);
+      static qint64 sizeBucketLowerBound(int bucket);
+      static qint64 sizeBucketUpperBound(int bucket);
+
+   protected:
+      void itemAdded(quint32 id, Entry* const& entry) override;
+      void itemRemoved(quint32 id, Entry* const& entry) override;
+
+   private:
+      void classify() const;
+
+      Common::RoaringBitmap all;
+      mutable Common::RoaringBitmap unclassified; ///< The entries are added during their construction, their type is only known later.
+      mutable Common::RoaringBitmap directories;
+      QVector<Common::RoaringBitmap> sizeBuckets;
+      QVector<quint8> sizeBucketOfItems; ///< The current bucket of each identifier.
+   };
+}
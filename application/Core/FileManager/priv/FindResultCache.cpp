@@ -0,0 +1,133 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/FindResultCache.h>
+using namespace FM;
+
+#include <QStringList>
+#include <QStringBuilder>
+
+#include <Common/StringUtils.h>
+
+/**
+  * @param capacity The maximum total size of the cached datagrams [B]. 0 disables the cache.
+  */
+FindResultCache::FindResultCache(int capacity) :
+   cache(capacity), generation(0), nbHits(0), nbMisses(0)
+{
+}
+
+/**
+  * Return a normalized representation of a search, two searches with the same key have the same results.
+  * The words are split like the indexes do and the extensions are sorted and put in lower case.
+  */
+QString FindResultCache::key(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize, bool substringMatch, int maxEditDistance)
+{
+   QStringList normalizedExtensions;
+   normalizedExtensions.reserve(extensions.size());
+   for (QListIterator<QString> i(extensions); i.hasNext();)
+      normalizedExtensions << i.next().toLower();
+   normalizedExtensions.sort();
+   normalizedExtensions.removeDuplicates();
+
+   // An extension can't contain '/', the words are appended at the end because they may contain any character.
+   return
+      QString::number(minFileSize) % '|' % QString::number(maxFileSize) % '|' % QString::number(category) % '|' %
+      QString::number(maxNbResult) % '|' % QString::number(maxSize) % '|' % (substringMatch ? '1' : '0') % '|' % QString::number(maxEditDistance) % '|' %
+      normalizedExtensions.join('/') % '/' % Common::StringUtils::splitInWords(words).join(' ');
+}
+
+/**
+  * @return 'true' if the results of the given key are known, they are copied to 'results'.
+  */
+bool FindResultCache::get(const QString& key, QList<Protos::Common::FindResult>& results)
+{
+   QMutexLocker locker(&this->mutex);
+
+   const QList<Protos::Common::FindResult>* cachedResults = this->cache.object(key);
+   if (!cachedResults)
+   {
+      this->nbMisses++;
+      return false;
+   }
+
+   this->nbHits++;
+   results = *cachedResults;
+   return true;
+}
+
+/**
+  * Must be read before computing the results to insert, see 'insert(..)'.
+  */
+quint64 FindResultCache::getGeneration() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->generation;
+}
+
+/**
+  * The results are dropped if the cache has been invalidated since 'generation' was read,
+  * they may have been computed from the previous state of the indexes.
+  */
+void FindResultCache::insert(const QString& key, const QList<Protos::Common::FindResult>& results, quint64 generation)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (generation != this->generation || this->cache.maxCost() == 0)
+      return;
+
+   int cost = 1; // An empty result still costs something.
+   for (QListIterator<Protos::Common::FindResult> i(results); i.hasNext();)
+      cost += int(i.next().ByteSizeLong());
+
+   // Too large results are refused by 'QCache' itself.
+   this->cache.insert(key, new QList<Protos::Common::FindResult>(results), cost);
+}
+
+void FindResultCache::invalidate()
+{
+   QMutexLocker locker(&this->mutex);
+   this->generation++;
+   if (!this->cache.isEmpty())
+      this->cache.clear();
+}
+
+quint64 FindResultCache::getNbHits() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->nbHits;
+}
+
+quint64 FindResultCache::getNbMisses() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->nbMisses;
+}
+
+QString FindResultCache::toStringLog() const
+{
+   QMutexLocker locker(&this->mutex);
+
+   const quint64 nbRequests = this->nbHits + this->nbMisses;
+   return QString("FindResultCache: %1 searches, %2 bytes, %3 hits, %4 misses, hit rate: %5%")
+      .arg(this->cache.count())
+      .arg(this->cache.totalCost())
+      .arg(this->nbHits)
+      .arg(this->nbMisses)
+      .arg(nbRequests == 0 ? 0.0 : 100.0 * this->nbHits / nbRequests, 0, 'f', 1);
+}
@@ -0,0 +1,70 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QCache>
+#include <QMutex>
+
+#include <Protos/common.pb.h>
+
+#include <Common/Uncopyable.h>
+#include <Common/LogManager/ILoggable.h>
+
+namespace FM
+{
+   /**
+     * @class FM::FindResultCache
+     *
+     * Keep the last results of 'FileManager::find(..)', already split in datagrams, to answer the same
+     * search sent by several peers without looking up the indexes and populating the entries again.
+     *
+     * The least recently used results are discarded when the total size of the cached datagrams exceeds the capacity.
+     * Any change of the indexed entries invalidates the whole cache, see 'invalidate()'.
+     *
+     * This class is thread safe.
+     */
+   class FindResultCache : public LM::ILoggable, Common::Uncopyable
+   {
+   public:
+      FindResultCache(int capacity);
+
+      static QString key(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize, bool substringMatch, int maxEditDistance);
+
+      bool get(const QString& key, QList<Protos::Common::FindResult>& results);
+      quint64 getGeneration() const;
+      void insert(const QString& key, const QList<Protos::Common::FindResult>& results, quint64 generation);
+      void invalidate();
+
+      quint64 getNbHits() const;
+      quint64 getNbMisses() const;
+
+      QString toStringLog() const;
+
+   private:
+      QCache<QString, QList<Protos::Common::FindResult>> cache; ///< The cost of an item is the size of its datagrams [B].
+      quint64 generation; ///< Incremented by each invalidation.
+
+      quint64 nbHits;
+      quint64 nbMisses;
+
+      mutable QMutex mutex;
+   };
+}
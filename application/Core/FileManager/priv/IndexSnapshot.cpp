@@ -0,0 +1,470 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/IndexSnapshot.h>
+using namespace FM;
+
+#include <algorithm>
+
+#include <QHash>
+#include <QVector>
+#include <QPair>
+
+#include <Common/Global.h>
+#include <Common/KnownExtensions.h>
+#include <Common/ProtoHelper.h>
+#include <Common/StringUtils.h>
+
+#include <priv/Log.h>
+#include <priv/Constants.h>
+#include <priv/Cache/Entry.h>
+#include <priv/Cache/Directory.h>
+#include <priv/Cache/SharedDirectory.h>
+
+const quint32 IndexSnapshot::MAGIC(0x58494C44); // "DLIX".
+const QString IndexSnapshot::TEMP_SUFFIX_TERM(".temp");
+
+IndexSnapshot::~IndexSnapshot()
+{
+   if (this->header)
+      this->file.unmap(reinterpret_cast<uchar*>(const_cast<Header*>(this->header)));
+}
+
+/**
+  * Write the content of the given indexes to the file 'filepath'.
+  * The file is first written to a temporary file and then renamed, a reader never sees a partial snapshot.
+  * The indexes must not be modified concurrently, the caller must lock the cache to prevent it from deleting any entry, see 'Cache::getMutex()'.
+  * @return 'false' if the file can't be written, the error is logged.
+  */
+bool IndexSnapshot::write(const QString& filepath, const WordIndex<Entry*>& wordIndex, const ExtensionIndex<Entry*>& extensionIndex, const SizeIndexEntries& sizeIndex)
+{
+   QVector<Entry*> entries;
+   QHash<Entry*, quint32> entryIds;
+   auto entryId = [&](Entry* entry) {
+      auto i = entryIds.find(entry);
+      if (i != entryIds.end())
+         return i.value();
+      const quint32 id = entries.size();
+      entryIds.insert(entry, id);
+      entries << entry;
+      return id;
+   };
+
+   // Each key is associated to its sorted and unique entries.
+   typedef QPair<QString, QVector<quint32>> Key;
+   auto sortKeys = [](QVector<Key>& keys) { std::sort(keys.begin(), keys.end(), [](const Key& k1, const Key& k2) { return k1.first < k2.first; }); };
+   auto normalizePostings = [](QVector<quint32>& postings) {
+      std::sort(postings.begin(), postings.end());
+      postings.erase(std::unique(postings.begin(), postings.end()), postings.end());
+   };
+
+   QVector<Key> words;
+   wordIndex.forall([&](const QString& word, const QList<Entry*>& items) {
+      Key key(word, QVector<quint32>());
+      for (QListIterator<Entry*> i(items); i.hasNext();)
+         key.second << entryId(i.next());
+      normalizePostings(key.second);
+      words << key;
+   });
+   sortKeys(words);
+
+   QVector<Key> extensions;
+   extensionIndex.forall([&](const QString& extension, const QList<Entry*>& items) {
+      Key key(extension, QVector<quint32>());
+      for (QListIterator<Entry*> i(items); i.hasNext();)
+         key.second << entryId(i.next());
+      normalizePostings(key.second);
+      extensions << key;
+   });
+   sortKeys(extensions);
+
+   QVector<quint32> sizeOrdered;
+   sizeIndex.forall([&](Entry* entry) {
+      sizeOrdered << entryId(entry);
+   });
+
+   // The string table, the paths are shared by a lot of entries.
+   QString chars;
+   QHash<QString, String> internedStrings;
+   auto addString = [&](const QString& str) {
+      auto i = internedStrings.find(str);
+      if (i != internedStrings.end())
+         return i.value();
+      const String s { static_cast<quint32>(chars.size()), static_cast<quint32>(str.size()) };
+      chars.append(str);
+      internedStrings.insert(str, s);
+      return s;
+   };
+
+   QVector<SharedDirRecord> sharedDirRecords;
+   QHash<SharedDirectory*, quint32> sharedDirIds;
+
+   QVector<EntryRecord> entryRecords(entries.size());
+   for (int i = 0; i < entries.size(); i++)
+   {
+      Entry* entry = entries[i];
+      SharedDirectory* sharedDir = entry->getRoot();
+
+      auto sharedDirId = sharedDirIds.find(sharedDir);
+      if (sharedDirId == sharedDirIds.end())
+      {
+         SharedDirRecord record {};
+         if (sharedDir)
+         {
+            memcpy(record.id, sharedDir->getId().getData(), Common::Hash::HASH_SIZE);
+            record.name = addString(sharedDir->getName());
+         }
+         sharedDirId = sharedDirIds.insert(sharedDir, sharedDirRecords.size());
+         sharedDirRecords << record;
+      }
+
+      EntryRecord& record = entryRecords[i];
+      record.size = entry->getSize();
+      record.path = addString(entry->getPath());
+      record.name = addString(entry->getName());
+      record.sharedDir = sharedDirId.value();
+      record.flags = dynamic_cast<Directory*>(entry) ? EntryRecord::DIRECTORY : 0;
+   }
+
+   QVector<KeyRecord> wordRecords;
+   QVector<KeyRecord> extensionRecords;
+   QVector<quint32> postings;
+   for (int k = 0; k < 2; k++)
+   {
+      const QVector<Key>& keys = k == 0 ? words : extensions;
+      QVector<KeyRecord>& records = k == 0 ? wordRecords : extensionRecords;
+      for (QVectorIterator<Key> i(keys); i.hasNext();)
+      {
+         const Key& key = i.next();
+         records << KeyRecord { addString(key.first), static_cast<quint32>(postings.size()), static_cast<quint32>(key.second.size()) };
+         postings << key.second;
+      }
+   }
+
+   Header header {};
+   header.magic = MAGIC;
+   header.version = INDEX_SNAPSHOT_VERSION;
+   header.nbEntries = entryRecords.size();
+   header.nbWords = wordRecords.size();
+   header.nbExtensions = extensionRecords.size();
+   header.nbSharedDirs = sharedDirRecords.size();
+   header.nbPostings = postings.size();
+   header.nbSizeOrdered = sizeOrdered.size();
+   header.nbChars = chars.size();
+
+   const QString TEMP_FILEPATH(filepath + TEMP_SUFFIX_TERM);
+
+   {
+      QFile file(TEMP_FILEPATH);
+      if (!file.open(QIODevice::WriteOnly))
+      {
+         L_ERRO(QString("Unable to open the file in write mode : %1, error : %2").arg(TEMP_FILEPATH).arg(file.errorString()));
+         return false;
+      }
+
+      bool ok =
+         file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) == sizeof(Header) &&
+         file.write(reinterpret_cast<const char*>(entryRecords.constData()), entryRecords.size() * sizeof(EntryRecord)) == qint64(entryRecords.size() * sizeof(EntryRecord)) &&
+         file.write(reinterpret_cast<const char*>(wordRecords.constData()), wordRecords.size() * sizeof(KeyRecord)) == qint64(wordRecords.size() * sizeof(KeyRecord)) &&
+         file.write(reinterpret_cast<const char*>(extensionRecords.constData()), extensionRecords.size() * sizeof(KeyRecord)) == qint64(extensionRecords.size() * sizeof(KeyRecord)) &&
+         file.write(reinterpret_cast<const char*>(sharedDirRecords.constData()), sharedDirRecords.size() * sizeof(SharedDirRecord)) == qint64(sharedDirRecords.size() * sizeof(SharedDirRecord)) &&
+         file.write(reinterpret_cast<const char*>(postings.constData()), postings.size() * sizeof(quint32)) == qint64(postings.size() * sizeof(quint32)) &&
+         file.write(reinterpret_cast<const char*>(sizeOrdered.constData()), sizeOrdered.size() * sizeof(quint32)) == qint64(sizeOrdered.size() * sizeof(quint32)) &&
+         file.write(reinterpret_cast<const char*>(chars.constData()), chars.size() * sizeof(QChar)) == qint64(chars.size() * sizeof(QChar));
+
+      if (!ok)
+      {
+         L_ERRO(QString("Unable to write the index snapshot : %1, error : %2").arg(TEMP_FILEPATH).arg(file.errorString()));
+         file.remove();
+         return false;
+      }
+   }
+
+   return Common::Global::rename(TEMP_FILEPATH, filepath);
+}
+
+/**
+  * Map the given snapshot file in memory.
+  * @return A null pointer if the file doesn't exist or isn't valid.
+  */
+QSharedPointer<IndexSnapshot> IndexSnapshot::load(const QString& filepath)
+{
+   QSharedPointer<IndexSnapshot> snapshot(new IndexSnapshot(filepath));
+
+   if (!snapshot->file.open(QIODevice::ReadOnly) || snapshot->file.size() < qint64(sizeof(Header)))
+      return QSharedPointer<IndexSnapshot>();
+
+   const uchar* data = snapshot->file.map(0, snapshot->file.size());
+   if (!data)
+   {
+      L_WARN(QString("Unable to map the index snapshot %1 : %2").arg(filepath).arg(snapshot->file.errorString()));
+      return QSharedPointer<IndexSnapshot>();
+   }
+
+   snapshot->header = reinterpret_cast<const Header*>(data);
+   const Header& header = *snapshot->header;
+
+   if (header.magic != MAGIC || header.version != INDEX_SNAPSHOT_VERSION)
+   {
+      L_WARN(QString("The index snapshot %1 has an unknown format or version (%2), it's ignored").arg(filepath).arg(header.version));
+      return QSharedPointer<IndexSnapshot>();
+   }
+
+   const qint64 expectedSize =
+      sizeof(Header) +
+      qint64(header.nbEntries) * sizeof(EntryRecord) +
+      (qint64(header.nbWords) + header.nbExtensions) * sizeof(KeyRecord) +
+      qint64(header.nbSharedDirs) * sizeof(SharedDirRecord) +
+      (qint64(header.nbPostings) + header.nbSizeOrdered) * sizeof(quint32) +
+      qint64(header.nbChars) * sizeof(QChar);
+
+   if (expectedSize != snapshot->file.size())
+   {
+      L_WARN(QString("The index snapshot %1 is corrupted, it's ignored").arg(filepath));
+      return QSharedPointer<IndexSnapshot>();
+   }
+
+   snapshot->entries = reinterpret_cast<const EntryRecord*>(data + sizeof(Header));
+   snapshot->words = reinterpret_cast<const KeyRecord*>(snapshot->entries + header.nbEntries);
+   snapshot->extensions = snapshot->words + header.nbWords;
+   snapshot->sharedDirs = reinterpret_cast<const SharedDirRecord*>(snapshot->extensions + header.nbExtensions);
+   snapshot->postings = reinterpret_cast<const quint32*>(snapshot->sharedDirs + header.nbSharedDirs);
+   snapshot->sizeOrdered = snapshot->postings + header.nbPostings;
+   snapshot->chars = reinterpret_cast<const QChar*>(snapshot->sizeOrdered + header.nbSizeOrdered);
+
+   if (!snapshot->checkReferences())
+   {
+      L_WARN(QString("The index snapshot %1 contains an invalid reference, it's ignored").arg(filepath));
+      return QSharedPointer<IndexSnapshot>();
+   }
+
+   return snapshot;
+}
+
+/**
+  * Same semantic as 'WordIndex::search(..)' without the tolerance to errors.
+  */
+QList<NodeResult<quint32>> IndexSnapshot::search(const QStringList& words, int maxNbResult, std::function<bool(const quint32&)> predicat) const
+{
+   const int N = words.size();
+
+   QVector<QSet<NodeResult<quint32>>> results(N);
+   for (int i = 0; i < N; i++)
+   {
+      const QList<NodeResult<quint32>>& result = this->search(words[i], N == 1 ? maxNbResult : -1, predicat);
+      for (QListIterator<NodeResult<quint32>> j(result); j.hasNext();)
+      {
+         const NodeResult<quint32>& nodeResult = j.next();
+         if (!results[i].contains(nodeResult)) // Keep the best level, the exact matches come first.
+            results[i].insert(nodeResult);
+      }
+   }
+
+   return WordIndex<quint32>::mergeResults(results, maxNbResult);
+}
+
+QList<quint32> IndexSnapshot::searchByExtensions(const QList<QString>& extensions, int limit, std::function<bool(const quint32&)> predicat) const
+{
+   QList<quint32> result;
+
+   const KeyRecord* end = this->extensions + this->header->nbExtensions;
+   for (QListIterator<QString> i(extensions); i.hasNext();)
+   {
+      const QString extension = i.next().toLower();
+      const KeyRecord* key = this->lowerBound(this->extensions, end, extension);
+      if (key == end || this->getRawString(key->key) != extension)
+         continue;
+
+      for (quint32 j = key->firstPosting; j < key->firstPosting + key->nbPostings; j++)
+         if (!predicat || predicat(this->postings[j]))
+         {
+            result << this->postings[j];
+            if (result.size() >= limit)
+               return result;
+         }
+   }
+
+   return result;
+}
+
+QList<quint32> IndexSnapshot::searchBySize(qint64 sizeMin, qint64 sizeMax, int limit, std::function<bool(const quint32&)> predicat) const
+{
+   QList<quint32> result;
+
+   const quint32* end = this->sizeOrdered + this->header->nbSizeOrdered;
+   const quint32* i = std::lower_bound(this->sizeOrdered, end, sizeMin, [this](quint32 entry, qint64 size) { return this->entries[entry].size < size; });
+
+   for (; i != end && this->entries[*i].size <= sizeMax; ++i)
+      if (!predicat || predicat(*i))
+      {
+         result << *i;
+         if (result.size() >= limit)
+            break;
+      }
+
+   return result;
+}
+
+int IndexSnapshot::getNbEntries() const
+{
+   return this->header->nbEntries;
+}
+
+qint64 IndexSnapshot::getSize(quint32 entry) const
+{
+   return this->entries[entry].size;
+}
+
+bool IndexSnapshot::isDirectory(quint32 entry) const
+{
+   return this->entries[entry].flags & EntryRecord::DIRECTORY;
+}
+
+QString IndexSnapshot::getExtension(quint32 entry) const
+{
+   return Common::KnownExtensions::getExtension(this->getString(this->entries[entry].name));
+}
+
+Common::Hash IndexSnapshot::getSharedDirId(quint32 entry) const
+{
+   return Common::Hash(this->sharedDirs[this->entries[entry].sharedDir].id);
+}
+
+/**
+  * The hashes aren't persisted in the snapshot, the remote peer will ask them later.
+  */
+void IndexSnapshot::populateEntry(quint32 entry, Protos::Common::Entry* protoEntry) const
+{
+   const EntryRecord& record = this->entries[entry];
+   const SharedDirRecord& sharedDir = this->sharedDirs[record.sharedDir];
+
+   protoEntry->set_type(record.flags & EntryRecord::DIRECTORY ? Protos::Common::Entry_Type_DIR : Protos::Common::Entry_Type_FILE);
+   Common::ProtoHelper::setStr(*protoEntry, &Protos::Common::Entry::set_path, this->getString(record.path));
+   Common::ProtoHelper::setStr(*protoEntry, &Protos::Common::Entry::set_name, this->getString(record.name));
+   protoEntry->set_size(record.size);
+
+   protoEntry->mutable_shared_dir()->mutable_id()->set_hash(sharedDir.id, Common::Hash::HASH_SIZE);
+   Common::ProtoHelper::setStr(*protoEntry->mutable_shared_dir(), &Protos::Common::SharedDir::set_shared_name, this->getString(sharedDir.name));
+}
+
+IndexSnapshot::IndexSnapshot(const QString& filepath) :
+   file(filepath),
+   header(nullptr),
+   entries(nullptr),
+   words(nullptr),
+   extensions(nullptr),
+   sharedDirs(nullptr),
+   postings(nullptr),
+   sizeOrdered(nullptr),
+   chars(nullptr)
+{
+   static_assert(sizeof(Header) % 8 == 0 && sizeof(EntryRecord) % 8 == 0 && sizeof(KeyRecord) % 8 == 0 && sizeof(SharedDirRecord) % 8 == 0, "Each table must keep the next ones aligned");
+}
+
+/**
+  * Check that each position read from the file is inside its table, the searches then use them without any check.
+  * @return 'false' at the first position out of its table.
+  */
+bool IndexSnapshot::checkReferences() const
+{
+   const Header& header = *this->header;
+
+   auto isStringValid = [&](const String& str) { return qint64(str.offset) + str.length <= header.nbChars; };
+
+   for (quint32 i = 0; i < header.nbEntries; i++)
+   {
+      const EntryRecord& record = this->entries[i];
+      if (!isStringValid(record.path) || !isStringValid(record.name) || record.sharedDir >= header.nbSharedDirs)
+         return false;
+   }
+
+   for (qint64 i = 0; i < qint64(header.nbWords) + header.nbExtensions; i++) // 'extensions' follows 'words'.
+   {
+      const KeyRecord& record = this->words[i];
+      if (!isStringValid(record.key) || qint64(record.firstPosting) + record.nbPostings > header.nbPostings)
+         return false;
+   }
+
+   for (quint32 i = 0; i < header.nbSharedDirs; i++)
+      if (!isStringValid(this->sharedDirs[i].name))
+         return false;
+
+   for (quint32 i = 0; i < header.nbPostings; i++)
+      if (this->postings[i] >= header.nbEntries)
+         return false;
+
+   for (quint32 i = 0; i < header.nbSizeOrdered; i++)
+      if (this->sizeOrdered[i] >= header.nbEntries)
+         return false;
+
+   return true;
+}
+
+/**
+  * The exact match is the first key not lesser than the word, the indexed words beginning with the word follow it.
+  */
+QList<NodeResult<quint32>> IndexSnapshot::search(const QString& word, int maxNbResult, const std::function<bool(const quint32&)>& predicat) const
+{
+   QList<NodeResult<quint32>> result;
+
+   const bool partialMatch = word.size() >= (Common::StringUtils::isKorean(word) ? WordIndex<quint32>::MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN : WordIndex<quint32>::MIN_WORD_SIZE_PARTIAL_MATCH);
+
+   const KeyRecord* end = this->words + this->header->nbWords;
+   for (const KeyRecord* key = this->lowerBound(this->words, end, word); key != end; ++key)
+   {
+      const QString indexedWord = this->getRawString(key->key);
+      const int level = indexedWord == word ? 0 : 1;
+      if (level == 1 && (!partialMatch || !indexedWord.startsWith(word)))
+         break;
+
+      for (quint32 i = key->firstPosting; i < key->firstPosting + key->nbPostings; i++)
+         if (!predicat || predicat(this->postings[i]))
+         {
+            result << NodeResult<quint32>(this->postings[i], level);
+            if (result.size() == maxNbResult)
+               return result;
+         }
+   }
+
+   return result;
+}
+
+const IndexSnapshot::KeyRecord* IndexSnapshot::lowerBound(const KeyRecord* begin, const KeyRecord* end, const QString& key) const
+{
+   return std::lower_bound(begin, end, key, [this](const KeyRecord& record, const QString& value) { return this->getRawString(record.key) < value; });
+}
+
+/**
+  * Return a copy of the string, it can outlive the snapshot.
+  */
+QString IndexSnapshot::getString(const String& str) const
+{
+   if (qint64(str.offset) + str.length > this->header->nbChars)
+      return QString();
+   return QString(this->chars + str.offset, str.length);
+}
+
+/**
+  * Return a string pointing directly to the mapped memory, it must not outlive the snapshot.
+  */
+QString IndexSnapshot::getRawString(const String& str) const
+{
+   if (qint64(str.offset) + str.length > this->header->nbChars)
+      return QString();
+   return QString::fromRawData(this->chars + str.offset, str.length);
+}
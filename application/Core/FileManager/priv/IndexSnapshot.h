@@ -0,0 +1,155 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#pragma once
+
+#include <functional>
+#include <limits>
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSharedPointer>
+#include <QFile>
+
+#include <Protos/common.pb.h>
+
+#include <Common/Uncopyable.h>
+#include <Common/Hash.h>
+
+#include <priv/WordIndex/WordIndex.h>
+#include <priv/ExtensionIndex.h>
+#include <priv/SizeIndexEntries.h>
+
+namespace FM
+{
+   class Entry;
+
+   /**
+     * @class FM::IndexSnapshot
+     *
+     * A read-only copy of the word, extension and size indexes persisted next to the file cache.
+     *
+     * Rebuilding the indexes at startup requires the whole file cache to be loaded and all the shared
+     * directories to be scanned again, which may take minutes. During this time the snapshot written
+     * by the previous session is used to answer the searches.
+     *
+     * The file is made of fixed size records and can be memory mapped as is, there is no parsing:
+     *  - Header
+     *  - EntryRecord[nbEntries]
+     *  - KeyRecord[nbWords], sorted by word
+     *  - KeyRecord[nbExtensions], sorted by extension
+     *  - SharedDirRecord[nbSharedDirs]
+     *  - quint32[nbPostings], the entries of each word and extension
+     *  - quint32[nbSizeOrdered], the entries sorted by size
+     *  - QChar[nbChars], the strings (UTF-16)
+     * The values are in the native byte order, a snapshot written by a different architecture is rejected.
+     *
+     * An entry is identified by its position in the entry table.
+     */
+   class IndexSnapshot : Common::Uncopyable
+   {
+      static const quint32 MAGIC;
+      static const QString TEMP_SUFFIX_TERM;
+
+      struct Header
+      {
+         quint32 magic;
+         quint32 version;
+         quint32 nbEntries;
+         quint32 nbWords;
+         quint32 nbExtensions;
+         quint32 nbSharedDirs;
+         quint32 nbPostings;
+         quint32 nbSizeOrdered;
+         quint32 nbChars;
+         quint32 padding;
+      };
+
+      struct String
+      {
+         quint32 offset; ///< In 'QChar' from the beginning of the string table.
+         quint32 length;
+      };
+
+      struct EntryRecord
+      {
+         enum Flag : quint32 { DIRECTORY = 0x1 };
+
+         qint64 size;
+         String path;
+         String name;
+         quint32 sharedDir; ///< Position in the shared directory table.
+         quint32 flags;
+      };
+
+      struct KeyRecord
+      {
+         String key; ///< A word or an extension.
+         quint32 firstPosting;
+         quint32 nbPostings;
+      };
+
+      struct SharedDirRecord
+      {
+         char id[Common::Hash::HASH_SIZE];
+         String name;
+         quint32 padding;
+      };
+
+   public:
+      ~IndexSnapshot();
+
+      static bool write(const QString& filepath, const WordIndex<Entry*>& wordIndex, const ExtensionIndex<Entry*>& extensionIndex, const SizeIndexEntries& sizeIndex);
+      static QSharedPointer<IndexSnapshot> load(const QString& filepath);
+
+      QList<NodeResult<quint32>> search(const QStringList& words, int maxNbResult = -1, std::function<bool(const quint32&)> predicat = nullptr) const;
+      QList<quint32> searchByExtensions(const QList<QString>& extensions, int limit = std::numeric_limits<int>::max(), std::function<bool(const quint32&)> predicat = nullptr) const;
+      QList<quint32> searchBySize(qint64 sizeMin, qint64 sizeMax, int limit = std::numeric_limits<int>::max(), std::function<bool(const quint32&)> predicat = nullptr) const;
+
+      int getNbEntries() const;
+      qint64 getSize(quint32 entry) const;
+      bool isDirectory(quint32 entry) const;
+      QString getExtension(quint32 entry) const;
+      Common::Hash getSharedDirId(quint32 entry) const;
+
+      void populateEntry(quint32 entry, Protos::Common::Entry* protoEntry) const;
+
+   private:
+      IndexSnapshot(const QString& filepath);
+
+      bool checkReferences() const;
+
+      QList<NodeResult<quint32>> search(const QString& word, int maxNbResult, const std::function<bool(const quint32&)>& predicat) const;
+      const KeyRecord* lowerBound(const KeyRecord* begin, const KeyRecord* end, const QString& key) const;
+
+      QString getString(const String& str) const;
+      QString getRawString(const String& str) const;
+
+      QFile file;
+
+      const Header* header;
+      const EntryRecord* entries;
+      const KeyRecord* words;
+      const KeyRecord* extensions;
+      const SharedDirRecord* sharedDirs;
+      const quint32* postings;
+      const quint32* sizeOrdered;
+      const QChar* chars;
+   };
+}
@@ -70,3 +70,14 @@ QList<Entry*> SizeIndexEntries::search(qint64 sizeMin, qint64 sizeMax, int limit
 
    return result;
 }
+
+/**
+  * Call 'fun' for each entry from the smallest to the biggest.
+  */
+void SizeIndexEntries::forall(std::function<void(Entry*)> fun) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   for (auto i = this->index.begin(); i != this->index.end(); ++i)
+      fun(*i);
+}
@@ -21,6 +21,8 @@ namespace FM
 
       QList<Entry*> search(qint64 sizeMin, qint64 sizeMax, int limit = std::numeric_limits<int>::max(), std::function<bool(const Entry*)> predicat = nullptr) const;
 
+      void forall(std::function<void(Entry*)> fun) const;
+
    private:
       Common::SortedArray<Entry*> index;
       mutable QMutex mutex;
@@ -19,8 +19,11 @@
 #pragma once
 
 #include <functional>
+#include <algorithm>
+#include <limits>
 
 #include <QList>
+#include <QVector>
 #include <QSet>
 #include <QString>
 #include <QPair>
@@ -36,11 +39,15 @@
 
 namespace FM
 {
+   /**
+     * 'level' is 0 for an exact match and 1 if the word matches only the beginning of the indexed string.
+     * For a search tolerating some errors the level is 2 * d for an entire match and 2 * d + 1 for a match of the beginning, where d is the edit distance.
+     */
    template<typename T>
    struct NodeResult
    {
       NodeResult() : level(0) {}
-      NodeResult(T v, bool level = 0) : value(v), level(level) {}
+      NodeResult(T v, int level = 0) : value(v), level(level) {}
       static void intersect(QSet<NodeResult<T>>& s1, const QSet<NodeResult<T>>& s2, int matchValue);
 
       T value;
@@ -61,7 +68,7 @@ namespace FM
          if (j == s2.constEnd())
             i.remove();
          else
-            const_cast<NodeResult<T>&>(node).level += j->level ? matchValue : 0;
+            const_cast<NodeResult<T>&>(node).level += j->level * matchValue;
       }
    }
 
@@ -112,6 +119,18 @@ namespace FM
 
       QList<NodeResult<T>> search(const QString& word, bool alsoFromSubNodes = false, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
 
+      /**
+        * Return the items whose word is at a Levenshtein distance of at most 'maxDistance' from the given word.
+        * If 'alsoFromSubNodes' is true the distance may also be measured against the beginning of the indexed words.
+        * The result is sorted by level, see 'NodeResult'.
+        */
+      QList<NodeResult<T>> searchFuzzy(const QString& word, int maxDistance, bool alsoFromSubNodes = false, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
+
+      /**
+        * Call 'fun' for each indexed word with the items associated to it, in no particular order.
+        */
+      void forall(std::function<void(const QString&, const QList<T>&)> fun) const;
+
       QString toStringDebug() const;
 
    private:
@@ -126,6 +145,8 @@ namespace FM
         */
       QList<NodeResult<T>> getItems(bool alsoFromSubNodes = false, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
 
+      void searchFuzzy(const QString& word, int maxDistance, bool alsoFromSubNodes, QVector<int> row, int bestPrefixDistance, const std::function<bool(const T&)>& predicat, QList<NodeResult<T>>& result) const;
+
       void remove(int i);
 
       QString part;
@@ -230,6 +251,48 @@ QList<FM::NodeResult<T>> FM::Node<T>::search(const QString& word, bool alsoFromS
    return nodes.first->children[nodes.second]->getItems(alsoFromSubNodes, maxNbResult, predicat);
 }
 
+/**
+  * The trie is traversed like a Levenshtein automaton: each character of a node part computes a new row of the
+  * edit distance matrix and a branch is abandoned as soon as all the values of the row exceed 'maxDistance'.
+  */
+template <typename T>
+QList<FM::NodeResult<T>> FM::Node<T>::searchFuzzy(const QString& word, int maxDistance, bool alsoFromSubNodes, int maxNbResult, std::function<bool(const T&)> predicat) const
+{
+   QList<NodeResult<T>> result;
+
+   QVector<int> firstRow(word.size() + 1);
+   for (int i = 0; i < firstRow.size(); i++)
+      firstRow[i] = i;
+
+   for (QListIterator<Node<T>*> i(this->children); i.hasNext();)
+      i.next()->searchFuzzy(word, maxDistance, alsoFromSubNodes, firstRow, std::numeric_limits<int>::max(), predicat, result);
+
+   std::stable_sort(result.begin(), result.end());
+
+   if (maxNbResult >= 0 && result.size() > maxNbResult)
+      result.erase(result.begin() + maxNbResult, result.end());
+
+   return result;
+}
+
+template <typename T>
+void FM::Node<T>::forall(std::function<void(const QString&, const QList<T>&)> fun) const
+{
+   QList<QPair<QString, const Node<T>*>> nodesToVisit { qMakePair(QString(), this) };
+
+   while (!nodesToVisit.isEmpty())
+   {
+      const QPair<QString, const Node<T>*> current = nodesToVisit.takeLast();
+      const QString word = current.first + current.second->part;
+
+      if (!current.second->items.isEmpty())
+         fun(word, current.second->items);
+
+      for (QListIterator<Node<T>*> i(current.second->children); i.hasNext();)
+         nodesToVisit << qMakePair(word, static_cast<const Node<T>*>(i.next()));
+   }
+}
+
 template <typename T>
 QString FM::Node<T>::toStringDebug() const
 {
@@ -341,6 +404,60 @@ QList<FM::NodeResult<T>> FM::Node<T>::getItems(bool alsoFromSubNodes, int maxNbR
    return result;
 }
 
+/**
+  * 'row' is the last row of the edit distance matrix computed by the parent node.
+  * 'bestPrefixDistance' is the smallest distance between the word and a beginning of the current path, only used if 'alsoFromSubNodes' is true.
+  */
+template <typename T>
+void FM::Node<T>::searchFuzzy(const QString& word, int maxDistance, bool alsoFromSubNodes, QVector<int> row, int bestPrefixDistance, const std::function<bool(const T&)>& predicat, QList<NodeResult<T>>& result) const
+{
+   const int n = word.size();
+   QVector<int> newRow(n + 1);
+
+   for (int i = 0; i < this->part.size(); i++)
+   {
+      newRow[0] = row[0] + 1;
+      int rowMin = newRow[0];
+      for (int j = 1; j <= n; j++)
+      {
+         newRow[j] = std::min(std::min(row[j] + 1, newRow[j - 1] + 1), row[j - 1] + (word[j - 1] == this->part[i] ? 0 : 1));
+         rowMin = std::min(rowMin, newRow[j]);
+      }
+      row.swap(newRow);
+
+      if (alsoFromSubNodes)
+         bestPrefixDistance = std::min(bestPrefixDistance, row[n]);
+
+      // No indexed word beginning with the current path can be close enough.
+      if (rowMin > maxDistance)
+      {
+         // But the current path is close enough to the beginning of the word, all the items below match.
+         if (bestPrefixDistance <= maxDistance)
+         {
+            QList<NodeResult<T>> items = this->getItems(true, -1, predicat);
+            for (QMutableListIterator<NodeResult<T>> k(items); k.hasNext();)
+               k.next().level = 2 * bestPrefixDistance + 1;
+            result << items;
+         }
+         return;
+      }
+   }
+
+   if (row[n] <= maxDistance || bestPrefixDistance <= maxDistance)
+   {
+      const int level = row[n] <= bestPrefixDistance ? 2 * row[n] : 2 * bestPrefixDistance + 1;
+      for (QListIterator<T> i(this->items); i.hasNext();)
+      {
+         const T& item = i.next();
+         if (!predicat || predicat(item))
+            result << NodeResult<T>(item, level);
+      }
+   }
+
+   for (QListIterator<Node<T>*> i(this->children); i.hasNext();)
+      i.next()->searchFuzzy(word, maxDistance, alsoFromSubNodes, row, bestPrefixDistance, predicat, result);
+}
+
 /**
   * Try to remove the i'th child.
   */
@@ -0,0 +1,334 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <functional>
+#include <algorithm>
+
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+
+#include <Common/Uncopyable.h>
+#include <Common/LogManager/ILoggable.h>
+
+#include <priv/WordIndex/Node.h>
+
+/**
+  * @class FM::TrigramIndex
+  *
+  * Index a set of items of type 'T' by all the substrings of three characters (trigrams) of their words.
+  * Unlike 'WordIndex' which only matches the beginning of the words, a term can match anywhere inside a word,
+  * for example "remaster" matches "2011remastered".
+  *
+  * A search looks up the posting list of each trigram of the terms, intersects them and then verifies each
+  * candidate against its indexed name because having all the trigrams doesn't mean containing the term.
+  * The items are appended to the posting lists, a posting list is sorted only when a search needs it.
+  * Keeping them always sorted would cost a linear insertion for each item of a common trigram.
+  *
+  * Terms shorter than 'GRAM_SIZE' can't be looked up, they are only used during the verification.
+  * If all the terms are too short, see 'isSearchable(..)', the caller should use the 'WordIndex' instead.
+  *
+  * The words given to the index must already be normalized, see 'Common::StringUtils::splitInWords(..)'.
+  *
+  * This class is thread safe.
+  */
+
+namespace FM
+{
+   template<typename T>
+   class TrigramIndex : public LM::ILoggable, Common::Uncopyable
+   {
+   public:
+      static const int GRAM_SIZE;
+
+      TrigramIndex();
+
+      void addItem(const QStringList& words, const T& item);
+      bool rmItem(const T& item);
+      void renameItem(const QStringList& newWords, const T& item);
+
+      QList<NodeResult<T>> search(const QStringList& terms, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
+
+      int nbItems() const;
+      int nbTrigrams() const;
+
+      QString toStringLog() const;
+
+      static bool isSearchable(const QStringList& terms);
+
+   private:
+      typedef quint64 Trigram;
+
+      static QSet<Trigram> getTrigrams(const QStringList& words);
+      static int matchLevel(const QString& name, const QStringList& terms);
+
+      const QVector<T>& sortPosting(typename QHash<Trigram, QVector<T>>::iterator posting) const;
+
+      mutable QHash<Trigram, QVector<T>> postings; ///< For each trigram the list of items having it, sorted if the trigram isn't in 'unsortedPostings'.
+      mutable QSet<Trigram> unsortedPostings; ///< The posting lists having some items appended since their last sort.
+      QHash<T, QString> names; ///< The indexed words of each item joined by a space, used to verify the candidates.
+      mutable QMutex mutex;
+   };
+}
+
+template<typename T>
+const int FM::TrigramIndex<T>::GRAM_SIZE(3);
+
+template<typename T>
+FM::TrigramIndex<T>::TrigramIndex() :
+   mutex(QMutex::Recursive)
+{
+}
+
+/**
+  * If the item is already indexed its previous words are replaced.
+  */
+template<typename T>
+void FM::TrigramIndex<T>::addItem(const QStringList& words, const T& item)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (this->names.contains(item))
+      this->rmItem(item);
+
+   const QSet<Trigram>& trigrams = TrigramIndex<T>::getTrigrams(words);
+   for (QSetIterator<Trigram> i(trigrams); i.hasNext();)
+   {
+      const Trigram trigram = i.next();
+      QVector<T>& posting = this->postings[trigram];
+      if (!posting.isEmpty() && !(posting.last() < item))
+         this->unsortedPostings.insert(trigram);
+      posting << item; // The item can't be already in the list, see the 'rmItem(..)' above.
+   }
+
+   this->names.insert(item, words.join(' '));
+}
+
+/**
+  * @return 'true' if the item was indexed.
+  */
+template<typename T>
+bool FM::TrigramIndex<T>::rmItem(const T& item)
+{
+   QMutexLocker locker(&this->mutex);
+
+   auto name = this->names.find(item);
+   if (name == this->names.end())
+      return false;
+
+   const QSet<Trigram>& trigrams = TrigramIndex<T>::getTrigrams(name->split(' ', QString::SkipEmptyParts));
+   for (QSetIterator<Trigram> i(trigrams); i.hasNext();)
+   {
+      const Trigram trigram = i.next();
+      auto posting = this->postings.find(trigram);
+      if (posting == this->postings.end())
+         continue;
+
+      if (this->unsortedPostings.contains(trigram))
+      {
+         // The order doesn't matter, the last item takes the place of the removed one.
+         auto j = std::find(posting->begin(), posting->end(), item);
+         if (j != posting->end())
+         {
+            *j = posting->last();
+            posting->removeLast();
+         }
+      }
+      else
+      {
+         auto j = std::lower_bound(posting->begin(), posting->end(), item);
+         if (j != posting->end() && *j == item)
+            posting->erase(j);
+      }
+
+      if (posting->isEmpty())
+      {
+         this->unsortedPostings.remove(trigram);
+         this->postings.erase(posting);
+      }
+   }
+
+   this->names.erase(name);
+   return true;
+}
+
+template<typename T>
+void FM::TrigramIndex<T>::renameItem(const QStringList& newWords, const T& item)
+{
+   QMutexLocker locker(&this->mutex);
+   this->rmItem(item);
+   this->addItem(newWords, item);
+}
+
+/**
+  * Return the items containing all the given terms sorted by level.
+  * The level is the number of terms which don't match the beginning of a word, thus an item matching like the 'WordIndex' has a level of 0.
+  */
+template<typename T>
+QList<FM::NodeResult<T>> FM::TrigramIndex<T>::search(const QStringList& terms, int maxNbResult, std::function<bool(const T&)> predicat) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   QList<NodeResult<T>> result;
+
+   const QSet<Trigram>& trigrams = TrigramIndex<T>::getTrigrams(terms);
+   if (trigrams.isEmpty())
+      return result;
+
+   QList<const QVector<T>*> postingsToIntersect;
+   for (QSetIterator<Trigram> i(trigrams); i.hasNext();)
+   {
+      auto posting = this->postings.find(i.next());
+      if (posting == this->postings.end())
+         return result; // One trigram is unknown -> no item can match.
+      postingsToIntersect << &this->sortPosting(posting);
+   }
+
+   // We begin with the smallest list, the size of the candidates can only decrease.
+   std::sort(postingsToIntersect.begin(), postingsToIntersect.end(), [](const QVector<T>* p1, const QVector<T>* p2) { return p1->size() < p2->size(); });
+
+   QVector<T> candidates = *postingsToIntersect.first();
+   for (int i = 1; i < postingsToIntersect.size() && !candidates.isEmpty(); i++)
+   {
+      const QVector<T>& posting = *postingsToIntersect[i];
+      candidates.erase(
+         std::remove_if(candidates.begin(), candidates.end(), [&](const T& candidate) { return !std::binary_search(posting.begin(), posting.end(), candidate); }),
+         candidates.end()
+      );
+   }
+
+   // Verification. All the candidates are verified, the best levels may be at the end of the posting lists.
+   for (auto i = candidates.constBegin(); i != candidates.constEnd(); ++i)
+   {
+      const int level = TrigramIndex<T>::matchLevel(this->names.value(*i), terms);
+      if (level != -1 && (!predicat || predicat(*i)))
+      {
+         NodeResult<T> nodeResult(*i);
+         nodeResult.level = level;
+         result << nodeResult;
+      }
+   }
+
+   std::stable_sort(result.begin(), result.end());
+
+   if (maxNbResult >= 0 && result.size() > maxNbResult)
+      result.erase(result.begin() + maxNbResult, result.end());
+
+   return result;
+}
+
+template<typename T>
+int FM::TrigramIndex<T>::nbItems() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->names.size();
+}
+
+template<typename T>
+int FM::TrigramIndex<T>::nbTrigrams() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->postings.size();
+}
+
+template<typename T>
+QString FM::TrigramIndex<T>::toStringLog() const
+{
+   QMutexLocker locker(&this->mutex);
+
+   qint64 nbPostings = 0;
+   for (auto i = this->postings.constBegin(); i != this->postings.constEnd(); ++i)
+      nbPostings += i->size();
+
+   return QString("TrigramIndex: %1 items, %2 trigrams, %3 postings").arg(this->names.size()).arg(this->postings.size()).arg(nbPostings);
+}
+
+/**
+  * Sort the given posting list if some items have been appended to it since its last sort.
+  * 'mutex' must be locked.
+  */
+template<typename T>
+const QVector<T>& FM::TrigramIndex<T>::sortPosting(typename QHash<Trigram, QVector<T>>::iterator posting) const
+{
+   if (this->unsortedPostings.remove(posting.key()))
+      std::sort(posting->begin(), posting->end());
+   return posting.value();
+}
+
+/**
+  * Returns 'true' if at least one term is long enough to be looked up.
+  */
+template<typename T>
+bool FM::TrigramIndex<T>::isSearchable(const QStringList& terms)
+{
+   for (QStringListIterator i(terms); i.hasNext();)
+      if (i.next().size() >= GRAM_SIZE)
+         return true;
+   return false;
+}
+
+/**
+  * The trigrams overlapping two words are not indexed, a term never contains a space.
+  */
+template<typename T>
+QSet<typename FM::TrigramIndex<T>::Trigram> FM::TrigramIndex<T>::getTrigrams(const QStringList& words)
+{
+   QSet<Trigram> trigrams;
+   for (QStringListIterator i(words); i.hasNext();)
+   {
+      const QString& word = i.next();
+      for (int j = 0; j <= word.size() - GRAM_SIZE; j++)
+         trigrams.insert(
+            static_cast<Trigram>(word[j].unicode()) << 32 |
+            static_cast<Trigram>(word[j + 1].unicode()) << 16 |
+            static_cast<Trigram>(word[j + 2].unicode())
+         );
+   }
+   return trigrams;
+}
+
+/**
+  * @return -1 if at least one term isn't contained in the name.
+  */
+template<typename T>
+int FM::TrigramIndex<T>::matchLevel(const QString& name, const QStringList& terms)
+{
+   int level = 0;
+   for (QStringListIterator i(terms); i.hasNext();)
+   {
+      const QString& term = i.next();
+
+      int position = name.indexOf(term);
+      if (position == -1)
+         return -1;
+
+      // Looking for an occurrence at the beginning of a word.
+      while (position > 0 && name[position - 1] != ' ')
+         position = name.indexOf(term, position + 1);
+
+      if (position == -1)
+         level += 1;
+   }
+   return level;
+}
@@ -22,6 +22,8 @@
 #include <algorithm>
 
 #include <QList>
+#include <QVector>
+#include <QSet>
 #include <QString>
 #include <QChar>
 #include <QMutex>
@@ -48,6 +50,7 @@ namespace FM
    public:
       static const int MIN_WORD_SIZE_PARTIAL_MATCH; ///< During a search, the words which have a size below this value must match entirely, for exemple 'of' match "conspiracy of one" and not "offspring".
       static const int MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN;
+      static const int MIN_WORD_SIZE_PER_ERROR; ///< When searching with a tolerance to errors, a word may contain one error for each 'MIN_WORD_SIZE_PER_ERROR' characters. Shorter words would match too many indexed words.
 
       WordIndex();
 
@@ -58,11 +61,14 @@ namespace FM
       void renameItem(const QString& oldWord, const QString& newWord, const T& item);
       void renameItem(const QStringList& oldWords, const QStringList& newWords, const T& item);
 
-      QList<NodeResult<T>> search(const QString& word, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
-      QList<NodeResult<T>> search(const QStringList& words, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
+      QList<NodeResult<T>> search(const QString& word, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr, int maxDistance = 0) const;
+      QList<NodeResult<T>> search(const QStringList& words, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr, int maxDistance = 0) const;
+
+      void forall(std::function<void(const QString&, const QList<T>&)> fun) const;
 
       QString toStringLog() const;
 
+      static QList<NodeResult<T>> mergeResults(const QVector<QSet<NodeResult<T>>>& results, int maxNbResult);
       static QList<T> resultToList(const QList<NodeResult<T>>& result);
 
    private:
@@ -77,6 +83,9 @@ const int FM::WordIndex<T>::MIN_WORD_SIZE_PARTIAL_MATCH(3);
 template<typename T>
 const int FM::WordIndex<T>::MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN(1);
 
+template<typename T>
+const int FM::WordIndex<T>::MIN_WORD_SIZE_PER_ERROR(3);
+
 template<typename T>
    FM::WordIndex<T>::WordIndex() :
       mutex(QMutex::Recursive)
@@ -138,19 +147,28 @@ void FM::WordIndex<T>::renameItem(const QStringList& oldWords, const QStringList
 /**
   * Return a an unordered list of 'NodeResult' matching the given word. If 'NodeResult::level' is 0 then the item matches entirely the given word otherwise (level is 1) the word match the begining of the indexed string.
   * There is a particular case when the word length is below 'MIN_WORD_SIZE_PARTIAL_MATCH', see the comment associated to this constant for more information.
+  * If 'maxDistance' is greater than 0 the indexed words may differ from the given word by this number of insertions, deletions or substitutions, see 'MIN_WORD_SIZE_PER_ERROR'.
+  * In this case the list is sorted by level.
   */
 template<typename T>
-QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QString& word, int maxNbResult, std::function<bool(const T&)> predicat) const
+QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QString& word, int maxNbResult, std::function<bool(const T&)> predicat, int maxDistance) const
 {
    QMutexLocker locker(&this->mutex);
-   return this->root.search(word, word.size() >= (Common::StringUtils::isKorean(word) ? MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN : MIN_WORD_SIZE_PARTIAL_MATCH), maxNbResult, predicat);
+
+   const bool partialMatch = word.size() >= (Common::StringUtils::isKorean(word) ? MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN : MIN_WORD_SIZE_PARTIAL_MATCH);
+   maxDistance = std::min(maxDistance, word.size() / MIN_WORD_SIZE_PER_ERROR);
+
+   if (maxDistance > 0)
+      return this->root.searchFuzzy(word, maxDistance, partialMatch, maxNbResult, predicat);
+
+   return this->root.search(word, partialMatch, maxNbResult, predicat);
 }
 
 /**
   * @see http://dev.euphorik.ch/wiki/pmp/Algorithms#Word-indexing for more information.
   */
 template<typename T>
-QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int maxNbResult, std::function<bool(const T&)> predicat) const
+QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int maxNbResult, std::function<bool(const T&)> predicat, int maxDistance) const
 {
    QMutexLocker locker(&this->mutex);
 
@@ -161,12 +179,45 @@ QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int
    for (int i = 0; i < N; i++)
    {
       // We can only limit the number of result for one term. When there is more than one term and thus some results set, say [a, b, c] for example, some good result may be contained in intersect, for example a & b or a & c.
-      auto result = this->search(words[i], N == 1 ? maxNbResult : -1, predicat);
+      auto result = this->search(words[i], N == 1 ? maxNbResult : -1, predicat, maxDistance);
       results[i] += QSet(result.begin(), result.end());
    }
 
+   return WordIndex<T>::mergeResults(results, maxNbResult);
+}
+
+template<typename T>
+void FM::WordIndex<T>::forall(std::function<void(const QString&, const QList<T>&)> fun) const
+{
+   QMutexLocker locker(&this->mutex);
+   this->root.forall(fun);
+}
+
+template<typename T>
+QString FM::WordIndex<T>::toStringLog() const
+{
+   QMutexLocker locker(&mutex);
+   return this->root.toStringDebug();
+}
+
+/**
+  * Combine the results of each searched word, 'results[i]' being the result of the i'th word.
+  * The items matching all the words come first, then the ones matching all the words but one, and so on.
+  * Each group has its own band of levels, its width depends on the greatest level of a word (greater than 1 with the fuzzy search)
+  * to keep an item matching more words before an item matching less words.
+  */
+template<typename T>
+QList<FM::NodeResult<T>> FM::WordIndex<T>::mergeResults(const QVector<QSet<NodeResult<T>>>& results, int maxNbResult)
+{
+   const int N = results.size();
+
    QList<NodeResult<T>> finalResult;
 
+   int maxWordLevel = 1;
+   for (int i = 0; i < N; i++)
+      for (QSetIterator<NodeResult<T>> j(results[i]); j.hasNext();)
+         maxWordLevel = std::max(maxWordLevel, j.next().level);
+
    int level = 0;
 
    // For each group of intersection number.
@@ -197,7 +248,7 @@ QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int
          for (QSetIterator<NodeResult<T>> k(currentLevelSet); k.hasNext();)
          {
             NodeResult<T>& node = const_cast<NodeResult<T>&>(k.next());
-            node.level = node.level ? NB_COMBINATIONS : 0;
+            node.level = node.level * NB_COMBINATIONS;
          }
 
          for (int k = 1; k < NB_INTERSECTS; k++)
@@ -231,7 +282,7 @@ QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int
 
       finalResult << nodesToSort;
 
-      level += NB_COMBINATIONS * NB_INTERSECTS;
+      level += NB_COMBINATIONS * NB_INTERSECTS * maxWordLevel;
    }
 
    if (finalResult.size() > maxNbResult)
@@ -240,13 +291,6 @@ QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int
    return finalResult;
 }
 
-template<typename T>
-QString FM::WordIndex<T>::toStringLog() const
-{
-   QMutexLocker locker(&mutex);
-   return this->root.toStringDebug();
-}
-
 template<typename T>
 QList<T> FM::WordIndex<T>::resultToList(const QList<NodeResult<T>>& result)
 {
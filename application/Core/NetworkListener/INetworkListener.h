@@ -56,6 +56,20 @@ namespace NL
         */
       virtual SendStatus send(Common::MessageHeader::MessageType type, const google::protobuf::Message& message, const Common::Hash& peerID = Common::Hash()) = 0;
 
+      struct FindStats
+      {
+         int nbPendingFinds;
+         quint64 nbDroppedFinds; ///< Rejected because the queue was full or the peer had too many pending finds, or processed too late.
+         int latencyMedian; ///< [ms]. From the reception of a 'Find' to its results, -1 if unknown.
+         int latency95; ///< [ms].
+         int latency99; ///< [ms].
+      };
+
+      /**
+        * Statistics about the processing of the 'Find' messages received from the other peers.
+        */
+      virtual FindStats getFindStats() const = 0;
+
    signals:
       void received(const Common::Message& message);
       void IMAliveMessageToBeSend(Protos::Core::IMAlive& IMAliveMessage);
@@ -15,7 +15,14 @@ INCLUDEPATH += . \
     ../..
 
 DEFINES += NETWORKLISTENER_LIBRARY
+
+win32:LIBS += -lws2_32 # 'select(..)' and 'recvfrom(..)', see 'DatagramReceiver'.
+
 SOURCES += priv/UDPListener.cpp \
+    priv/DatagramReceiver.cpp \
+    priv/DatagramSender.cpp \
+    priv/FindProcessor.cpp \
+    priv/LocateQueries.cpp \
     priv/TCPListener.cpp \
     priv/Search.cpp \
     priv/NetworkListener.cpp \
@@ -27,6 +34,10 @@ SOURCES += priv/UDPListener.cpp \
 HEADERS += ISearch.h \
     INetworkListener.h \
     priv/UDPListener.h \
+    priv/DatagramReceiver.h \
+    priv/DatagramSender.h \
+    priv/FindProcessor.h \
+    priv/LocateQueries.h \
     priv/TCPListener.h \
     priv/Search.h \
     priv/NetworkListener.h \
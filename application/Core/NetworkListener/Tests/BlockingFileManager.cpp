@@ -0,0 +1,63 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#include <BlockingFileManager.h>
+
+#include <QMutexLocker>
+
+BlockingFileManager::BlockingFileManager() :
+   blocked(false), nbRunningFinds(0)
+{
+}
+
+/**
+  * While blocked the searches wait, they all continue once unblocked.
+  */
+void BlockingFileManager::setBlocked(bool blocked)
+{
+   QMutexLocker locker(&this->mutex);
+   this->blocked = blocked;
+   if (!blocked)
+      this->unblocked.wakeAll();
+}
+
+/**
+  * The number of searches currently waiting to be unblocked or running.
+  */
+int BlockingFileManager::getNbRunningFinds() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->nbRunningFinds;
+}
+
+QList<Protos::Common::FindResult> BlockingFileManager::find(const QString&, int, int)
+{
+   return this->find(QString(), QList<QString>(), 0, 0, Protos::Common::FindPattern::FILE_DIR, 0, 0, false, 0);
+}
+
+QList<Protos::Common::FindResult> BlockingFileManager::find(const QString&, const QList<QString>&, qint64, qint64, Protos::Common::FindPattern_Category, int, int, bool, int)
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->nbRunningFinds++;
+   while (this->blocked)
+      this->unblocked.wait(&this->mutex);
+   this->nbRunningFinds--;
+
+   return QList<Protos::Common::FindResult>() << Protos::Common::FindResult();
+}
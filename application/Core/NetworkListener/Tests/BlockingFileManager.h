@@ -0,0 +1,65 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#pragma once
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <FileManager/IFileManager.h>
+
+/**
+  * A file manager without any entry. Its searches return one empty result and can be blocked to keep the workers
+  * of a 'FindProcessor' busy, see 'setBlocked(..)'.
+  */
+class BlockingFileManager : public FM::IFileManager
+{
+public:
+   BlockingFileManager();
+
+   void setBlocked(bool blocked);
+   int getNbRunningFinds() const;
+
+   void setSharedDirs(const QStringList&) {}
+   QPair<Common::SharedDir, QString> addASharedDir(const QString&) { return QPair<Common::SharedDir, QString>(); }
+   QList<Common::SharedDir> getSharedDirs() const { return QList<Common::SharedDir>(); }
+   QString getSharedDir(const Common::Hash&) const { return QString(); }
+   QSharedPointer<FM::IChunk> getChunk(const Common::Hash&) const { return QSharedPointer<FM::IChunk>(); }
+   QList<QSharedPointer<FM::IChunk>> getAllChunks(const Protos::Common::Entry&, const Common::Hashes&) const { return QList<QSharedPointer<FM::IChunk>>(); }
+   QList<QSharedPointer<FM::IChunk>> newFile(Protos::Common::Entry&) { return QList<QSharedPointer<FM::IChunk>>(); }
+   void newDirectory(Protos::Common::Entry&) {}
+   QSharedPointer<FM::IGetHashesResult> getHashes(const Protos::Common::Entry&) { return QSharedPointer<FM::IGetHashesResult>(); }
+   QSharedPointer<FM::IGetEntriesResult> getScannedEntries(const Protos::Common::Entry&, int) { return QSharedPointer<FM::IGetEntriesResult>(); }
+   Protos::Common::Entries getEntries(const Protos::Common::Entry&, int) { return Protos::Common::Entries(); }
+   Protos::Common::Entries getEntries() { return Protos::Common::Entries(); }
+   QList<Protos::Common::FindResult> find(const QString&, int, int);
+   QList<Protos::Common::FindResult> find(const QString&, const QList<QString>&, qint64, qint64, Protos::Common::FindPattern_Category, int, int, bool, int);
+   QBitArray haveChunks(const QList<Common::Hash>& hashes) { return QBitArray(hashes.size()); }
+   QBitArray haveChunks(const QList<quint64>& hashPrefixes) { return QBitArray(hashPrefixes.size()); }
+   quint64 getAmount() { return 0; }
+   CacheStatus getCacheStatus() const { return UP_TO_DATE; }
+   int getProgress() const { return 0; }
+   void dumpWordIndex() const {}
+   void printSimilarFiles() const {}
+
+private:
+   mutable QMutex mutex;
+   QWaitCondition unblocked;
+   bool blocked;
+   int nbRunningFinds;
+};
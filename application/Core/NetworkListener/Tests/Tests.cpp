@@ -21,6 +21,7 @@
 #include <Builder.h>
 
 #include <QTest>
+#include <QUdpSocket>
 
 using namespace NL;
 
@@ -30,6 +31,7 @@ using namespace NL;
 #include <NetworkListener/Builder.h>
 #include <NetworkListener/IChat.h>
 #include <PeerManager/Builder.h>
+#include <priv/DatagramSender.h>
 
 
 Tests::Tests()
@@ -96,3 +98,288 @@ void Tests::messageRecevied(const Protos::Core::ChatMessage& message)
    if ( QString::fromStdString(message.message()) == "TEST")
       this->isMessageRecevied = true;
 }
+
+/**
+ * Send a datagram by unicast to several sockets listening on the loopback interface, see 'DatagramSender'.
+ */
+void Tests::sendDatagramToSeveralPeers()
+{
+   const int NB_PEERS = 3;
+
+   QUdpSocket senderSocket;
+   QVERIFY(senderSocket.bind(QHostAddress::LocalHost, 0));
+
+   QList<QSharedPointer<QUdpSocket>> receiverSockets;
+   QList<DatagramSender::Destination> destinations;
+   for (int i = 0; i < NB_PEERS; i++)
+   {
+      QSharedPointer<QUdpSocket> receiverSocket(new QUdpSocket());
+      QVERIFY(receiverSocket->bind(QHostAddress::LocalHost, 0)); // Each socket has its own port.
+      destinations << DatagramSender::Destination { QHostAddress(QHostAddress::LocalHost), receiverSocket->localPort() };
+      receiverSockets << receiverSocket;
+   }
+
+   const QByteArray data("IMAlive");
+   QCOMPARE(DatagramSender::send(senderSocket, data.constData(), data.size(), destinations), NB_PEERS);
+
+   for (QListIterator<QSharedPointer<QUdpSocket>> i(receiverSockets); i.hasNext();)
+   {
+      QSharedPointer<QUdpSocket> receiverSocket = i.next();
+      QVERIFY(receiverSocket->hasPendingDatagrams() || receiverSocket->waitForReadyRead(1000));
+
+      QByteArray receivedData(static_cast<int>(receiverSocket->pendingDatagramSize()), 0);
+      quint16 senderPort;
+      QCOMPARE(receiverSocket->readDatagram(receivedData.data(), receivedData.size(), nullptr, &senderPort), static_cast<qint64>(data.size()));
+      QCOMPARE(receivedData, data);
+      QCOMPARE(senderPort, senderSocket.localPort());
+   }
+}
+
+#include <QElapsedTimer>
+
+#include <Protos/core_protocol.pb.h>
+
+#include <Common/Network/Message.h>
+#include <priv/DatagramReceiver.h>
+
+/**
+  * More datagrams than 'DatagramReceiver::BATCH_SIZE' are waiting on a socket when a 'DatagramReceiver' starts to read it: they are all
+  * taken at once. Then the receiver is stopped and started again on a new socket, like in 'UDPListener::rebindSockets()'.
+  */
+void Tests::receiveDatagramsByBatch()
+{
+   const int NB_DATAGRAMS = 40;
+
+   QUdpSocket senderSocket;
+   QVERIFY(senderSocket.bind(QHostAddress::LocalHost, 0));
+
+   // The tag of each 'Find' message is its number.
+   auto sendDatagrams = [&](quint16 port, int first)
+   {
+      char buffer[1024];
+      for (int i = first; i < first + NB_DATAGRAMS; i++)
+      {
+         Protos::Core::Find findMessage;
+         findMessage.set_tag(i);
+         const Common::MessageHeader header(Common::MessageHeader::CORE_FIND, findMessage.ByteSizeLong(), Common::Hash::rand());
+         const int size = Common::Message::writeMessageToBuffer(buffer, sizeof(buffer), header, &findMessage);
+         if (size == 0 || senderSocket.writeDatagram(buffer, size, QHostAddress::LocalHost, port) != size)
+            return false;
+      }
+      return true;
+   };
+
+   auto checkDatagrams = [&](const QList<DatagramReceiver::Datagram>& datagrams, int first)
+   {
+      if (datagrams.size() != NB_DATAGRAMS)
+         return false;
+      for (int i = 0; i < NB_DATAGRAMS; i++)
+         if (datagrams[i].multicast || datagrams[i].peerAddress != QHostAddress(QHostAddress::LocalHost) ||
+             datagrams[i].message.getHeader().getType() != Common::MessageHeader::CORE_FIND ||
+             datagrams[i].message.getMessage<Protos::Core::Find>().tag() != static_cast<quint64>(first + i))
+            return false;
+      return true;
+   };
+
+   QUdpSocket receiverSocket1;
+   QVERIFY(receiverSocket1.bind(QHostAddress::LocalHost, 0));
+   QVERIFY(sendDatagrams(receiverSocket1.localPort(), 0));
+
+   DatagramReceiver receiver;
+   int nbDatagramsReceivedSignals = 0;
+   connect(&receiver, &DatagramReceiver::datagramsReceived, this, [&]() { nbDatagramsReceivedSignals++; }, Qt::QueuedConnection);
+
+   receiver.startReceiving(-1, receiverSocket1.socketDescriptor());
+   QTest::qWait(500);
+   QCOMPARE(nbDatagramsReceivedSignals, 1);
+   QVERIFY(checkDatagrams(receiver.takeDatagrams(), 0));
+
+   // Once stopped, the socket isn't read anymore.
+   receiver.stop();
+   QVERIFY(sendDatagrams(receiverSocket1.localPort(), NB_DATAGRAMS));
+   QTest::qWait(100);
+   QVERIFY(receiver.takeDatagrams().isEmpty());
+   QVERIFY(receiverSocket1.hasPendingDatagrams());
+   receiverSocket1.close();
+
+   QUdpSocket receiverSocket2;
+   QVERIFY(receiverSocket2.bind(QHostAddress::LocalHost, 0));
+   receiver.startReceiving(-1, receiverSocket2.socketDescriptor());
+   QVERIFY(sendDatagrams(receiverSocket2.localPort(), 2 * NB_DATAGRAMS));
+
+   QList<DatagramReceiver::Datagram> datagrams;
+   QElapsedTimer timer;
+   timer.start();
+   while (datagrams.size() < NB_DATAGRAMS && timer.elapsed() < 2000)
+   {
+      QTest::qWait(50);
+      datagrams << receiver.takeDatagrams();
+   }
+   QVERIFY(checkDatagrams(datagrams, 2 * NB_DATAGRAMS));
+
+   receiver.stop();
+}
+
+#include <Common/Settings.h>
+
+#include <priv/FindProcessor.h>
+#include <BlockingFileManager.h>
+
+/**
+  * The only worker of the 'FindProcessor' is blocked by the file manager while the finds are added.
+  */
+void Tests::findProcessorLimits()
+{
+   const int DEADLINE = 500; // [ms].
+
+   SETTINGS.set("find_nb_threads", 1u);
+   SETTINGS.set("find_queue_size", 3u);
+   SETTINGS.set("find_max_pending_per_peer", 2u);
+   SETTINGS.set("search_lifetime", static_cast<quint32>(DEADLINE));
+
+   QSharedPointer<BlockingFileManager> fileManager(new BlockingFileManager());
+   fileManager->setBlocked(true);
+   FindProcessor findProcessor(fileManager, 8000);
+
+   const Common::Hash peerA = Common::Hash::rand();
+   const Common::Hash peerB = Common::Hash::rand();
+   const Common::Hash peerC = Common::Hash::rand();
+   const Common::Hash peerD = Common::Hash::rand();
+   Protos::Core::Find findMessage;
+
+   QVERIFY(findProcessor.add(peerA, findMessage));
+   for (int i = 0; i < 50 && fileManager->getNbRunningFinds() == 0; i++)
+      QTest::qSleep(10);
+   QCOMPARE(fileManager->getNbRunningFinds(), 1);
+
+   QVERIFY(findProcessor.add(peerA, findMessage));
+   QVERIFY(!findProcessor.add(peerA, findMessage)); // 'find_max_pending_per_peer', the running find is counted.
+   QVERIFY(findProcessor.add(peerB, findMessage));
+   QVERIFY(findProcessor.add(peerC, findMessage));
+   QVERIFY(!findProcessor.add(peerD, findMessage)); // 'find_queue_size'.
+
+   INetworkListener::FindStats stats = findProcessor.getStats();
+   QCOMPARE(stats.nbPendingFinds, 3);
+   QCOMPARE(stats.nbDroppedFinds, quint64(2));
+   QCOMPARE(stats.latencyMedian, -1);
+
+   // The running find and the queued ones exceed 'search_lifetime': the results of the first are dropped, the others aren't processed.
+   QTest::qSleep(DEADLINE + 100);
+   fileManager->setBlocked(false);
+   for (int i = 0; i < 50 && findProcessor.getStats().nbDroppedFinds < 6; i++)
+      QTest::qSleep(10);
+
+   stats = findProcessor.getStats();
+   QCOMPARE(stats.nbPendingFinds, 0);
+   QCOMPARE(stats.nbDroppedFinds, quint64(6));
+   QVERIFY(stats.latencyMedian >= DEADLINE);
+   QCOMPARE(fileManager->getNbRunningFinds(), 0);
+   QVERIFY(findProcessor.takeResults().isEmpty());
+
+   // Nothing is pending anymore for 'peerA'.
+   findMessage.set_tag(42);
+   QVERIFY(findProcessor.add(peerA, findMessage));
+   QList<FindProcessor::Results> results;
+   for (int i = 0; i < 50 && results.isEmpty(); i++)
+   {
+      QTest::qSleep(10);
+      results = findProcessor.takeResults();
+   }
+   QCOMPARE(results.size(), 1);
+   QCOMPARE(results.first().peerID, peerA);
+   QCOMPARE(results.first().findResults.size(), 1);
+   QCOMPARE(results.first().findResults.first().tag(), quint64(42));
+}
+
+void Tests::findLatencyPercentiles()
+{
+   INetworkListener::FindStats stats { 0, 0, -1, -1, -1 };
+
+   FindProcessor::setLatencyPercentiles(QVector<int>(), stats);
+   QCOMPARE(stats.latencyMedian, -1);
+   QCOMPARE(stats.latency95, -1);
+   QCOMPARE(stats.latency99, -1);
+
+   FindProcessor::setLatencyPercentiles(QVector<int> { 7 }, stats);
+   QCOMPARE(stats.latencyMedian, 7);
+   QCOMPARE(stats.latency95, 7);
+   QCOMPARE(stats.latency99, 7);
+
+   // From 100 ms to 1 ms, they are sorted before.
+   QVector<int> latencies;
+   for (int i = 100; i >= 1; i--)
+      latencies << i;
+   FindProcessor::setLatencyPercentiles(latencies, stats);
+   QCOMPARE(stats.latencyMedian, 50);
+   QCOMPARE(stats.latency95, 95);
+   QCOMPARE(stats.latency99, 99);
+}
+
+#include <priv/LocateQueries.h>
+
+/**
+  * The replies ('ChunksOwned') are matched by tag to the queries ('HaveChunks') of the current and the previous period.
+  */
+void Tests::locateQueriesTags()
+{
+   // The lists are only distinguished by their size.
+   const QList<QSharedPointer<DM::IChunkDownloader>> chunks1 { QSharedPointer<DM::IChunkDownloader>() };
+   const QList<QSharedPointer<DM::IChunkDownloader>> chunks2 { QSharedPointer<DM::IChunkDownloader>(), QSharedPointer<DM::IChunkDownloader>() };
+
+   LocateQueries queries;
+   QVERIFY(!queries.get(1));
+
+   queries.add(1, chunks1);
+   QVERIFY(queries.get(1));
+   QCOMPARE(queries.get(1)->size(), 1);
+   QVERIFY(!queries.get(2));
+
+   // A query is still known during the next period.
+   queries.nextPeriod();
+   queries.add(2, chunks2);
+   QCOMPARE(queries.get(1)->size(), 1);
+   QCOMPARE(queries.get(2)->size(), 2);
+
+   // And then forgotten.
+   queries.nextPeriod();
+   QVERIFY(!queries.get(1));
+   QCOMPARE(queries.get(2)->size(), 2);
+
+   queries.nextPeriod();
+   QVERIFY(!queries.get(2));
+}
+
+#include <priv/UDPListener.h>
+
+/**
+  * The states of the chunks sent in a 'ChunksOwned' message by the recent peers, the number of chunks isn't a multiple of 8.
+  */
+void Tests::chunkBitmapRoundTrip()
+{
+   QBitArray chunkStates(11);
+   chunkStates.setBit(0);
+   chunkStates.setBit(3);
+   chunkStates.setBit(8);
+   chunkStates.setBit(10);
+
+   Protos::Core::ChunksOwned chunksOwnedMessage;
+   UDPListener::setChunkBitmap(chunksOwnedMessage, chunkStates);
+
+   // The first chunk is the least significant bit, the last byte is padded with zeros.
+   QCOMPARE(chunksOwnedMessage.chunk_bitmap().size(), size_t(2));
+   QCOMPARE(static_cast<quint8>(chunksOwnedMessage.chunk_bitmap()[0]), quint8(0x09));
+   QCOMPARE(static_cast<quint8>(chunksOwnedMessage.chunk_bitmap()[1]), quint8(0x05));
+
+   Protos::Core::ChunksOwned receivedMessage;
+   QVERIFY(receivedMessage.ParseFromString(chunksOwnedMessage.SerializeAsString()));
+
+   QBitArray receivedChunkStates;
+   QVERIFY(UDPListener::getChunkBitmap(receivedMessage, chunkStates.size(), receivedChunkStates));
+   QCOMPARE(receivedChunkStates, chunkStates);
+
+   // The size of the bitmap must match the number of queried chunks.
+   QVERIFY(!UDPListener::getChunkBitmap(receivedMessage, 17, receivedChunkStates));
+   QVERIFY(!UDPListener::getChunkBitmap(receivedMessage, 8, receivedChunkStates));
+   QVERIFY(UDPListener::getChunkBitmap(receivedMessage, 9, receivedChunkStates));
+   QCOMPARE(receivedChunkStates.size(), 9);
+}
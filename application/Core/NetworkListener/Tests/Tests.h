@@ -46,6 +46,12 @@ private slots:
    void testSending();
    void testReception();
    void messageRecevied(const Protos::Core::ChatMessage& message);
+   void sendDatagramToSeveralPeers();
+   void receiveDatagramsByBatch();
+   void findProcessorLimits();
+   void findLatencyPercentiles();
+   void locateQueriesTags();
+   void chunkBitmapRoundTrip();
 
 
 private :
@@ -42,5 +42,7 @@ CONFIG += console
 CONFIG -= app_bundle
 TEMPLATE = app
 SOURCES += main.cpp \
-    Tests.cpp
-HEADERS += Tests.h
+    Tests.cpp \
+    BlockingFileManager.cpp
+HEADERS += Tests.h \
+    BlockingFileManager.h
@@ -0,0 +1,234 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/DatagramReceiver.h>
+using namespace NL;
+
+#if defined(Q_OS_WIN32)
+   #include <winsock2.h>
+   typedef int socklen_t;
+#else
+   #include <cerrno>
+   #include <cstring>
+   #include <sys/types.h>
+   #include <sys/socket.h>
+   #include <sys/select.h>
+   #include <netinet/in.h>
+#endif
+
+#include <QMutexLocker>
+#include <QVector>
+
+#include <Common/Network/MessageHeader.h>
+
+#include <priv/Log.h>
+
+/**
+  * @class NL::DatagramReceiver
+  *
+  * Read the datagrams of the multicast and the unicast sockets in its own thread and decode them.
+  * The decoded messages are kept until they are taken by 'takeDatagrams()' from the main thread, thus
+  * a busy main thread doesn't make the socket receive buffers overflow.
+  *
+  * On Linux the datagrams are read by batch with 'recvmmsg(..)'.
+  *
+  * The sockets are owned by the caller ('QUdpSocket') which still binds, configures them and send the datagrams,
+  * the 'QUdpSocket' must not read them.
+  */
+
+DatagramReceiver::DatagramReceiver() :
+   multicastSocket(-1), unicastSocket(-1), toStop(false)
+{
+}
+
+DatagramReceiver::~DatagramReceiver()
+{
+   this->stop();
+}
+
+/**
+  * Start to read the given socket descriptors, -1 if a socket isn't available.
+  * The thread must be stopped, see 'stop()'.
+  */
+void DatagramReceiver::startReceiving(qintptr multicastSocket, qintptr unicastSocket)
+{
+   this->multicastSocket = multicastSocket;
+   this->unicastSocket = unicastSocket;
+   this->toStop = false;
+   this->start();
+}
+
+/**
+  * Must be called before the sockets are closed. It returns when the thread is stopped, the pending datagrams are kept.
+  */
+void DatagramReceiver::stop()
+{
+   this->mutex.lock();
+   this->toStop = true;
+   this->mutex.unlock();
+
+   this->wait();
+}
+
+QList<DatagramReceiver::Datagram> DatagramReceiver::takeDatagrams()
+{
+   QMutexLocker locker(&this->mutex);
+
+   QList<Datagram> datagrams;
+   datagrams.swap(this->datagrams);
+   return datagrams;
+}
+
+void DatagramReceiver::run()
+{
+   QVector<char> buffer(BATCH_SIZE * BUFFER_SIZE);
+
+   forever
+   {
+      this->mutex.lock();
+      const bool toStop = this->toStop;
+      this->mutex.unlock();
+
+      if (toStop)
+         return;
+
+      fd_set sockets;
+      FD_ZERO(&sockets);
+      qintptr maxSocket = -1;
+      if (this->multicastSocket != -1)
+      {
+         FD_SET(this->multicastSocket, &sockets);
+         maxSocket = this->multicastSocket;
+      }
+      if (this->unicastSocket != -1)
+      {
+         FD_SET(this->unicastSocket, &sockets);
+         maxSocket = qMax(maxSocket, this->unicastSocket);
+      }
+
+      if (maxSocket == -1)
+      {
+         QThread::msleep(WAIT_TIMEOUT);
+         continue;
+      }
+
+      timeval timeout { 0, WAIT_TIMEOUT * 1000 };
+      const int nbSocketsReady = select(static_cast<int>(maxSocket) + 1, &sockets, nullptr, nullptr, &timeout);
+      if (nbSocketsReady <= 0)
+      {
+#if !defined(Q_OS_WIN32)
+         if (nbSocketsReady < 0 && errno != EINTR)
+#else
+         if (nbSocketsReady < 0)
+#endif
+         {
+            L_WARN("DatagramReceiver::run(): select(..) failed");
+            QThread::msleep(WAIT_TIMEOUT);
+         }
+         continue;
+      }
+
+      QList<Datagram> datagrams;
+      if (this->multicastSocket != -1 && FD_ISSET(this->multicastSocket, &sockets))
+         this->readDatagrams(this->multicastSocket, true, buffer.data(), datagrams);
+      if (this->unicastSocket != -1 && FD_ISSET(this->unicastSocket, &sockets))
+         this->readDatagrams(this->unicastSocket, false, buffer.data(), datagrams);
+
+      if (datagrams.isEmpty())
+         continue;
+
+      QMutexLocker locker(&this->mutex);
+
+      if (this->datagrams.size() + datagrams.size() > MAX_NB_PENDING_DATAGRAMS)
+      {
+         L_WARN(QString("DatagramReceiver::run(): too many pending datagrams, %1 datagram(s) dropped").arg(datagrams.size()));
+         continue;
+      }
+
+      const bool wasEmpty = this->datagrams.isEmpty();
+      this->datagrams.append(datagrams);
+      locker.unlock();
+
+      if (wasEmpty)
+         emit datagramsReceived();
+   }
+}
+
+/**
+  * Read all the pending datagrams of the given socket, the socket must be in non-blocking mode.
+  * @param buffer Must have a size of 'BATCH_SIZE' * 'BUFFER_SIZE'.
+  */
+void DatagramReceiver::readDatagrams(qintptr socket, bool multicast, char* buffer, QList<Datagram>& datagrams)
+{
+#if defined(Q_OS_LINUX)
+   mmsghdr messages[BATCH_SIZE];
+   iovec iovecs[BATCH_SIZE];
+   sockaddr_storage addresses[BATCH_SIZE];
+
+   int nbDatagrams;
+   do
+   {
+      memset(messages, 0, sizeof(messages));
+      for (int i = 0; i < BATCH_SIZE; i++)
+      {
+         iovecs[i].iov_base = buffer + i * BUFFER_SIZE;
+         iovecs[i].iov_len = BUFFER_SIZE;
+         messages[i].msg_hdr.msg_iov = &iovecs[i];
+         messages[i].msg_hdr.msg_iovlen = 1;
+         messages[i].msg_hdr.msg_name = &addresses[i];
+         messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+      }
+
+      nbDatagrams = recvmmsg(static_cast<int>(socket), messages, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+
+      for (int i = 0; i < nbDatagrams; i++)
+         DatagramReceiver::addDatagram(buffer + i * BUFFER_SIZE, messages[i].msg_len, QHostAddress(reinterpret_cast<const sockaddr*>(&addresses[i])), multicast, datagrams);
+   } while (nbDatagrams == BATCH_SIZE);
+#else
+   for (int i = 0; i < BATCH_SIZE; i++)
+   {
+      sockaddr_storage address;
+      socklen_t addressSize = sizeof(address);
+      const int datagramSize = recvfrom(socket, buffer, BUFFER_SIZE, 0, reinterpret_cast<sockaddr*>(&address), &addressSize);
+      if (datagramSize < 0)
+         break;
+      DatagramReceiver::addDatagram(buffer, datagramSize, QHostAddress(reinterpret_cast<const sockaddr*>(&address)), multicast, datagrams);
+   }
+#endif
+}
+
+/**
+  * Decode the given datagram and add it to 'datagrams', the invalid datagrams are ignored.
+  */
+void DatagramReceiver::addDatagram(const char* data, int size, const QHostAddress& peerAddress, bool multicast, QList<Datagram>& datagrams)
+{
+   if (size < Common::MessageHeader::HEADER_SIZE)
+   {
+      L_WARN(QString("Datagram too small received from %1").arg(peerAddress.toString()));
+      return;
+   }
+
+   try
+   {
+      datagrams << Datagram { Common::Message::readMessage(data, size), peerAddress, multicast };
+   }
+   catch (Common::ReadErrorException&)
+   {
+      L_WARN(QString("Unable to read a %1 message from %2").arg(multicast ? "multicast" : "unicast").arg(peerAddress.toString()));
+   }
+}
@@ -0,0 +1,75 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QList>
+#include <QHostAddress>
+
+#include <Common/Uncopyable.h>
+#include <Common/Network/Message.h>
+
+namespace NL
+{
+   class DatagramReceiver : public QThread, Common::Uncopyable
+   {
+      Q_OBJECT
+      static const int BUFFER_SIZE = 65536; // The size max of an UDP datagram.
+      static const int BATCH_SIZE = 16; // Number of datagrams read with one system call, only on Linux.
+      static const int MAX_NB_PENDING_DATAGRAMS = 8192; // Beyond this number the received datagrams are dropped.
+      static const int WAIT_TIMEOUT = 200; // [ms]. To check regularly if the thread must be stopped.
+
+   public:
+      struct Datagram
+      {
+         Common::Message message;
+         QHostAddress peerAddress;
+         bool multicast;
+      };
+
+      DatagramReceiver();
+      ~DatagramReceiver();
+
+      void startReceiving(qintptr multicastSocket, qintptr unicastSocket);
+      void stop();
+
+      QList<Datagram> takeDatagrams();
+
+   signals:
+      /**
+        * Emitted when some datagrams are received and there was no pending datagram, see 'takeDatagrams()'.
+        */
+      void datagramsReceived();
+
+   protected:
+      void run();
+
+   private:
+      void readDatagrams(qintptr socket, bool multicast, char* buffer, QList<Datagram>& datagrams);
+      static void addDatagram(const char* data, int size, const QHostAddress& peerAddress, bool multicast, QList<Datagram>& datagrams);
+
+      qintptr multicastSocket;
+      qintptr unicastSocket;
+
+      bool toStop;
+      QMutex mutex; ///< Protect 'toStop' and 'datagrams'.
+      QList<Datagram> datagrams; ///< Received datagrams not yet taken.
+   };
+}
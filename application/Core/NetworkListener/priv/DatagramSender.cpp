@@ -0,0 +1,152 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+
+#include <priv/DatagramSender.h>
+using namespace NL;
+
+#if defined(Q_OS_LINUX)
+   #include <cerrno>
+   #include <cstring>
+   #include <sys/types.h>
+   #include <sys/socket.h>
+   #include <netinet/in.h>
+#endif
+
+#include <QVector>
+
+#include <priv/Log.h>
+
+/**
+  * @class NL::DatagramSender
+  *
+  * Send the same datagram to several destinations with the unicast socket, used when the multicast messages
+  * must be sent by unicast, see 'UDPListener::send(..)'.
+  *
+  * On Linux the datagrams are sent by batch with 'sendmmsg(..)'.
+  */
+
+/**
+  * @return The number of datagrams sent.
+  */
+int DatagramSender::send(QUdpSocket& socket, const char* data, int size, const QList<Destination>& destinations)
+{
+   int nbSent = 0;
+
+#if defined(Q_OS_LINUX)
+   const int socketDescriptor = static_cast<int>(socket.socketDescriptor());
+   sockaddr_storage localAddress;
+   socklen_t localAddressSize = sizeof(localAddress);
+   if (socketDescriptor == -1 || getsockname(socketDescriptor, reinterpret_cast<sockaddr*>(&localAddress), &localAddressSize) == -1)
+      return 0;
+
+   QVector<sockaddr_storage> addresses;
+   addresses.reserve(destinations.size());
+   QVector<mmsghdr> messages;
+   messages.reserve(destinations.size());
+   iovec iov { const_cast<char*>(data), static_cast<size_t>(size) };
+
+   for (QListIterator<Destination> i(destinations); i.hasNext();)
+   {
+      const Destination& destination = i.next();
+
+      sockaddr_storage address;
+      memset(&address, 0, sizeof(address));
+      socklen_t addressSize;
+
+      if (localAddress.ss_family == AF_INET6)
+      {
+         sockaddr_in6* address6 = reinterpret_cast<sockaddr_in6*>(&address);
+         address6->sin6_family = AF_INET6;
+         address6->sin6_port = htons(destination.port);
+
+         bool isIPv4;
+         const quint32 IPv4 = destination.address.toIPv4Address(&isIPv4);
+         if (isIPv4) // The IPv4 addresses are mapped (::ffff:a.b.c.d), the socket is dual stack.
+         {
+            address6->sin6_addr.s6_addr[10] = 0xFF;
+            address6->sin6_addr.s6_addr[11] = 0xFF;
+            const quint32 IPv4BigEndian = htonl(IPv4);
+            memcpy(&address6->sin6_addr.s6_addr[12], &IPv4BigEndian, sizeof(IPv4BigEndian));
+         }
+         else
+         {
+            const Q_IPV6ADDR bytes = destination.address.toIPv6Address();
+            memcpy(&address6->sin6_addr, &bytes, sizeof(address6->sin6_addr));
+            address6->sin6_scope_id = destination.address.scopeId().toUInt();
+         }
+         addressSize = sizeof(sockaddr_in6);
+      }
+      else
+      {
+         bool isIPv4;
+         const quint32 IPv4 = destination.address.toIPv4Address(&isIPv4);
+         if (!isIPv4)
+            continue; // An IPv6 destination can't be reached with an IPv4 socket.
+
+         sockaddr_in* address4 = reinterpret_cast<sockaddr_in*>(&address);
+         address4->sin_family = AF_INET;
+         address4->sin_port = htons(destination.port);
+         address4->sin_addr.s_addr = htonl(IPv4);
+         addressSize = sizeof(sockaddr_in);
+      }
+
+      addresses << address;
+      mmsghdr message;
+      memset(&message, 0, sizeof(message));
+      message.msg_hdr.msg_iov = &iov;
+      message.msg_hdr.msg_iovlen = 1;
+      message.msg_hdr.msg_namelen = addressSize;
+      messages << message;
+   }
+
+   for (int i = 0; i < messages.size(); i++)
+      messages[i].msg_hdr.msg_name = &addresses[i];
+
+   int position = 0;
+   while (position < messages.size())
+   {
+      const int nb = sendmmsg(socketDescriptor, messages.data() + position, qMin(BATCH_SIZE, messages.size() - position), MSG_DONTWAIT);
+      if (nb < 0)
+      {
+         if (errno == EINTR)
+            continue;
+
+         // The first datagram of the batch can't be sent (unreachable destination, full buffer, ..), it's skipped.
+         L_WARN(QString("DatagramSender::send(..): unable to send a datagram: %1").arg(strerror(errno)));
+         position++;
+      }
+      else
+      {
+         nbSent += nb;
+         position += nb;
+      }
+   }
+#else
+   for (QListIterator<Destination> i(destinations); i.hasNext();)
+   {
+      const Destination& destination = i.next();
+      if (socket.writeDatagram(data, size, destination.address, destination.port) == -1)
+         L_WARN(QString("DatagramSender::send(..): unable to send a datagram to %1: %2").arg(destination.address.toString()).arg(socket.errorString()));
+      else
+         nbSent++;
+   }
+#endif
+
+   return nbSent;
+}
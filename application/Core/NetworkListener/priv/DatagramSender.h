@@ -0,0 +1,43 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+
+#pragma once
+
+#include <QList>
+#include <QHostAddress>
+#include <QUdpSocket>
+
+namespace NL
+{
+   class DatagramSender
+   {
+      static const int BATCH_SIZE = 64; // Number of datagrams sent with one system call, only on Linux.
+
+   public:
+      struct Destination
+      {
+         QHostAddress address;
+         quint16 port;
+
+         bool operator==(const Destination& other) const { return this->port == other.port && this->address.isEqual(other.address, QHostAddress::TolerantConversion); } // An IPv4 address is equal to its IPv6 mapped address.
+      };
+
+      static int send(QUdpSocket& socket, const char* data, int size, const QList<Destination>& destinations);
+   };
+}
@@ -0,0 +1,238 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/FindProcessor.h>
+using namespace NL;
+
+#include <limits>
+#include <algorithm>
+
+#include <QMutexLocker>
+
+#include <Common/Settings.h>
+#include <Common/ProtoHelper.h>
+
+#include <priv/Log.h>
+
+/**
+  * @class NL::FindProcessor
+  *
+  * Process the 'Find' messages received from the other peers with some worker threads, a long search doesn't
+  * delay the processing of the other messages.
+  *
+  * The number of queued finds is limited by 'find_queue_size' and each peer can't have more than 'find_max_pending_per_peer'
+  * queued or running finds, the other ones are dropped. A find not processed before 'search_lifetime' is dropped too because
+  * the searching peer doesn't wait its results anymore.
+  *
+  * The results of each find are given back to the main thread as soon as they are ready, see 'takeResults()'.
+  * All the 'FindResult' messages of a find are given at once: 'IFileManager::find(..)' has to rank all the matching entries
+  * before splitting them into messages and it caches the complete list, streaming the messages wouldn't make the first one
+  * available sooner.
+  */
+
+FindProcessor::FindProcessor(QSharedPointer<FM::IFileManager> fileManager, int maxResultSize) :
+   MAX_RESULT_SIZE(maxResultSize),
+   MAX_NB_RESULTS(SETTINGS.get<quint32>("max_number_of_search_result_to_send")),
+   QUEUE_SIZE(SETTINGS.get<quint32>("find_queue_size")),
+   MAX_PENDING_PER_PEER(SETTINGS.get<quint32>("find_max_pending_per_peer")),
+   DEADLINE(SETTINGS.get<quint32>("search_lifetime")),
+   fileManager(fileManager),
+   nextLatency(0),
+   nbDroppedFinds(0),
+   toStop(false)
+{
+   const int nbThreads = qMax(1, static_cast<int>(SETTINGS.get<quint32>("find_nb_threads")));
+   for (int i = 0; i < nbThreads; i++)
+   {
+      Worker* worker = new Worker(*this);
+      worker->start(QThread::LowPriority);
+      this->workers << worker;
+   }
+}
+
+FindProcessor::~FindProcessor()
+{
+   this->mutex.lock();
+   this->toStop = true;
+   this->findAvailable.wakeAll();
+   this->mutex.unlock();
+
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+   {
+      Worker* worker = i.next();
+      worker->wait();
+      delete worker;
+   }
+}
+
+/**
+  * @return 'false' if the find has been dropped.
+  */
+bool FindProcessor::add(const Common::Hash& peerID, const Protos::Core::Find& findMessage)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (this->finds.size() >= this->QUEUE_SIZE)
+   {
+      L_DEBU(QString("Find from %1 dropped, the queue is full").arg(peerID.toStr()));
+      this->nbDroppedFinds++;
+      return false;
+   }
+
+   int& nbPendingFinds = this->nbPendingFindsPerPeer[peerID];
+   if (nbPendingFinds >= this->MAX_PENDING_PER_PEER)
+   {
+      L_DEBU(QString("Find from %1 dropped, too many pending finds for this peer").arg(peerID.toStr()));
+      this->nbDroppedFinds++;
+      return false;
+   }
+   nbPendingFinds++;
+
+   this->finds.enqueue(Find { peerID, findMessage, QElapsedTimer() });
+   this->finds.last().timer.start();
+   this->findAvailable.wakeOne();
+   return true;
+}
+
+QList<FindProcessor::Results> FindProcessor::takeResults()
+{
+   QMutexLocker locker(&this->mutex);
+
+   QList<Results> results;
+   results.swap(this->results);
+   return results;
+}
+
+INetworkListener::FindStats FindProcessor::getStats() const
+{
+   QMutexLocker locker(&this->mutex);
+
+   INetworkListener::FindStats stats { this->finds.size(), this->nbDroppedFinds, -1, -1, -1 };
+   FindProcessor::setLatencyPercentiles(this->latencies, stats);
+   return stats;
+}
+
+/**
+  * Set the median and the 95th and 99th percentiles of the given latencies, they aren't changed if there is no latency.
+  */
+void FindProcessor::setLatencyPercentiles(QVector<int> latencies, INetworkListener::FindStats& stats)
+{
+   if (latencies.isEmpty())
+      return;
+
+   std::sort(latencies.begin(), latencies.end());
+   stats.latencyMedian = latencies[(latencies.size() - 1) * 50 / 100];
+   stats.latency95 = latencies[(latencies.size() - 1) * 95 / 100];
+   stats.latency99 = latencies[(latencies.size() - 1) * 99 / 100];
+}
+
+void FindProcessor::work()
+{
+   QMutexLocker locker(&this->mutex);
+
+   forever
+   {
+      while (this->finds.isEmpty() && !this->toStop)
+         this->findAvailable.wait(&this->mutex);
+
+      if (this->toStop)
+         return;
+
+      const Find find = this->finds.dequeue();
+
+      if (find.timer.elapsed() >= this->DEADLINE)
+      {
+         L_DEBU(QString("Find from %1 dropped, deadline exceeded before being processed").arg(find.peerID.toStr()));
+         this->nbDroppedFinds++;
+         this->findDone(find.peerID);
+         continue;
+      }
+
+      locker.unlock();
+      const QList<Protos::Common::FindResult>& findResults = this->find(find.findMessage);
+      locker.relock();
+
+      this->findDone(find.peerID);
+
+      const int latency = find.timer.elapsed();
+      if (this->latencies.size() < NB_LATENCIES)
+         this->latencies << latency;
+      else
+         this->latencies[this->nextLatency] = latency;
+      this->nextLatency = (this->nextLatency + 1) % NB_LATENCIES;
+
+      if (latency >= this->DEADLINE)
+      {
+         L_DEBU(QString("The results of a find from %1 are dropped, deadline exceeded: %2 ms").arg(find.peerID.toStr()).arg(latency));
+         this->nbDroppedFinds++;
+         continue;
+      }
+
+      if (findResults.isEmpty())
+         continue;
+
+      const bool wasEmpty = this->results.isEmpty();
+      this->results << Results { find.peerID, findResults };
+
+      if (wasEmpty)
+      {
+         locker.unlock();
+         emit resultsReady();
+         locker.relock();
+      }
+   }
+}
+
+/**
+  * Called by a worker thread, the mutex isn't locked.
+  */
+QList<Protos::Common::FindResult> FindProcessor::find(const Protos::Core::Find& findMessage)
+{
+   QList<QString> extensions;
+   extensions.reserve(findMessage.pattern().extension_filter_size());
+   for (int i = 0; i < findMessage.pattern().extension_filter_size(); i++)
+      extensions << Common::ProtoHelper::getRepeatedStr(findMessage.pattern(), &Protos::Common::FindPattern::extension_filter, i);
+
+   QList<Protos::Common::FindResult> findResults =
+      this->fileManager->find(
+         Common::ProtoHelper::getStr(findMessage.pattern(), &Protos::Common::FindPattern::pattern),
+         extensions,
+         findMessage.pattern().min_size() == 0 ? std::numeric_limits<qint64>::min() : (qint64)findMessage.pattern().min_size(), // According the protocol.
+         findMessage.pattern().max_size() == 0 ? std::numeric_limits<qint64>::max() : (qint64)findMessage.pattern().max_size(), // According the protocol.
+         findMessage.pattern().category(),
+         this->MAX_NB_RESULTS,
+         this->MAX_RESULT_SIZE,
+         findMessage.pattern().substring_match(),
+         findMessage.pattern().max_edit_distance()
+      );
+
+   for (QMutableListIterator<Protos::Common::FindResult> i(findResults); i.hasNext();)
+      i.next().set_tag(findMessage.tag());
+
+   return findResults;
+}
+
+/**
+  * The mutex must be locked.
+  */
+void FindProcessor::findDone(const Common::Hash& peerID)
+{
+   auto nbPendingFinds = this->nbPendingFindsPerPeer.find(peerID);
+   if (nbPendingFinds != this->nbPendingFindsPerPeer.end() && --nbPendingFinds.value() <= 0)
+      this->nbPendingFindsPerPeer.erase(nbPendingFinds);
+}
@@ -0,0 +1,115 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QQueue>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+#include <Protos/core_protocol.pb.h>
+#include <Protos/common.pb.h>
+
+#include <Common/Hash.h>
+#include <Common/Uncopyable.h>
+#include <Core/FileManager/IFileManager.h>
+#include <INetworkListener.h>
+
+namespace NL
+{
+   class FindProcessor : public QObject, Common::Uncopyable
+   {
+      Q_OBJECT
+      static const int NB_LATENCIES = 1024; // Number of the last latencies kept to compute the percentiles.
+
+   public:
+      struct Results
+      {
+         Common::Hash peerID;
+         QList<Protos::Common::FindResult> findResults;
+      };
+
+      FindProcessor(QSharedPointer<FM::IFileManager> fileManager, int maxResultSize);
+      ~FindProcessor();
+
+      bool add(const Common::Hash& peerID, const Protos::Core::Find& findMessage);
+      QList<Results> takeResults();
+
+      INetworkListener::FindStats getStats() const;
+      static void setLatencyPercentiles(QVector<int> latencies, INetworkListener::FindStats& stats);
+
+   signals:
+      /**
+        * Emitted when some results are ready and there was no pending result, see 'takeResults()'.
+        */
+      void resultsReady();
+
+   private:
+      class Worker : public QThread
+      {
+      public:
+         Worker(FindProcessor& processor) : processor(processor) {}
+
+      protected:
+         void run() override { this->processor.work(); }
+
+      private:
+         FindProcessor& processor;
+      };
+
+      struct Find
+      {
+         Common::Hash peerID;
+         Protos::Core::Find findMessage;
+         QElapsedTimer timer; ///< Started when the 'Find' is received.
+      };
+
+      void work();
+      QList<Protos::Common::FindResult> find(const Protos::Core::Find& findMessage);
+      void findDone(const Common::Hash& peerID);
+
+      const int MAX_RESULT_SIZE;
+      const int MAX_NB_RESULTS;
+      const int QUEUE_SIZE;
+      const int MAX_PENDING_PER_PEER;
+      const int DEADLINE; ///< [ms].
+
+      QSharedPointer<FM::IFileManager> fileManager;
+
+      QList<Worker*> workers;
+
+      QQueue<Find> finds; ///< The finds waiting for a worker.
+      QHash<Common::Hash, int> nbPendingFindsPerPeer; ///< Queued or running.
+      QList<Results> results; ///< The results ready to be taken by 'takeResults()'.
+
+      QVector<int> latencies; ///< Circular buffer of the last latencies [ms].
+      int nextLatency;
+      quint64 nbDroppedFinds;
+      bool toStop;
+
+      mutable QMutex mutex;
+      QWaitCondition findAvailable;
+   };
+}
@@ -0,0 +1,50 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/LocateQueries.h>
+using namespace NL;
+
+void LocateQueries::add(quint64 tag, const QList<QSharedPointer<DM::IChunkDownloader>>& chunkDownloaders)
+{
+   this->queries.insert(tag, chunkDownloaders);
+}
+
+/**
+  * @return The chunks of the query having the given tag or 'nullptr' if there is no such query.
+  */
+const QList<QSharedPointer<DM::IChunkDownloader>>* LocateQueries::get(quint64 tag) const
+{
+   auto query = this->queries.constFind(tag);
+   if (query != this->queries.constEnd())
+      return &query.value();
+
+   query = this->previousQueries.constFind(tag);
+   if (query != this->previousQueries.constEnd())
+      return &query.value();
+
+   return nullptr;
+}
+
+/**
+  * The queries added before the previous call are forgotten.
+  */
+void LocateQueries::nextPeriod()
+{
+   this->previousQueries.swap(this->queries);
+   this->queries.clear();
+}
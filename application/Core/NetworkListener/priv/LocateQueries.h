@@ -0,0 +1,44 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+
+#include <Core/DownloadManager/IChunkDownloader.h>
+
+namespace NL
+{
+   /**
+     * The chunks of the 'HaveChunks' queries waiting for the 'ChunksOwned' replies, indexed by tag.
+     * A query is kept during one or two periods, see 'nextPeriod()'.
+     */
+   class LocateQueries
+   {
+   public:
+      void add(quint64 tag, const QList<QSharedPointer<DM::IChunkDownloader>>& chunkDownloaders);
+      const QList<QSharedPointer<DM::IChunkDownloader>>* get(quint64 tag) const;
+      void nextPeriod();
+
+   private:
+      QHash<quint64, QList<QSharedPointer<DM::IChunkDownloader>>> queries;
+      QHash<quint64, QList<QSharedPointer<DM::IChunkDownloader>>> previousQueries;
+   };
+}
@@ -68,3 +68,8 @@ NetworkListener::SendStatus NetworkListener::send(Common::MessageHeader::Message
    else
       return this->uDPListener.send(type, message, peerID);
 }
+
+NetworkListener::FindStats NetworkListener::getFindStats() const
+{
+   return this->uDPListener.getFindStats();
+}
@@ -56,6 +56,8 @@ namespace NL
    public:
       SendStatus send(Common::MessageHeader::MessageType type, const google::protobuf::Message& message, const Common::Hash& peerID = Common::Hash());
 
+      FindStats getFindStats() const;
+
    private:      
       LOG_INIT_H("NetworkListener")
 
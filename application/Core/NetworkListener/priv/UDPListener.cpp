@@ -49,8 +49,10 @@ using namespace NL;
   *
   * The goals of this class are:
   *  - Listen for incoming unicast and multicast datagrams, process them and dispatch the information the correct manager: 'FileManager', 'DownloadManager' or 'PeerManager'.
+  *    The datagrams are read and decoded in a separated thread, see 'DatagramReceiver'.
   *  - Offer methods to send unicast or multicast datagrams.
-  *  - Periodically send a 'IMAlive' multicast datagrams.
+  *  - Periodically send a 'IMAlive' multicast datagrams. The multicast datagrams can also be sent by unicast to some peers, see 'getUnicastDestinations()'.
+  *  - Ask once for the sources of the chunks whose hash has just become known with a 'HaveChunks' multicast datagram.
   *
   * @author mcuony
   * @author gburri
@@ -64,27 +66,41 @@ UDPListener::UDPListener(
    quint16 unicastPort
 ) :
    MAX_UDP_DATAGRAM_PAYLOAD_SIZE(static_cast<int>(SETTINGS.get<quint32>("max_udp_datagram_size"))),
-   bodyBuffer(UDPListener::buffer + Common::MessageHeader::HEADER_SIZE),
    UNICAST_PORT(unicastPort),
    MULTICAST_PORT(SETTINGS.get<quint32>("multicast_port")),
+   MULTICAST_DISCOVERY(SETTINGS.get<bool>("multicast_discovery")),
    multicastGroup(Utils::getMulticastGroup()),
    fileManager(fileManager),
    peerManager(peerManager),
    uploadManager(uploadManager),
    downloadManager(downloadManager),
+   findProcessor(fileManager, this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - Common::MessageHeader::HEADER_SIZE),
    currentIMAliveTag(0),
    nextHashRequestType(FIRST_HASHES),
    loggerIMAlive(LM::Builder::newLogger("NetworkListener (IMAlive)"))
 {
    this->initMulticastUDPSocket();
    this->initUnicastUDPSocket();
+   this->loadUnicastPeers();
+
+   connect(&this->datagramReceiver, &DatagramReceiver::datagramsReceived, this, &UDPListener::processReceivedDatagrams, Qt::QueuedConnection);
+   connect(&this->findProcessor, &FindProcessor::resultsReady, this, &UDPListener::sendFindResults, Qt::QueuedConnection);
+   this->startReceiving();
 
    connect(&this->timerIMAlive, &QTimer::timeout, this, &UDPListener::sendIMAliveMessage);
    this->timerIMAlive.start(static_cast<int>(SETTINGS.get<quint32>("peer_imalive_period")));
 
+   connect(&this->timerLocateChunks, &QTimer::timeout, this, &UDPListener::locateChunks);
+   this->timerLocateChunks.start(LOCATE_CHUNKS_PERIOD);
+
    this->sendIMAliveMessage();
 }
 
+UDPListener::~UDPListener()
+{
+   this->datagramReceiver.stop();
+}
+
 /**
   * Send an UDP unicast datagram to the given peer.
   * @return 'false' if the datagram can't be sent.
@@ -116,7 +132,7 @@ INetworkListener::SendStatus UDPListener::send(Common::MessageHeader::MessageTyp
 }
 
 /**
-  * Send an UDP multicast message.
+  * Send an UDP multicast message. It's also sent by unicast to the peers not reachable by multicast.
   */
 INetworkListener::SendStatus UDPListener::send(Common::MessageHeader::MessageType type, const google::protobuf::Message& message)
 {
@@ -136,6 +152,12 @@ INetworkListener::SendStatus UDPListener::send(Common::MessageHeader::MessageTyp
       L_DEBU(logMess);
 #endif
 
+   const QList<DatagramSender::Destination>& destinations = this->getUnicastDestinations();
+   const int nbSent = destinations.isEmpty() ? 0 : DatagramSender::send(this->unicastSocket, this->buffer, messageSize, destinations);
+
+   if (!this->MULTICAST_DISCOVERY)
+      return nbSent == destinations.size() ? INetworkListener::SendStatus::OK : INetworkListener::SendStatus::UNABLE_TO_SEND;
+
    if (this->multicastSocket.writeDatagram(this->buffer, messageSize, this->multicastGroup, MULTICAST_PORT) == -1)
    {
       L_WARN(QString("Unable to send datagram (multicast): error: %1").arg(this->unicastSocket.errorString()));
@@ -151,6 +173,7 @@ void UDPListener::sendIMAliveMessage()
    IMAliveMessage.set_version(Common::Constants::PROTOCOL_VERSION);
    Common::ProtoHelper::setStr(IMAliveMessage, &Protos::Core::IMAlive::set_core_version, Common::Global::getVersionFull());
    IMAliveMessage.set_port(this->UNICAST_PORT);
+   IMAliveMessage.set_chunk_prefix_understood(true);
 
    const QString& nick = this->peerManager->getSelf()->getNick();
    Common::ProtoHelper::setStr(IMAliveMessage, &Protos::Core::IMAlive::set_nick, nick.length() > MAX_NICK_LENGTH ? nick.left(MAX_NICK_LENGTH) : nick);
@@ -167,12 +190,15 @@ void UDPListener::sendIMAliveMessage()
    static const int AVERAGE_FIXED_SIZE = 100; // [Byte]. Header size + information in the 'IMAlive' message without the hashes.
    static const quint32 IMALIVE_PERIOD = SETTINGS.get<quint32>("peer_imalive_period") / 1000; // [s]
    static const int FIXED_RATE_PER_PEER = AVERAGE_FIXED_SIZE / IMALIVE_PERIOD; // [Byte/s]
-   static const int HASH_SIZE = Common::Hash::HASH_SIZE + 4; // "4" is the overhead added by protobuff for each hash.
+   static const bool HASH_PREFIXES_ENABLED = SETTINGS.get<bool>("imalive_hash_prefixes");
+   const bool HASH_PREFIXES = HASH_PREFIXES_ENABLED && this->allPeersUnderstandHashPrefixes();
+   const int HASH_SIZE = HASH_PREFIXES ? sizeof(quint64) : Common::Hash::HASH_SIZE + 4; // "4" is the overhead added by protobuff for each hash, the prefixes are packed.
 
-   const int numberOfPeers = this->peerManager->getNbOfPeers();
+   const int numberOfPeers = qMax(this->peerManager->getNbOfPeers(), this->staticUnicastPeers.size()); // Some static unicast peers may not be known yet.
    const int maxNumberOfHashesToSend = numberOfPeers == 0 ? std::numeric_limits<int>::max() : IMALIVE_PERIOD * (MAX_IMALIVE_THROUGHPUT - numberOfPeers * FIXED_RATE_PER_PEER) / (numberOfPeers * HASH_SIZE);
 
-   int numberOfHashesToSend = (this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - IMAliveMessage.ByteSizeLong() - Common::MessageHeader::HEADER_SIZE) / HASH_SIZE;
+   static const int PACKED_FIELD_OVERHEAD = 4; // Tag and length of 'chunk_prefix'.
+   int numberOfHashesToSend = (this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - IMAliveMessage.ByteSizeLong() - Common::MessageHeader::HEADER_SIZE - (HASH_PREFIXES ? PACKED_FIELD_OVERHEAD : 0)) / HASH_SIZE;
    if (numberOfHashesToSend > maxNumberOfHashesToSend)
       numberOfHashesToSend = maxNumberOfHashesToSend;
 
@@ -191,11 +217,18 @@ void UDPListener::sendIMAliveMessage()
       break;
    }
 
-   IMAliveMessage.mutable_chunk()->Reserve(this->currentChunkDownloaders.size());
+   if (HASH_PREFIXES)
+      IMAliveMessage.mutable_chunk_prefix()->Reserve(this->currentChunkDownloaders.size());
+   else
+      IMAliveMessage.mutable_chunk()->Reserve(this->currentChunkDownloaders.size());
+
    for (QListIterator<QSharedPointer<DM::IChunkDownloader>> i(this->currentChunkDownloaders); i.hasNext();)
    {
       QSharedPointer<DM::IChunkDownloader> chunkDownloader = i.next();
-      IMAliveMessage.add_chunk()->set_hash(chunkDownloader->getHash().getData(), Common::Hash::HASH_SIZE);
+      if (HASH_PREFIXES)
+         IMAliveMessage.add_chunk_prefix(chunkDownloader->getHash().getPrefix());
+      else
+         IMAliveMessage.add_chunk()->set_hash(chunkDownloader->getHash().getData(), Common::Hash::HASH_SIZE);
 
       // If we already have the chunk . . .
       QSharedPointer<FM::IChunk> chunk = this->fileManager->getChunk(chunkDownloader->getHash());
@@ -210,176 +243,399 @@ void UDPListener::sendIMAliveMessage()
    this->send(Common::MessageHeader::CORE_IM_ALIVE, IMAliveMessage);
 }
 
+/**
+  * Ask all the peers which of the new chunks in the download queue they own, see 'IDownloadManager::getChunksToLocate(..)'.
+  * The replies are 'ChunksOwned' messages handled like the replies to the 'IMAlive' messages. The following changes
+  * are known via the periodic 'IMAlive' messages.
+  */
+void UDPListener::locateChunks()
+{
+   this->locateQueries.nextPeriod();
+
+   if (this->peerManager->getNbOfPeers() == 0) // The chunks are kept to be located when a peer appears.
+      return;
+
+   static const int HAVE_CHUNKS_FIXED_SIZE = 16; // [Byte]. The tag and the field header of 'chunk_prefix'.
+   const int maxNumberOfPrefixes = (this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - Common::MessageHeader::HEADER_SIZE - HAVE_CHUNKS_FIXED_SIZE) / sizeof(quint64);
+
+   for (int n = 0; n < MAX_NB_HAVE_CHUNKS_PER_PERIOD; n++)
+   {
+      const QList<QSharedPointer<DM::IChunkDownloader>>& chunkDownloaders = this->downloadManager->getChunksToLocate(maxNumberOfPrefixes);
+      if (chunkDownloaders.isEmpty())
+         break;
+
+      Protos::Core::HaveChunks haveChunksMessage;
+      const quint64 tag = QRandomGenerator64::global()->generate64();
+      haveChunksMessage.set_tag(tag);
+      haveChunksMessage.mutable_chunk_prefix()->Reserve(chunkDownloaders.size());
+      for (QListIterator<QSharedPointer<DM::IChunkDownloader>> i(chunkDownloaders); i.hasNext();)
+         haveChunksMessage.add_chunk_prefix(i.next()->getHash().getPrefix());
+
+      this->locateQueries.add(tag, chunkDownloaders);
+      this->send(Common::MessageHeader::CORE_HAVE_CHUNKS, haveChunksMessage);
+
+      if (chunkDownloaders.size() < maxNumberOfPrefixes)
+         break;
+   }
+}
+
+INetworkListener::FindStats UDPListener::getFindStats() const
+{
+   return this->findProcessor.getStats();
+}
+
 void UDPListener::rebindSockets()
 {
+   this->datagramReceiver.stop();
    this->initMulticastUDPSocket();
    this->initUnicastUDPSocket();
+   this->loadUnicastPeers();
+   this->startReceiving();
 }
 
-void UDPListener::processPendingMulticastDatagrams()
+/**
+  * Process the datagrams decoded by the 'DatagramReceiver' thread.
+  */
+void UDPListener::processReceivedDatagrams()
 {
-   while (this->multicastSocket.hasPendingDatagrams())
+   const QList<DatagramReceiver::Datagram>& datagrams = this->datagramReceiver.takeDatagrams();
+   for (QListIterator<DatagramReceiver::Datagram> i(datagrams); i.hasNext();)
    {
-      QHostAddress peerAddress;
-      const Common::MessageHeader& header = this->readDatagramToBuffer(this->multicastSocket, peerAddress);
-      if (header.isNull())
+      const DatagramReceiver::Datagram& datagram = i.next();
+      if (!this->isMessageAccepted(datagram.message.getHeader(), datagram.peerAddress))
          continue;
 
-      try
-      {
-         const Common::Message& message = Common::Message::readMessageBody(header, this->bodyBuffer);
+      // In the unicast discovery mode the multicast messages are received by the unicast socket.
+      if (datagram.multicast || UDPListener::isMulticastMessage(datagram.message.getHeader().getType()))
+         this->processMulticastMessage(datagram.message, datagram.peerAddress, !datagram.multicast);
+      else
+         this->processUnicastMessage(datagram.message, datagram.peerAddress);
+   }
+}
+
+void UDPListener::processMulticastMessage(const Common::Message& message, const QHostAddress& peerAddress, bool receivedByUnicast)
+{
+   const Common::MessageHeader& header = message.getHeader();
 
-         switch (header.getType())
+   switch (header.getType())
+   {
+   case Common::MessageHeader::CORE_IM_ALIVE:
+      {
+         const Protos::Core::IMAlive& IMAliveMessage = message.getMessage<Protos::Core::IMAlive>();
+
+         this->peerManager->updatePeer(
+            header.getSenderID(),
+            peerAddress,
+            IMAliveMessage.port(),
+            Common::ProtoHelper::getStr(IMAliveMessage, &Protos::Core::IMAlive::nick),
+            IMAliveMessage.amount(),
+            Common::ProtoHelper::getStr(IMAliveMessage, &Protos::Core::IMAlive::core_version),
+            IMAliveMessage.download_rate(),
+            IMAliveMessage.upload_rate(),
+            IMAliveMessage.version()
+         );
+
+         if (receivedByUnicast)
+            this->learnedUnicastPeers.insert(header.getSenderID());
+
+         if (IMAliveMessage.chunk_prefix_understood())
+            this->peersNotUnderstandingHashPrefixes.remove(header.getSenderID());
+         else
+            this->peersNotUnderstandingHashPrefixes.insert(header.getSenderID());
+
+         if (IMAliveMessage.chunk_size() > 0 || IMAliveMessage.chunk_prefix_size() > 0)
          {
-         case Common::MessageHeader::CORE_IM_ALIVE:
+            QBitArray bitArray;
+            if (IMAliveMessage.chunk_prefix_size() > 0)
             {
-               const Protos::Core::IMAlive& IMAliveMessage = message.getMessage<Protos::Core::IMAlive>();
-
-               this->peerManager->updatePeer(
-                  header.getSenderID(),
-                  peerAddress,
-                  IMAliveMessage.port(),
-                  Common::ProtoHelper::getStr(IMAliveMessage, &Protos::Core::IMAlive::nick),
-                  IMAliveMessage.amount(),
-                  Common::ProtoHelper::getStr(IMAliveMessage, &Protos::Core::IMAlive::core_version),
-                  IMAliveMessage.download_rate(),
-                  IMAliveMessage.upload_rate(),
-                  IMAliveMessage.version()
-               );
-
-               if (IMAliveMessage.chunk_size() > 0)
-               {
-                  QList<Common::Hash> hashes;
-                  hashes.reserve(IMAliveMessage.chunk_size());
-                  for (int i = 0; i < IMAliveMessage.chunk_size(); i++)
-                     hashes << IMAliveMessage.chunk(i).hash();
-
-                  const QBitArray& bitArray = this->fileManager->haveChunks(hashes);
-
-                  if (!bitArray.isNull()) // If we own at least one chunk we reply with a CHUNKS_OWNED message.
-                  {
-                     Protos::Core::ChunksOwned chunkOwnedMessage;
-                     chunkOwnedMessage.set_tag(IMAliveMessage.tag());
-                     chunkOwnedMessage.mutable_chunk_state()->Reserve(bitArray.size());
-                     for (int i = 0; i < bitArray.size(); i++)
-                        chunkOwnedMessage.add_chunk_state(bitArray[i]);
-                     this->send(Common::MessageHeader::CORE_CHUNKS_OWNED, chunkOwnedMessage, header.getSenderID());
-                  }
-               }
+               QList<quint64> hashPrefixes;
+               hashPrefixes.reserve(IMAliveMessage.chunk_prefix_size());
+               for (int i = 0; i < IMAliveMessage.chunk_prefix_size(); i++)
+                  hashPrefixes << IMAliveMessage.chunk_prefix(i);
+               bitArray = this->fileManager->haveChunks(hashPrefixes);
             }
-            break;
-
-         case Common::MessageHeader::CORE_GOODBYE:
-            this->peerManager->removePeer(header.getSenderID(), peerAddress);
-            break;
-
-         case Common::MessageHeader::CORE_FIND:
+            else
             {
-               PM::IPeer* peer = this->peerManager->getPeer(header.getSenderID());
+               QList<Common::Hash> hashes;
+               hashes.reserve(IMAliveMessage.chunk_size());
+               for (int i = 0; i < IMAliveMessage.chunk_size(); i++)
+                  hashes << IMAliveMessage.chunk(i).hash();
+               bitArray = this->fileManager->haveChunks(hashes);
+            }
 
-               if (peer && peer->isAvailable())
+            if (!bitArray.isNull()) // If we own at least one chunk we reply with a CHUNKS_OWNED message.
+            {
+               Protos::Core::ChunksOwned chunkOwnedMessage;
+               chunkOwnedMessage.set_tag(IMAliveMessage.tag());
+               if (IMAliveMessage.chunk_prefix_size() > 0) // Only the recent peers use the prefixes and understand the bitmap.
+               {
+                  UDPListener::setChunkBitmap(chunkOwnedMessage, bitArray);
+               }
+               else
                {
-                  const Protos::Core::Find& findMessage = message.getMessage<Protos::Core::Find>();
-                  QList<QString> extensions;
-                  extensions.reserve(findMessage.pattern().extension_filter_size());
-                  for (int i = 0; i < findMessage.pattern().extension_filter_size(); i++)
-                     extensions << Common::ProtoHelper::getRepeatedStr(findMessage.pattern(), &Protos::Common::FindPattern::extension_filter, i);
-
-                  QList<Protos::Common::FindResult> results =
-                     this->fileManager->find(
-                        Common::ProtoHelper::getStr(findMessage.pattern(), &Protos::Common::FindPattern::pattern),
-                        extensions,
-                        findMessage.pattern().min_size() == 0 ? std::numeric_limits<qint64>::min() : (qint64)findMessage.pattern().min_size(), // According the protocol.
-                        findMessage.pattern().max_size() == 0 ? std::numeric_limits<qint64>::max() : (qint64)findMessage.pattern().max_size(), // According the protocol.
-                        findMessage.pattern().category(),
-                        SETTINGS.get<quint32>("max_number_of_search_result_to_send"),
-                        this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - Common::MessageHeader::HEADER_SIZE
-                     );
-
-                  for (QMutableListIterator<Protos::Common::FindResult> i(results); i.hasNext();)
-                  {
-                     Protos::Common::FindResult& result = i.next();
-                     result.set_tag(findMessage.tag());
-                     this->send(Common::MessageHeader::CORE_FIND_RESULT, result, header.getSenderID());
-                  }
+                  chunkOwnedMessage.mutable_chunk_state()->Reserve(bitArray.size());
+                  for (int i = 0; i < bitArray.size(); i++)
+                     chunkOwnedMessage.add_chunk_state(bitArray[i]);
                }
+               this->send(Common::MessageHeader::CORE_CHUNKS_OWNED, chunkOwnedMessage, header.getSenderID());
             }
-            break;
-
-         default:; // Ignore other messages.
          }
+      }
+      break;
+
+   case Common::MessageHeader::CORE_HAVE_CHUNKS:
+      {
+         const Protos::Core::HaveChunks& haveChunksMessage = message.getMessage<Protos::Core::HaveChunks>();
+
+         QList<quint64> hashPrefixes;
+         hashPrefixes.reserve(haveChunksMessage.chunk_prefix_size());
+         for (int i = 0; i < haveChunksMessage.chunk_prefix_size(); i++)
+            hashPrefixes << haveChunksMessage.chunk_prefix(i);
 
-         emit received(message);
+         const QBitArray& bitArray = this->fileManager->haveChunks(hashPrefixes);
+         if (!bitArray.isNull())
+         {
+            Protos::Core::ChunksOwned chunkOwnedMessage;
+            chunkOwnedMessage.set_tag(haveChunksMessage.tag());
+            UDPListener::setChunkBitmap(chunkOwnedMessage, bitArray);
+            this->send(Common::MessageHeader::CORE_CHUNKS_OWNED, chunkOwnedMessage, header.getSenderID());
+         }
       }
-      catch (Common::ReadErrorException&)
+      break;
+
+   case Common::MessageHeader::CORE_GOODBYE:
+      this->peerManager->removePeer(header.getSenderID(), peerAddress);
+      this->learnedUnicastPeers.remove(header.getSenderID());
+      this->peersNotUnderstandingHashPrefixes.remove(header.getSenderID());
+      break;
+
+   case Common::MessageHeader::CORE_FIND:
       {
-         L_WARN(QString("Unable to read a multicast message from peer %1 %2").arg(header.getSenderID().toStr()).arg(peerAddress.toString()));
+         PM::IPeer* peer = this->peerManager->getPeer(header.getSenderID());
+
+         // The results are sent by 'sendFindResults()'.
+         if (peer && peer->isAvailable())
+            this->findProcessor.add(header.getSenderID(), message.getMessage<Protos::Core::Find>());
       }
+      break;
+
+   default:; // Ignore other messages.
    }
+
+   emit received(message);
 }
 
-/**
-  * Function called when data is recevied by the socket : The corresponding proto is created and the coresponding event is rised.
-  */
-void UDPListener::processPendingUnicastDatagrams()
+void UDPListener::processUnicastMessage(const Common::Message& message, const QHostAddress& peerAddress)
 {
-   while (this->unicastSocket.hasPendingDatagrams())
-   {
-      QHostAddress peerAddress;
-      const Common::MessageHeader& header =  UDPListener::readDatagramToBuffer(this->unicastSocket, peerAddress);
-      if (header.isNull())
-         continue;
+   const Common::MessageHeader& header = message.getHeader();
 
-      try
+   PM::IPeer* peer = this->peerManager->getPeer(header.getSenderID());
+   if (!peer || !peer->isAvailable())
+      return;
+
+   switch (header.getType())
+   {
+   case Common::MessageHeader::CORE_CHUNKS_OWNED:
       {
-         const Common::Message& message = Common::Message::readMessageBody(header, this->bodyBuffer);
-         PM::IPeer* peer = this->peerManager->getPeer(header.getSenderID());
-         if (!peer || !peer->isAvailable())
-            continue;
+         const Protos::Core::ChunksOwned& chunksOwnedMessage = message.getMessage<Protos::Core::ChunksOwned>();
+
+         // The message replies either to our last 'IMAlive' message or to a recent 'HaveChunks' message.
+         const QList<QSharedPointer<DM::IChunkDownloader>>* chunkDownloaders =
+            chunksOwnedMessage.tag() == this->currentIMAliveTag ? &this->currentChunkDownloaders : this->locateQueries.get(chunksOwnedMessage.tag());
 
-         switch (header.getType())
+         if (!chunkDownloaders)
          {
-         case Common::MessageHeader::CORE_CHUNKS_OWNED:
+            L_WARN(QString("ChunksOwned : tag (%1) doesn't match current tag (%2)").arg(chunksOwnedMessage.tag()).arg(currentIMAliveTag));
+            return;
+         }
+
+         QBitArray chunkStates;
+         if (!chunksOwnedMessage.chunk_bitmap().empty())
+         {
+            if (!UDPListener::getChunkBitmap(chunksOwnedMessage, chunkDownloaders->size(), chunkStates))
             {
-               const Protos::Core::ChunksOwned& chunksOwnedMessage = message.getMessage<Protos::Core::ChunksOwned>();
+               L_WARN(QString("ChunksOwned : The bitmap size (%1) doesn't match the expected one (%2)").arg(chunksOwnedMessage.chunk_bitmap().size()).arg((chunkDownloaders->size() + 7) / 8));
+               return;
+            }
+         }
+         else
+         {
+            if (chunksOwnedMessage.chunk_state_size() != chunkDownloaders->size())
+            {
+               L_WARN(QString("ChunksOwned : The size (%1) doesn't match the expected one (%2)").arg(chunksOwnedMessage.chunk_state_size()).arg(chunkDownloaders->size()));
+               return;
+            }
+            chunkStates.resize(chunksOwnedMessage.chunk_state_size());
+            for (int i = 0; i < chunksOwnedMessage.chunk_state_size(); i++)
+               chunkStates.setBit(i, chunksOwnedMessage.chunk_state(i));
+         }
 
-               if (chunksOwnedMessage.tag() != this->currentIMAliveTag)
-               {
-                  L_WARN(QString("ChunksOwned : tag (%1) doesn't match current tag (%2)").arg(chunksOwnedMessage.tag()).arg(currentIMAliveTag));
-                  continue;
-               }
+         for (int i = 0; i < chunkStates.size(); i++)
+            if (chunkStates.testBit(i))
+               (*chunkDownloaders)[i]->addPeer(peer);
+            else
+               (*chunkDownloaders)[i]->rmPeer(peer);
+      }
+      break;
 
-               if (chunksOwnedMessage.chunk_state_size() != this->currentChunkDownloaders.size())
-               {
-                  L_WARN(QString("ChunksOwned : The size (%1) doesn't match the expected one (%2)").arg(chunksOwnedMessage.chunk_state_size()).arg(this->currentChunkDownloaders.size()));
-                  continue;
-               }
+   case Common::MessageHeader::CORE_FIND_RESULT:
+      {
+         Protos::Common::FindResult findResultMessage = message.getMessage<Protos::Common::FindResult>();
+         findResultMessage.mutable_peer_id()->set_hash(header.getSenderID().getData(), Common::Hash::HASH_SIZE);
+         emit newFindResultMessage(findResultMessage);
+      }
+      break;
 
-               for (int i = 0; i < chunksOwnedMessage.chunk_state_size(); i++)
-                  if (chunksOwnedMessage.chunk_state(i))
-                     this->currentChunkDownloaders[i]->addPeer(peer);
-                  else
-                     this->currentChunkDownloaders[i]->rmPeer(peer);
-            }
-            break;
+   default:; // Ignore other messages.
+   }
 
-         case Common::MessageHeader::CORE_FIND_RESULT:
-            {
-               Protos::Common::FindResult findResultMessage = message.getMessage<Protos::Common::FindResult>();
-               findResultMessage.mutable_peer_id()->set_hash(header.getSenderID().getData(), Common::Hash::HASH_SIZE);
-               emit newFindResultMessage(findResultMessage);
-            }
-            break;
+   emit received(message);
+}
 
-         default:; // Ignore other messages.
-         }
+void UDPListener::sendFindResults()
+{
+   const QList<FindProcessor::Results>& results = this->findProcessor.takeResults();
+   for (QListIterator<FindProcessor::Results> i(results); i.hasNext();)
+   {
+      const FindProcessor::Results& result = i.next();
+      for (QListIterator<Protos::Common::FindResult> j(result.findResults); j.hasNext();)
+         this->send(Common::MessageHeader::CORE_FIND_RESULT, j.next(), result.peerID);
+   }
+}
+
+/**
+  * Start to read the sockets in the 'DatagramReceiver' thread. The read notifications of the 'QUdpSocket' are disabled
+  * by Qt as long as nobody reads them.
+  */
+void UDPListener::startReceiving()
+{
+   this->datagramReceiver.startReceiving(
+      this->multicastSocket.state() == QAbstractSocket::BoundState ? this->multicastSocket.socketDescriptor() : -1,
+      this->unicastSocket.state() == QAbstractSocket::BoundState ? this->unicastSocket.socketDescriptor() : -1
+   );
+}
+
+/**
+  * Read the setting 'unicast_peers'.
+  */
+void UDPListener::loadUnicastPeers()
+{
+   this->staticUnicastPeers.clear();
+
+   const quint32 DEFAULT_PORT = SETTINGS.get<quint32>("unicast_base_port");
+
+   for (QListIterator<QString> i(SETTINGS.getRepeated<QString>("unicast_peers")); i.hasNext();)
+   {
+      const QString& peer = i.next().trimmed();
 
-         emit received(message);
+      QString address = peer;
+      QString port;
+      const int portSeparator = peer.lastIndexOf(':');
+      if (peer.startsWith('[')) // "[<IPv6>]:<port>".
+      {
+         const int end = peer.indexOf(']');
+         address = peer.mid(1, end - 1);
+         if (end != -1 && portSeparator > end)
+            port = peer.mid(portSeparator + 1);
       }
-      catch (Common::ReadErrorException&)
+      else if (portSeparator != -1 && peer.indexOf(':') == portSeparator) // "<IPv4>:<port>", an IPv6 address without brackets has several ':'.
+      {
+         address = peer.left(portSeparator);
+         port = peer.mid(portSeparator + 1);
+      }
+
+      bool portOk = true;
+      const quint32 portValue = port.isEmpty() ? DEFAULT_PORT : port.toUInt(&portOk);
+
+      QHostAddress hostAddress;
+      if (!hostAddress.setAddress(address) || !portOk || portValue == 0 || portValue > 65535)
+      {
+         L_WARN(QString("Invalid address in the setting 'unicast_peers': %1").arg(peer));
+         continue;
+      }
+
+      const DatagramSender::Destination destination { hostAddress, static_cast<quint16>(portValue) };
+      if (!this->staticUnicastPeers.contains(destination))
+         this->staticUnicastPeers << destination;
+   }
+}
+
+/**
+  * Return the destinations of the multicast messages sent by unicast: the peers of the setting 'unicast_peers' and
+  * the alive peers which have sent us their 'IMAlive' message by unicast. Each destination is given once.
+  */
+QList<DatagramSender::Destination> UDPListener::getUnicastDestinations()
+{
+   QList<DatagramSender::Destination> destinations = this->staticUnicastPeers;
+
+   for (QMutableSetIterator<Common::Hash> i(this->learnedUnicastPeers); i.hasNext();)
+   {
+      PM::IPeer* peer = this->peerManager->getPeer(i.next());
+      if (!peer || !peer->isAlive())
       {
-         L_WARN(QString("Unable to read an unicast message from peer %1 %2").arg(header.getSenderID().toStr()).arg(peerAddress.toString()));
+         i.remove();
+         continue;
       }
+
+      const DatagramSender::Destination destination { peer->getIP(), peer->getPort() };
+      if (!destinations.contains(destination))
+         destinations << destination;
+   }
+
+   return destinations;
+}
+
+/**
+  * The prefixes of the hashes can be sent in the 'IMAlive' messages only if all the alive peers understand them ('IMAlive.chunk_prefix_understood'),
+  * the older peers would ignore them and never tell which chunks they own.
+  */
+bool UDPListener::allPeersUnderstandHashPrefixes()
+{
+   for (QMutableSetIterator<Common::Hash> i(this->peersNotUnderstandingHashPrefixes); i.hasNext();)
+   {
+      PM::IPeer* peer = this->peerManager->getPeer(i.next());
+      if (!peer || !peer->isAlive())
+         i.remove();
+   }
+
+   return this->peersNotUnderstandingHashPrefixes.isEmpty();
+}
+
+/**
+  * The messages sent to all the peers, they can be received by multicast or by unicast.
+  */
+/**
+  * The bit of the chunk 'i' is the bit 'i % 8' of the byte 'i / 8', the last byte is padded with zeros.
+  */
+void UDPListener::setChunkBitmap(Protos::Core::ChunksOwned& chunksOwnedMessage, const QBitArray& chunkStates)
+{
+   chunksOwnedMessage.set_chunk_bitmap(chunkStates.bits(), (chunkStates.size() + 7) / 8);
+}
+
+/**
+  * See 'setChunkBitmap(..)'.
+  * @return 'false' if the size of the bitmap doesn't match 'nbChunks'.
+  */
+bool UDPListener::getChunkBitmap(const Protos::Core::ChunksOwned& chunksOwnedMessage, int nbChunks, QBitArray& chunkStates)
+{
+   if (static_cast<int>(chunksOwnedMessage.chunk_bitmap().size()) != (nbChunks + 7) / 8)
+      return false;
+
+   chunkStates = QBitArray::fromBits(chunksOwnedMessage.chunk_bitmap().data(), nbChunks);
+   return true;
+}
+
+bool UDPListener::isMulticastMessage(Common::MessageHeader::MessageType type)
+{
+   switch (type)
+   {
+   case Common::MessageHeader::CORE_IM_ALIVE:
+   case Common::MessageHeader::CORE_GOODBYE:
+   case Common::MessageHeader::CORE_HAVE_CHUNKS:
+   case Common::MessageHeader::CORE_FIND:
+      return true;
+   default:
+      return false;
    }
 }
 
@@ -390,6 +646,9 @@ void UDPListener::initMulticastUDPSocket()
 
    this->multicastGroup = Utils::getMulticastGroup();
 
+   if (!this->MULTICAST_DISCOVERY)
+      return;
+
    if (!this->multicastSocket.bind(Utils::getCurrentAddressToListenTo(), MULTICAST_PORT))
    {
       L_ERRO("Can't bind the multicast socket");
@@ -413,8 +672,6 @@ void UDPListener::initMulticastUDPSocket()
    static const int BUFFER_SIZE_UDP = SETTINGS.get<quint32>("udp_buffer_size");
    this->multicastSocket.setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, BUFFER_SIZE_UDP);
    this->multicastSocket.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, BUFFER_SIZE_UDP);
-
-   connect(&this->multicastSocket, &QUdpSocket::readyRead, this, &UDPListener::processPendingMulticastDatagrams);
 }
 
 void UDPListener::initUnicastUDPSocket()
@@ -428,8 +685,6 @@ void UDPListener::initUnicastUDPSocket()
    static const int BUFFER_SIZE_UDP = SETTINGS.get<quint32>("udp_buffer_size");
    this->unicastSocket.setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, BUFFER_SIZE_UDP);
    this->unicastSocket.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, BUFFER_SIZE_UDP);
-
-   connect(&this->unicastSocket, &QUdpSocket::readyRead, this, &UDPListener::processPendingUnicastDatagrams);
 }
 
 /**
@@ -448,33 +703,12 @@ int UDPListener::writeMessageToBuffer(Common::MessageHeader::MessageType type, c
 }
 
 /**
-  * @return A null header if error.
+  * @return 'false' if the message must be ignored: sent by ourself or by an unknown or dead peer.
   */
-Common::MessageHeader UDPListener::readDatagramToBuffer(QUdpSocket& socket, QHostAddress& peerAddress)
+bool UDPListener::isMessageAccepted(const Common::MessageHeader& header, const QHostAddress& peerAddress)
 {
-   quint16 port;
-   const qint64 datagramSize = socket.readDatagram(this->buffer, BUFFER_SIZE, &peerAddress, &port);
-   if (datagramSize == -1)
-   {
-      L_WARN(QString("UDPListener::readDatagramToBuffer(..): Unable to read multicast datagram from address:port: %1:%2").arg(peerAddress.toString()).arg(port));
-      return Common::MessageHeader();
-   }
-
-   Common::MessageHeader header = Common::MessageHeader::readHeader(this->buffer);
-
-   if (header.getSize() > datagramSize - Common::MessageHeader::HEADER_SIZE)
-   {
-      L_ERRO("The message size (header.size) exceeds the datagram size received");
-      header.setNull();
-      return header;
-   }
-
    if (header.getSenderID() == this->peerManager->getSelf()->getID())
-   {
-      // L_WARN("We receive a datagram from ourself, skip"); // Don't care . . .
-      header.setNull();
-      return header;
-   }
+      return false; // We receive a datagram from ourself, skip.
 
    if (header.getType() != Common::MessageHeader::CORE_IM_ALIVE)
    {
@@ -482,15 +716,13 @@ Common::MessageHeader UDPListener::readDatagramToBuffer(QUdpSocket& socket, QHos
       if (!peer)
       {
           L_WARN(QString("We receive a datagram from an unknown peer (%1), skip").arg(peerAddress.toString()));
-         header.setNull();
-         return header;
+         return false;
       }
 
       if (!peer->isAlive())
       {
           L_WARN(QString("We receive a datagram from a dead peer (%1), skip").arg(peerAddress.toString()));
-         header.setNull();
-         return header;
+         return false;
       }
 
       L_DEBU(QString("Receive a datagram UDP from %1, %2").arg(peer->toStringLog()).arg(header.toStr()));
@@ -499,7 +731,7 @@ Common::MessageHeader UDPListener::readDatagramToBuffer(QUdpSocket& socket, QHos
    {
       L_DEBU(QString("Receive a datagram UDP from %1, %2").arg(header.getSenderID().toStr()).arg(header.toStr()));
    }
-   return header;
+   return true;
 }
 
 Common::Hash UDPListener::getOwnID() const
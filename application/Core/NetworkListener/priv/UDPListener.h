@@ -21,8 +21,11 @@
 #include <QObject>
 #include <QUdpSocket>
 #include <QTimer>
+#include <QHash>
+#include <QSet>
 #include <QSharedPointer>
 #include <QNetworkInterface>
+#include <QBitArray>
 #include <QUdpSocket>
 
 #include <google/protobuf/message.h>
@@ -40,6 +43,10 @@
 #include <Core/UploadManager/IUploadManager.h>
 #include <Core/DownloadManager/IDownloadManager.h>
 #include <INetworkListener.h>
+#include <priv/DatagramReceiver.h>
+#include <priv/DatagramSender.h>
+#include <priv/FindProcessor.h>
+#include <priv/LocateQueries.h>
 
 namespace NL
 {
@@ -52,6 +59,9 @@ namespace NL
 
       static const int MAX_NICK_LENGTH = 255; // Datagram UDP are limited in size, this limit avoid to fill the whole datagram with only a nickname.
 
+      static const int LOCATE_CHUNKS_PERIOD = 1000; // [ms]. A 'HaveChunks' query is forgotten after one or two periods.
+      static const int MAX_NB_HAVE_CHUNKS_PER_PERIOD = 4;
+
    public:
       UDPListener(
          QSharedPointer<FM::IFileManager> fileManager,
@@ -60,12 +70,18 @@ namespace NL
          QSharedPointer<DM::IDownloadManager> downloadManager,
          quint16 unicastPort
       );
+      ~UDPListener();
 
       INetworkListener::SendStatus send(Common::MessageHeader::MessageType type, const google::protobuf::Message& message, const Common::Hash& peerID);
       INetworkListener::SendStatus send(Common::MessageHeader::MessageType type, const google::protobuf::Message& message = Protos::Common::Null());
 
       void rebindSockets();
 
+      INetworkListener::FindStats getFindStats() const;
+
+      static void setChunkBitmap(Protos::Core::ChunksOwned& chunksOwnedMessage, const QBitArray& chunkStates);
+      static bool getChunkBitmap(const Protos::Core::ChunksOwned& chunksOwnedMessage, int nbChunks, QBitArray& chunkStates);
+
    signals:
       /**
         * This signal is emitted when a message is received (unicast or multicast).
@@ -76,27 +92,43 @@ namespace NL
 
    private slots:
       void sendIMAliveMessage();
-      void processPendingMulticastDatagrams();
-      void processPendingUnicastDatagrams();
+      void locateChunks();
+      void processReceivedDatagrams();
+      void sendFindResults();
 
       void initMulticastUDPSocket();
       void initUnicastUDPSocket();
 
    private:
+      void processMulticastMessage(const Common::Message& message, const QHostAddress& peerAddress, bool receivedByUnicast);
+      void processUnicastMessage(const Common::Message& message, const QHostAddress& peerAddress);
+
+      void startReceiving();
+
+      void loadUnicastPeers();
+      QList<DatagramSender::Destination> getUnicastDestinations();
+      bool allPeersUnderstandHashPrefixes();
+      static bool isMulticastMessage(Common::MessageHeader::MessageType type);
+
       int writeMessageToBuffer(Common::MessageHeader::MessageType type, const google::protobuf::Message& message);
-      Common::MessageHeader readDatagramToBuffer(QUdpSocket& socket, QHostAddress& peerAddress);
+      bool isMessageAccepted(const Common::MessageHeader& header, const QHostAddress& peerAddress);
 
       Common::Hash getOwnID() const;
 
       const int MAX_UDP_DATAGRAM_PAYLOAD_SIZE;
 
-      char buffer[BUFFER_SIZE]; // Buffer used when sending or receiving datagram.
-      char* const bodyBuffer;
+      char buffer[BUFFER_SIZE]; // Buffer used when sending datagram.
 
       const quint16 UNICAST_PORT;
       const quint16 MULTICAST_PORT;
+      const bool MULTICAST_DISCOVERY;
       QHostAddress multicastGroup;
 
+      // The multicast messages are also sent by unicast to these peers, see 'Protos::CoreSettings::unicast_peers'.
+      QList<DatagramSender::Destination> staticUnicastPeers;
+      QSet<Common::Hash> learnedUnicastPeers; ///< The peers sending us their 'IMAlive' messages by unicast.
+      QSet<Common::Hash> peersNotUnderstandingHashPrefixes; ///< See 'allPeersUnderstandHashPrefixes()'.
+
       QSharedPointer<FM::IFileManager> fileManager;
       QSharedPointer<PM::IPeerManager> peerManager;
       QSharedPointer<UM::IUploadManager> uploadManager;
@@ -104,6 +136,8 @@ namespace NL
 
       QUdpSocket multicastSocket;
       QUdpSocket unicastSocket;
+      DatagramReceiver datagramReceiver; // Must be destroyed before the sockets.
+      FindProcessor findProcessor;
 
       quint64 currentIMAliveTag;
       QList<QSharedPointer<DM::IChunkDownloader>> currentChunkDownloaders;
@@ -114,7 +148,10 @@ namespace NL
       };
       HashRequestType nextHashRequestType;
 
+      LocateQueries locateQueries;
+
       QTimer timerIMAlive;
+      QTimer timerLocateChunks;
       QSharedPointer<LM::ILogger> loggerIMAlive; // A logger especially for the IMAlive message.
    };
 }
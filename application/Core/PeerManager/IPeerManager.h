@@ -53,6 +53,7 @@ namespace PM
       /**
         * Return all alive peers. A peer is never deleted but can become inactive.
         * @remarks This list doesn't include us ('getSelf()').
+        * @remarks The list is a snapshot shared between the callers, it isn't copied and isn't modified afterwards.
         */
       virtual QList<IPeer*> getPeers() const = 0;
 
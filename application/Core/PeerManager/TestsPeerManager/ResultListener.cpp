@@ -64,6 +64,11 @@ quint32 ResultListener::getNbHashReceivedFromLastGetHashes()
    return this->currentHash;
 }
 
+QList<quint32> ResultListener::getHashNumsFromLastGetHashes() const
+{
+   return this->hashNums;
+}
+
 bool ResultListener::isStreamReceived()
 {
    return this->streamReceived;
@@ -79,6 +84,7 @@ void ResultListener::hashesResult(const Protos::Core::GetHashesResult& result)
 {
    this->nbHashes = result.nb_hash();
    this->currentHash = 0;
+   this->hashNums.clear();
    qDebug() << "ResultListener::hashesResult : " << Common::ProtoHelper::getDebugStr(result);
 }
 
@@ -87,6 +93,7 @@ void ResultListener::nextHashResult(const Protos::Core::HashResult& hashResult)
    this->lastHashReceived = hashResult.hash().hash();
    qDebug() << "ResultListener::nextHashResult (" << hashResult.num() << ") : [" << this->currentHash + 1 << "/" << this->nbHashes << "] " << this->lastHashReceived.toStr();
    this->currentHash++;
+   this->hashNums << hashResult.num();
 }
 
 void ResultListener::chunkResult(const Protos::Core::GetChunkResult& result)
@@ -43,6 +43,7 @@ public:
    const Protos::Core::GetHashesResult& getLastGetHashesResult();
    const Common::Hash& getLastReceivedHash();
    quint32 getNbHashReceivedFromLastGetHashes();
+   QList<quint32> getHashNumsFromLastGetHashes() const;
 
    bool isStreamReceived();
 
@@ -64,6 +65,7 @@ private:
    quint32 nbHashes;
    quint32 currentHash;
    Common::Hash lastHashReceived;
+   QList<quint32> hashNums; // The numbers of the hashes received since the last 'GetHashesResult', in the order of reception.
 
    bool streamReceived;
 };
@@ -309,6 +309,9 @@ void Tests::askForHashes()
       if (timer.elapsed() > 30000)
          QFAIL("We don't receive all the hashes");
    }
+
+   // The hashes are sent with some 'HashResults' messages and expanded in order.
+   QCOMPARE(this->resultListener.getHashNumsFromLastGetHashes(), QList<quint32>() << 0 << 1 << 2 << 3);
 }
 
 void Tests::askForAChunk()
@@ -336,6 +339,137 @@ void Tests::askForAChunk()
    }
 }
 
+#include <priv/ConnectionPool.h>
+
+void Tests::prewarmSocketsSizing()
+{
+   // No demand: nothing to open, the idle sockets are kept until 'idle_socket_timeout'.
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(0, 0, 6), 0);
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(0, 2, 6), 0);
+
+   // As many idle sockets as the demand.
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(3, 0, 6), 3);
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(3, 1, 6), 2);
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(3, 3, 6), 0);
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(3, 5, 6), 0);
+
+   // Never more than 'max_number_idle_socket'.
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(10, 0, 6), 6);
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(10, 4, 6), 2);
+   QCOMPARE(ConnectionPool::getNbSocketsToPrewarm(10, 8, 6), 0);
+}
+
+#include <Common/Network/Message.h>
+#include <priv/PeerMessageSocket.h>
+#include <priv/GetHashesResult.h>
+
+/**
+  * The hashes packed in a 'HashResults' message are sent and received then expanded with their numbers.
+  */
+void Tests::hashResultsRoundTrip()
+{
+   QList<Protos::Core::HashResult> sentHashResults;
+   Protos::Core::HashResults hashResults;
+   for (quint32 num = 10; num < 15; num++)
+   {
+      Protos::Core::HashResult hashResult;
+      hashResult.set_num(num);
+      hashResult.mutable_hash()->set_hash(Common::Hash::rand().getData(), Common::Hash::HASH_SIZE);
+      PeerMessageSocket::appendHashResult(hashResults, hashResult);
+      sentHashResults << hashResult;
+   }
+   QCOMPARE(static_cast<int>(hashResults.hashes().size()), 5 * Common::Hash::HASH_SIZE);
+
+   char buffer[1024];
+   const int size = Common::Message::writeMessageToBuffer(buffer, sizeof(buffer), Common::MessageHeader(Common::MessageHeader::CORE_HASH_RESULTS, hashResults.ByteSizeLong(), Common::Hash::rand()), &hashResults);
+   QVERIFY(size > 0);
+   const Common::Message message = Common::Message::readMessage(buffer, size);
+   QVERIFY(message.getHeader().getType() == Common::MessageHeader::CORE_HASH_RESULTS);
+
+   QList<Protos::Core::HashResult> receivedHashResults;
+   QVERIFY(GetHashesResult::expandHashResults(message.getMessage<Protos::Core::HashResults>(), receivedHashResults));
+   QCOMPARE(receivedHashResults.size(), sentHashResults.size());
+   for (int i = 0; i < sentHashResults.size(); i++)
+   {
+      QCOMPARE(receivedHashResults[i].num(), sentHashResults[i].num());
+      QVERIFY(receivedHashResults[i].hash().hash() == sentHashResults[i].hash().hash());
+   }
+
+   // An empty message is valid.
+   receivedHashResults.clear();
+   QVERIFY(GetHashesResult::expandHashResults(Protos::Core::HashResults(), receivedHashResults));
+   QVERIFY(receivedHashResults.isEmpty());
+
+   // The size of the hashes must match the number of hashes.
+   Protos::Core::HashResults truncatedHashResults(hashResults);
+   truncatedHashResults.mutable_hashes()->resize(truncatedHashResults.hashes().size() - 1);
+   QVERIFY(!GetHashesResult::expandHashResults(truncatedHashResults, receivedHashResults));
+
+   Protos::Core::HashResults oneNumMoreHashResults(hashResults);
+   oneNumMoreHashResults.add_num(15);
+   QVERIFY(!GetHashesResult::expandHashResults(oneNumMoreHashResults, receivedHashResults));
+   QVERIFY(receivedHashResults.isEmpty());
+}
+
+/**
+  * 'IPeerManager::getPeers()' returns a cached list of the alive peers, it must be rebuilt when a peer becomes alive or dead.
+  * A peer manager without connection is used to control the state of its peers.
+  */
+void Tests::alivePeersSnapshot()
+{
+   qDebug() << "===== alivePeersSnapshot() =====";
+
+   const quint32 IMAlivePeriod = SETTINGS.get<quint32>("peer_imalive_period");
+   const double timeoutFactor = SETTINGS.get<double>("peer_timeout_factor");
+   SETTINGS.set("peer_imalive_period", 100u); // The peers created below are dead after 200 ms without update.
+   SETTINGS.set("peer_timeout_factor", 2.0);
+   SETTINGS.set("peer_id", Common::Hash::fromStr("3333333333333333333333333333333333333333"));
+   QSharedPointer<IPeerManager> peerManager = Builder::newPeerManager(this->fileManagers[0]);
+
+   const Common::Hash ID1 = Common::Hash::fromStr("4444444444444444444444444444444444444444");
+   const Common::Hash ID2 = Common::Hash::fromStr("5555555555555555555555555555555555555555");
+   auto update = [&](const Common::Hash& ID) {
+      peerManager->updatePeer(ID, QHostAddress::LocalHost, PORT, "peer", 0, QString(), 0, 0, Common::Constants::PROTOCOL_VERSION);
+   };
+
+   QVERIFY(peerManager->getPeers().isEmpty());
+
+   // Becoming alive.
+   update(ID1);
+   const QList<IPeer*> snapshot = peerManager->getPeers();
+   QCOMPARE(snapshot.size(), 1);
+   update(ID2);
+   QCOMPARE(peerManager->getPeers().size(), 2);
+   update(ID1); // Already alive.
+   QCOMPARE(peerManager->getPeers().size(), 2);
+
+   // Set as dead, only by its own address.
+   peerManager->removePeer(ID1, QHostAddress("192.0.2.1"));
+   QCOMPARE(peerManager->getPeers().size(), 2);
+   peerManager->removePeer(ID1, QHostAddress::LocalHost);
+   QCOMPARE(peerManager->getPeers().size(), 1);
+   QVERIFY(peerManager->getPeers().first()->getID() == ID2);
+
+   // Timeout.
+   for (int i = 0; i < 20 && !peerManager->getPeers().isEmpty(); i++)
+      QTest::qWait(50);
+   QVERIFY(peerManager->getPeers().isEmpty());
+
+   // Alive again and all removed.
+   update(ID1);
+   update(ID2);
+   QCOMPARE(peerManager->getPeers().size(), 2);
+   peerManager->removeAllPeers();
+   QVERIFY(peerManager->getPeers().isEmpty());
+
+   // A list returned earlier isn't changed by the rebuilds.
+   QCOMPARE(snapshot.size(), 1);
+   QVERIFY(snapshot.first()->getID() == ID1);
+
+   SETTINGS.set("peer_imalive_period", IMAlivePeriod);
+   SETTINGS.set("peer_timeout_factor", timeoutFactor);
+}
+
 void Tests::cleanupTestCase()
 {
    qDebug() << "===== cleanupTestCase() =====";
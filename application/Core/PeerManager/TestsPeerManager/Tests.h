@@ -55,6 +55,9 @@ private slots:
    void askForSomeEntries();
    void askForHashes();
    void askForAChunk();
+   void prewarmSocketsSizing();
+   void hashResultsRoundTrip();
+   void alivePeersSnapshot();
    void cleanupTestCase();
 
 private:
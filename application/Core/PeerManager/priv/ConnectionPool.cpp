@@ -40,10 +40,11 @@ using namespace PM;
   * The socket will be occupied for a moment to receive or send the stream of data and cannot handle others messages.
   *
   * The method 'getASocket()' may reuse a existing socket or create a new connection to the peer.
+  * Some idle connections are opened in advance depending of the demand, see 'prewarmSockets()'.
   */
 
 ConnectionPool::ConnectionPool(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManager, const Common::Hash& peerID) :
-   peerManager(peerManager), fileManager(fileManager), peerID(peerID)
+   peerManager(peerManager), fileManager(fileManager), demand(0), port(0), peerID(peerID)
 {
 }
 
@@ -75,21 +76,22 @@ void ConnectionPool::newConnexion(QTcpSocket* tcpSocket)
   */
 QSharedPointer<PeerMessageSocket> ConnectionPool::getASocket()
 {
-   for (QListIterator<QSharedPointer<PeerMessageSocket>> i(this->socketsToPeer); i.hasNext();)
+   QSharedPointer<PeerMessageSocket> socket = this->takeAnIdleSocket();
+
+   if (socket.isNull())
    {
-      QSharedPointer<PeerMessageSocket> socket = i.next();
-      if (!socket->isActive())
+      if (this->peerIP.isNull())
       {
-         socket->setActive();
+         L_ERRO("ConnectionPool::getASocket(): Unable to get a socket");
          return socket;
       }
+      socket = this->addNewSocket(QSharedPointer<PeerMessageSocket>(new PeerMessageSocket(this->peerManager, this->fileManager, this->peerID, this->peerIP, this->port)), TO_PEER);
    }
 
-   if (!this->peerIP.isNull())
-      return this->addNewSocket(QSharedPointer<PeerMessageSocket>(new PeerMessageSocket(this->peerManager, this->fileManager, this->peerID, this->peerIP, this->port)), TO_PEER);
+   this->updateDemand();
+   this->prewarmSockets();
 
-   L_ERRO("ConnectionPool::getASocket(): Unable to get a socket");
-   return QSharedPointer<PeerMessageSocket>();
+   return socket;
 }
 
 void ConnectionPool::closeAllSocket()
@@ -176,6 +178,80 @@ QSharedPointer<PeerMessageSocket> ConnectionPool::addNewSocket(QSharedPointer<Pe
    return socket;
 }
 
+/**
+  * Return an idle and established connection to the peer and set it as active.
+  * Return a null pointer if there is no such socket, the ones being established are left to the next requests.
+  */
+QSharedPointer<PeerMessageSocket> ConnectionPool::takeAnIdleSocket()
+{
+   QSharedPointer<PeerMessageSocket> idleSocket;
+   for (QListIterator<QSharedPointer<PeerMessageSocket>> i(this->socketsToPeer); i.hasNext();)
+   {
+      QSharedPointer<PeerMessageSocket> socket = i.next();
+      if (!socket->isActive() && socket->isConnected())
+      {
+         idleSocket = socket;
+         break;
+      }
+   }
+
+   if (!idleSocket.isNull())
+      idleSocket->setActive();
+   return idleSocket;
+}
+
+/**
+  * The demand is the maximum number of sockets to the peer used at the same time during the last 'idle_socket_timeout'.
+  */
+void ConnectionPool::updateDemand()
+{
+   static const qint64 IDLE_SOCKET_TIMEOUT = SETTINGS.get<quint32>("idle_socket_timeout");
+
+   int nbActiveSockets = 0;
+   for (QListIterator<QSharedPointer<PeerMessageSocket>> i(this->socketsToPeer); i.hasNext();)
+      if (i.next()->isActive())
+         nbActiveSockets++;
+
+   if (nbActiveSockets >= this->demand || !this->demandTimer.isValid() || this->demandTimer.elapsed() > IDLE_SOCKET_TIMEOUT)
+   {
+      this->demand = nbActiveSockets;
+      this->demandTimer.start();
+   }
+}
+
+/**
+  * The number of connections to open in advance to have as many idle sockets as the demand, without exceeding 'maxNbIdleSockets'.
+  */
+int ConnectionPool::getNbSocketsToPrewarm(int demand, int nbIdleSockets, int maxNbIdleSockets)
+{
+   return qMax(0, qMin(demand, maxNbIdleSockets) - nbIdleSockets);
+}
+
+/**
+  * Open some connections in advance so the next requests don't wait for the TCP handshake, the connections are
+  * established in parallel. There are as many idle sockets as the demand, thus a peer to which we don't ask anything
+  * has no warm socket and the ones opened for nothing are closed after 'idle_socket_timeout'.
+  * The remote peer drops a new connection if it doesn't receive any data during 'pending_socket_timeout' (10 s),
+  * before 'idle_socket_timeout' (1 min). Thus each warm socket identifies itself right away, the remote peer then
+  * keeps it until its own 'idle_socket_timeout', see 'PeerMessageSocket::identify()'.
+  */
+void ConnectionPool::prewarmSockets()
+{
+   static const bool PREWARM_SOCKETS = SETTINGS.get<bool>("prewarm_sockets");
+   static const int MAX_NUMBER_IDLE_SOCKET = SETTINGS.get<quint32>("max_number_idle_socket");
+
+   if (!PREWARM_SOCKETS || this->peerIP.isNull())
+      return;
+
+   int nbIdleSockets = 0;
+   for (QListIterator<QSharedPointer<PeerMessageSocket>> i(this->socketsToPeer); i.hasNext();)
+      if (!i.next()->isActive())
+         nbIdleSockets++;
+
+   for (int n = getNbSocketsToPrewarm(this->demand, nbIdleSockets, MAX_NUMBER_IDLE_SOCKET); n > 0; n--)
+      this->addNewSocket(QSharedPointer<PeerMessageSocket>(new PeerMessageSocket(this->peerManager, this->fileManager, this->peerID, this->peerIP, this->port, true)), TO_PEER)->identify();
+}
+
 QList<QSharedPointer<PeerMessageSocket>> ConnectionPool::getAllSockets() const
 {
    QList<QSharedPointer<PeerMessageSocket>> allSockets;
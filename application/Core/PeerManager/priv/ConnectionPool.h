@@ -21,6 +21,7 @@
 #include <QtNetwork>
 #include <QList>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QSharedPointer>
 
 #include <Common/Uncopyable.h>
@@ -50,6 +51,8 @@ namespace PM
       QSharedPointer<PeerMessageSocket> getASocket();
       void closeAllSocket();
 
+      static int getNbSocketsToPrewarm(int demand, int nbIdleSockets, int maxNbIdleSockets);
+
    private slots:
       void socketBecomeIdle(PeerMessageSocket* socket);
       void socketClosed(PeerMessageSocket* socket);
@@ -58,6 +61,9 @@ namespace PM
    private:
       enum Direction { TO_PEER, FROM_PEER };
       QSharedPointer<PeerMessageSocket> addNewSocket(QSharedPointer<PeerMessageSocket> socket, Direction direction);
+      QSharedPointer<PeerMessageSocket> takeAnIdleSocket();
+      void updateDemand();
+      void prewarmSockets();
       QList<QSharedPointer<PeerMessageSocket>> getAllSockets() const;
 
       PeerManager* peerManager;
@@ -66,6 +72,9 @@ namespace PM
       QList<QSharedPointer<PeerMessageSocket>> socketsToPeer;
       QList<QSharedPointer<PeerMessageSocket>> socketsFromPeer;
 
+      int demand; ///< The maximum number of sockets to the peer used at the same time since 'demandTimer' has been started.
+      QElapsedTimer demandTimer;
+
       QHostAddress peerIP;
       quint16 port;
       const Common::Hash peerID;
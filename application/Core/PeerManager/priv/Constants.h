@@ -23,4 +23,5 @@
 namespace PM
 {
    const int MAX_NICK_LENGTH = 255; // To avoid infinite nick length ;).
+   const int MAX_NB_HASHES_PER_HASH_RESULTS = 1024; // About 24 KiB per 'HashResults' message.
 }
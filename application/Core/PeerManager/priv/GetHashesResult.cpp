@@ -32,6 +32,7 @@ void GetHashesResult::start()
 {
    Protos::Core::GetHashes message;
    message.mutable_file()->CopyFrom(this->file);
+   message.set_batch_results(true);
    connect(this->socket.data(), SIGNAL(newMessage(Common::Message)), this, SLOT(newMessage(Common::Message)), Qt::DirectConnection);
    socket->send(Common::MessageHeader::CORE_GET_HASHES, message);
    this->startTimer();
@@ -45,6 +46,28 @@ void GetHashesResult::doDeleteLater()
    this->deleteLater();
 }
 
+/**
+  * Split a 'HashResults' message into one 'HashResult' per hash, see 'PeerMessageSocket::appendHashResult(..)'.
+  * @return 'false' if the size of the hashes doesn't match the number of hashes, 'hashResultList' is then left unchanged.
+  */
+bool GetHashesResult::expandHashResults(const Protos::Core::HashResults& hashResults, QList<Protos::Core::HashResult>& hashResultList)
+{
+   const std::string& hashes = hashResults.hashes();
+   if (hashes.size() != static_cast<size_t>(hashResults.num_size()) * Common::Hash::HASH_SIZE)
+      return false;
+
+   hashResultList.reserve(hashResultList.size() + hashResults.num_size());
+   for (int i = 0; i < hashResults.num_size(); i++)
+   {
+      Protos::Core::HashResult hashResult;
+      hashResult.set_num(hashResults.num(i));
+      hashResult.mutable_hash()->set_hash(hashes.data() + i * Common::Hash::HASH_SIZE, Common::Hash::HASH_SIZE);
+      hashResultList << hashResult;
+   }
+
+   return true;
+}
+
 void GetHashesResult::newMessage(const Common::Message& message)
 {
    switch (message.getHeader().getType())
@@ -65,6 +88,23 @@ void GetHashesResult::newMessage(const Common::Message& message)
       }
       break;
 
+   case Common::MessageHeader::CORE_HASH_RESULTS:
+      {
+         const Protos::Core::HashResults& hashResults = message.getMessage<Protos::Core::HashResults>();
+         this->startTimer(); // Restart the timer.
+
+         QList<Protos::Core::HashResult> hashResultList;
+         if (!expandHashResults(hashResults, hashResultList))
+         {
+            L_WARN(QString("GetHashesResult::newMessage(..): malformed HashResults message, %1 numbers for %2 bytes of hashes").arg(hashResults.num_size()).arg(hashResults.hashes().size()));
+            break;
+         }
+
+         for (QListIterator<Protos::Core::HashResult> i(hashResultList); i.hasNext();)
+            emit nextHash(i.next());
+      }
+      break;
+
    default:;
    }
 }
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <QObject>
+#include <QList>
 #include <QSharedPointer>
 
 #include <google/protobuf/message.h>
@@ -42,6 +43,8 @@ namespace PM
       void start();
       void doDeleteLater();
 
+      static bool expandHashResults(const Protos::Core::HashResults& hashResults, QList<Protos::Core::HashResult>& hashResultList);
+
    private slots:
       void newMessage(const Common::Message& message);
 
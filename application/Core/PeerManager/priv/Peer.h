@@ -90,6 +90,7 @@ namespace PM
 
    signals:
       void unblocked();
+      void becomesDead();
 
    protected slots:
       void consideredDead();
@@ -36,7 +36,7 @@ using namespace PM;
 LOG_INIT_CPP(PeerManager)
 
 PeerManager::PeerManager(QSharedPointer<FM::IFileManager> fileManager) :
-   fileManager(fileManager), self(new PeerSelf(this, this->fileManager))
+   fileManager(fileManager), self(new PeerSelf(this, this->fileManager)), alivePeersUpToDate(true)
 {
    this->timer.setInterval(SETTINGS.get<quint32>("pending_socket_timeout") / 10);
    connect(&this->timer, &QTimer::timeout, this, &PeerManager::checkIdlePendingSockets);
@@ -44,7 +44,7 @@ PeerManager::PeerManager(QSharedPointer<FM::IFileManager> fileManager) :
 
 PeerManager::~PeerManager()
 {
-   for (QMapIterator<Common::Hash, Peer*> i(this->peers); i.hasNext();)
+   for (QHashIterator<Common::Hash, Peer*> i(this->peers); i.hasNext();)
       delete i.next().value();
    delete this->self;
 
@@ -66,25 +66,24 @@ IPeer* PeerManager::getSelf()
 
 int PeerManager::getNbOfPeers() const
 {
-   int n = 0;
-   for (QMapIterator<Common::Hash, Peer*> i(this->peers); i.hasNext();)
-      if (i.next().value()->isAlive())
-         n++;
-   return n;
+   return this->getPeers().size();
 }
 
 QList<IPeer*> PeerManager::getPeers() const
 {
-   QList<IPeer*> peers;
-
-   for (QMapIterator<Common::Hash, Peer*> i(this->peers); i.hasNext();)
+   if (!this->alivePeersUpToDate)
    {
-      Peer* peer = i.next().value();
-      if (peer->isAlive())
-         peers << peer;
+      this->alivePeers.clear();
+      for (QHashIterator<Common::Hash, Peer*> i(this->peers); i.hasNext();)
+      {
+         Peer* peer = i.next().value();
+         if (peer->isAlive())
+            this->alivePeers << peer;
+      }
+      this->alivePeersUpToDate = true;
    }
 
-   return peers;
+   return this->alivePeers;
 }
 
 IPeer* PeerManager::getPeer(const Common::Hash& ID)
@@ -108,11 +107,7 @@ IPeer* PeerManager::createPeer(const Common::Hash& ID, const QString& nick)
    if (existingPeer)
       return existingPeer;
 
-   Peer* peer = new Peer(this, this->fileManager, ID, nick);
-   connect(peer, &Peer::unblocked, this, &PeerManager::peerUnblocked);
-   this->peers.insert(peer->getID(), peer);
-
-   return peer;
+   return this->newPeer(ID, nick);
 }
 
 /**
@@ -137,16 +132,15 @@ void PeerManager::updatePeer(
 
    Peer* peer = static_cast<Peer*>(this->getPeer(ID));
    if (!peer)
-   {
-      peer = new Peer(this, this->fileManager, ID);
-      connect(peer, &Peer::unblocked, this, &PeerManager::peerUnblocked);
-      this->peers.insert(peer->getID(), peer);
-   }
+      peer = this->newPeer(ID);
 
    const bool wasDead = !peer->isAlive();
 
    peer->update(IP, port, nick, sharingAmount, coreVersion, downloadRate, uploadRate, protocolVersion);
 
+   if (wasDead)
+      this->alivePeersUpToDate = false;
+
    if (wasDead && peer->isAvailable())
       emit peerBecomesAvailable(peer);
 }
@@ -163,7 +157,7 @@ void PeerManager::removePeer(const Common::Hash& ID, const QHostAddress& IP)
 
 void PeerManager::removeAllPeers()
 {
-   for (QMapIterator<Common::Hash, Peer*> i(this->peers); i.hasNext();)
+   for (QHashIterator<Common::Hash, Peer*> i(this->peers); i.hasNext();)
       i.next().value()->setAsDead();
 }
 
@@ -268,6 +262,20 @@ void PeerManager::peerUnblocked()
       emit peerBecomesAvailable(peer);
 }
 
+void PeerManager::peerBecomesDead()
+{
+   this->alivePeersUpToDate = false;
+}
+
+Peer* PeerManager::newPeer(const Common::Hash& ID, const QString& nick)
+{
+   Peer* peer = new Peer(this, this->fileManager, ID, nick);
+   connect(peer, &Peer::unblocked, this, &PeerManager::peerUnblocked);
+   connect(peer, &Peer::becomesDead, this, &PeerManager::peerBecomesDead);
+   this->peers.insert(peer->getID(), peer);
+   return peer;
+}
+
 void PeerManager::removeFromPending(QTcpSocket* socket)
 {
    for (QMutableListIterator<PendingSocket> i(this->pendingSockets); i.hasNext();)
@@ -19,7 +19,7 @@
 #pragma once
 
 #include <QObject>
-#include <QMap>
+#include <QHash>
 #include <QString>
 #include <QTimer>
 #include <QElapsedTimer>
@@ -92,8 +92,10 @@ namespace PM
       void disconnected(QTcpSocket* tcpSocket = nullptr);
       void checkIdlePendingSockets();
       void peerUnblocked();
+      void peerBecomesDead();
 
    private:
+      Peer* newPeer(const Common::Hash& ID, const QString& nick = QString());
       void removeFromPending(QTcpSocket* socket);
 
       LOG_INIT_H("PeerManager")
@@ -101,7 +103,12 @@ namespace PM
       QSharedPointer<FM::IFileManager> fileManager;
 
       PeerSelf* self; // Ourself.
-      QMap<Common::Hash, Peer*> peers; // The other peers.
+      QHash<Common::Hash, Peer*> peers; // The other peers.
+
+      // The alive peers, rebuilt by 'getPeers()' only when a peer becomes alive or dead. As the list is implicitly shared
+      // the callers get it without any copy.
+      mutable QList<IPeer*> alivePeers;
+      mutable bool alivePeersUpToDate;
 
       QTimer timer; ///< Used to check periodically if some pending sockets have timeouted.
       QList<PendingSocket> pendingSockets;
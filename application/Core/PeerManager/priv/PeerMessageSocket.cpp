@@ -42,13 +42,16 @@ void PeerMessageSocket::Logger::logError(const QString& message)
 }
 
 PeerMessageSocket::PeerMessageSocket(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManager, const Common::Hash& remotePeerID, QTcpSocket* socket) :
-   MessageSocket(new PeerMessageSocket::Logger(), socket, peerManager->getSelf()->getID(), remotePeerID), fileManager(fileManager), active(true), nbError(0)
+   MessageSocket(new PeerMessageSocket::Logger(), socket, peerManager->getSelf()->getID(), remotePeerID), fileManager(fileManager), active(true), nbError(0), nbHash(0), batchHashResults(false)
 {
    this->initUnactiveTimer();
 }
 
-PeerMessageSocket::PeerMessageSocket(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManager, const Common::Hash& remotePeerID, const QHostAddress& address, quint16 port) :
-   MessageSocket(new PeerMessageSocket::Logger(), address, port, peerManager->getSelf()->getID(), remotePeerID), fileManager(fileManager), active(true), nbError(0)
+/**
+  * @param idle 'true' for a connection opened in advance, see 'ConnectionPool::prewarmSockets()'.
+  */
+PeerMessageSocket::PeerMessageSocket(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManager, const Common::Hash& remotePeerID, const QHostAddress& address, quint16 port, bool idle) :
+   MessageSocket(new PeerMessageSocket::Logger(), address, port, peerManager->getSelf()->getID(), remotePeerID), fileManager(fileManager), active(!idle), nbError(0), nbHash(0), batchHashResults(false)
 {
    this->initUnactiveTimer();
 }
@@ -128,6 +131,17 @@ void PeerMessageSocket::send(Common::MessageHeader::MessageType type, const goog
    this->MessageSocket::send(type, message);
 }
 
+/**
+  * Send a message without body ('HELLO') to tell the remote peer who we are, the socket stays idle.
+  * The remote peer gives a new connection to the pool of the sender of its first message and drops the connections
+  * without data after 'pending_socket_timeout', see 'ConnectionPool::prewarmSockets()'. The message is ignored on reception
+  * and the following ones are read in the same pass, the older cores read it as a 'Null' message.
+  */
+void PeerMessageSocket::identify()
+{
+   this->MessageSocket::send(Common::MessageHeader::CORE_HELLO);
+}
+
 /**
   * Is the socket currently been used?
   */
@@ -197,15 +211,48 @@ void PeerMessageSocket::close()
   */
 void PeerMessageSocket::nextAskedHash(Protos::Core::HashResult hash)
 {
-   this->send(Common::MessageHeader::CORE_HASH_RESULT, hash);
+   if (this->batchHashResults)
+   {
+      // The hashes already computed are queued in our event loop, the batch is sent once they all have been processed.
+      if (this->pendingHashResults.num_size() == 0)
+         QMetaObject::invokeMethod(this, "sendPendingHashResults", Qt::QueuedConnection);
+
+      appendHashResult(this->pendingHashResults, hash);
 
-   if (--this->nbHash == 0)
+      if (--this->nbHash == 0 || this->pendingHashResults.num_size() >= MAX_NB_HASHES_PER_HASH_RESULTS)
+         this->sendPendingHashResults();
+   }
+   else
+   {
+      this->send(Common::MessageHeader::CORE_HASH_RESULT, hash);
+      --this->nbHash;
+   }
+
+   if (this->nbHash == 0)
    {
       this->currentHashesResult.clear();
       this->finished();
    }
 }
 
+/**
+  * Add a hash and its number to a 'HashResults' message, see 'GetHashesResult::expandHashResults(..)' for the reverse.
+  */
+void PeerMessageSocket::appendHashResult(Protos::Core::HashResults& hashResults, const Protos::Core::HashResult& hashResult)
+{
+   hashResults.add_num(hashResult.num());
+   hashResults.mutable_hashes()->append(hashResult.hash().hash());
+}
+
+void PeerMessageSocket::sendPendingHashResults()
+{
+   if (this->pendingHashResults.num_size() == 0)
+      return;
+
+   this->send(Common::MessageHeader::CORE_HASH_RESULTS, this->pendingHashResults);
+   this->pendingHashResults.Clear();
+}
+
 void PeerMessageSocket::entriesResult(const Protos::Core::GetEntriesResult::EntryResult& result)
 {
    bool resultEmpty = true;
@@ -291,6 +338,8 @@ void PeerMessageSocket::onNewMessage(const Common::Message& message)
       {
          const Protos::Core::GetHashes& getHashes = message.getMessage<Protos::Core::GetHashes>();
 
+         this->batchHashResults = getHashes.batch_results();
+         this->pendingHashResults.Clear();
          this->currentHashesResult = this->fileManager->getHashes(getHashes.file());
          connect(this->currentHashesResult.data(), &FM::IGetHashesResult::nextHash, this, &PeerMessageSocket::nextAskedHash, Qt::QueuedConnection);
          Protos::Core::GetHashesResult res = this->currentHashesResult->start();
@@ -320,6 +369,14 @@ void PeerMessageSocket::onNewMessage(const Common::Message& message)
       }
       break;
 
+   case Common::MessageHeader::CORE_HASH_RESULTS:
+      {
+         const Protos::Core::HashResults& hashResults = message.getMessage<Protos::Core::HashResults>();
+         if ((this->nbHash -= hashResults.num_size()) <= 0)
+            this->finished();
+      }
+      break;
+
    case Common::MessageHeader::CORE_GET_CHUNK:
       {
          const Protos::Core::GetChunk& getChunkMessage = message.getMessage<Protos::Core::GetChunk>();
@@ -55,7 +55,7 @@ namespace PM
 
    public:
       PeerMessageSocket(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManager, const Common::Hash& remotePeerID, QTcpSocket* socket);
-      PeerMessageSocket(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManager, const Common::Hash& remotePeerID, const QHostAddress& address, quint16 port);
+      PeerMessageSocket(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManager, const Common::Hash& remotePeerID, const QHostAddress& address, quint16 port, bool idle = false);
       ~PeerMessageSocket();
 
       void setReadBufferSize(qint64 size);
@@ -76,12 +76,15 @@ namespace PM
       Common::Hash getRemotePeerID() const;
 
       void send(Common::MessageHeader::MessageType type, const google::protobuf::Message& message);
+      void identify();
 
       bool isActive() const;
       void setActive();
 
       void finished(bool closeTheSocket = false);
 
+      static void appendHashResult(Protos::Core::HashResults& hashResults, const Protos::Core::HashResult& hashResult);
+
    public slots:
       void close();
 
@@ -96,6 +99,7 @@ namespace PM
 
    private slots:
       void nextAskedHash(Protos::Core::HashResult hash);
+      void sendPendingHashResults();
       void entriesResult(const Protos::Core::GetEntriesResult::EntryResult& result);
       void entriesResultTimeout();
 
@@ -119,5 +123,7 @@ namespace PM
       // Used when asking hashes to the fileManager.
       QSharedPointer<FM::IGetHashesResult> currentHashesResult;
       int nbHash;
+      bool batchHashResults; ///< If the remote peer wants the hashes with some 'HashResults' messages, see 'Protos::Core::GetHashes::batch_results'.
+      Protos::Core::HashResults pendingHashResults; ///< The hashes not sent yet when 'batchHashResults' is true.
    };
 }
@@ -540,7 +540,9 @@ void RemoteConnection::onNewMessage(const Common::Message& message)
                findPattern.max_size() == 0 ? std::numeric_limits<qint64>::max() : (qint64)findPattern.max_size(),
                findPattern.category(),
                MAX_NUMBER_OF_RESULT_SHOWN,
-               std::numeric_limits<int>::max()
+               std::numeric_limits<int>::max(),
+               findPattern.substring_match(),
+               findPattern.max_edit_distance()
             );
 
             const quint64 tag = QRandomGenerator64::global()->generate64();